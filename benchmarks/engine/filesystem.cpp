@@ -0,0 +1,483 @@
+#include "filesystem.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+static bool PathIDMatches( const CBaseFileSystem::CSearchPath &searchpath, const char *pathid )
+{
+	return pathid == nullptr || strcasecmp( searchpath.m_pPathIDInfo->m_pDebugPathID, pathid ) == 0;
+}
+
+static bool CopyString( const std::string &str, char *dest, int maxlen )
+{
+	if( maxlen <= 0 || str.size( ) >= static_cast<size_t>( maxlen ) )
+		return false;
+
+	std::memcpy( dest, str.c_str( ), str.size( ) + 1 );
+	return true;
+}
+
+bool V_IsAbsolutePath( const char *path )
+{
+	return path[0] == '/' || path[0] == '\\' || ( path[0] != '\0' && path[1] == ':' );
+}
+
+bool V_RemoveDotSlashes( char *filename, char separator, bool removedoubleslashes )
+{
+	V_FixSlashes( filename, separator );
+
+	// in place like tier1's, components are copied down over the . and .. ones
+	char *write = filename;
+	const char *read = filename;
+	if( *read == separator )
+		*write++ = *read++;
+
+	char *const root = write;
+	while( *read != '\0' )
+	{
+		const char *end = read;
+		while( *end != separator && *end != '\0' )
+			++end;
+
+		const size_t len = static_cast<size_t>( end - read );
+		const bool last = *end == '\0';
+		if( len == 2 && read[0] == '.' && read[1] == '.' )
+		{
+			if( write == root )
+				return false;
+
+			// drops the separator after the previous component, then the component
+			--write;
+			while( write != root && write[-1] != separator )
+				--write;
+		}
+		else if( !( len == 1 && read[0] == '.' ) && ( len != 0 || !removedoubleslashes ) )
+		{
+			std::memmove( write, read, len );
+			write += len;
+			if( !last )
+				*write++ = separator;
+		}
+
+		read = last ? end : end + 1;
+	}
+
+	*write = '\0';
+	return true;
+}
+
+const char *V_GetFileExtension( const char *path )
+{
+	const char *dot = std::strrchr( path, '.' );
+	if( dot == nullptr || std::strpbrk( dot, "/\\" ) != nullptr )
+		return nullptr;
+
+	return dot + 1;
+}
+
+const char *V_GetFileName( const char *path )
+{
+	const char *name = path;
+	for( const char *pos = path; *pos != '\0'; ++pos )
+		if( *pos == '/' || *pos == '\\' )
+			name = pos + 1;
+
+	return name;
+}
+
+void V_ComposeFileName( const char *path, const char *filename, char *dest, int destsize )
+{
+	if( destsize <= 0 )
+		return;
+
+	const size_t len = std::strlen( path );
+	const bool separator = len != 0 && path[len - 1] != '/' && path[len - 1] != '\\';
+	std::snprintf( dest, static_cast<size_t>( destsize ), "%s%s%s", path, separator ? "/" : "", filename );
+	V_FixSlashes( dest );
+}
+
+bool V_StripLastDir( char *dirname, int maxlen )
+{
+	if( maxlen <= 0 || dirname[0] == '\0' )
+		return false;
+
+	size_t len = std::strlen( dirname );
+	if( dirname[len - 1] == '/' || dirname[len - 1] == '\\' )
+		--len;
+
+	while( len != 0 && dirname[len - 1] != '/' && dirname[len - 1] != '\\' )
+		--len;
+
+	if( len == 0 )
+	{
+		std::snprintf( dirname, static_cast<size_t>( maxlen ), ".%c", CORRECT_PATH_SEPARATOR );
+		return true;
+	}
+
+	dirname[len] = '\0';
+	return true;
+}
+
+void V_StripFilename( char *path )
+{
+	char *name = const_cast<char *>( V_GetFileName( path ) );
+	if( name != path )
+		--name;
+
+	*name = '\0';
+}
+
+void V_FixSlashes( char *name, char separator )
+{
+	for( ; *name != '\0'; ++name )
+		if( *name == '/' || *name == '\\' )
+			*name = separator;
+}
+
+CBaseFileSystem::CBaseFileSystem( ) :
+	nextfind( 0 )
+{ }
+
+CBaseFileSystem::~CBaseFileSystem( )
+{ }
+
+int CBaseFileSystem::GetSearchPath( const char *pathid, bool, char *dest, int maxlen )
+{
+	std::lock_guard<std::recursive_mutex> lock( mutex );
+
+	std::string list;
+	for( unsigned short k = 0; k < m_SearchPaths.Count( ); ++k )
+		if( PathIDMatches( m_SearchPaths[k], pathid ) )
+		{
+			if( !list.empty( ) )
+				list += ';';
+
+			list += m_SearchPaths[k].m_pDebugPath;
+		}
+
+	if( !CopyString( list, dest, maxlen ) )
+		return 0;
+
+	return static_cast<int>( list.size( ) + 1 );
+}
+
+void CBaseFileSystem::AddSearchPath( const char *path, const char *pathid, SearchPathAdd_t addtype )
+{
+	std::lock_guard<std::recursive_mutex> lock( mutex );
+
+	std::string fullpath = path;
+	if( fullpath.empty( ) || fullpath.back( ) != '/' )
+		fullpath += '/';
+
+	CPathIDInfo *info = nullptr;
+	for( auto it = pathids.begin( ); it != pathids.end( ); ++it )
+		if( strcasecmp( it->m_pDebugPathID, pathid ) == 0 )
+			info = &*it;
+
+	if( info == nullptr )
+	{
+		pathidnames.push_back( pathid );
+		pathids.push_back( CPathIDInfo{ pathidnames.back( ).c_str( ) } );
+		info = &pathids.back( );
+	}
+
+	paths.push_back( fullpath );
+	const CSearchPath searchpath = { paths.back( ).c_str( ), info, nullptr, nullptr };
+	if( addtype == PATH_ADD_TO_HEAD )
+		m_SearchPaths.AddToHead( searchpath );
+	else
+		m_SearchPaths.AddToTail( searchpath );
+}
+
+bool CBaseFileSystem::RemoveSearchPath( const char *path, const char *pathid )
+{
+	std::lock_guard<std::recursive_mutex> lock( mutex );
+
+	std::string fullpath = path;
+	if( fullpath.empty( ) || fullpath.back( ) != '/' )
+		fullpath += '/';
+
+	bool removed = false;
+	for( unsigned short k = m_SearchPaths.Count( ); k != 0; --k )
+		if( PathIDMatches( m_SearchPaths[k - 1], pathid ) && fullpath == m_SearchPaths[k - 1].m_pDebugPath )
+		{
+			m_SearchPaths.Remove( k - 1 );
+			removed = true;
+		}
+
+	return removed;
+}
+
+bool CBaseFileSystem::Resolve( const char *filename, const char *pathid, bool existing, std::string &fullpath ) const
+{
+	std::lock_guard<std::recursive_mutex> lock( mutex );
+
+	if( V_IsAbsolutePath( filename ) )
+	{
+		fullpath = filename;
+		return !existing || access( filename, F_OK ) == 0;
+	}
+
+	char path[2048] = { 0 };
+	for( unsigned short k = 0; k < m_SearchPaths.Count( ); ++k )
+		if( PathIDMatches( m_SearchPaths[k], pathid ) )
+		{
+			V_ComposeFileName( m_SearchPaths[k].m_pDebugPath, filename, path, sizeof( path ) );
+			if( !existing || access( path, F_OK ) == 0 )
+			{
+				fullpath = path;
+				return true;
+			}
+		}
+
+	return false;
+}
+
+FileHandle_t CBaseFileSystem::Open( const char *filename, const char *options, const char *pathid )
+{
+	const bool write = std::strpbrk( options, "wa+" ) != nullptr;
+	std::string fullpath;
+	if( !Resolve( filename, pathid, !write, fullpath ) )
+		return nullptr;
+
+	return std::fopen( fullpath.c_str( ), options );
+}
+
+void CBaseFileSystem::Close( FileHandle_t file )
+{
+	std::fclose( static_cast<FILE *>( file ) );
+}
+
+int CBaseFileSystem::Read( void *output, int size, FileHandle_t file )
+{
+	return static_cast<int>( std::fread( output, 1, static_cast<size_t>( size ), static_cast<FILE *>( file ) ) );
+}
+
+int CBaseFileSystem::Write( const void *input, int size, FileHandle_t file )
+{
+	return static_cast<int>( std::fwrite( input, 1, static_cast<size_t>( size ), static_cast<FILE *>( file ) ) );
+}
+
+void CBaseFileSystem::Seek( FileHandle_t file, int pos, FileSystemSeek_t seektype )
+{
+	static const int origins[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+	std::fseek( static_cast<FILE *>( file ), pos, origins[seektype] );
+}
+
+unsigned int CBaseFileSystem::Tell( FileHandle_t file )
+{
+	return static_cast<unsigned int>( std::ftell( static_cast<FILE *>( file ) ) );
+}
+
+unsigned int CBaseFileSystem::Size( FileHandle_t file )
+{
+	struct stat stats;
+	if( fstat( fileno( static_cast<FILE *>( file ) ), &stats ) != 0 )
+		return 0;
+
+	return static_cast<unsigned int>( stats.st_size );
+}
+
+void CBaseFileSystem::Flush( FileHandle_t file )
+{
+	std::fflush( static_cast<FILE *>( file ) );
+}
+
+bool CBaseFileSystem::EndOfFile( FileHandle_t file )
+{
+	return std::feof( static_cast<FILE *>( file ) ) != 0;
+}
+
+bool CBaseFileSystem::IsOk( FileHandle_t file )
+{
+	return file != nullptr && std::ferror( static_cast<FILE *>( file ) ) == 0;
+}
+
+bool CBaseFileSystem::FileExists( const char *filename, const char *pathid )
+{
+	std::string fullpath;
+	return Resolve( filename, pathid, true, fullpath );
+}
+
+bool CBaseFileSystem::IsDirectory( const char *filename, const char *pathid )
+{
+	std::string fullpath;
+	struct stat stats;
+	return Resolve( filename, pathid, true, fullpath ) && stat( fullpath.c_str( ), &stats ) == 0 &&
+		S_ISDIR( stats.st_mode );
+}
+
+unsigned int CBaseFileSystem::Size( const char *filename, const char *pathid )
+{
+	std::string fullpath;
+	struct stat stats;
+	if( !Resolve( filename, pathid, true, fullpath ) || stat( fullpath.c_str( ), &stats ) != 0 )
+		return 0;
+
+	return static_cast<unsigned int>( stats.st_size );
+}
+
+long CBaseFileSystem::GetFileTime( const char *filename, const char *pathid )
+{
+	return GetPathTime( filename, pathid );
+}
+
+long CBaseFileSystem::GetPathTime( const char *filename, const char *pathid )
+{
+	std::string fullpath;
+	struct stat stats;
+	if( !Resolve( filename, pathid, true, fullpath ) || stat( fullpath.c_str( ), &stats ) != 0 )
+		return 0;
+
+	return static_cast<long>( stats.st_mtime );
+}
+
+bool CBaseFileSystem::RenameFile( const char *oldpath, const char *newpath, const char *pathid )
+{
+	std::string fullold, fullnew;
+	return Resolve( oldpath, pathid, true, fullold ) && Resolve( newpath, pathid, false, fullnew ) &&
+		rename( fullold.c_str( ), fullnew.c_str( ) ) == 0;
+}
+
+void CBaseFileSystem::RemoveFile( const char *filename, const char *pathid )
+{
+	std::string fullpath;
+	if( Resolve( filename, pathid, true, fullpath ) )
+		unlink( fullpath.c_str( ) );
+}
+
+void CBaseFileSystem::CreateDirHierarchy( const char *path, const char *pathid )
+{
+	std::string fullpath;
+	if( !Resolve( path, pathid, false, fullpath ) )
+		return;
+
+	for( size_t pos = fullpath.find( '/', 1 ); ; pos = fullpath.find( '/', pos + 1 ) )
+	{
+		mkdir( fullpath.substr( 0, pos ).c_str( ), 0755 );
+		if( pos == fullpath.npos )
+			break;
+	}
+}
+
+const char *CBaseFileSystem::RelativePathToFullPath(
+	const char *filename,
+	const char *pathid,
+	char *dest,
+	int maxlen,
+	PathTypeFilter_t,
+	PathTypeQuery_t *pathtype
+)
+{
+	if( pathtype != nullptr )
+		*pathtype = PATH_IS_NORMAL;
+
+	std::string fullpath;
+	if( !Resolve( filename, pathid, true, fullpath ) || !CopyString( fullpath, dest, maxlen ) )
+		return nullptr;
+
+	return dest;
+}
+
+bool CBaseFileSystem::FullPathToRelativePathEx( const char *fullpath, const char *pathid, char *dest, int maxlen )
+{
+	std::lock_guard<std::recursive_mutex> lock( mutex );
+
+	char fixed[2048] = { 0 };
+	std::snprintf( fixed, sizeof( fixed ), "%s", fullpath );
+	V_FixSlashes( fixed );
+
+	const size_t length = std::strlen( fixed );
+	for( unsigned short k = 0; k < m_SearchPaths.Count( ); ++k )
+	{
+		if( !PathIDMatches( m_SearchPaths[k], pathid ) )
+			continue;
+
+		const char *searchpath = m_SearchPaths[k].m_pDebugPath;
+		const size_t len = std::strlen( searchpath );
+		if( length >= len && strncasecmp( fixed, searchpath, len ) == 0 )
+			return CopyString( fixed + len, dest, maxlen );
+	}
+
+	return false;
+}
+
+const char *CBaseFileSystem::FindFirstEx( const char *wildcard, const char *pathid, FileFindHandle_t *handle )
+{
+	std::lock_guard<std::recursive_mutex> lock( mutex );
+
+	std::string directory = wildcard, pattern = V_GetFileName( wildcard );
+	directory.resize( directory.size( ) - pattern.size( ) );
+
+	Find find;
+	find.current = 0;
+	char path[2048] = { 0 };
+	for( unsigned short k = 0; k < m_SearchPaths.Count( ); ++k )
+	{
+		if( !PathIDMatches( m_SearchPaths[k], pathid ) )
+			continue;
+
+		V_ComposeFileName( m_SearchPaths[k].m_pDebugPath, directory.c_str( ), path, sizeof( path ) );
+		DIR *dir = opendir( path );
+		if( dir == nullptr )
+			continue;
+
+		const size_t base = std::strlen( path );
+		for( dirent *entry = readdir( dir ); entry != nullptr; entry = readdir( dir ) )
+		{
+			if( fnmatch( pattern.c_str( ), entry->d_name, 0 ) != 0 ||
+				std::find( find.names.begin( ), find.names.end( ), entry->d_name ) != find.names.end( ) )
+				continue;
+
+			std::snprintf( path + base, sizeof( path ) - base, "%s%s", base != 0 && path[base - 1] != '/' ? "/" : "", entry->d_name );
+			struct stat stats;
+			find.names.push_back( entry->d_name );
+			find.directories.push_back( stat( path, &stats ) == 0 && S_ISDIR( stats.st_mode ) );
+			path[base] = '\0';
+		}
+
+		closedir( dir );
+	}
+
+	if( find.names.empty( ) )
+	{
+		*handle = FILESYSTEM_INVALID_FIND_HANDLE;
+		return nullptr;
+	}
+
+	*handle = nextfind++;
+	return finds.emplace( *handle, std::move( find ) ).first->second.names[0].c_str( );
+}
+
+const char *CBaseFileSystem::FindNext( FileFindHandle_t handle )
+{
+	std::lock_guard<std::recursive_mutex> lock( mutex );
+
+	const auto it = finds.find( handle );
+	if( it == finds.end( ) || ++it->second.current >= it->second.names.size( ) )
+		return nullptr;
+
+	return it->second.names[it->second.current].c_str( );
+}
+
+bool CBaseFileSystem::FindIsDirectory( FileFindHandle_t handle )
+{
+	std::lock_guard<std::recursive_mutex> lock( mutex );
+
+	const auto it = finds.find( handle );
+	return it != finds.end( ) && it->second.current < it->second.names.size( ) &&
+		it->second.directories[it->second.current];
+}
+
+void CBaseFileSystem::FindClose( FileFindHandle_t handle )
+{
+	std::lock_guard<std::recursive_mutex> lock( mutex );
+	finds.erase( handle );
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+// Stand-in for the parts of the Source SDK's filesystem the wrapper uses, backed by the POSIX
+// filesystem, so the benchmarks can drive the real Wrapper. Search paths are directories only and
+// are looked up in order like the engine does, there are no pack files.
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <mutex>
+
+typedef void *FileHandle_t;
+typedef int FileFindHandle_t;
+
+#define FILESYSTEM_INVALID_FIND_HANDLE -1
+#define FILESYSTEM_INTERFACE_VERSION "VFileSystem022"
+#define CORRECT_PATH_SEPARATOR '/'
+#define CORRECT_PATH_SEPARATOR_S "/"
+
+enum FileSystemSeek_t
+{
+	FILESYSTEM_SEEK_HEAD,
+	FILESYSTEM_SEEK_CURRENT,
+	FILESYSTEM_SEEK_TAIL
+};
+
+enum SearchPathAdd_t
+{
+	PATH_ADD_TO_HEAD,
+	PATH_ADD_TO_TAIL
+};
+
+enum PathTypeFilter_t
+{
+	FILTER_NONE,
+	FILTER_CULLPACK,
+	FILTER_CULLNONPACK
+};
+
+typedef uint32_t PathTypeQuery_t;
+
+#define PATH_IS_NORMAL 0x00
+#define PATH_IS_PACKFILE 0x01
+#define PATH_IS_MAPPACKFILE 0x02
+#define PATH_IS_REMOTE 0x04
+
+bool V_IsAbsolutePath( const char *path );
+bool V_RemoveDotSlashes( char *filename, char separator = CORRECT_PATH_SEPARATOR, bool removedoubleslashes = true );
+const char *V_GetFileExtension( const char *path );
+const char *V_GetFileName( const char *path );
+void V_ComposeFileName( const char *path, const char *filename, char *dest, int destsize );
+bool V_StripLastDir( char *dirname, int maxlen );
+void V_StripFilename( char *path );
+void V_FixSlashes( char *name, char separator = CORRECT_PATH_SEPARATOR );
+
+template<class T>
+class CUtlLinkedList
+{
+public:
+	unsigned short Count( ) const
+	{
+		return static_cast<unsigned short>( elements.size( ) );
+	}
+
+	const T &operator[]( unsigned short index ) const
+	{
+		return elements[index];
+	}
+
+	void AddToHead( const T &element )
+	{
+		elements.insert( elements.begin( ), element );
+	}
+
+	void AddToTail( const T &element )
+	{
+		elements.push_back( element );
+	}
+
+	void Remove( unsigned short index )
+	{
+		elements.erase( elements.begin( ) + index );
+	}
+
+private:
+	std::vector<T> elements;
+};
+
+class CUtlString
+{
+public:
+	const char *Get( ) const
+	{
+		return string.c_str( );
+	}
+
+private:
+	std::string string;
+};
+
+class CBaseFileSystem
+{
+public:
+	struct CPathIDInfo
+	{
+		const char *m_pDebugPathID;
+	};
+
+	struct CPackFile
+	{
+		CUtlString m_ZipName;
+	};
+
+	struct CPackedStore
+	{
+		char m_pszFullPathName[260];
+	};
+
+	struct CSearchPath
+	{
+		const char *m_pDebugPath;
+		CPathIDInfo *m_pPathIDInfo;
+		CPackFile *m_pPackFile;
+		CPackedStore *m_pPackFile2;
+	};
+
+	CUtlLinkedList<CSearchPath> m_SearchPaths;
+
+	CBaseFileSystem( );
+	~CBaseFileSystem( );
+
+	int GetSearchPath( const char *pathid, bool getpackfiles, char *dest, int maxlen );
+	int GetSearchPath_safe( const char *pathid, bool getpackfiles, char ( &dest )[2048] )
+	{
+		return GetSearchPath( pathid, getpackfiles, dest, static_cast<int>( sizeof( dest ) ) );
+	}
+
+	void AddSearchPath( const char *path, const char *pathid, SearchPathAdd_t addtype = PATH_ADD_TO_TAIL );
+	bool RemoveSearchPath( const char *path, const char *pathid = nullptr );
+
+	FileHandle_t Open( const char *filename, const char *options, const char *pathid = nullptr );
+	void Close( FileHandle_t file );
+	int Read( void *output, int size, FileHandle_t file );
+	int Write( const void *input, int size, FileHandle_t file );
+	void Seek( FileHandle_t file, int pos, FileSystemSeek_t seektype );
+	unsigned int Tell( FileHandle_t file );
+	unsigned int Size( FileHandle_t file );
+	void Flush( FileHandle_t file );
+	bool EndOfFile( FileHandle_t file );
+	bool IsOk( FileHandle_t file );
+
+	bool FileExists( const char *filename, const char *pathid = nullptr );
+	bool IsDirectory( const char *filename, const char *pathid = nullptr );
+	unsigned int Size( const char *filename, const char *pathid = nullptr );
+	long GetFileTime( const char *filename, const char *pathid = nullptr );
+	long GetPathTime( const char *filename, const char *pathid = nullptr );
+	bool RenameFile( const char *oldpath, const char *newpath, const char *pathid = nullptr );
+	void RemoveFile( const char *filename, const char *pathid = nullptr );
+	void CreateDirHierarchy( const char *path, const char *pathid = nullptr );
+
+	const char *RelativePathToFullPath(
+		const char *filename,
+		const char *pathid,
+		char *dest,
+		int maxlen,
+		PathTypeFilter_t filter = FILTER_NONE,
+		PathTypeQuery_t *pathtype = nullptr
+	);
+	template<size_t N>
+	const char *RelativePathToFullPath_safe(
+		const char *filename,
+		const char *pathid,
+		char ( &dest )[N],
+		PathTypeFilter_t filter = FILTER_NONE,
+		PathTypeQuery_t *pathtype = nullptr
+	)
+	{
+		return RelativePathToFullPath( filename, pathid, dest, static_cast<int>( N ), filter, pathtype );
+	}
+	bool FullPathToRelativePathEx( const char *fullpath, const char *pathid, char *dest, int maxlen );
+
+	const char *FindFirstEx( const char *wildcard, const char *pathid, FileFindHandle_t *handle );
+	const char *FindNext( FileFindHandle_t handle );
+	bool FindIsDirectory( FileFindHandle_t handle );
+	void FindClose( FileFindHandle_t handle );
+
+private:
+	struct Find
+	{
+		std::vector<std::string> names;
+		std::vector<bool> directories;
+		size_t current;
+	};
+
+	// full path of the first search path of pathid that has filename, or where it would be written
+	bool Resolve( const char *filename, const char *pathid, bool existing, std::string &fullpath ) const;
+
+	// the engine takes its search path lock on every lookup, so does this
+	mutable std::recursive_mutex mutex;
+	// search paths and path IDs keep their addresses while mounted, like the engine's
+	std::list<std::string> paths;
+	std::list<CPathIDInfo> pathids;
+	std::list<std::string> pathidnames;
+	std::map<FileFindHandle_t, Find> finds;
+	FileFindHandle_t nextfind;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+// A temporary game directory mounted on the stand-in engine (benchmarks/engine) the way a server
+// mounts garrysmod, so the benchmarks can drive the real Wrapper. Removed when it goes away.
+
+#include <filesystem.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace benchmarks
+{
+
+class GameDirectory
+{
+public:
+	GameDirectory( ) :
+		root( "/tmp/gm_filesystem_XXXXXX" )
+	{
+		if( mkdtemp( &root[0] ) == nullptr )
+		{
+			std::perror( "mkdtemp" );
+			std::exit( 1 );
+		}
+
+		garrysmod = root + "/garrysmod/";
+		MakeDirectory( garrysmod );
+		MakeDirectory( garrysmod + "data" );
+		MakeDirectory( garrysmod + "download" );
+
+		engine.AddSearchPath( garrysmod.c_str( ), "GAME" );
+		engine.AddSearchPath( ( garrysmod + "download" ).c_str( ), "GAME" );
+		engine.AddSearchPath( garrysmod.c_str( ), "MOD" );
+		engine.AddSearchPath( ( garrysmod + "lua" ).c_str( ), "LUA" );
+		engine.AddSearchPath( ( garrysmod + "data" ).c_str( ), "DATA" );
+		engine.AddSearchPath( ( garrysmod + "download" ).c_str( ), "DOWNLOAD" );
+		engine.AddSearchPath( garrysmod.c_str( ), "DEFAULT_WRITE_PATH" );
+	}
+
+	~GameDirectory( )
+	{
+		nftw( root.c_str( ), Remove, 16, FTW_DEPTH | FTW_PHYS );
+	}
+
+	// relative to garrysmod, with its parent directories
+	void AddFile( const std::string &path, const std::string &contents )
+	{
+		for( size_t pos = path.find( '/' ); pos != path.npos; pos = path.find( '/', pos + 1 ) )
+			MakeDirectory( garrysmod + path.substr( 0, pos ) );
+
+		FILE *file = std::fopen( ( garrysmod + path ).c_str( ), "wb" );
+		if( file == nullptr )
+		{
+			std::perror( path.c_str( ) );
+			std::exit( 1 );
+		}
+
+		std::fwrite( contents.c_str( ), 1, contents.size( ), file );
+		std::fclose( file );
+	}
+
+	const std::string &GetPath( ) const
+	{
+		return garrysmod;
+	}
+
+	CBaseFileSystem *GetEngine( )
+	{
+		return &engine;
+	}
+
+private:
+	static void MakeDirectory( const std::string &path )
+	{
+		mkdir( path.c_str( ), 0755 );
+	}
+
+	static int Remove( const char *path, const struct stat *, int, struct FTW * )
+	{
+		return remove( path );
+	}
+
+	std::string root;
+	std::string garrysmod;
+	CBaseFileSystem engine;
+};
+
+}
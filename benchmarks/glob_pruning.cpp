@@ -0,0 +1,113 @@
+// Directories a glob traversal lists for a few patterns over an in-memory tree, walked the way
+// Wrapper::Glob walks search paths. Exits with 1 when a pattern lists more than it should, like
+// data/* descending into the directories it matched.
+//
+// POSIX only, from the repository root:
+// g++ -std=c++11 -O2 -DSYSTEM_POSIX -DSYSTEM_LINUX -Isource benchmarks/glob_pruning.cpp source/glob.cpp -o glob_pruning
+
+#include "glob.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+using namespace filesystem;
+
+struct Entry
+{
+	std::string name;
+	bool directory;
+};
+
+typedef std::map<std::string, std::vector<Entry>> Tree;
+
+static Tree MakeTree( )
+{
+	Tree tree;
+	tree["data/"] = { { "a", true }, { "b", true }, { "x.txt", false } };
+	tree["data/a/"] = { { "c", true }, { "y.txt", false } };
+	tree["data/a/c/"] = { { "z.txt", false } };
+	tree["data/b/"] = { { "x.txt", false } };
+	return tree;
+}
+
+// returns the amount of directories listed, matches are counted in matches
+static size_t Traverse( const Tree &tree, const std::string &pattern, size_t &matches )
+{
+	GlobMatcher matcher;
+	matches = 0;
+	if( !matcher.Compile( pattern, false ) )
+		return 0;
+
+	std::vector<std::pair<std::string, GlobMatcher::State>> pending;
+	pending.emplace_back( matcher.GetBase( ), matcher.Start( ) );
+
+	size_t listed = 0;
+	GlobMatcher::State next;
+	while( !pending.empty( ) )
+	{
+		const std::pair<std::string, GlobMatcher::State> current = std::move( pending.back( ) );
+		pending.pop_back( );
+
+		const auto it = tree.find( current.first );
+		if( it == tree.end( ) )
+			continue;
+
+		++listed;
+		for( auto entry = it->second.begin( ); entry != it->second.end( ); ++entry )
+		{
+			if( matcher.Step( current.second, entry->name, next ) )
+				++matches;
+
+			if( entry->directory && !next.empty( ) )
+				pending.emplace_back( current.first + entry->name + '/', std::move( next ) );
+		}
+	}
+
+	return listed;
+}
+
+int main( )
+{
+	struct Case
+	{
+		const char *pattern;
+		size_t listed;
+		size_t matches;
+	};
+
+	static const Case cases[] = {
+		{ "data/*", 1, 3 },
+		{ "data/*.txt", 1, 1 },
+		{ "data/*/*.txt", 3, 2 },
+		{ "data/{a,b}", 1, 2 },
+		{ "data/a/*", 1, 2 },
+		{ "data/**", 4, 7 },
+		{ "data/**/x.txt", 4, 2 }
+	};
+
+	const Tree tree = MakeTree( );
+
+	bool failed = false;
+	for( size_t k = 0; k < sizeof( cases ) / sizeof( *cases ); ++k )
+	{
+		const Case &test = cases[k];
+		size_t matches = 0;
+		const size_t listed = Traverse( tree, test.pattern, matches );
+		const bool ok = listed == test.listed && matches == test.matches;
+		std::printf(
+			"%-16s listed %zu (expected %zu), matched %zu (expected %zu)%s\n",
+			test.pattern,
+			listed,
+			test.listed,
+			matches,
+			test.matches,
+			ok ? "" : "  FAILED"
+		);
+		failed = failed || !ok;
+	}
+
+	return failed ? 1 : 0;
+}
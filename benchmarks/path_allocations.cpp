@@ -0,0 +1,141 @@
+// Heap allocations and time per call of Wrapper::Exists and Wrapper::Open once their answers are
+// cached, driving the real wrapper against the stand-in engine in benchmarks/engine. Allocations
+// made on the calling thread are counted by replacing operator new. Open returns a heap allocated
+// file, closing a file from the handle cache puts its handle back in it, both are reported apart.
+//
+// POSIX only, from the repository root (the Lua bindings are left out):
+// g++ -std=c++11 -O2 -DSYSTEM_POSIX -DSYSTEM_LINUX -Ibenchmarks/engine -Isource -Isource/posix benchmarks/path_allocations.cpp benchmarks/engine/filesystem.cpp $(ls source/*.cpp source/posix/*.cpp | grep -v -e /file.cpp -e /filesystem.cpp -e /findhandle.cpp -e /main.cpp) -o path_allocations -pthread
+
+#include "gamedirectory.hpp"
+#include "filesystemwrapper.hpp"
+#include "filebase.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <new>
+#include <chrono>
+
+using benchmarks::GameDirectory;
+using filesystem::Wrapper;
+
+static thread_local size_t allocations = 0;
+
+void *operator new( size_t size )
+{
+	++allocations;
+	void *memory = std::malloc( size != 0 ? size : 1 );
+	if( memory == nullptr )
+		throw std::bad_alloc( );
+
+	return memory;
+}
+
+void operator delete( void *memory ) noexcept
+{
+	std::free( memory );
+}
+
+struct Case
+{
+	const char *name;
+	std::string path;
+	const char *pathid;
+	// opened for reading instead of checked for existence
+	bool open;
+};
+
+struct Result
+{
+	double allocations;
+	double closeallocations;
+	double nanoseconds;
+};
+
+static bool Request( Wrapper &wrapper, const Case &test, size_t &closeallocations )
+{
+	if( !test.open )
+		return wrapper.Exists( test.path.c_str( ), test.pathid );
+
+	file::Base *file = wrapper.Open( test.path.c_str( ), "rb", test.pathid );
+	if( file == nullptr )
+		return false;
+
+	const size_t before = allocations;
+	delete file;
+	closeallocations += allocations - before;
+	return true;
+}
+
+static Result Measure( Wrapper &wrapper, const Case &test )
+{
+	static const size_t iterations = 200000;
+
+	size_t closeallocations = 0;
+	const size_t before = allocations;
+	const auto start = std::chrono::steady_clock::now( );
+	for( size_t k = 0; k < iterations; ++k )
+		Request( wrapper, test, closeallocations );
+
+	const auto elapsed = std::chrono::steady_clock::now( ) - start;
+	const size_t total = allocations - before;
+
+	Result result;
+	result.allocations = static_cast<double>( total - closeallocations ) / iterations;
+	result.closeallocations = static_cast<double>( closeallocations ) / iterations;
+	result.nanoseconds = std::chrono::duration<double, std::nano>( elapsed ).count( ) / iterations;
+	return result;
+}
+
+int main( )
+{
+	GameDirectory game;
+	game.AddFile( "data/mygm/settings/config.txt", "volume=1\n" );
+	game.AddFile( "data/mygm/preloaded.txt", "preloaded\n" );
+	game.AddFile( "materials/models/props_c17/furniture01a.vmt", "\"VertexLitGeneric\"\n{\n}\n" );
+	game.AddFile( "lua/autorun/server/init.lua", "print( \"hello\" )\n" );
+
+	Wrapper wrapper;
+	if( !wrapper.Initialize( game.GetEngine( ) ) )
+	{
+		std::printf( "failed to initialize the wrapper\n" );
+		return 1;
+	}
+
+	const std::vector<Case> cases = {
+		{ "exists, DATA", "mygm/settings/config.txt", "DATA", false },
+		{ "exists, game", "materials/models/props_c17/furniture01a.vmt", "game", false },
+		{ "exists, missing", "mygm/settings/missing.txt", "data", false },
+		{ "exists, normalized", "./mygm/settings/config.txt", "data", false },
+		{ "exists, absolute", game.GetPath( ) + "data/mygm/settings/config.txt", "data", false },
+		{ "open, preloaded", "mygm/preloaded.txt", "data", true },
+		{ "open, cached handle", "lua/autorun/server/init.lua", "game", true }
+	};
+
+	if( !wrapper.Preload( "mygm/preloaded.txt", "data" ) )
+	{
+		std::printf( "failed to preload\n" );
+		return 1;
+	}
+
+	// the first requests start the lookup filters, which are built like the filesystem tick does,
+	// the next ones fill the metadata, path and handle caches
+	size_t ignored = 0;
+	for( auto it = cases.begin( ); it != cases.end( ); ++it )
+		Request( wrapper, *it, ignored );
+
+	wrapper.UpdateFilters( 10.0 );
+	for( auto it = cases.begin( ); it != cases.end( ); ++it )
+		Request( wrapper, *it, ignored );
+
+	std::printf( "%-22s %12s %14s %10s\n", "request", "allocs", "close allocs", "ns" );
+	for( auto it = cases.begin( ); it != cases.end( ); ++it )
+	{
+		const Result result = Measure( wrapper, *it );
+		std::printf( "%-22s %12.2f %14.2f %10.1f\n", it->name, result.allocations, result.closeallocations, result.nanoseconds );
+	}
+
+	wrapper.Deinitialize( );
+	return 0;
+}
@@ -0,0 +1,174 @@
+// Time per request of validating a path against answering it from the PathInternCache, for
+// relative paths and for absolute ones made relative by walking the search paths. The engine's
+// FullPathToRelativePathEx goes through every search path under its lock, filtering them by path
+// ID, so absolute paths cost more the more games and addons are mounted.
+//
+// POSIX only, from the repository root:
+// g++ -std=c++11 -O2 -DSYSTEM_POSIX -DSYSTEM_LINUX -Isource benchmarks/path_intern_cache.cpp source/pathinterncache.cpp -o path_intern_cache -pthread
+
+#include "pathhelpers.hpp"
+#include "fixedstring.hpp"
+#include "pathinterncache.hpp"
+
+#include <cstdio>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+using namespace benchmarks;
+using filesystem::FixedString;
+using filesystem::PathInternCache;
+
+typedef FixedString<2048> PathBuffer;
+
+struct SearchPath
+{
+	std::string path;
+	std::string pathid;
+};
+
+static std::mutex searchpaths_mutex;
+static std::vector<SearchPath> searchpaths;
+
+// mounted games and addons first, the data directory last like in a running server
+static void MountSearchPaths( size_t count )
+{
+	searchpaths.clear( );
+	for( size_t k = 0; k + 1 < count; ++k )
+		searchpaths.push_back( SearchPath{ "/srv/garrysmod/garrysmod/addons/addon" + std::to_string( k ) + '/', "game" } );
+
+	searchpaths.push_back( SearchPath{ "/srv/garrysmod/garrysmod/data/", "data" } );
+}
+
+static bool FullPathToRelativePathEx( const char *fullpath, const char *pathid, char *relative, size_t size )
+{
+	std::lock_guard<std::mutex> lock( searchpaths_mutex );
+
+	char fixed[2048] = { 0 };
+	std::strncpy( fixed, fullpath, sizeof( fixed ) - 1 );
+	std::replace( fixed, fixed + std::strlen( fixed ), '\\', '/' );
+
+	const size_t length = std::strlen( fixed );
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+	{
+		if( strcasecmp( it->pathid.c_str( ), pathid ) != 0 )
+			continue;
+
+		const size_t len = it->path.size( );
+		if( length >= len && strncasecmp( fixed, it->path.c_str( ), len ) == 0 && length - len < size )
+		{
+			std::strcpy( relative, fixed + len );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static const char *const extensions[] = { "txt", "dat", "json", "vmt", "bsp" };
+
+// FixupFilePath, VerifyFilePath and VerifyExtension as done on posix
+static bool Validate( const std::string &input, PathBuffer &filepath, const char *pathid )
+{
+	if( V_IsAbsolutePath( input.c_str( ) ) )
+	{
+		if( !FullPathToRelativePathEx( input.c_str( ), pathid, filepath.GetBuffer( ), filepath.GetCapacity( ) ) )
+			return false;
+	}
+	else if( !filepath.Assign( input ) || !V_RemoveDotSlashes( filepath.GetBuffer( ) ) )
+	{
+		return false;
+	}
+
+	filepath.Update( );
+
+	const char *extension = V_GetFileExtension( filepath.Get( ) );
+	if( extension == nullptr )
+		return true;
+
+	char ext[16] = { 0 };
+	const size_t len = std::strlen( extension );
+	if( len >= sizeof( ext ) )
+		return false;
+
+	std::transform( extension, extension + len, ext, tolower );
+	for( size_t k = 0; k < sizeof( extensions ) / sizeof( *extensions ); ++k )
+		if( std::strcmp( extensions[k], ext ) == 0 )
+			return true;
+
+	return false;
+}
+
+static bool Cached( PathInternCache &cache, const std::string &input, PathBuffer &filepath, const char *pathid )
+{
+	bool allowed = false, nonascii = false;
+	if( cache.Get( input, pathid, 1, allowed, nonascii, filepath.GetBuffer( ), filepath.GetCapacity( ) ) )
+	{
+		if( allowed )
+			filepath.Update( );
+
+		return allowed;
+	}
+
+	allowed = Validate( input, filepath, pathid );
+	cache.Set( input, pathid, 1, allowed, nonascii, filepath.Get( ) );
+	return allowed;
+}
+
+template<typename Request>
+static double Measure( Request request )
+{
+	static const size_t iterations = 1000000;
+
+	size_t total = 0;
+	const auto start = std::chrono::steady_clock::now( );
+	for( size_t k = 0; k < iterations; ++k )
+	{
+		PathBuffer filepath;
+		if( request( filepath ) )
+			total += filepath.GetLength( );
+	}
+
+	const auto elapsed = std::chrono::steady_clock::now( ) - start;
+
+	// keeps the loop from being optimized away
+	if( total == 0 )
+		std::printf( "nothing validated\n" );
+
+	return std::chrono::duration<double, std::nano>( elapsed ).count( ) / iterations;
+}
+
+int main( )
+{
+	const std::string relative = "mygm/settings/config.txt";
+	const std::string absolute = "/srv/garrysmod/garrysmod/data/mygm/settings/config.txt";
+
+	std::printf( "%-14s %-9s %12s %12s\n", "search paths", "path", "validate ns", "cached ns" );
+
+	static const size_t counts[] = { 1, 10, 40, 100 };
+	for( size_t k = 0; k < sizeof( counts ) / sizeof( *counts ); ++k )
+	{
+		MountSearchPaths( counts[k] );
+
+		const std::string *inputs[] = { &relative, &absolute };
+		for( size_t i = 0; i < 2; ++i )
+		{
+			const std::string &input = *inputs[i];
+			PathInternCache cache;
+			const double validate = Measure( [&input]( PathBuffer &filepath )
+			{
+				return Validate( input, filepath, "data" );
+			} );
+			const double cached = Measure( [&cache, &input]( PathBuffer &filepath )
+			{
+				return Cached( cache, input, filepath, "data" );
+			} );
+			std::printf( "%-14zu %-9s %12.1f %12.1f\n", counts[k], i == 0 ? "relative" : "absolute", validate, cached );
+		}
+	}
+
+	return 0;
+}
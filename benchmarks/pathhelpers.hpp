@@ -0,0 +1,58 @@
+#pragma once
+
+// Stand-ins for the tier1 path helpers the wrapper calls, so the benchmarks build without the
+// Source SDK. They do the same amount of work on the same kind of input, not the same checks.
+
+#include <cstring>
+
+#include <strings.h>
+
+namespace benchmarks
+{
+
+inline bool V_IsAbsolutePath( const char *path )
+{
+	return path[0] == '/' || ( path[0] != '\0' && path[1] == ':' );
+}
+
+inline bool V_RemoveDotSlashes( char *path )
+{
+	char *write = path;
+	for( const char *read = path; *read != '\0'; )
+	{
+		if( read[0] == '.' && read[1] == '/' )
+		{
+			read += 2;
+			continue;
+		}
+
+		*write++ = *read++;
+	}
+
+	*write = '\0';
+	return true;
+}
+
+inline const char *V_GetFileExtension( const char *path )
+{
+	const char *dot = std::strrchr( path, '.' );
+	return dot != nullptr && std::strchr( dot, '/' ) == nullptr ? dot + 1 : nullptr;
+}
+
+// FullPathToRelativePathEx walks the search paths of the path ID, comparing each one as a prefix
+inline bool FullPathToRelativePath( const char *fullpath, const char *const *searchpaths, size_t count, char *relative, size_t size )
+{
+	for( size_t k = 0; k < count; ++k )
+	{
+		const size_t len = std::strlen( searchpaths[k] );
+		if( strncasecmp( fullpath, searchpaths[k], len ) == 0 && std::strlen( fullpath + len ) < size )
+		{
+			std::strcpy( relative, fullpath + len );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+}
@@ -0,0 +1,167 @@
+// Lookup throughput of the real Wrapper as reader threads are added, driven against the stand-in
+// engine in benchmarks/engine. Readers call Exists, GetSize, GetTime and Stat, which hold the
+// wrapper's ReadWriteLock for reading, while the main thread mounts and unmounts a search path every
+// 10 ms, which takes it for writing. The same calls are also made with a mutex around each of them,
+// like the lock would behave if it were exclusive. Thread counts go past the number of cores, a
+// single core machine shows what readers cost each other rather than how they scale.
+//
+// POSIX only, from the repository root (the Lua bindings are left out):
+// g++ -std=c++11 -O2 -DSYSTEM_POSIX -DSYSTEM_LINUX -Ibenchmarks/engine -Isource -Isource/posix benchmarks/rwlock_scaling.cpp benchmarks/engine/filesystem.cpp $(ls source/*.cpp source/posix/*.cpp | grep -v -e /file.cpp -e /filesystem.cpp -e /findhandle.cpp -e /main.cpp) -o rwlock_scaling -pthread
+
+#include "gamedirectory.hpp"
+#include "filesystemwrapper.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+using benchmarks::GameDirectory;
+using filesystem::Wrapper;
+using filesystem::FileInfo;
+
+struct Lookup
+{
+	const char *path;
+	const char *pathid;
+};
+
+static const Lookup lookups[] = {
+	{ "mygm/settings/config.txt", "data" },
+	{ "./materials/models/props_c17/furniture01a.vmt", "GAME" },
+	{ "lua/autorun/server/init.lua", "game" },
+	{ "maps/gm_construct.bsp", "game" },
+	{ "mygm/settings/missing.txt", "data" }
+};
+static const size_t nlookups = sizeof( lookups ) / sizeof( *lookups );
+
+static uint64_t Request( const Wrapper &wrapper, size_t k )
+{
+	const Lookup &lookup = lookups[k % nlookups];
+	switch( ( k / nlookups ) % 4 )
+	{
+		case 0:
+			return wrapper.Exists( lookup.path, lookup.pathid ) ? 1 : 0;
+
+		case 1:
+			return wrapper.GetSize( lookup.path, lookup.pathid );
+
+		case 2:
+			return wrapper.GetTime( lookup.path, lookup.pathid );
+
+		default:
+		{
+			FileInfo info;
+			return wrapper.Stat( lookup.path, lookup.pathid, info ) ? info.size : 0;
+		}
+	}
+}
+
+// serialized is null for the wrapper's own locking, otherwise every call is made holding it
+static double Run( Wrapper &wrapper, size_t threads, std::mutex *serialized )
+{
+	std::atomic<bool> stop( false );
+	std::atomic<uint64_t> total( 0 );
+
+	std::vector<std::thread> readers;
+	for( size_t t = 0; t < threads; ++t )
+		readers.emplace_back( [&wrapper, &stop, &total, serialized, t]
+		{
+			uint64_t count = 0, sink = 0;
+			for( size_t k = t; !stop; ++k )
+			{
+				if( serialized != nullptr )
+				{
+					std::lock_guard<std::mutex> lock( *serialized );
+					sink += Request( wrapper, k );
+				}
+				else
+				{
+					sink += Request( wrapper, k );
+				}
+
+				++count;
+			}
+
+			// keeps the calls from being optimized away
+			if( sink == 0 )
+				std::printf( "nothing found\n" );
+
+			total += count;
+		} );
+
+	// search path changes are made from the main thread, like the engine and Lua do
+	const std::chrono::seconds duration( 1 );
+	const auto deadline = std::chrono::steady_clock::now( ) + duration;
+	for( bool mounted = false; std::chrono::steady_clock::now( ) < deadline; mounted = !mounted )
+	{
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+
+		std::unique_lock<std::mutex> lock;
+		if( serialized != nullptr )
+			lock = std::unique_lock<std::mutex>( *serialized );
+
+		if( mounted )
+			wrapper.RemoveSearchPath( "addons/benchmark", "game" );
+		else
+			wrapper.AddSearchPath( "addons/benchmark", "game" );
+	}
+
+	stop = true;
+	for( auto &reader : readers )
+		reader.join( );
+
+	wrapper.RemoveSearchPath( "addons/benchmark", "game" );
+	return total / std::chrono::duration<double>( duration ).count( );
+}
+
+int main( int argc, char **argv )
+{
+	// the thread count to go up to can be given, it defaults to 8 whatever the number of cores
+	const size_t maxthreads = argc > 1 ? std::strtoul( argv[1], nullptr, 10 ) : 8;
+
+	GameDirectory game;
+	game.AddFile( "data/mygm/settings/config.txt", "volume=1\n" );
+	game.AddFile( "materials/models/props_c17/furniture01a.vmt", "\"VertexLitGeneric\"\n{\n}\n" );
+	game.AddFile( "lua/autorun/server/init.lua", "print( \"hello\" )\n" );
+	game.AddFile( "maps/gm_construct.bsp", std::string( 4096, '\0' ) );
+	game.AddFile( "addons/benchmark/lua/autorun/addon.lua", "print( \"addon\" )\n" );
+
+	Wrapper wrapper;
+	if( !wrapper.Initialize( game.GetEngine( ) ) )
+	{
+		std::printf( "failed to initialize the wrapper\n" );
+		return 1;
+	}
+
+	// the first lookups start the lookup filters, which are built like the filesystem tick does
+	for( size_t k = 0; k < nlookups * 4; ++k )
+		Request( wrapper, k );
+
+	wrapper.UpdateFilters( 10.0 );
+
+	std::printf( "%u cores\n", std::thread::hardware_concurrency( ) );
+	std::printf( "%8s %16s %9s %16s %9s\n", "threads", "rwlock/s", "speedup", "mutex/s", "speedup" );
+
+	std::mutex mutex;
+	double rwbase = 0.0, mutexbase = 0.0;
+	for( size_t threads = 1; threads <= maxthreads; threads *= 2 )
+	{
+		const double rw = Run( wrapper, threads, nullptr );
+		const double serialized = Run( wrapper, threads, &mutex );
+		if( threads == 1 )
+		{
+			rwbase = rw;
+			mutexbase = serialized;
+		}
+
+		std::printf( "%8zu %16.0f %8.2fx %16.0f %8.2fx\n", threads, rw, rw / rwbase, serialized, serialized / mutexbase );
+	}
+
+	wrapper.Deinitialize( );
+	return 0;
+}
@@ -0,0 +1,90 @@
+#include "bloomfilter.hpp"
+
+namespace filesystem
+{
+
+static const uint32_t hash_count = 7;
+
+static uint64_t Mix( uint64_t value )
+{
+	value ^= value >> 31;
+	value *= 0x7fb5d329728ea185ULL;
+	value ^= value >> 27;
+	value *= 0x81dadef4bc2dd44dULL;
+	value ^= value >> 33;
+	return value;
+}
+
+BloomFilter::BloomFilter( ) :
+	mask( 0 )
+{ }
+
+void BloomFilter::Reset( size_t expected )
+{
+	// 10 bits per entry and 7 hashes give about 1% false positives, round up to a power of two
+	uint64_t size = 64;
+	while( size < static_cast<uint64_t>( expected ) * 10 )
+		size <<= 1;
+
+	bits.assign( static_cast<size_t>( size / 64 ), 0 );
+	mask = size - 1;
+}
+
+void BloomFilter::Add( uint64_t hash )
+{
+	if( bits.empty( ) )
+		return;
+
+	const uint64_t step = Mix( hash ) | 1;
+	for( uint32_t k = 0; k < hash_count; ++k, hash += step )
+	{
+		const uint64_t bit = hash & mask;
+		bits[bit / 64] |= 1ULL << ( bit % 64 );
+	}
+}
+
+bool BloomFilter::MayContain( uint64_t hash ) const
+{
+	if( bits.empty( ) )
+		return true;
+
+	const uint64_t step = Mix( hash ) | 1;
+	for( uint32_t k = 0; k < hash_count; ++k, hash += step )
+	{
+		const uint64_t bit = hash & mask;
+		if( ( bits[bit / 64] & ( 1ULL << ( bit % 64 ) ) ) == 0 )
+			return false;
+	}
+
+	return true;
+}
+
+size_t BloomFilter::GetSize( ) const
+{
+	return bits.size( ) * sizeof( uint64_t );
+}
+
+uint64_t BloomFilter::Hash( const StringRef &path )
+{
+	size_t len = path.size( );
+	while( len != 0 && ( path[len - 1] == '/' || path[len - 1] == '\\' ) )
+		--len;
+
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for( size_t k = 0; k < len; ++k )
+	{
+		char c = path[k];
+		if( c == '\\' )
+			c = '/';
+		else if( c >= 'A' && c <= 'Z' )
+			c = static_cast<char>( c - 'A' + 'a' );
+
+		hash ^= static_cast<uint8_t>( c );
+		hash *= 0x100000001b3ULL;
+	}
+
+	return Mix( hash );
+}
+
+}
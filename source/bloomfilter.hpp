@@ -0,0 +1,35 @@
+#pragma once
+
+#include "stringref.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace filesystem
+{
+
+// Fixed size Bloom filter over 64 bits hashes, sized for about 1% false positives.
+class BloomFilter
+{
+public:
+	BloomFilter( );
+
+	// clears the filter and sizes it for the expected amount of entries
+	void Reset( size_t expected );
+
+	void Add( uint64_t hash );
+	bool MayContain( uint64_t hash ) const;
+
+	size_t GetSize( ) const;
+
+	// case and separator insensitive, trailing separators are ignored
+	static uint64_t Hash( const StringRef &path );
+
+private:
+	std::vector<uint64_t> bits;
+	uint64_t mask;
+};
+
+}
@@ -0,0 +1,387 @@
+#include "changejournal.hpp"
+
+#include <ctime>
+#include <cstdlib>
+#include <algorithm>
+
+namespace filesystem
+{
+
+const size_t ChangeJournal::default_capacity = 65536;
+
+static const char *operation_names[] = {
+	"write",
+	"rename",
+	"remove",
+	"mkdir",
+	"copy",
+	"copytree",
+	"removetree",
+	"addsearchpath",
+	"removesearchpath"
+};
+
+static const size_t operation_count = sizeof( operation_names ) / sizeof( *operation_names );
+
+// fields are tab separated and entries newline terminated, both can't show up inside a field
+static void Escape( std::string &output, const std::string &field )
+{
+	for( auto it = field.begin( ); it != field.end( ); ++it )
+		switch( *it )
+		{
+			case '\\':
+				output += "\\\\";
+				break;
+
+			case '\t':
+				output += "\\t";
+				break;
+
+			case '\n':
+				output += "\\n";
+				break;
+
+			default:
+				output += *it;
+				break;
+		}
+}
+
+static bool Unescape( const std::string &field, std::string &output )
+{
+	output.clear( );
+	for( size_t k = 0; k < field.size( ); ++k )
+	{
+		if( field[k] != '\\' )
+		{
+			output += field[k];
+			continue;
+		}
+
+		if( ++k == field.size( ) )
+			return false;
+
+		switch( field[k] )
+		{
+			case '\\':
+				output += '\\';
+				break;
+
+			case 't':
+				output += '\t';
+				break;
+
+			case 'n':
+				output += '\n';
+				break;
+
+			default:
+				return false;
+		}
+	}
+
+	return true;
+}
+
+ChangeJournal::ChangeJournal( ) :
+	sequence( 0 ),
+	capacity( default_capacity ),
+	file( nullptr ),
+	persisted( 0 )
+{ }
+
+ChangeJournal::~ChangeJournal( )
+{
+	Close( );
+}
+
+uint64_t ChangeJournal::Record(
+	Operation operation,
+	const std::string &path,
+	const std::string &pathid,
+	const std::string &target
+)
+{
+	uint64_t recorded = 0;
+	bool persisting = false;
+
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+
+		recorded = ++sequence;
+		ring.push_back( Entry{ recorded, static_cast<int64_t>( std::time( nullptr ) ), operation, path, pathid, target } );
+		if( file != nullptr )
+		{
+			unwritten += Format( ring.back( ) );
+			persisting = true;
+		}
+
+		Trim( );
+	}
+
+	if( persisting )
+		Flush( );
+
+	return recorded;
+}
+
+bool ChangeJournal::Since( uint64_t after, std::vector<Entry> &entries, size_t limit ) const
+{
+	entries.clear( );
+
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if( after >= sequence )
+		return true;
+
+	// sequences skipped when persisting was enabled leave gaps that were never handed out,
+	// only entries dropped from the front of the ring make the answer incomplete
+	const uint64_t oldest = ring.empty( ) ? sequence + 1 : ring.front( ).sequence;
+	const bool complete = after + 1 >= oldest;
+	const size_t start = static_cast<size_t>( std::lower_bound(
+		ring.begin( ),
+		ring.end( ),
+		after + 1,
+		[]( const Entry &entry, uint64_t wanted )
+		{
+			return entry.sequence < wanted;
+		}
+	) - ring.begin( ) );
+
+	size_t count = ring.size( ) - start;
+	if( limit != 0 && limit < count )
+		count = limit;
+
+	entries.assign( ring.begin( ) + start, ring.begin( ) + start + count );
+	return complete;
+}
+
+uint64_t ChangeJournal::GetSequence( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return sequence;
+}
+
+bool ChangeJournal::SetPersistence( const std::string &fullpath )
+{
+	std::lock_guard<std::mutex> file_lock( file_mutex );
+	std::lock_guard<std::mutex> lock( mutex );
+
+	Close( );
+	filepath = fullpath;
+	if( filepath.empty( ) )
+		return true;
+
+	std::deque<Entry> loaded;
+	FILE *input = OpenLog( filepath, "rb" );
+	if( input != nullptr )
+	{
+		std::string line;
+		char buffer[4096];
+		while( fgets( buffer, sizeof( buffer ), input ) != nullptr )
+		{
+			line += buffer;
+			if( line.back( ) != '\n' )
+				continue;
+
+			line.pop_back( );
+			Entry entry;
+			// a torn last line (the process died mid write) or anything out of order is dropped
+			if( Parse( line, entry ) && ( loaded.empty( ) || entry.sequence > loaded.back( ).sequence ) )
+			{
+				loaded.push_back( std::move( entry ) );
+				if( loaded.size( ) > capacity )
+					loaded.pop_front( );
+			}
+
+			line.clear( );
+		}
+
+		fclose( input );
+	}
+
+	if( !loaded.empty( ) )
+	{
+		if( ring.empty( ) || loaded.back( ).sequence + 1 == ring.front( ).sequence )
+		{
+			ring.insert( ring.begin( ), loaded.begin( ), loaded.end( ) );
+			Trim( );
+		}
+
+		// anything else would hide entries between the saved and the recorded ones, the file is just
+		// replaced; consumers already hold the numbers recorded so far, those are never renumbered
+		// and the next one starts above everything the file handed out
+		if( loaded.back( ).sequence > sequence )
+			sequence = loaded.back( ).sequence;
+	}
+
+	if( !Compact( ) )
+	{
+		filepath.clear( );
+		return false;
+	}
+
+	return true;
+}
+
+void ChangeJournal::SetCapacity( size_t entries )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	capacity = entries != 0 ? entries : 1;
+	Trim( );
+}
+
+ChangeJournal::Statistics ChangeJournal::GetStatistics( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return Statistics{
+		sequence,
+		ring.empty( ) ? 0 : ring.front( ).sequence,
+		ring.size( ),
+		capacity,
+		file != nullptr
+	};
+}
+
+const char *ChangeJournal::GetOperationName( Operation operation )
+{
+	const size_t index = static_cast<size_t>( operation );
+	return index < operation_count ? operation_names[index] : "unknown";
+}
+
+void ChangeJournal::Trim( )
+{
+	while( ring.size( ) > capacity )
+		ring.pop_front( );
+}
+
+void ChangeJournal::Flush( )
+{
+	std::lock_guard<std::mutex> file_lock( file_mutex );
+
+	// concurrent records pile up while one of them writes, the next one takes them all at once
+	std::string lines;
+	size_t count = 0;
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		if( file == nullptr || unwritten.empty( ) )
+			return;
+
+		lines.swap( unwritten );
+		count = static_cast<size_t>( std::count( lines.begin( ), lines.end( ), '\n' ) );
+	}
+
+	const bool written = fwrite( lines.data( ), 1, lines.size( ), file ) == lines.size( ) &&
+		fflush( file ) == 0;
+
+	std::lock_guard<std::mutex> lock( mutex );
+	if( !written )
+	{
+		// a journal with holes is worse than none, consumers would miss changes silently
+		Close( );
+		filepath.clear( );
+		return;
+	}
+
+	persisted += count;
+	if( persisted >= capacity * 2 && !Compact( ) )
+	{
+		Close( );
+		filepath.clear( );
+	}
+}
+
+bool ChangeJournal::Compact( )
+{
+	Close( );
+	// the ring already holds whatever wasn't written yet
+	unwritten.clear( );
+
+	const std::string temporary = filepath + ".tmp";
+	FILE *output = OpenLog( temporary, "wb" );
+	if( output == nullptr )
+		return false;
+
+	bool success = true;
+	for( auto it = ring.begin( ); it != ring.end( ) && success; ++it )
+	{
+		const std::string line = Format( *it );
+		success = fwrite( line.data( ), 1, line.size( ), output ) == line.size( );
+	}
+
+	success = fclose( output ) == 0 && success;
+	if( !success || !ReplaceLog( temporary, filepath ) )
+		return false;
+
+	file = OpenLog( filepath, "ab" );
+	persisted = ring.size( );
+	return file != nullptr;
+}
+
+void ChangeJournal::Close( )
+{
+	if( file != nullptr )
+	{
+		fclose( file );
+		file = nullptr;
+	}
+
+	unwritten.clear( );
+}
+
+bool ChangeJournal::Parse( const std::string &line, Entry &entry )
+{
+	std::vector<std::string> fields;
+	size_t start = 0;
+	for( size_t tab = line.find( '\t' ); ; tab = line.find( '\t', start ) )
+	{
+		fields.push_back( line.substr( start, tab == line.npos ? line.npos : tab - start ) );
+		if( tab == line.npos )
+			break;
+
+		start = tab + 1;
+	}
+
+	if( fields.size( ) != 6 || fields[0].empty( ) || fields[1].empty( ) )
+		return false;
+
+	char *end = nullptr;
+	entry.sequence = std::strtoull( fields[0].c_str( ), &end, 10 );
+	if( *end != '\0' || entry.sequence == 0 )
+		return false;
+
+	entry.time = std::strtoll( fields[1].c_str( ), &end, 10 );
+	if( *end != '\0' )
+		return false;
+
+	size_t index = 0;
+	while( index < operation_count && fields[2] != operation_names[index] )
+		++index;
+
+	if( index == operation_count )
+		return false;
+
+	entry.operation = static_cast<Operation>( index );
+	return Unescape( fields[3], entry.pathid ) &&
+		Unescape( fields[4], entry.path ) &&
+		Unescape( fields[5], entry.target );
+}
+
+std::string ChangeJournal::Format( const Entry &entry )
+{
+	std::string line = std::to_string( entry.sequence );
+	line += '\t';
+	line += std::to_string( entry.time );
+	line += '\t';
+	line += GetOperationName( entry.operation );
+	line += '\t';
+	Escape( line, entry.pathid );
+	line += '\t';
+	Escape( line, entry.path );
+	line += '\t';
+	Escape( line, entry.target );
+	line += '\n';
+	return line;
+}
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+
+namespace filesystem
+{
+
+// Ring of the mutations made through the wrapper, numbered by a sequence that never goes back
+// (not even across restarts when persisted). Changes made by anything else (the engine's file library,
+// other processes) aren't recorded, consumers still need the occasional full rescan.
+class ChangeJournal
+{
+public:
+	enum class Operation
+	{
+		Write,
+		Rename,
+		Remove,
+		MakeDirectory,
+		Copy,
+		CopyTree,
+		RemoveTree,
+		AddSearchPath,
+		RemoveSearchPath
+	};
+
+	struct Entry
+	{
+		uint64_t sequence;
+		// seconds since the Unix epoch
+		int64_t time;
+		Operation operation;
+		std::string path;
+		std::string pathid;
+		// the new path of renames and the destination of copies, empty otherwise
+		std::string target;
+	};
+
+	struct Statistics
+	{
+		uint64_t sequence;
+		uint64_t oldest;
+		size_t entries;
+		size_t capacity;
+		bool persisted;
+	};
+
+	ChangeJournal( );
+	~ChangeJournal( );
+
+	uint64_t Record(
+		Operation operation,
+		const std::string &path,
+		const std::string &pathid,
+		const std::string &target = std::string( )
+	);
+
+	// entries recorded after sequence, oldest first and up to limit (0 for all), false when
+	// some of them were already dropped from the ring and the consumer has to rescan instead
+	bool Since( uint64_t sequence, std::vector<Entry> &entries, size_t limit = 0 ) const;
+	uint64_t GetSequence( ) const;
+
+	// loads the entries kept in the file and appends every new one to it, empty stops persisting;
+	// numbers already handed out are kept and new ones continue above the highest one in the file
+	bool SetPersistence( const std::string &fullpath );
+	void SetCapacity( size_t capacity );
+
+	Statistics GetStatistics( ) const;
+
+	static const char *GetOperationName( Operation operation );
+
+private:
+	ChangeJournal( const ChangeJournal & ) = delete;
+	ChangeJournal &operator=( const ChangeJournal & ) = delete;
+
+	void Trim( );
+	// writes the lines recorded since the last call, outside of the ring's lock
+	void Flush( );
+	// rewrites the file with the ring alone, the log keeps growing otherwise
+	bool Compact( );
+	void Close( );
+
+	static bool Parse( const std::string &line, Entry &entry );
+	static std::string Format( const Entry &entry );
+
+	static FILE *OpenLog( const std::string &fullpath, const char *mode );
+	static bool ReplaceLog( const std::string &source, const std::string &destination );
+
+	static const size_t default_capacity;
+
+	mutable std::mutex mutex;
+	std::deque<Entry> ring;
+	uint64_t sequence;
+	size_t capacity;
+
+	// held while writing the file, taken before mutex when both are needed
+	std::mutex file_mutex;
+	std::string filepath;
+	FILE *file;
+	size_t persisted;
+	// formatted entries not written yet, guarded by mutex
+	std::string unwritten;
+};
+
+}
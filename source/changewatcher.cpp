@@ -0,0 +1,244 @@
+#include "changewatcher.hpp"
+#include "walker.hpp"
+
+#include <algorithm>
+#include <memory>
+
+namespace filesystem
+{
+
+const size_t ChangeWatcher::max_queued = 16384;
+const size_t ChangeWatcher::max_depth = 64;
+
+static std::unordered_map<GarrysMod::Lua::ILuaBase *, std::unique_ptr<ChangeWatcher>> changewatchers;
+
+ChangeWatcher::ChangeWatcher( ) :
+	next( 1 )
+{ }
+
+ChangeWatcher *ChangeWatcher::Create( GarrysMod::Lua::ILuaBase *LUA )
+{
+	std::unique_ptr<ChangeWatcher> &changewatcher = changewatchers[LUA];
+	changewatcher.reset( new ChangeWatcher );
+	return changewatcher.get( );
+}
+
+ChangeWatcher *ChangeWatcher::Get( GarrysMod::Lua::ILuaBase *LUA )
+{
+	const auto it = changewatchers.find( LUA );
+	if( it == changewatchers.end( ) )
+		return nullptr;
+
+	return it->second.get( );
+}
+
+void ChangeWatcher::Destroy( GarrysMod::Lua::ILuaBase *LUA )
+{
+	changewatchers.erase( LUA );
+}
+
+bool ChangeWatcher::Available( ) const
+{
+	return watcher.Available( );
+}
+
+int32_t ChangeWatcher::Add( const std::vector<std::string> &fullpaths, const std::string &name, bool recursive )
+{
+	if( !watcher.Available( ) || fullpaths.empty( ) )
+		return -1;
+
+	const int32_t id = next++;
+	Watch &watch = watches[id];
+	watch.name = name;
+	watch.recursive = recursive && name.empty( );
+
+	for( auto it = fullpaths.begin( ); it != fullpaths.end( ); ++it )
+		AddDirectory( id, *it, std::string( ), 0 );
+
+	if( watch.descriptors.empty( ) )
+	{
+		watches.erase( id );
+		return -1;
+	}
+
+	return id;
+}
+
+bool ChangeWatcher::Remove( int32_t id )
+{
+	const auto it = watches.find( id );
+	if( it == watches.end( ) )
+		return false;
+
+	for( auto descriptor = it->second.descriptors.begin( ); descriptor != it->second.descriptors.end( ); ++descriptor )
+	{
+		const auto users = directories.find( *descriptor );
+		if( users == directories.end( ) )
+			continue;
+
+		std::vector<Directory> &list = users->second;
+		list.erase( std::remove_if( list.begin( ), list.end( ), [id]( const Directory &directory )
+		{
+			return directory.watch == id;
+		} ), list.end( ) );
+
+		if( list.empty( ) )
+		{
+			watcher.Remove( *descriptor );
+			directories.erase( users );
+		}
+	}
+
+	watches.erase( it );
+	return true;
+}
+
+void ChangeWatcher::Poll( )
+{
+	watcher.Poll( [this]( int32_t descriptor, const std::string &name, uint32_t events )
+	{
+		if( ( events & Watcher::Overflow ) != 0 )
+		{
+			PushOverflow( );
+			return;
+		}
+
+		const auto found = directories.find( descriptor );
+		if( found == directories.end( ) )
+			return;
+
+		// copied, adding directories below can grow the same list
+		const std::vector<Directory> users = found->second;
+		for( auto it = users.begin( ); it != users.end( ); ++it )
+		{
+			const auto watch = watches.find( it->watch );
+			if( watch == watches.end( ) )
+				continue;
+
+			if( !watch->second.name.empty( ) && watch->second.name != name )
+				continue;
+
+			const std::string path = name.empty( ) ? it->relative :
+				it->relative.empty( ) ? name : it->relative + '/' + name;
+			Push( it->watch, path, events & ~Watcher::Directory );
+
+			// new directories below recursive watches get watched as well
+			if( watch->second.recursive && !name.empty( ) &&
+				( events & Watcher::Directory ) != 0 && ( events & ( Watcher::Created | Watcher::Renamed ) ) != 0 )
+				AddDirectory( it->watch, it->fullpath + '/' + name, path, it->depth + 1 );
+		}
+
+		if( ( events & Watcher::Gone ) != 0 && name.empty( ) )
+		{
+			for( auto it = users.begin( ); it != users.end( ); ++it )
+			{
+				const auto watch = watches.find( it->watch );
+				if( watch != watches.end( ) )
+				{
+					std::vector<int32_t> &descriptors = watch->second.descriptors;
+					descriptors.erase( std::remove( descriptors.begin( ), descriptors.end( ), descriptor ), descriptors.end( ) );
+				}
+			}
+
+			directories.erase( descriptor );
+		}
+	} );
+}
+
+void ChangeWatcher::Drain( std::vector<Event> &events, size_t max )
+{
+	events.clear( );
+	if( max == 0 || max >= queue.size( ) )
+	{
+		events.swap( queue );
+		queued.clear( );
+		return;
+	}
+
+	events.assign( std::make_move_iterator( queue.begin( ) ), std::make_move_iterator( queue.begin( ) + max ) );
+	queue.erase( queue.begin( ), queue.begin( ) + max );
+
+	queued.clear( );
+	for( size_t k = 0; k < queue.size( ); ++k )
+		queued[std::to_string( queue[k].watch ) + ':' + queue[k].path] = k;
+}
+
+void ChangeWatcher::AddDirectory( int32_t id, const std::string &fullpath, const std::string &relative, size_t depth )
+{
+	if( depth >= max_depth )
+		return;
+
+	Watch &watch = watches[id];
+
+	std::vector<Directory> pending( 1, Directory{ id, fullpath, relative, depth } );
+	if( watch.recursive && depth + 1 < max_depth )
+	{
+		// the directories below are listed once, new ones are picked up from their creation events
+		Walker::Options options;
+		options.threads = 1;
+		options.max_depth = max_depth - depth - 1;
+		Walker walker( std::vector<std::string>( 1, fullpath ), options );
+		walker.Start( );
+		walker.Wait( );
+
+		Walker::Batch entries;
+		walker.Take( entries );
+		for( auto it = entries.begin( ); it != entries.end( ); ++it )
+			if( it->directory )
+				pending.push_back( Directory{
+					id,
+					fullpath + '/' + it->path,
+					relative.empty( ) ? it->path : relative + '/' + it->path,
+					depth + 1 + static_cast<size_t>( std::count( it->path.begin( ), it->path.end( ), '/' ) )
+				} );
+	}
+
+	for( auto it = pending.begin( ); it != pending.end( ); ++it )
+	{
+		const int32_t descriptor = watcher.Add( it->fullpath );
+		if( descriptor == -1 )
+			continue;
+
+		std::vector<Directory> &users = directories[descriptor];
+		const bool known = std::find_if( users.begin( ), users.end( ), [id]( const Directory &directory )
+		{
+			return directory.watch == id;
+		} ) != users.end( );
+		if( known )
+			continue;
+
+		users.push_back( *it );
+		watch.descriptors.push_back( descriptor );
+	}
+}
+
+void ChangeWatcher::Push( int32_t watch, const std::string &path, uint32_t events )
+{
+	const std::string key = std::to_string( watch ) + ':' + path;
+	const auto found = queued.find( key );
+	if( found != queued.end( ) )
+	{
+		queue[found->second].events |= events;
+		return;
+	}
+
+	if( queue.size( ) >= max_queued )
+	{
+		PushOverflow( );
+		return;
+	}
+
+	queued.emplace( key, queue.size( ) );
+	queue.push_back( Event{ watch, path, events } );
+}
+
+void ChangeWatcher::PushOverflow( )
+{
+	// individual events are meaningless once some were lost, every watch gets a single overflow
+	queue.clear( );
+	queued.clear( );
+	for( auto it = watches.begin( ); it != watches.end( ); ++it )
+		queue.push_back( Event{ it->first, std::string( ), Watcher::Overflow } );
+}
+
+}
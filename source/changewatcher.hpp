@@ -0,0 +1,90 @@
+#pragma once
+
+#include "watcher.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace GarrysMod
+{
+	namespace Lua
+	{
+		class ILuaBase;
+	}
+}
+
+namespace filesystem
+{
+
+// Watches registered from one Lua state. Notifications are coalesced per watch and path until
+// they're drained, nothing is polled from the filesystem so an idle watch costs nothing.
+class ChangeWatcher
+{
+public:
+	struct Event
+	{
+		int32_t watch;
+		// relative to the watched directory and separated by '/', the name for file watches,
+		// empty when the event is about the watched directory itself
+		std::string path;
+		// Watcher::Events
+		uint32_t events;
+	};
+
+	ChangeWatcher( );
+
+	static ChangeWatcher *Create( GarrysMod::Lua::ILuaBase *LUA );
+	static ChangeWatcher *Get( GarrysMod::Lua::ILuaBase *LUA );
+	static void Destroy( GarrysMod::Lua::ILuaBase *LUA );
+
+	bool Available( ) const;
+
+	// directories are the full paths of the same directory in every loose search path,
+	// a non-empty name only reports events about that entry, returns -1 on failure
+	int32_t Add( const std::vector<std::string> &directories, const std::string &name, bool recursive );
+	bool Remove( int32_t watch );
+
+	// reads pending notifications without blocking, meant to be called once per tick
+	void Poll( );
+	// moves up to max coalesced events (0 for all) into events, oldest first
+	void Drain( std::vector<Event> &events, size_t max = 0 );
+
+private:
+	struct Directory
+	{
+		int32_t watch;
+		std::string fullpath;
+		std::string relative;
+		size_t depth;
+	};
+
+	struct Watch
+	{
+		std::string name;
+		bool recursive;
+		std::vector<int32_t> descriptors;
+	};
+
+	ChangeWatcher( const ChangeWatcher & ) = delete;
+	ChangeWatcher &operator=( const ChangeWatcher & ) = delete;
+
+	// adds the directory and, for recursive watches, every directory below it
+	void AddDirectory( int32_t watch, const std::string &fullpath, const std::string &relative, size_t depth );
+	void Push( int32_t watch, const std::string &path, uint32_t events );
+	void PushOverflow( );
+
+	static const size_t max_queued;
+	static const size_t max_depth;
+
+	Watcher watcher;
+	int32_t next;
+	std::unordered_map<int32_t, Watch> watches;
+	// every watch using a watcher descriptor, a directory can be watched more than once
+	std::unordered_map<int32_t, std::vector<Directory>> directories;
+	std::vector<Event> queue;
+	std::unordered_map<std::string, size_t> queued;
+};
+
+}
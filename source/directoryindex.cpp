@@ -0,0 +1,682 @@
+#include "directoryindex.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <map>
+
+namespace filesystem
+{
+
+static const char index_magic[8] = { 'G', 'M', 'F', 'S', 'I', 'D', 'X', '\0' };
+// a file written on a machine with the other byte order fails the version check
+static const uint32_t index_version = 1;
+
+static const uint32_t entry_directory = 1 << 0;
+static const uint32_t entry_link = 1 << 1;
+
+struct DirectoryIndex::Header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t directories;
+	uint32_t entries;
+	uint32_t reserved;
+	uint64_t strings;
+};
+
+// sorted by path, entries of a directory are contiguous and sorted by name
+struct DirectoryIndex::DirectoryRecord
+{
+	uint32_t path;
+	uint32_t first;
+	uint32_t count;
+	uint32_t reserved;
+	int64_t mtime;
+};
+
+struct DirectoryIndex::EntryRecord
+{
+	uint32_t name;
+	uint32_t flags;
+	uint64_t size;
+	int64_t mtime;
+};
+
+const size_t DirectoryIndex::max_entries = 1000000;
+const size_t DirectoryIndex::max_depth = 64;
+
+// names compare like the platform's filesystems do
+static inline char Fold( char c )
+{
+
+#if defined SYSTEM_WINDOWS
+
+	if( c >= 'A' && c <= 'Z' )
+		return static_cast<char>( c - 'A' + 'a' );
+
+#endif
+
+	return c;
+}
+
+static bool HasPrefix( const char *str, const std::string &prefix )
+{
+	for( size_t k = 0; k < prefix.size( ); ++k )
+		if( str[k] == '\0' || Fold( str[k] ) != Fold( prefix[k] ) )
+			return false;
+
+	return true;
+}
+
+struct PathLess
+{
+	bool operator()( const std::string &a, const std::string &b ) const
+	{
+		return std::lexicographical_compare( a.begin( ), a.end( ), b.begin( ), b.end( ), []( char x, char y )
+		{
+			return static_cast<unsigned char>( Fold( x ) ) < static_cast<unsigned char>( Fold( y ) );
+		} );
+	}
+};
+
+DirectoryIndex::DirectoryIndex( ) :
+	data( nullptr ),
+	size( 0 ),
+	mapping( 0 ),
+	directories( nullptr ),
+	entries( nullptr ),
+	strings( nullptr ),
+	ndirectories( 0 ),
+	nentries( 0 ),
+	answering( false ),
+	validating( false ),
+	stopping( false ),
+	hits( 0 ),
+	misses( 0 )
+{ }
+
+DirectoryIndex::~DirectoryIndex( )
+{
+	Stop( );
+}
+
+void DirectoryIndex::Start( const std::string &path, const std::vector<std::string> &roots )
+{
+	Stop( );
+
+	{
+		WriteLock guard( lock );
+		filepath = path;
+		answering = Map( );
+	}
+
+	stopping = false;
+	validating = true;
+	thread = std::thread( &DirectoryIndex::Validate, this, roots );
+}
+
+void DirectoryIndex::Stop( )
+{
+	stopping = true;
+	if( thread.joinable( ) )
+		thread.join( );
+
+	WriteLock guard( lock );
+	answering = false;
+	Unmap( );
+}
+
+bool DirectoryIndex::IsAnswering( ) const
+{
+	return answering;
+}
+
+bool DirectoryIndex::HasDirectory( const std::string &fullpath ) const
+{
+	const std::string path = Normalize( fullpath );
+
+	ReadLock guard( lock );
+	if( !answering )
+		return false;
+
+	const int64_t directory = FindDirectory( path );
+	return directory != -1 && !stale[directory];
+}
+
+DirectoryIndex::Result DirectoryIndex::Find( const std::string &fullpath, Listed &entry ) const
+{
+	std::string parent = Normalize( fullpath );
+
+	ReadLock guard( lock );
+	if( !answering )
+		return Unknown;
+
+	// the nearest indexed ancestor tells whether the path can exist at all
+	bool direct = true;
+	for( size_t slash = parent.rfind( '/' ); slash != parent.npos && slash != 0; slash = parent.rfind( '/' ), direct = false )
+	{
+		const std::string name = parent.substr( slash + 1 );
+		parent.resize( slash );
+
+		const int64_t directory = FindDirectory( parent );
+		if( directory == -1 )
+			continue;
+
+		if( stale[directory] )
+			break;
+
+		const EntryRecord *found = FindEntry( directories[directory], name );
+		if( found == nullptr )
+		{
+			++hits;
+			return Missing;
+		}
+
+		// an entry below a directory that wasn't indexed (too deep or a link)
+		if( !direct )
+			break;
+
+		++hits;
+		entry = GetListed( *found );
+		return Found;
+	}
+
+	++misses;
+	return Unknown;
+}
+
+DirectoryIndex::Result DirectoryIndex::List( const std::string &fullpath, std::vector<Listed> &listing ) const
+{
+	listing.clear( );
+
+	{
+		const std::string path = Normalize( fullpath );
+
+		ReadLock guard( lock );
+		if( !answering )
+			return Unknown;
+
+		const int64_t directory = FindDirectory( path );
+		if( directory != -1 )
+		{
+			if( stale[directory] )
+			{
+				++misses;
+				return Unknown;
+			}
+
+			const DirectoryRecord &record = directories[directory];
+			listing.reserve( record.count );
+			for( uint32_t k = 0; k < record.count; ++k )
+				listing.push_back( GetListed( entries[record.first + k] ) );
+
+			++hits;
+			return Found;
+		}
+	}
+
+	// not a directory, either missing or a file
+	Listed entry;
+	const Result result = Find( fullpath, entry );
+	return result == Found ? Missing : result;
+}
+
+void DirectoryIndex::Invalidate( const std::string &fullpath )
+{
+	if( fullpath.empty( ) || !validating )
+		return;
+
+	const std::string path = Normalize( fullpath );
+
+	{
+		ReadLock guard( lock );
+		if( answering )
+			MarkStale( path );
+	}
+
+	const size_t slash = path.rfind( '/' );
+	std::lock_guard<std::mutex> guard( dirty_mutex );
+	dirty.push_back( path );
+	if( slash != path.npos && slash != 0 )
+		dirty.push_back( path.substr( 0, slash ) );
+}
+
+DirectoryIndex::Statistics DirectoryIndex::GetStatistics( ) const
+{
+	ReadLock guard( lock );
+
+	Statistics stats = { };
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.directories = ndirectories;
+	stats.entries = nentries;
+	for( uint32_t k = 0; k < ndirectories; ++k )
+		if( stale[k] )
+			++stats.stale;
+
+	stats.answering = answering;
+	stats.validating = validating;
+	return stats;
+}
+
+bool DirectoryIndex::Map( )
+{
+	data = MapFile( filepath, size, mapping );
+	if( data == nullptr )
+		return false;
+
+	if( size < sizeof( Header ) )
+	{
+		Unmap( );
+		return false;
+	}
+
+	// checked once so lookups can trust every offset
+	const Header &header = *reinterpret_cast<const Header *>( data );
+	const uint64_t records = sizeof( Header ) +
+		static_cast<uint64_t>( header.directories ) * sizeof( DirectoryRecord ) +
+		static_cast<uint64_t>( header.entries ) * sizeof( EntryRecord );
+	if( std::memcmp( header.magic, index_magic, sizeof( index_magic ) ) != 0 ||
+		header.version != index_version ||
+		header.strings == 0 ||
+		records + header.strings != size ||
+		data[size - 1] != '\0' )
+	{
+		Unmap( );
+		return false;
+	}
+
+	directories = reinterpret_cast<const DirectoryRecord *>( data + sizeof( Header ) );
+	entries = reinterpret_cast<const EntryRecord *>( directories + header.directories );
+	strings = reinterpret_cast<const char *>( entries + header.entries );
+	ndirectories = header.directories;
+	nentries = header.entries;
+
+	for( uint32_t k = 0; k < ndirectories; ++k )
+		if( directories[k].path >= header.strings ||
+			directories[k].first > nentries ||
+			directories[k].count > nentries - directories[k].first )
+		{
+			Unmap( );
+			return false;
+		}
+
+	for( uint32_t k = 0; k < nentries; ++k )
+		if( entries[k].name >= header.strings )
+		{
+			Unmap( );
+			return false;
+		}
+
+	stale.reset( new std::atomic<bool>[ndirectories] );
+	for( uint32_t k = 0; k < ndirectories; ++k )
+		stale[k] = false;
+
+	return true;
+}
+
+void DirectoryIndex::Unmap( )
+{
+	if( data != nullptr )
+		UnmapFile( data, size, mapping );
+
+	data = nullptr;
+	size = 0;
+	mapping = 0;
+	directories = nullptr;
+	entries = nullptr;
+	strings = nullptr;
+	ndirectories = 0;
+	nentries = 0;
+	stale.reset( );
+}
+
+void DirectoryIndex::Validate( std::vector<std::string> roots )
+{
+	struct Directory
+	{
+		int64_t mtime;
+		std::vector<Listed> entries;
+	};
+
+	std::map<std::string, Directory, PathLess> fresh;
+	std::vector<std::pair<std::string, size_t>> pending;
+	for( auto it = roots.begin( ); it != roots.end( ); ++it )
+		pending.emplace_back( Normalize( *it ), 0 );
+
+	size_t total = 0;
+	bool complete = true;
+	while( !pending.empty( ) && !stopping )
+	{
+		const std::string path = std::move( pending.back( ).first );
+		const size_t depth = pending.back( ).second;
+		pending.pop_back( );
+
+		// roots can be inside other roots
+		if( fresh.find( path ) != fresh.end( ) )
+			continue;
+
+		int64_t mtime = 0;
+		const bool exists = GetDirectoryTime( path, mtime );
+
+		bool listed = false;
+		Directory directory;
+		directory.mtime = mtime;
+		int64_t index = -1;
+
+		{
+			ReadLock guard( lock );
+			index = FindDirectory( path );
+			if( !exists )
+			{
+				MarkStale( path );
+			}
+			else if( index != -1 && !stale[index] && directories[index].mtime == mtime )
+			{
+				const DirectoryRecord &record = directories[index];
+				directory.entries.reserve( record.count );
+				for( uint32_t k = 0; k < record.count; ++k )
+					directory.entries.push_back( GetListed( entries[record.first + k] ) );
+
+				listed = true;
+			}
+			else if( index != -1 )
+			{
+				stale[index] = true;
+			}
+		}
+
+		if( !exists )
+			continue;
+
+		if( listed )
+		{
+			// files rewritten in place keep their directory's time, every saved entry is checked
+			const std::vector<Listed> saved = directory.entries;
+			listed = StatListing( path, directory.entries ) && SameListing( saved, directory.entries );
+			if( !listed )
+			{
+				ReadLock guard( lock );
+				stale[index] = true;
+				directory.entries.clear( );
+			}
+		}
+
+		if( !listed )
+		{
+			if( !ListDirectory( path, directory.entries ) )
+				continue;
+
+			// subdirectories that are gone take their saved listings with them
+			ReadLock guard( lock );
+			MarkRemoved( path, directory.entries );
+		}
+
+		total += directory.entries.size( );
+		if( total > max_entries )
+		{
+			complete = false;
+			break;
+		}
+
+		for( auto it = directory.entries.begin( ); it != directory.entries.end( ); ++it )
+			if( it->directory && !it->link && depth + 1 < max_depth )
+				pending.emplace_back( path + '/' + it->name, depth + 1 );
+
+		fresh.emplace( path, std::move( directory ) );
+	}
+
+	{
+		WriteLock guard( lock );
+		answering = false;
+		// Windows can't replace a mapped file
+		Unmap( );
+	}
+
+	if( complete && !stopping )
+	{
+		std::vector<std::string> written;
+		{
+			std::lock_guard<std::mutex> guard( dirty_mutex );
+			written.swap( dirty );
+		}
+
+		for( auto it = written.begin( ); it != written.end( ); ++it )
+		{
+			const auto directory = fresh.find( *it );
+			if( directory == fresh.end( ) )
+				continue;
+
+			directory->second.entries.clear( );
+			if( !GetDirectoryTime( *it, directory->second.mtime ) ||
+				!ListDirectory( *it, directory->second.entries ) )
+				fresh.erase( directory );
+		}
+
+		std::vector<std::pair<std::string, int64_t>> paths;
+		std::vector<std::vector<Listed>> listings;
+		paths.reserve( fresh.size( ) );
+		listings.reserve( fresh.size( ) );
+		for( auto it = fresh.begin( ); it != fresh.end( ); ++it )
+		{
+			paths.emplace_back( it->first, it->second.mtime );
+			listings.push_back( std::move( it->second.entries ) );
+		}
+
+		Save( paths, listings );
+	}
+
+	validating = false;
+}
+
+bool DirectoryIndex::Save(
+	const std::vector<std::pair<std::string, int64_t>> &paths,
+	const std::vector<std::vector<Listed>> &listings
+) const
+{
+	std::vector<DirectoryRecord> directory_records;
+	std::vector<EntryRecord> entry_records;
+	std::string blob;
+
+	directory_records.reserve( paths.size( ) );
+	for( size_t k = 0; k < paths.size( ); ++k )
+	{
+		std::vector<const Listed *> sorted;
+		sorted.reserve( listings[k].size( ) );
+		for( auto it = listings[k].begin( ); it != listings[k].end( ); ++it )
+			sorted.push_back( &*it );
+
+		std::sort( sorted.begin( ), sorted.end( ), []( const Listed *a, const Listed *b )
+		{
+			return Compare( a->name.c_str( ), b->name.c_str( ) ) < 0;
+		} );
+
+		directory_records.push_back( DirectoryRecord{
+			static_cast<uint32_t>( blob.size( ) ),
+			static_cast<uint32_t>( entry_records.size( ) ),
+			static_cast<uint32_t>( sorted.size( ) ),
+			0,
+			paths[k].second
+		} );
+		blob.append( paths[k].first.c_str( ), paths[k].first.size( ) + 1 );
+
+		for( auto it = sorted.begin( ); it != sorted.end( ); ++it )
+		{
+			const Listed &listed = **it;
+			entry_records.push_back( EntryRecord{
+				static_cast<uint32_t>( blob.size( ) ),
+				( listed.directory ? entry_directory : 0 ) | ( listed.link ? entry_link : 0 ),
+				listed.size,
+				listed.mtime
+			} );
+			blob.append( listed.name.c_str( ), listed.name.size( ) + 1 );
+		}
+	}
+
+	if( blob.empty( ) || blob.size( ) > UINT32_MAX )
+		return false;
+
+	Header header = { };
+	std::memcpy( header.magic, index_magic, sizeof( index_magic ) );
+	header.version = index_version;
+	header.directories = static_cast<uint32_t>( directory_records.size( ) );
+	header.entries = static_cast<uint32_t>( entry_records.size( ) );
+	header.strings = blob.size( );
+
+	std::string contents;
+	contents.reserve(
+		sizeof( Header ) +
+		directory_records.size( ) * sizeof( DirectoryRecord ) +
+		entry_records.size( ) * sizeof( EntryRecord ) +
+		blob.size( )
+	);
+	contents.append( reinterpret_cast<const char *>( &header ), sizeof( header ) );
+	contents.append(
+		reinterpret_cast<const char *>( directory_records.data( ) ),
+		directory_records.size( ) * sizeof( DirectoryRecord )
+	);
+	contents.append(
+		reinterpret_cast<const char *>( entry_records.data( ) ),
+		entry_records.size( ) * sizeof( EntryRecord )
+	);
+	contents += blob;
+	return SaveFile( filepath, contents );
+}
+
+int64_t DirectoryIndex::FindDirectory( const std::string &path ) const
+{
+	const DirectoryRecord *end = directories + ndirectories;
+	const DirectoryRecord *found = std::lower_bound( directories, end, path, [this]( const DirectoryRecord &record, const std::string &value )
+	{
+		return Compare( strings + record.path, value.c_str( ) ) < 0;
+	} );
+
+	if( found == end || Compare( strings + found->path, path.c_str( ) ) != 0 )
+		return -1;
+
+	return found - directories;
+}
+
+const DirectoryIndex::EntryRecord *DirectoryIndex::FindEntry( const DirectoryRecord &directory, const std::string &name ) const
+{
+	const EntryRecord *begin = entries + directory.first, *end = begin + directory.count;
+	const EntryRecord *found = std::lower_bound( begin, end, name, [this]( const EntryRecord &record, const std::string &value )
+	{
+		return Compare( strings + record.name, value.c_str( ) ) < 0;
+	} );
+
+	if( found == end || Compare( strings + found->name, name.c_str( ) ) != 0 )
+		return nullptr;
+
+	return found;
+}
+
+DirectoryIndex::Listed DirectoryIndex::GetListed( const EntryRecord &entry ) const
+{
+	return Listed{
+		strings + entry.name,
+		( entry.flags & entry_directory ) != 0,
+		entry.size,
+		entry.mtime,
+		( entry.flags & entry_link ) != 0
+	};
+}
+
+void DirectoryIndex::MarkStale( const std::string &path )
+{
+	if( data == nullptr )
+		return;
+
+	const int64_t directory = FindDirectory( path );
+	if( directory != -1 )
+		stale[directory] = true;
+
+	const size_t slash = path.rfind( '/' );
+	if( slash != path.npos )
+	{
+		const int64_t parent = FindDirectory( path.substr( 0, slash ) );
+		if( parent != -1 )
+			stale[parent] = true;
+	}
+
+	// everything below sorts right after the directory itself
+	const std::string prefix = path + '/';
+	const DirectoryRecord *end = directories + ndirectories;
+	const DirectoryRecord *it = std::lower_bound( directories, end, prefix, [this]( const DirectoryRecord &record, const std::string &value )
+	{
+		return Compare( strings + record.path, value.c_str( ) ) < 0;
+	} );
+	for( ; it != end && HasPrefix( strings + it->path, prefix ); ++it )
+		stale[it - directories] = true;
+}
+
+void DirectoryIndex::MarkRemoved( const std::string &path, const std::vector<Listed> &listing )
+{
+	if( data == nullptr )
+		return;
+
+	const std::string prefix = path + '/';
+	const DirectoryRecord *end = directories + ndirectories;
+	const DirectoryRecord *it = std::lower_bound( directories, end, prefix, [this]( const DirectoryRecord &record, const std::string &value )
+	{
+		return Compare( strings + record.path, value.c_str( ) ) < 0;
+	} );
+	for( ; it != end && HasPrefix( strings + it->path, prefix ); ++it )
+	{
+		const char *child = strings + it->path + prefix.size( );
+		const char *slash = std::strchr( child, '/' );
+		const std::string name( child, slash != nullptr ? static_cast<size_t>( slash - child ) : std::strlen( child ) );
+		const bool kept = std::find_if( listing.begin( ), listing.end( ), [&name]( const Listed &listed )
+		{
+			return listed.directory && !listed.link && Compare( listed.name.c_str( ), name.c_str( ) ) == 0;
+		} ) != listing.end( );
+		if( !kept )
+			stale[it - directories] = true;
+	}
+}
+
+std::string DirectoryIndex::Normalize( const std::string &path )
+{
+	std::string normalized = path;
+	std::replace( normalized.begin( ), normalized.end( ), '\\', '/' );
+	while( normalized.size( ) > 1 && normalized.back( ) == '/' )
+		normalized.pop_back( );
+
+	return normalized;
+}
+
+bool DirectoryIndex::SameListing( const std::vector<Listed> &a, const std::vector<Listed> &b )
+{
+	if( a.size( ) != b.size( ) )
+		return false;
+
+	// saved listings are sorted by name, fresh ones come in whatever order the platform lists them
+	std::vector<const Listed *> sorted;
+	sorted.reserve( b.size( ) );
+	for( auto it = b.begin( ); it != b.end( ); ++it )
+		sorted.push_back( &*it );
+
+	std::sort( sorted.begin( ), sorted.end( ), []( const Listed *x, const Listed *y )
+	{
+		return Compare( x->name.c_str( ), y->name.c_str( ) ) < 0;
+	} );
+
+	for( size_t k = 0; k < a.size( ); ++k )
+	{
+		const Listed &x = a[k], &y = *sorted[k];
+		if( Compare( x.name.c_str( ), y.name.c_str( ) ) != 0 || x.directory != y.directory ||
+			x.size != y.size || x.mtime != y.mtime || x.link != y.link )
+			return false;
+	}
+
+	return true;
+}
+
+int DirectoryIndex::Compare( const char *a, const char *b )
+{
+	for( ; *a != '\0' && Fold( *a ) == Fold( *b ); ++a, ++b );
+	return static_cast<int>( static_cast<unsigned char>( Fold( *a ) ) ) -
+		static_cast<int>( static_cast<unsigned char>( Fold( *b ) ) );
+}
+
+}
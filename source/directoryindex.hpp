@@ -0,0 +1,140 @@
+#pragma once
+
+#include "rwlock.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace filesystem
+{
+
+// Listing of every directory below a set of roots (names, sizes, times and types), saved to a single
+// file that is mapped as is on the next start. The saved listing answers lookups while a thread
+// validates it against the disk, comparing directory times and listing again only the directories
+// that changed, after which the refreshed listing replaces the file and lookups go to the disk again.
+// Directory times only change when entries come and go, so the entries of unchanged directories are
+// still checked one by one and a directory stops answering as soon as any of them differs.
+// Nothing is indexed unless asked for, the file lives in the user's cache directory where Lua can't
+// reach it since it holds absolute paths.
+class DirectoryIndex
+{
+public:
+	enum Result
+	{
+		// not indexed, stale or no longer answering, the caller looks it up the slow way
+		Unknown,
+		Missing,
+		Found
+	};
+
+	struct Listed
+	{
+		std::string name;
+		bool directory;
+		uint64_t size;
+		// seconds since the Unix epoch
+		int64_t mtime;
+		// symbolic link, never descended into so validating can't loop
+		bool link;
+	};
+
+	struct Statistics
+	{
+		uint64_t hits;
+		uint64_t misses;
+		size_t directories;
+		size_t entries;
+		size_t stale;
+		bool answering;
+		bool validating;
+	};
+
+	DirectoryIndex( );
+	~DirectoryIndex( );
+
+	// directory of the user's cache for this library (created if needed), empty when there's none
+	static std::string GetCacheDirectory( );
+
+	// maps the index saved at filepath (when there's one) and starts validating it against roots
+	void Start( const std::string &filepath, const std::vector<std::string> &roots );
+	// stops validating without saving and unmaps the file
+	void Stop( );
+
+	bool IsAnswering( ) const;
+	// true when fullpath is an indexed directory the saved listing still answers for
+	bool HasDirectory( const std::string &fullpath ) const;
+	Result Find( const std::string &fullpath, Listed &entry ) const;
+	Result List( const std::string &fullpath, std::vector<Listed> &entries ) const;
+
+	// written through the wrapper, fullpath, its directory and everything below it aren't answered for
+	// anymore and the directory is listed again before saving
+	void Invalidate( const std::string &fullpath );
+
+	Statistics GetStatistics( ) const;
+
+private:
+	struct Header;
+	struct DirectoryRecord;
+	struct EntryRecord;
+
+	DirectoryIndex( const DirectoryIndex & ) = delete;
+	DirectoryIndex &operator=( const DirectoryIndex & ) = delete;
+
+	bool Map( );
+	void Unmap( );
+	void Validate( std::vector<std::string> roots );
+	bool Save( const std::vector<std::pair<std::string, int64_t>> &directories, const std::vector<std::vector<Listed>> &listings ) const;
+
+	// these expect the lock to be held
+	int64_t FindDirectory( const std::string &path ) const;
+	const EntryRecord *FindEntry( const DirectoryRecord &directory, const std::string &name ) const;
+	Listed GetListed( const EntryRecord &entry ) const;
+	void MarkStale( const std::string &path );
+	void MarkRemoved( const std::string &path, const std::vector<Listed> &listing );
+
+	static std::string Normalize( const std::string &path );
+	static int Compare( const char *a, const char *b );
+	static bool SameListing( const std::vector<Listed> &a, const std::vector<Listed> &b );
+
+	static const char *MapFile( const std::string &fullpath, size_t &size, intptr_t &mapping );
+	static void UnmapFile( const char *data, size_t size, intptr_t mapping );
+	static bool SaveFile( const std::string &fullpath, const std::string &contents );
+	static bool GetDirectoryTime( const std::string &fullpath, int64_t &mtime );
+	static bool ListDirectory( const std::string &fullpath, std::vector<Listed> &entries );
+	// describes entries again as they are now, false when any of them can't be
+	static bool StatListing( const std::string &fullpath, std::vector<Listed> &entries );
+
+	static const size_t max_entries;
+	static const size_t max_depth;
+
+	mutable ReadWriteLock lock;
+	std::string filepath;
+	const char *data;
+	size_t size;
+	intptr_t mapping;
+	const DirectoryRecord *directories;
+	const EntryRecord *entries;
+	const char *strings;
+	uint32_t ndirectories;
+	uint32_t nentries;
+	std::unique_ptr<std::atomic<bool>[]> stale;
+
+	std::atomic<bool> answering;
+	std::atomic<bool> validating;
+	std::atomic<bool> stopping;
+	mutable std::atomic<uint64_t> hits;
+	mutable std::atomic<uint64_t> misses;
+
+	// directories written to while validating, listed again before saving
+	std::mutex dirty_mutex;
+	std::vector<std::string> dirty;
+
+	std::thread thread;
+};
+
+}
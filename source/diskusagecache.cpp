@@ -0,0 +1,180 @@
+#include "diskusagecache.hpp"
+#include "sharedcache.hpp"
+
+#include <algorithm>
+
+namespace filesystem
+{
+
+const size_t DiskUsageCache::max_entries = 1024;
+const std::chrono::seconds DiskUsageCache::max_age( 30 );
+
+// true when a is b or one of them lies inside the other, keys look like "pathid:path"
+static bool IsRelated( const std::string &a, const std::string &b )
+{
+	const std::string &shorter = a.size( ) < b.size( ) ? a : b, &longer = a.size( ) < b.size( ) ? b : a;
+	if( longer.compare( 0, shorter.size( ), shorter ) != 0 )
+		return false;
+
+	if( longer.size( ) == shorter.size( ) )
+		return true;
+
+	const char next = longer[shorter.size( )];
+	return next == '/' || next == '\\' || shorter.back( ) == ':';
+}
+
+// full paths, either way around
+static bool IsRelatedPath( const std::string &a, const std::string &b )
+{
+	return SharedCache::IsSameOrBelow( a, b ) || SharedCache::IsSameOrBelow( b, a );
+}
+
+DiskUsageCache::DiskUsageCache( ) :
+	generation( 0 ),
+	stats( )
+{ }
+
+bool DiskUsageCache::Get( const std::string &key, bool children, DiskUsageReport &report )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = entries.find( key );
+	if( it == entries.end( ) || ( children && !it->second.children ) || it->second.expiration <= Clock::now( ) )
+	{
+		++stats.misses;
+		return false;
+	}
+
+	++stats.hits;
+	report.total = it->second.report.total;
+	if( children )
+		report.children = it->second.report.children;
+
+	return true;
+}
+
+uint64_t DiskUsageCache::GetGeneration( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return generation;
+}
+
+void DiskUsageCache::Set(
+	const std::string &key,
+	const std::vector<std::string> &roots,
+	bool children,
+	const DiskUsageReport &report,
+	uint64_t walked
+)
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	// the walk may have seen a change halfway through
+	if( walked != generation )
+		return;
+
+	for( auto change = changes.begin( ); change != changes.end( ); ++change )
+		for( auto root = roots.begin( ); root != roots.end( ); ++root )
+			if( IsRelatedPath( *change, *root ) )
+				return;
+
+	// no eviction order is kept, a full cache just starts over
+	if( entries.size( ) >= max_entries )
+		entries.clear( );
+
+	Entry &entry = entries[key];
+	entry.report = report;
+	entry.roots = roots;
+	entry.children = children;
+	entry.expiration = Clock::now( ) + max_age;
+}
+
+void DiskUsageCache::InvalidatePath( const std::string &fullpath )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	InvalidatePathUnlocked( fullpath );
+}
+
+std::shared_ptr<void> DiskUsageCache::BeginChange( const std::string &fullpath )
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		changes.push_back( fullpath );
+		InvalidatePathUnlocked( fullpath );
+	}
+
+	// the cache lives as long as the module, the token never outlives it
+	return std::shared_ptr<void>( this, [fullpath]( void *cache )
+	{
+		static_cast<DiskUsageCache *>( cache )->EndChange( fullpath );
+	} );
+}
+
+void DiskUsageCache::EndChange( const std::string &fullpath )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = std::find( changes.begin( ), changes.end( ), fullpath );
+	if( it != changes.end( ) )
+		changes.erase( it );
+
+	InvalidatePathUnlocked( fullpath );
+}
+
+void DiskUsageCache::InvalidatePathUnlocked( const std::string &fullpath )
+{
+	++generation;
+
+	for( auto it = entries.begin( ); it != entries.end( ); )
+	{
+		bool related = false;
+		for( auto root = it->second.roots.begin( ); root != it->second.roots.end( ) && !related; ++root )
+			related = IsRelatedPath( *root, fullpath );
+
+		if( related )
+		{
+			it = entries.erase( it );
+			++stats.invalidations;
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void DiskUsageCache::Invalidate( const std::string &key )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	++generation;
+
+	for( auto it = entries.begin( ); it != entries.end( ); )
+		if( IsRelated( it->first, key ) )
+		{
+			it = entries.erase( it );
+			++stats.invalidations;
+		}
+		else
+		{
+			++it;
+		}
+}
+
+void DiskUsageCache::Clear( )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	++generation;
+	stats.invalidations += entries.size( );
+	entries.clear( );
+}
+
+DiskUsageCache::Statistics DiskUsageCache::GetStatistics( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	Statistics statistics = stats;
+	statistics.entries = entries.size( );
+	return statistics;
+}
+
+}
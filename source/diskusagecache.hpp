@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+
+namespace filesystem
+{
+
+struct UsageTotals
+{
+	uint64_t bytes;
+	// bytes allocated on disk, what compressed and sparse files actually take
+	uint64_t allocated;
+	uint64_t files;
+	uint64_t directories;
+};
+
+struct DiskUsageReport
+{
+	UsageTotals total;
+	// per first level child, only filled when asked for
+	std::map<std::string, UsageTotals> children;
+};
+
+// Disk usage reports keyed by path ID and normalized path, along with the full paths they walked.
+// Writes through the wrapper drop the reports of the written path, its parents and children under
+// every path ID that reaches them, and nothing is stored while a background change runs there;
+// anything else (the engine's file library, other processes) is only caught by reports expiring.
+class DiskUsageCache
+{
+public:
+	struct Statistics
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t invalidations;
+		size_t entries;
+	};
+
+	DiskUsageCache( );
+
+	// reports with children also answer requests without them
+	bool Get( const std::string &key, bool children, DiskUsageReport &report );
+	// moves on with every invalidation and change, taken before walking
+	uint64_t GetGeneration( ) const;
+	// roots are the full paths that were walked, nothing is stored when the generation moved
+	// since or a change is still running in, above or below one of them
+	void Set(
+		const std::string &key,
+		const std::vector<std::string> &roots,
+		bool children,
+		const DiskUsageReport &report,
+		uint64_t generation
+	);
+
+	void Invalidate( const std::string &key );
+	// drops the reports that walked fullpath, something inside it or something holding it
+	void InvalidatePath( const std::string &fullpath );
+	// keeps reports related to fullpath from being stored until the returned token is released,
+	// for changes that run in the background
+	std::shared_ptr<void> BeginChange( const std::string &fullpath );
+	void Clear( );
+
+	Statistics GetStatistics( ) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Entry
+	{
+		DiskUsageReport report;
+		std::vector<std::string> roots;
+		bool children;
+		Clock::time_point expiration;
+	};
+
+	void EndChange( const std::string &fullpath );
+	void InvalidatePathUnlocked( const std::string &fullpath );
+
+	static const size_t max_entries;
+	static const std::chrono::seconds max_age;
+
+	mutable std::mutex mutex;
+	std::unordered_map<std::string, Entry> entries;
+	std::vector<std::string> changes;
+	uint64_t generation;
+	Statistics stats;
+};
+
+}
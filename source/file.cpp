@@ -1,5 +1,6 @@
 #include "file.hpp"
 #include "filebase.hpp"
+#include "scheduler.hpp"
 
 #include <GarrysMod/Lua/Interface.h>
 #include <lua.hpp>
@@ -168,10 +169,27 @@ LUA_FUNCTION_STATIC( Seek )
 
 LUA_FUNCTION_STATIC( Flush )
 {
+	filesystem::Scheduler::Timer timer( LUA );
+
 	LUA->PushBool( Get( LUA, 1 )->Flush( ) );
 	return 1;
 }
 
+LUA_FUNCTION_STATIC( Prefetch )
+{
+	Base *file = Get( LUA, 1 );
+
+	int64_t offset = 0, len = -1;
+	if( LUA->GetType( 2 ) > GarrysMod::Lua::Type::Nil )
+		offset = static_cast<int64_t>( LUA->CheckNumber( 2 ) );
+
+	if( LUA->GetType( 3 ) > GarrysMod::Lua::Type::Nil )
+		len = static_cast<int64_t>( LUA->CheckNumber( 3 ) );
+
+	LUA->PushBool( file->Prefetch( offset, len ) );
+	return 1;
+}
+
 LUA_FUNCTION_STATIC( InvertBytes )
 {
 	CheckType( LUA, 1 );
@@ -182,6 +200,8 @@ LUA_FUNCTION_STATIC( InvertBytes )
 
 LUA_FUNCTION_STATIC( Read )
 {
+	filesystem::Scheduler::Timer timer( LUA );
+
 	Base *file = Get( LUA, 1 );
 	LUA->CheckType( 2, GarrysMod::Lua::Type::Number );
 
@@ -202,6 +222,8 @@ LUA_FUNCTION_STATIC( Read )
 
 LUA_FUNCTION_STATIC( ReadString )
 {
+	filesystem::Scheduler::Timer timer( LUA );
+
 	Base *file = Get( LUA, 1 );
 
 	int64_t pos = file->Tell( );
@@ -373,6 +395,8 @@ LUA_FUNCTION_STATIC( ReadDouble )
 
 LUA_FUNCTION_STATIC( Write )
 {
+	filesystem::Scheduler::Timer timer( LUA );
+
 	Base *file = Get( LUA, 1 );
 	LUA->CheckType( 2, GarrysMod::Lua::Type::String );
 
@@ -385,6 +409,8 @@ LUA_FUNCTION_STATIC( Write )
 
 LUA_FUNCTION_STATIC( WriteString )
 {
+	filesystem::Scheduler::Timer timer( LUA );
+
 	Base *file = Get( LUA, 1 );
 	LUA->CheckType( 2, GarrysMod::Lua::Type::String );
 
@@ -555,6 +581,9 @@ void Initialize( GarrysMod::Lua::ILuaBase *LUA )
 	LUA->PushCFunction( Flush );
 	LUA->SetField( -2, "Flush" );
 
+	LUA->PushCFunction( Prefetch );
+	LUA->SetField( -2, "Prefetch" );
+
 	LUA->PushCFunction( InvertBytes );
 	LUA->SetField( -2, "InvertBytes" );
 
@@ -13,6 +13,14 @@ enum SeekDirection
 	SeekEnd
 };
 
+enum AccessHint
+{
+	AccessNormal,
+	AccessSequential,
+	AccessRandom,
+	AccessNoReuse
+};
+
 class Base
 {
 public:
@@ -32,6 +40,12 @@ public:
 
 	virtual size_t Read( void *buffer, size_t len ) = 0;
 	virtual size_t Write( const void *buffer, size_t len ) = 0;
+
+	// asks for the range to be read into cache in the background, len < 0 means until the end
+	virtual bool Prefetch( int64_t, int64_t )
+	{
+		return false;
+	}
 };
 
 }
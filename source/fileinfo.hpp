@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <memory>
+
+namespace filesystem
+{
+
+struct FileInfo
+{
+	uint64_t size;
+	// seconds since the Unix epoch, ctime is the creation time on Windows
+	int64_t mtime;
+	int64_t ctime;
+	int64_t atime;
+	// birth time, 0 when the platform or filesystem doesn't keep it
+	int64_t btime;
+	bool directory;
+	bool packed;
+	// shared so results copied out of the caches don't copy it, null when nothing was resolved
+	std::shared_ptr<const std::string> searchpath;
+};
+
+}
@@ -0,0 +1,94 @@
+#include "filejournaled.hpp"
+
+namespace file
+{
+
+Journaled::Journaled( Base *inner, std::function<void( )> record, bool truncated ) :
+	file( inner ),
+	callback( std::move( record ) ),
+	pending( truncated )
+{ }
+
+Journaled::~Journaled( )
+{
+	Close( );
+	delete file;
+}
+
+bool Journaled::Valid( ) const
+{
+	return file->Valid( );
+}
+
+bool Journaled::Good( ) const
+{
+	return file->Good( );
+}
+
+bool Journaled::EndOfFile( ) const
+{
+	return file->EndOfFile( );
+}
+
+bool Journaled::Close( )
+{
+	if( !file->Valid( ) )
+		return false;
+
+	const bool closed = file->Close( );
+	if( pending )
+		Record( );
+
+	return closed;
+}
+
+int64_t Journaled::Size( ) const
+{
+	return file->Size( );
+}
+
+int64_t Journaled::Tell( ) const
+{
+	return file->Tell( );
+}
+
+bool Journaled::Seek( int64_t pos, SeekDirection dir )
+{
+	return file->Seek( pos, dir );
+}
+
+bool Journaled::Flush( )
+{
+	return file->Flush( );
+}
+
+size_t Journaled::Read( void *buffer, size_t len )
+{
+	return file->Read( buffer, len );
+}
+
+size_t Journaled::Write( const void *buffer, size_t len )
+{
+	const size_t written = file->Write( buffer, len );
+	if( written != 0 && callback )
+		Record( );
+
+	return written;
+}
+
+bool Journaled::Prefetch( int64_t offset, int64_t len )
+{
+	return file->Prefetch( offset, len );
+}
+
+void Journaled::Record( )
+{
+	// later writes to the same handle don't need entries of their own, consumers rescan the file
+	std::function<void( )> record;
+	record.swap( callback );
+	pending = false;
+	if( record )
+		record( );
+}
+
+}
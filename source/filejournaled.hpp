@@ -0,0 +1,46 @@
+#pragma once
+
+#include "filebase.hpp"
+
+#include <functional>
+
+namespace file
+{
+
+// Forwards everything to a file opened for writing and calls back once, on the first write that
+// lands. Opens that truncate the file report it when closed if nothing was written since.
+class Journaled : public Base
+{
+public:
+	Journaled( Base *inner, std::function<void( )> record, bool truncated );
+	~Journaled( );
+
+	bool Valid( ) const;
+	bool Good( ) const;
+	bool EndOfFile( ) const;
+
+	bool Close( );
+
+	int64_t Size( ) const;
+	int64_t Tell( ) const;
+	bool Seek( int64_t pos, SeekDirection dir );
+
+	bool Flush( );
+
+	size_t Read( void *buffer, size_t len );
+	size_t Write( const void *buffer, size_t len );
+
+	bool Prefetch( int64_t offset, int64_t len );
+
+private:
+	Journaled( const Journaled & ) = delete;
+	Journaled &operator=( const Journaled & ) = delete;
+
+	void Record( );
+
+	Base *file;
+	std::function<void( )> callback;
+	bool pending;
+};
+
+}
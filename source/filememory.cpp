@@ -0,0 +1,115 @@
+#include "filememory.hpp"
+
+#include <cstring>
+
+namespace file
+{
+
+Memory::Memory( std::shared_ptr<const std::string> data ) :
+	contents( std::move( data ) ),
+	position( 0 ),
+	eof( false )
+{ }
+
+Memory::~Memory( )
+{
+	Close( );
+}
+
+bool Memory::Valid( ) const
+{
+	return static_cast<bool>( contents );
+}
+
+bool Memory::Good( ) const
+{
+	return true;
+}
+
+bool Memory::EndOfFile( ) const
+{
+	if( !Valid( ) )
+		return true;
+
+	return eof;
+}
+
+bool Memory::Close( )
+{
+	if( !Valid( ) )
+		return false;
+
+	contents.reset( );
+	return true;
+}
+
+int64_t Memory::Size( ) const
+{
+	if( !Valid( ) )
+		return -1;
+
+	return static_cast<int64_t>( contents->size( ) );
+}
+
+int64_t Memory::Tell( ) const
+{
+	if( !Valid( ) )
+		return -1;
+
+	return static_cast<int64_t>( position );
+}
+
+bool Memory::Seek( int64_t pos, SeekDirection dir )
+{
+	if( !Valid( ) )
+		return false;
+
+	int64_t base = 0;
+	if( dir == SeekCur )
+		base = static_cast<int64_t>( position );
+	else if( dir == SeekEnd )
+		base = static_cast<int64_t>( contents->size( ) );
+
+	const int64_t target = base + pos;
+	if( target < 0 )
+		return false;
+
+	position = static_cast<size_t>( target );
+	eof = false;
+	return true;
+}
+
+bool Memory::Flush( )
+{
+	return Valid( );
+}
+
+size_t Memory::Read( void *buffer, size_t len )
+{
+	if( !Valid( ) )
+		return 0;
+
+	const size_t size = contents->size( );
+	const size_t available = position < size ? size - position : 0;
+	if( len > available )
+	{
+		len = available;
+		eof = true;
+	}
+
+	std::memcpy( buffer, contents->data( ) + position, len );
+	position += len;
+	return len;
+}
+
+size_t Memory::Write( const void *, size_t )
+{
+	return 0;
+}
+
+bool Memory::Prefetch( int64_t, int64_t )
+{
+	return Valid( );
+}
+
+}
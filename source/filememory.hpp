@@ -0,0 +1,41 @@
+#pragma once
+
+#include "filebase.hpp"
+
+#include <string>
+#include <memory>
+
+namespace file
+{
+
+// Read-only view over file contents preloaded in memory.
+class Memory : public Base
+{
+public:
+	Memory( std::shared_ptr<const std::string> data );
+	~Memory( );
+
+	bool Valid( ) const;
+	bool Good( ) const;
+	bool EndOfFile( ) const;
+
+	bool Close( );
+
+	int64_t Size( ) const;
+	int64_t Tell( ) const;
+	bool Seek( int64_t pos, SeekDirection dir );
+
+	bool Flush( );
+
+	size_t Read( void *buffer, size_t len );
+	size_t Write( const void *buffer, size_t len );
+
+	bool Prefetch( int64_t offset, int64_t len );
+
+private:
+	std::shared_ptr<const std::string> contents;
+	size_t position;
+	bool eof;
+};
+
+}
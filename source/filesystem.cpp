@@ -1,15 +1,24 @@
 #include "file.hpp"
+#include "filebase.hpp"
+#include "changewatcher.hpp"
 #include "filesystemwrapper.hpp"
+#include "findhandle.hpp"
+#include "scheduler.hpp"
 
 #include <filesystem.h>
 
 #include <GarrysMod/Lua/Interface.h>
 #include <GarrysMod/FactoryLoader.hpp>
+#include <lua.hpp>
 
 #include <cstdint>
 #include <string>
-#include <tuple>
+#include <algorithm>
+#include <cctype>
 #include <vector>
+#include <memory>
+#include <unordered_map>
+#include <list>
 
 #if defined FILESYSTEM_SERVER
 
@@ -67,11 +76,95 @@ static const Symbol g_pFullFileSystem_sym = Symbol::FromName( "g_pFullFileSystem
 
 #endif
 
+static const char *scheduler_hook = "filesystem.Scheduler";
+
+static const std::unordered_map<std::string, file::AccessHint> access_hints = {
+	{ "normal", file::AccessNormal },
+	{ "sequential", file::AccessSequential },
+	{ "random", file::AccessRandom },
+	{ "noreuse", file::AccessNoReuse }
+};
+
+static const std::unordered_map<std::string, Wrapper::BatchOperation> batch_operations = {
+	{ "exists", Wrapper::BatchOperation::Exists },
+	{ "isdir", Wrapper::BatchOperation::IsDirectory },
+	{ "size", Wrapper::BatchOperation::Size },
+	{ "time", Wrapper::BatchOperation::Time }
+};
+
+static bool IsBatchOperation( const char *name )
+{
+	return name != nullptr && batch_operations.find( name ) != batch_operations.end( );
+}
+
+static const std::unordered_map<std::string, Wrapper::FindSort> find_sorts = {
+	{ "name", Wrapper::FindSort::Name },
+	{ "natural", Wrapper::FindSort::Natural },
+	{ "mtime", Wrapper::FindSort::Time },
+	{ "size", Wrapper::FindSort::Size }
+};
+
 Wrapper filesystem;
 
+// walk streaming batches into a Lua callback, polled on every tick
+struct ActiveWalk
+{
+	std::unique_ptr<Walker> walker;
+	int32_t callback;
+	std::string caller;
+	size_t batch;
+};
+
+static std::unordered_map<GarrysMod::Lua::ILuaBase *, std::list<ActiveWalk>> walks;
+
+// deferred work is accounted to the Lua file that requested it
+static std::string GetCaller( GarrysMod::Lua::ILuaBase *LUA )
+{
+	lua_State *state = LUA->GetState( );
+	lua_Debug ar;
+	if( lua_getstack( state, 1, &ar ) == 1 && lua_getinfo( state, "S", &ar ) != 0 )
+		return ar.short_src;
+
+	return "[C]";
+}
+
+// calls the function at the top of the stack (below its arguments) and reports errors without halting
+static void SafeCall( GarrysMod::Lua::ILuaBase *LUA, int32_t nargs )
+{
+	if( LUA->PCall( nargs, 0, 0 ) == 0 )
+		return;
+
+	LUA->GetField( GarrysMod::Lua::INDEX_GLOBAL, "ErrorNoHalt" );
+	if( LUA->IsType( -1, GarrysMod::Lua::Type::Function ) )
+	{
+		LUA->Push( -2 );
+		LUA->PushString( "\n" );
+		LUA->Call( 2, 0 );
+	}
+	else
+	{
+		LUA->Pop( 1 );
+	}
+
+	LUA->Pop( 1 );
+}
+
 LUA_FUNCTION_STATIC( Open )
 {
-	file::Base *f = filesystem.Open( LUA->CheckString( 1 ), LUA->CheckString( 2 ), LUA->CheckString( 3 ) );
+	Scheduler::Timer timer( LUA );
+
+	file::AccessHint hint = file::AccessNormal;
+	if( LUA->GetType( 4 ) > GarrysMod::Lua::Type::Nil )
+	{
+		const std::string name = LUA->CheckString( 4 );
+		const auto it = access_hints.find( name );
+		if( it == access_hints.end( ) )
+			LUA->ArgError( 4, "unknown access hint, must be normal, sequential, random or noreuse" );
+
+		hint = it->second;
+	}
+
+	file::Base *f = filesystem.Open( LUA->CheckString( 1 ), LUA->CheckString( 2 ), LUA->CheckString( 3 ), hint );
 	if( f == nullptr )
 		return 0;
 
@@ -79,82 +172,959 @@ LUA_FUNCTION_STATIC( Open )
 	return 1;
 }
 
+LUA_FUNCTION_STATIC( ReadAsync )
+{
+	const std::string path = LUA->CheckString( 1 ), pathid = LUA->CheckString( 2 );
+	LUA->CheckType( 3, GarrysMod::Lua::Type::Function );
+
+	LUA->Push( 3 );
+	const int32_t callback = LUA->ReferenceCreate( );
+
+	Scheduler::Get( LUA )->Enqueue( GetCaller( LUA ), [path, pathid, callback]( GarrysMod::Lua::ILuaBase *LUA )
+	{
+		LUA->ReferencePush( callback );
+		LUA->ReferenceFree( callback );
+		LUA->PushString( path.c_str( ) );
+		LUA->PushString( pathid.c_str( ) );
+
+		std::unique_ptr<file::Base> f( filesystem.Open( path, "rb", pathid ) );
+		const int64_t size = f ? f->Size( ) : -1;
+		if( size > 0 )
+		{
+			std::vector<char> buffer( static_cast<size_t>( size ) );
+			LUA->PushString( buffer.data( ), f->Read( buffer.data( ), buffer.size( ) ) );
+		}
+		else if( size == 0 )
+		{
+			LUA->PushString( "" );
+		}
+		else
+		{
+			LUA->PushNil( );
+		}
+
+		SafeCall( LUA, 3 );
+	} );
+
+	return 0;
+}
+
+LUA_FUNCTION_STATIC( Prefetch )
+{
+	const std::string path = LUA->CheckString( 1 ), pathid = LUA->CheckString( 2 );
+
+	Scheduler::Get( LUA )->Enqueue( GetCaller( LUA ), [path, pathid]( GarrysMod::Lua::ILuaBase * )
+	{
+		filesystem.Prefetch( path, pathid );
+	} );
+
+	return 0;
+}
+
+LUA_FUNCTION_STATIC( Preload )
+{
+	Scheduler::Timer timer( LUA );
+
+	LUA->PushBool( filesystem.Preload( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( Unload )
+{
+	Scheduler::Timer timer( LUA );
+
+	LUA->PushBool( filesystem.Unload( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
+	return 1;
+}
+
 LUA_FUNCTION_STATIC( Exists )
 {
+	Scheduler::Timer timer( LUA );
+
 	LUA->PushBool( filesystem.Exists( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
 	return 1;
 }
 
 LUA_FUNCTION_STATIC( IsDirectory )
 {
+	Scheduler::Timer timer( LUA );
+
 	LUA->PushBool( filesystem.IsDirectory( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
 	return 1;
 }
 
 LUA_FUNCTION_STATIC( GetSize )
 {
+	Scheduler::Timer timer( LUA );
+
 	LUA->PushNumber( static_cast<double>( filesystem.GetSize( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) ) );
 	return 1;
 }
 
 LUA_FUNCTION_STATIC( GetTime )
 {
+	Scheduler::Timer timer( LUA );
+
 	LUA->PushNumber( static_cast<double>( filesystem.GetTime( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) ) );
 	return 1;
 }
 
-LUA_FUNCTION_STATIC( Rename )
-{
-	LUA->PushBool( filesystem.Rename( LUA->CheckString( 1 ), LUA->CheckString( 2 ), LUA->CheckString( 3 ) ) );
-	return 1;
-}
+LUA_FUNCTION_STATIC( Stat )
+{
+	Scheduler::Timer timer( LUA );
+
+	FileInfo info;
+	if( !filesystem.Stat( LUA->CheckString( 1 ), LUA->CheckString( 2 ), info ) )
+		return 0;
+
+	LUA->CreateTable( );
+
+	LUA->PushNumber( static_cast<double>( info.size ) );
+	LUA->SetField( -2, "size" );
+
+	LUA->PushNumber( static_cast<double>( info.mtime ) );
+	LUA->SetField( -2, "mtime" );
+
+	LUA->PushNumber( static_cast<double>( info.ctime ) );
+	LUA->SetField( -2, "ctime" );
+
+	LUA->PushNumber( static_cast<double>( info.atime ) );
+	LUA->SetField( -2, "atime" );
+
+	if( info.btime != 0 )
+	{
+		LUA->PushNumber( static_cast<double>( info.btime ) );
+		LUA->SetField( -2, "btime" );
+	}
+
+	LUA->PushBool( info.directory );
+	LUA->SetField( -2, "isdir" );
+
+	LUA->PushBool( info.packed );
+	LUA->SetField( -2, "packed" );
+
+	if( info.searchpath && !info.searchpath->empty( ) )
+	{
+		LUA->PushString( info.searchpath->c_str( ) );
+		LUA->SetField( -2, "searchpath" );
+	}
+
+	return 1;
+}
+
+// array of { operation, path, pathid } with operation being exists, isdir, size or time,
+// returns an array with the result of each one, in the same order
+LUA_FUNCTION_STATIC( Batch )
+{
+	Scheduler::Timer timer( LUA );
+
+	LUA->CheckType( 1, GarrysMod::Lua::Type::Table );
+
+	lua_State *state = LUA->GetState( );
+	const size_t count = lua_objlen( state, 1 );
+
+	// errors jump out of this function, so everything is validated before any C++ object that
+	// needs destroying exists
+	for( size_t k = 0; k < count; ++k )
+	{
+		lua_rawgeti( state, 1, static_cast<int>( k + 1 ) );
+		if( !LUA->IsType( -1, GarrysMod::Lua::Type::Table ) )
+			LUA->ArgError( 1, "every operation must be a table of { operation, path, pathid }" );
+
+		lua_rawgeti( state, -1, 1 );
+		lua_rawgeti( state, -2, 2 );
+		lua_rawgeti( state, -3, 3 );
+		if( !LUA->IsType( -3, GarrysMod::Lua::Type::String ) || !IsBatchOperation( LUA->GetString( -3 ) ) )
+			LUA->ArgError( 1, "unknown operation, must be exists, isdir, size or time" );
+
+		if( LUA->GetString( -2 ) == nullptr || LUA->GetString( -1 ) == nullptr )
+			LUA->ArgError( 1, "every operation needs a path and a path ID" );
+
+		LUA->Pop( 4 );
+	}
+
+	std::vector<Wrapper::BatchItem> items( count );
+	for( size_t k = 0; k < count; ++k )
+	{
+		Wrapper::BatchItem &item = items[k];
+
+		lua_rawgeti( state, 1, static_cast<int>( k + 1 ) );
+		lua_rawgeti( state, -1, 1 );
+		lua_rawgeti( state, -2, 2 );
+		lua_rawgeti( state, -3, 3 );
+		item.operation = batch_operations.find( LUA->GetString( -3 ) )->second;
+		item.path = LUA->GetString( -2 );
+		item.pathid = LUA->GetString( -1 );
+		LUA->Pop( 4 );
+	}
+
+	filesystem.Batch( items );
+
+	lua_createtable( state, static_cast<int>( count ), 0 );
+	for( size_t k = 0; k < count; ++k )
+	{
+		const Wrapper::BatchItem &item = items[k];
+		switch( item.operation )
+		{
+			case Wrapper::BatchOperation::Exists:
+				LUA->PushBool( item.exists );
+				break;
+
+			case Wrapper::BatchOperation::IsDirectory:
+				LUA->PushBool( item.exists && item.info.directory );
+				break;
+
+			case Wrapper::BatchOperation::Size:
+				LUA->PushNumber( item.exists ? static_cast<double>( item.info.size ) : 0.0 );
+				break;
+
+			case Wrapper::BatchOperation::Time:
+				LUA->PushNumber( item.exists ? static_cast<double>( item.info.mtime ) : 0.0 );
+				break;
+		}
+
+		lua_rawseti( state, -2, static_cast<int>( k + 1 ) );
+	}
+
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( Rename )
+{
+	Scheduler::Timer timer( LUA );
+
+	LUA->PushBool( filesystem.Rename( LUA->CheckString( 1 ), LUA->CheckString( 2 ), LUA->CheckString( 3 ) ) );
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( Remove )
+{
+	Scheduler::Timer timer( LUA );
+
+	LUA->PushBool( filesystem.Remove( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( MakeDirectory )
+{
+	Scheduler::Timer timer( LUA );
+
+	LUA->PushBool( filesystem.MakeDirectory( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
+	return 1;
+}
+
+// pushes a sequence preallocated to its final length
+static void PushNames( GarrysMod::Lua::ILuaBase *LUA, const std::vector<FindEntry> &entries )
+{
+	lua_State *state = LUA->GetState( );
+	lua_createtable( state, static_cast<int>( entries.size( ) ), 0 );
+	for( size_t k = 0; k < entries.size( ); ++k )
+	{
+		LUA->PushString( entries[k].name.c_str( ), static_cast<unsigned int>( entries[k].name.size( ) ) );
+		lua_rawseti( state, -2, static_cast<int>( k + 1 ) );
+	}
+}
+
+// optional table with sort ("name", "natural", "mtime" or "size"), descending, offset and limit
+static Wrapper::FindOptions GetFindOptions( GarrysMod::Lua::ILuaBase *LUA, int32_t index )
+{
+	Wrapper::FindOptions options;
+	if( LUA->GetType( index ) <= GarrysMod::Lua::Type::Nil )
+		return options;
+
+	LUA->CheckType( index, GarrysMod::Lua::Type::Table );
+
+	LUA->GetField( index, "sort" );
+	if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+	{
+		const auto it = find_sorts.find( LUA->CheckString( -1 ) );
+		if( it == find_sorts.end( ) )
+			LUA->ArgError( index, "unknown sort, must be name, natural, mtime or size" );
+
+		options.sort = it->second;
+	}
+
+	LUA->GetField( index, "descending" );
+	options.descending = LUA->GetBool( -1 );
+
+	LUA->GetField( index, "offset" );
+	if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+		options.offset = static_cast<size_t>( std::max( LUA->CheckNumber( -1 ), 0.0 ) );
+
+	LUA->GetField( index, "limit" );
+	if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+		options.limit = static_cast<size_t>( std::max( LUA->CheckNumber( -1 ), 0.0 ) );
+
+	LUA->Pop( 4 );
+	return options;
+}
+
+LUA_FUNCTION_STATIC( Find )
+{
+	Scheduler::Timer timer( LUA );
+
+	Wrapper::FindResults results;
+	filesystem.Find( LUA->CheckString( 1 ), LUA->CheckString( 2 ), Wrapper::FindOptions( ), results );
+
+	PushNames( LUA, results.files );
+	PushNames( LUA, results.directories );
+	return 2;
+}
+
+// Find with sorting and paging, also returns the counts before paging
+LUA_FUNCTION_STATIC( FindPaged )
+{
+	Scheduler::Timer timer( LUA );
+
+	const Wrapper::FindOptions options = GetFindOptions( LUA, 3 );
+
+	Wrapper::FindResults results;
+	filesystem.Find( LUA->CheckString( 1 ), LUA->CheckString( 2 ), options, results );
+
+	PushNames( LUA, results.files );
+	PushNames( LUA, results.directories );
+	LUA->PushNumber( static_cast<double>( results.total_files ) );
+	LUA->PushNumber( static_cast<double>( results.total_directories ) );
+	return 4;
+}
+
+// sequence of { name, isdir, size, mtime } records
+static void PushRecords( GarrysMod::Lua::ILuaBase *LUA, const std::vector<FindEntry> &entries )
+{
+	lua_State *state = LUA->GetState( );
+	lua_createtable( state, static_cast<int>( entries.size( ) ), 0 );
+	for( size_t k = 0; k < entries.size( ); ++k )
+	{
+		const FindEntry &entry = entries[k];
+
+		lua_createtable( state, 0, 4 );
+
+		LUA->PushString( entry.name.c_str( ), static_cast<unsigned int>( entry.name.size( ) ) );
+		LUA->SetField( -2, "name" );
+
+		LUA->PushBool( entry.directory );
+		LUA->SetField( -2, "isdir" );
+
+		LUA->PushNumber( static_cast<double>( entry.size ) );
+		LUA->SetField( -2, "size" );
+
+		LUA->PushNumber( static_cast<double>( entry.mtime ) );
+		LUA->SetField( -2, "mtime" );
+
+		lua_rawseti( state, -2, static_cast<int>( k + 1 ) );
+	}
+}
+
+LUA_FUNCTION_STATIC( FindDetailed )
+{
+	Scheduler::Timer timer( LUA );
+
+	Wrapper::FindOptions options = GetFindOptions( LUA, 3 );
+	options.metadata = true;
+
+	Wrapper::FindResults results;
+	filesystem.Find( LUA->CheckString( 1 ), LUA->CheckString( 2 ), options, results );
+
+	PushRecords( LUA, results.files );
+	PushRecords( LUA, results.directories );
+	LUA->PushNumber( static_cast<double>( results.total_files ) );
+	LUA->PushNumber( static_cast<double>( results.total_directories ) );
+	return 4;
+}
+
+static void GetExtension( GarrysMod::Lua::ILuaBase *LUA, int32_t index, std::vector<std::string> &extensions )
+{
+	std::string extension = LUA->CheckString( index );
+	if( !extension.empty( ) && extension[0] == '.' )
+		extension.erase( 0, 1 );
+
+	std::transform( extension.begin( ), extension.end( ), extension.begin( ), []( char c )
+	{
+		return static_cast<char>( std::tolower( static_cast<unsigned char>( c ) ) );
+	} );
+	extensions.push_back( std::move( extension ) );
+}
+
+// optional table with ext (string or list of strings), minsize, maxsize,
+// olderthan and newerthan (Unix timestamps), recursive and limit
+static Wrapper::QueryOptions GetQueryOptions( GarrysMod::Lua::ILuaBase *LUA, int32_t index )
+{
+	Wrapper::QueryOptions options;
+	if( LUA->GetType( index ) <= GarrysMod::Lua::Type::Nil )
+		return options;
+
+	LUA->CheckType( index, GarrysMod::Lua::Type::Table );
+
+	LUA->GetField( index, "ext" );
+	if( LUA->GetType( -1 ) == GarrysMod::Lua::Type::Table )
+	{
+		for( int32_t k = 1; ; ++k )
+		{
+			LUA->PushNumber( k );
+			LUA->GetTable( -2 );
+			if( LUA->GetType( -1 ) <= GarrysMod::Lua::Type::Nil )
+			{
+				LUA->Pop( 1 );
+				break;
+			}
+
+			GetExtension( LUA, -1, options.extensions );
+			LUA->Pop( 1 );
+		}
+	}
+	else if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+	{
+		GetExtension( LUA, -1, options.extensions );
+	}
+
+	LUA->GetField( index, "minsize" );
+	if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+		options.min_size = static_cast<uint64_t>( std::max( LUA->CheckNumber( -1 ), 0.0 ) );
+
+	LUA->GetField( index, "maxsize" );
+	if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+		options.max_size = static_cast<uint64_t>( std::max( LUA->CheckNumber( -1 ), 0.0 ) );
+
+	LUA->GetField( index, "olderthan" );
+	if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+		options.older_than = static_cast<int64_t>( LUA->CheckNumber( -1 ) );
+
+	LUA->GetField( index, "newerthan" );
+	if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+		options.newer_than = static_cast<int64_t>( LUA->CheckNumber( -1 ) );
+
+	LUA->GetField( index, "recursive" );
+	options.recursive = LUA->GetBool( -1 );
+
+	LUA->GetField( index, "limit" );
+	if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+		options.limit = static_cast<size_t>( std::max( LUA->CheckNumber( -1 ), 0.0 ) );
+
+	LUA->Pop( 7 );
+	return options;
+}
+
+LUA_FUNCTION_STATIC( Query )
+{
+	Scheduler::Timer timer( LUA );
+
+	const Wrapper::QueryOptions options = GetQueryOptions( LUA, 3 );
+
+	std::vector<FindEntry> files;
+	filesystem.Query( LUA->CheckString( 1 ), LUA->CheckString( 2 ), options, files );
+
+	PushRecords( LUA, files );
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( FindIter )
+{
+	Scheduler::Timer timer( LUA );
+
+	// a disallowed path still gets an iterator, it just yields nothing like Find's empty tables
+	findhandle::Create( LUA, filesystem.FindFirst( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
+	return 2;
+}
+
+static void PushStrings( GarrysMod::Lua::ILuaBase *LUA, const std::vector<std::string> &strings )
+{
+	lua_State *state = LUA->GetState( );
+	lua_createtable( state, static_cast<int>( strings.size( ) ), 0 );
+	for( size_t k = 0; k < strings.size( ); ++k )
+	{
+		LUA->PushString( strings[k].c_str( ), static_cast<unsigned int>( strings[k].size( ) ) );
+		lua_rawseti( state, -2, static_cast<int>( k + 1 ) );
+	}
+}
+
+// optional table with nocase and limit, returns relative paths of matching files and directories
+LUA_FUNCTION_STATIC( Glob )
+{
+	Scheduler::Timer timer( LUA );
+
+	bool nocase = false;
+	size_t limit = 0;
+	if( LUA->GetType( 3 ) > GarrysMod::Lua::Type::Nil )
+	{
+		LUA->CheckType( 3, GarrysMod::Lua::Type::Table );
+
+		LUA->GetField( 3, "nocase" );
+		nocase = LUA->GetBool( -1 );
+
+		LUA->GetField( 3, "limit" );
+		if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+			limit = static_cast<size_t>( std::max( LUA->CheckNumber( -1 ), 0.0 ) );
+
+		LUA->Pop( 2 );
+	}
+
+	std::vector<std::string> files, directories;
+	filesystem.Glob( LUA->CheckString( 1 ), LUA->CheckString( 2 ), nocase, limit, files, directories );
+
+	PushStrings( LUA, files );
+	PushStrings( LUA, directories );
+	return 2;
+}
+
+// write path IDs only, the destination is never replaced unless overwrite is true
+LUA_FUNCTION_STATIC( Copy )
+{
+	Scheduler::Timer timer( LUA );
+
+	uint64_t bytes = 0;
+	const bool copied = filesystem.Copy(
+		LUA->CheckString( 1 ),
+		LUA->CheckString( 2 ),
+		LUA->CheckString( 3 ),
+		LUA->GetBool( 4 ),
+		bytes
+	);
+
+	LUA->PushBool( copied );
+	LUA->PushNumber( static_cast<double>( bytes ) );
+	return 2;
+}
+
+// returns whether everything was copied, the files copied, their bytes and the files skipped
+// for having extensions that can't be written
+LUA_FUNCTION_STATIC( CopyTree )
+{
+	Scheduler::Timer timer( LUA );
+
+	std::unique_ptr<TreeCopier> copier( filesystem.CopyTree(
+		LUA->CheckString( 1 ),
+		LUA->CheckString( 2 ),
+		LUA->CheckString( 3 ),
+		LUA->GetBool( 4 )
+	) );
+	if( !copier )
+	{
+		LUA->PushBool( false );
+		return 1;
+	}
+
+	const TreeCopier::Result result = copier->Run( );
+	LUA->PushBool( result.complete );
+	LUA->PushNumber( static_cast<double>( result.files ) );
+	LUA->PushNumber( static_cast<double>( result.bytes ) );
+	LUA->PushNumber( static_cast<double>( result.skipped ) );
+	return 4;
+}
+
+// { bytes, allocated, files, directories } table
+static void PushDiskUsage( GarrysMod::Lua::ILuaBase *LUA, const UsageTotals &usage )
+{
+	lua_createtable( LUA->GetState( ), 0, 4 );
+
+	LUA->PushNumber( static_cast<double>( usage.bytes ) );
+	LUA->SetField( -2, "bytes" );
+
+	LUA->PushNumber( static_cast<double>( usage.allocated ) );
+	LUA->SetField( -2, "allocated" );
+
+	LUA->PushNumber( static_cast<double>( usage.files ) );
+	LUA->SetField( -2, "files" );
+
+	LUA->PushNumber( static_cast<double>( usage.directories ) );
+	LUA->SetField( -2, "directories" );
+}
+
+// totals of the loose files under path, with children a children field maps every
+// first level entry name to its own totals, nil when the path isn't allowed
+LUA_FUNCTION_STATIC( DiskUsage )
+{
+	Scheduler::Timer timer( LUA );
+
+	const bool children = LUA->GetBool( 3 );
+
+	DiskUsageReport report;
+	if( !filesystem.DiskUsage( LUA->CheckString( 1 ), LUA->CheckString( 2 ), children, report ) )
+		return 0;
+
+	PushDiskUsage( LUA, report.total );
+	if( children )
+	{
+		lua_createtable( LUA->GetState( ), 0, static_cast<int>( report.children.size( ) ) );
+		for( auto it = report.children.begin( ); it != report.children.end( ); ++it )
+		{
+			PushDiskUsage( LUA, it->second );
+			LUA->SetField( -2, it->first.c_str( ) );
+		}
+
+		LUA->SetField( -2, "children" );
+	}
+
+	return 1;
+}
+
+// tree removal running in the background, polled on every tick
+struct ActiveRemoval
+{
+	std::unique_ptr<TreeRemover> remover;
+	int32_t callback;
+	std::string caller;
+};
+
+static std::unordered_map<GarrysMod::Lua::ILuaBase *, std::list<ActiveRemoval>> removals;
+
+static void PushRemoveResult( GarrysMod::Lua::ILuaBase *LUA, const TreeRemover::Result &result )
+{
+	LUA->PushBool( result.complete );
+	LUA->PushNumber( static_cast<double>( result.entries ) );
+	LUA->PushNumber( static_cast<double>( result.bytes ) );
+	LUA->PushNumber( static_cast<double>( result.skipped ) );
+}
+
+static void PollRemovals( GarrysMod::Lua::ILuaBase *LUA, Scheduler *scheduler )
+{
+	const auto found = removals.find( LUA );
+	if( found == removals.end( ) )
+		return;
+
+	std::list<ActiveRemoval> &active = found->second;
+	for( auto it = active.begin( ); it != active.end( ); )
+	{
+		TreeRemover::Result result;
+		if( !it->remover->Poll( result ) )
+		{
+			++it;
+			continue;
+		}
+
+		const int32_t callback = it->callback;
+		scheduler->Enqueue( it->caller, [result, callback]( GarrysMod::Lua::ILuaBase *LUA )
+		{
+			LUA->ReferencePush( callback );
+			LUA->ReferenceFree( callback );
+			PushRemoveResult( LUA, result );
+			SafeCall( LUA, 4 );
+		} );
+
+		it = active.erase( it );
+	}
+}
+
+// returns whether everything was removed, the entries removed, the bytes they held and the files
+// skipped for having extensions that can't be written, with a callback it runs in the background
+// and callback( complete, entries, bytes, skipped ) gets them
+LUA_FUNCTION_STATIC( RemoveTree )
+{
+	Scheduler::Timer timer( LUA );
+
+	const bool background = LUA->GetType( 3 ) > GarrysMod::Lua::Type::Nil;
+	if( background )
+		LUA->CheckType( 3, GarrysMod::Lua::Type::Function );
+
+	std::unique_ptr<TreeRemover> remover( filesystem.RemoveTree( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
+	if( !remover )
+	{
+		LUA->PushBool( false );
+		return 1;
+	}
+
+	if( background )
+	{
+		remover->Start( );
+
+		LUA->Push( 3 );
+		removals[LUA].push_back( ActiveRemoval{ std::move( remover ), LUA->ReferenceCreate( ), GetCaller( LUA ) } );
+		LUA->PushBool( true );
+		return 1;
+	}
+
+	PushRemoveResult( LUA, remover->Run( ) );
+	return 4;
+}
+
+// pushes the files and directories tables of a walk batch
+static void PushWalkBatch( GarrysMod::Lua::ILuaBase *LUA, const Walker::Batch &batch )
+{
+	std::vector<std::string> files, directories;
+	for( auto it = batch.begin( ); it != batch.end( ); ++it )
+		( it->directory ? directories : files ).push_back( it->path );
+
+	PushStrings( LUA, files );
+	PushStrings( LUA, directories );
+}
+
+static void PollWalks( GarrysMod::Lua::ILuaBase *LUA, Scheduler *scheduler )
+{
+	const auto found = walks.find( LUA );
+	if( found == walks.end( ) )
+		return;
+
+	std::list<ActiveWalk> &active = found->second;
+	for( auto it = active.begin( ); it != active.end( ); )
+	{
+		bool more = true;
+		while( more )
+		{
+			std::shared_ptr<Walker::Batch> batch = std::make_shared<Walker::Batch>( );
+			more = it->walker->Take( *batch, it->batch );
+			if( more && batch->empty( ) )
+				break;
+
+			// delivered like any other deferred work, so big trees don't blow the tick budget
+			const int32_t callback = it->callback;
+			const bool finished = !more;
+			scheduler->Enqueue( it->caller, [batch, callback, finished]( GarrysMod::Lua::ILuaBase *LUA )
+			{
+				LUA->ReferencePush( callback );
+				if( finished )
+					LUA->ReferenceFree( callback );
+
+				PushWalkBatch( LUA, *batch );
+				LUA->PushBool( finished );
+				SafeCall( LUA, 3 );
+			} );
+		}
+
+		if( more )
+			++it;
+		else
+			it = active.erase( it );
+	}
+}
+
+// optional table with threads, depth, limit and batch, only loose files are walked
+// without a callback it blocks and returns files and directories, otherwise
+// callback( files, directories, finished ) receives batches on the next ticks
+LUA_FUNCTION_STATIC( Walk )
+{
+	Scheduler::Timer timer( LUA );
+
+	Walker::Options options;
+	size_t batch = 1024;
+	if( LUA->GetType( 3 ) > GarrysMod::Lua::Type::Nil )
+	{
+		LUA->CheckType( 3, GarrysMod::Lua::Type::Table );
+
+		LUA->GetField( 3, "threads" );
+		if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+			options.threads = static_cast<size_t>( std::max( LUA->CheckNumber( -1 ), 0.0 ) );
+
+		LUA->GetField( 3, "depth" );
+		if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+			options.max_depth = static_cast<size_t>( std::max( LUA->CheckNumber( -1 ), 0.0 ) );
+
+		LUA->GetField( 3, "limit" );
+		if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+			options.limit = static_cast<size_t>( std::max( LUA->CheckNumber( -1 ), 0.0 ) );
+
+		LUA->GetField( 3, "batch" );
+		if( LUA->GetType( -1 ) > GarrysMod::Lua::Type::Nil )
+			batch = static_cast<size_t>( std::max( LUA->CheckNumber( -1 ), 1.0 ) );
+
+		LUA->Pop( 4 );
+	}
+
+	const bool streaming = LUA->GetType( 4 ) > GarrysMod::Lua::Type::Nil;
+	if( streaming )
+		LUA->CheckType( 4, GarrysMod::Lua::Type::Function );
+
+	std::unique_ptr<Walker> walker( filesystem.Walk( LUA->CheckString( 1 ), LUA->CheckString( 2 ), options ) );
+	if( !walker )
+	{
+		if( streaming )
+		{
+			LUA->PushBool( false );
+			return 1;
+		}
+
+		PushWalkBatch( LUA, Walker::Batch( ) );
+		return 2;
+	}
+
+	walker->Start( );
+
+	if( streaming )
+	{
+		LUA->Push( 4 );
+		walks[LUA].push_back( ActiveWalk{ std::move( walker ), LUA->ReferenceCreate( ), GetCaller( LUA ), batch } );
+		LUA->PushBool( true );
+		return 1;
+	}
+
+	walker->Wait( );
+
+	Walker::Batch entries;
+	walker->Take( entries );
+	PushWalkBatch( LUA, entries );
+	return 2;
+}
+
+// watches the loose copies of path (a directory, or a single entry that doesn't need to exist yet),
+// returns an id for Unwatch or nil when the path isn't allowed or can't be watched
+LUA_FUNCTION_STATIC( Watch )
+{
+	Scheduler::Timer timer( LUA );
+
+	ChangeWatcher *changewatcher = ChangeWatcher::Get( LUA );
+	if( changewatcher == nullptr || !changewatcher->Available( ) )
+		return 0;
+
+	std::vector<std::string> directories;
+	std::string name;
+	if( !filesystem.GetWatchTargets( LUA->CheckString( 1 ), LUA->CheckString( 2 ), directories, name ) )
+		return 0;
+
+	const int32_t watch = changewatcher->Add( directories, name, LUA->GetBool( 3 ) );
+	if( watch == -1 )
+		return 0;
+
+	LUA->PushNumber( watch );
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( Unwatch )
+{
+	ChangeWatcher *changewatcher = ChangeWatcher::Get( LUA );
+	LUA->PushBool( changewatcher != nullptr &&
+		changewatcher->Remove( static_cast<int32_t>( LUA->CheckNumber( 1 ) ) ) );
+	return 1;
+}
+
+// events coalesced since the last call, oldest first, as { watch, path, created, modified, removed,
+// renamed, overflow } records, overflow means anything under that watch might have changed
+LUA_FUNCTION_STATIC( PollEvents )
+{
+	Scheduler::Timer timer( LUA );
+
+	std::vector<ChangeWatcher::Event> events;
+	ChangeWatcher *changewatcher = ChangeWatcher::Get( LUA );
+	if( changewatcher != nullptr )
+	{
+		changewatcher->Poll( );
+		changewatcher->Drain( events, static_cast<size_t>( LUA->GetNumber( 1 ) ) );
+	}
+
+	static const std::pair<uint32_t, const char *> flags[] = {
+		{ Watcher::Created, "created" },
+		{ Watcher::Modified, "modified" },
+		{ Watcher::Removed, "removed" },
+		{ Watcher::Renamed, "renamed" },
+		{ Watcher::Overflow, "overflow" }
+	};
+
+	lua_State *state = LUA->GetState( );
+	lua_createtable( state, static_cast<int>( events.size( ) ), 0 );
+	for( size_t k = 0; k < events.size( ); ++k )
+	{
+		const ChangeWatcher::Event &event = events[k];
+
+		lua_createtable( state, 0, 3 );
+
+		LUA->PushNumber( event.watch );
+		LUA->SetField( -2, "watch" );
+
+		LUA->PushString( event.path.c_str( ) );
+		LUA->SetField( -2, "path" );
+
+		for( size_t f = 0; f < sizeof( flags ) / sizeof( *flags ); ++f )
+			if( ( event.events & flags[f].first ) != 0 )
+			{
+				LUA->PushBool( true );
+				LUA->SetField( -2, flags[f].second );
+			}
+
+		lua_rawseti( state, -2, static_cast<int>( k + 1 ) );
+	}
+
+	return 1;
+}
+
+// mutations made through this module after sequence as { sequence, time, operation, path, pathid, target }
+// records, followed by the latest sequence and false when older entries were dropped and a rescan is due
+LUA_FUNCTION_STATIC( ChangesSince )
+{
+	Scheduler::Timer timer( LUA );
+
+	const double after = LUA->CheckNumber( 1 );
+	const size_t limit = static_cast<size_t>( LUA->GetNumber( 2 ) );
+
+	ChangeJournal &journal = filesystem.GetChangeJournal( );
+	std::vector<ChangeJournal::Entry> entries;
+	const bool complete = journal.Since( after > 0.0 ? static_cast<uint64_t>( after ) : 0, entries, limit );
+
+	lua_State *state = LUA->GetState( );
+	lua_createtable( state, static_cast<int>( entries.size( ) ), 0 );
+	for( size_t k = 0; k < entries.size( ); ++k )
+	{
+		const ChangeJournal::Entry &entry = entries[k];
+
+		lua_createtable( state, 0, 6 );
+
+		LUA->PushNumber( static_cast<double>( entry.sequence ) );
+		LUA->SetField( -2, "sequence" );
+
+		LUA->PushNumber( static_cast<double>( entry.time ) );
+		LUA->SetField( -2, "time" );
+
+		LUA->PushString( ChangeJournal::GetOperationName( entry.operation ) );
+		LUA->SetField( -2, "operation" );
+
+		LUA->PushString( entry.path.c_str( ) );
+		LUA->SetField( -2, "path" );
+
+		LUA->PushString( entry.pathid.c_str( ) );
+		LUA->SetField( -2, "pathid" );
 
-LUA_FUNCTION_STATIC( Remove )
-{
-	LUA->PushBool( filesystem.Remove( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
-	return 1;
+		if( !entry.target.empty( ) )
+		{
+			LUA->PushString( entry.target.c_str( ) );
+			LUA->SetField( -2, "target" );
+		}
+
+		lua_rawseti( state, -2, static_cast<int>( k + 1 ) );
+	}
+
+	// with a limit the latest sequence returned is the one to resume from
+	LUA->PushNumber( static_cast<double>( entries.empty( ) ? journal.GetSequence( ) : entries.back( ).sequence ) );
+	LUA->PushBool( complete );
+	return 3;
 }
 
-LUA_FUNCTION_STATIC( MakeDirectory )
+LUA_FUNCTION_STATIC( GetChangeSequence )
 {
-	LUA->PushBool( filesystem.MakeDirectory( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
+	LUA->PushNumber( static_cast<double>( filesystem.GetChangeJournal( ).GetSequence( ) ) );
 	return 1;
 }
 
-LUA_FUNCTION_STATIC( Find )
+// nil or an empty path stops persisting the journal
+LUA_FUNCTION_STATIC( SetJournalFile )
 {
-	std::set<std::string> files, directories;
-	std::tie( files, directories ) = filesystem.Find( LUA->CheckString( 1 ), LUA->CheckString( 2 ) );
+	Scheduler::Timer timer( LUA );
 
-	LUA->CreateTable( );
-	size_t nfiles = 0;
-	for( auto it = files.begin( ); it != files.end( ); ++it )
+	if( LUA->GetType( 1 ) <= GarrysMod::Lua::Type::Nil )
 	{
-		LUA->PushNumber( static_cast<double>( ++nfiles ) );
-		LUA->PushString( it->c_str( ) );
-		LUA->SetTable( -3 );
+		LUA->PushBool( filesystem.SetJournalFile( std::string( ), std::string( ) ) );
+		return 1;
 	}
 
-	LUA->CreateTable( );
-	size_t ndirs = 0;
-	for( auto it = directories.begin( ); it != directories.end( ); ++it )
-	{
-		LUA->PushNumber( static_cast<double>( ++ndirs ) );
-		LUA->PushString( it->c_str( ) );
-		LUA->SetTable( -3 );
-	}
+	LUA->PushBool( filesystem.SetJournalFile( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
+	return 1;
+}
 
-	return 2;
+// walks the loose search paths of GAME and DATA in the background, nothing is indexed until asked
+LUA_FUNCTION_STATIC( EnableDirectoryIndex )
+{
+	Scheduler::Timer timer( LUA );
+
+	LUA->CheckType( 1, GarrysMod::Lua::Type::Bool );
+	LUA->PushBool( filesystem.SetDirectoryIndexEnabled( LUA->GetBool( 1 ) ) );
+	return 1;
 }
 
 LUA_FUNCTION_STATIC( GetSearchPaths )
 {
+	Scheduler::Timer timer( LUA );
+
 	if( LUA->GetType( 1 ) <= GarrysMod::Lua::Type::Nil )
 	{
-		const std::unordered_map<std::string, std::set<std::string>> searchpaths = filesystem.GetSearchPaths( );
+		const std::shared_ptr<const Wrapper::SearchPathMap> searchpaths = filesystem.GetSearchPaths( );
 
 		LUA->CreateTable( );
-		for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+		for( auto it = searchpaths->begin( ); it != searchpaths->end( ); ++it )
 		{
 			LUA->PushString( it->first.c_str( ) );
 			LUA->CreateTable( );
@@ -188,18 +1158,379 @@ LUA_FUNCTION_STATIC( GetSearchPaths )
 	return 1;
 }
 
+LUA_FUNCTION_STATIC( GetSearchPathsGeneration )
+{
+	LUA->PushNumber( static_cast<double>( filesystem.GetSearchPathsGeneration( ) ) );
+	return 1;
+}
+
 LUA_FUNCTION_STATIC( AddSearchPath )
 {
+	Scheduler::Timer timer( LUA );
+
 	LUA->PushBool( filesystem.AddSearchPath( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
 	return 1;
 }
 
 LUA_FUNCTION_STATIC( RemoveSearchPath )
 {
+	Scheduler::Timer timer( LUA );
+
 	LUA->PushBool( filesystem.RemoveSearchPath( LUA->CheckString( 1 ), LUA->CheckString( 2 ) ) );
 	return 1;
 }
 
+LUA_FUNCTION_STATIC( Tick )
+{
+	filesystem.GetSharedCache( ).GetMetadataCache( ).Poll( );
+	filesystem.GetSharedCache( ).GetResolutionIndex( ).Poll( );
+
+	Scheduler *scheduler = Scheduler::Get( LUA );
+	if( scheduler != nullptr )
+	{
+		{
+			// lookup filters get at most half of the budget, deferred tasks keep the rest
+			Scheduler::Timer timer( LUA );
+			filesystem.UpdateFilters( scheduler->GetBudget( ) / 2 );
+		}
+
+		PollWalks( LUA, scheduler );
+		PollRemovals( LUA, scheduler );
+
+		ChangeWatcher *changewatcher = ChangeWatcher::Get( LUA );
+		if( changewatcher != nullptr )
+		{
+			Scheduler::Timer timer( LUA );
+			changewatcher->Poll( );
+		}
+
+		scheduler->Tick( LUA );
+	}
+
+	return 0;
+}
+
+LUA_FUNCTION_STATIC( SetTickBudget )
+{
+	Scheduler::Get( LUA )->SetBudget( LUA->CheckNumber( 1 ) );
+	return 0;
+}
+
+LUA_FUNCTION_STATIC( GetTickBudget )
+{
+	LUA->PushNumber( Scheduler::Get( LUA )->GetBudget( ) );
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( SetHandleCacheSize )
+{
+	const double size = LUA->CheckNumber( 1 );
+	if( size < 0.0 || size > 65535.0 )
+		LUA->ArgError( 1, "size out of bounds, must be between 0 and 65535" );
+
+	filesystem.GetSharedCache( ).GetHandleCache( ).SetCapacity( static_cast<size_t>( size ) );
+	return 0;
+}
+
+LUA_FUNCTION_STATIC( GetHandleCacheSize )
+{
+	LUA->PushNumber( static_cast<double>( filesystem.GetSharedCache( ).GetHandleCache( ).GetCapacity( ) ) );
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( SetPathCacheSize )
+{
+	const double size = LUA->CheckNumber( 1 );
+	if( size < 0.0 || size > 1048576.0 )
+		LUA->ArgError( 1, "size out of bounds, must be between 0 and 1048576" );
+
+	filesystem.GetSharedCache( ).GetPathInternCache( ).SetCapacity( static_cast<size_t>( size ) );
+	return 0;
+}
+
+LUA_FUNCTION_STATIC( GetPathCacheSize )
+{
+	LUA->PushNumber( static_cast<double>( filesystem.GetSharedCache( ).GetPathInternCache( ).GetCapacity( ) ) );
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( SetPreloadLimit )
+{
+	const double limit = LUA->CheckNumber( 1 );
+	if( limit < 0.0 || limit > 4294967295.0 )
+		LUA->ArgError( 1, "limit out of bounds, must fit in a 32 bits unsigned integer" );
+
+	filesystem.GetSharedCache( ).SetContentsLimit( static_cast<size_t>( limit ) );
+	return 0;
+}
+
+LUA_FUNCTION_STATIC( GetPreloadLimit )
+{
+	LUA->PushNumber( static_cast<double>( filesystem.GetSharedCache( ).GetContentsLimit( ) ) );
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( GetStats )
+{
+	LUA->CreateTable( );
+
+	{
+		const Scheduler::Statistics stats = Scheduler::Get( LUA )->GetStatistics( );
+
+		LUA->CreateTable( );
+
+		LUA->PushNumber( static_cast<double>( stats.ticks ) );
+		LUA->SetField( -2, "ticks" );
+
+		LUA->PushNumber( static_cast<double>( stats.budget_hits ) );
+		LUA->SetField( -2, "budget_hits" );
+
+		LUA->PushNumber( static_cast<double>( stats.deferred ) );
+		LUA->SetField( -2, "deferred" );
+
+		LUA->PushNumber( static_cast<double>( stats.executed ) );
+		LUA->SetField( -2, "executed" );
+
+		LUA->PushNumber( static_cast<double>( stats.pending ) );
+		LUA->SetField( -2, "pending" );
+
+		LUA->PushNumber( stats.last_tick_time );
+		LUA->SetField( -2, "last_tick_time" );
+
+		LUA->PushNumber( stats.total_time );
+		LUA->SetField( -2, "total_time" );
+
+		LUA->SetField( -2, "scheduler" );
+	}
+
+	{
+		const HandleCache::Statistics stats = filesystem.GetSharedCache( ).GetHandleCache( ).GetStatistics( );
+
+		LUA->CreateTable( );
+
+		LUA->PushNumber( static_cast<double>( stats.hits ) );
+		LUA->SetField( -2, "hits" );
+
+		LUA->PushNumber( static_cast<double>( stats.misses ) );
+		LUA->SetField( -2, "misses" );
+
+		LUA->PushNumber( static_cast<double>( stats.stale ) );
+		LUA->SetField( -2, "stale" );
+
+		LUA->PushNumber( static_cast<double>( stats.evictions ) );
+		LUA->SetField( -2, "evictions" );
+
+		LUA->PushNumber( static_cast<double>( stats.cached ) );
+		LUA->SetField( -2, "cached" );
+
+		LUA->PushNumber( static_cast<double>( stats.capacity ) );
+		LUA->SetField( -2, "capacity" );
+
+		LUA->SetField( -2, "handles" );
+	}
+
+	{
+		const SharedCache::Statistics stats = filesystem.GetSharedCache( ).GetStatistics( );
+
+		LUA->CreateTable( );
+
+		LUA->PushNumber( static_cast<double>( stats.contents ) );
+		LUA->SetField( -2, "preloaded" );
+
+		LUA->PushNumber( static_cast<double>( stats.contents_size ) );
+		LUA->SetField( -2, "preloaded_size" );
+
+		LUA->PushNumber( static_cast<double>( stats.contents_limit ) );
+		LUA->SetField( -2, "preload_limit" );
+
+		LUA->PushNumber( static_cast<double>( stats.references ) );
+		LUA->SetField( -2, "references" );
+
+		LUA->SetField( -2, "shared" );
+	}
+
+	{
+		const MetadataCache::Statistics stats = filesystem.GetSharedCache( ).GetMetadataCache( ).GetStatistics( );
+
+		LUA->CreateTable( );
+
+		LUA->PushNumber( static_cast<double>( stats.hits ) );
+		LUA->SetField( -2, "hits" );
+
+		LUA->PushNumber( static_cast<double>( stats.misses ) );
+		LUA->SetField( -2, "misses" );
+
+		LUA->PushNumber( static_cast<double>( stats.invalidations ) );
+		LUA->SetField( -2, "invalidations" );
+
+		LUA->PushNumber( static_cast<double>( stats.entries ) );
+		LUA->SetField( -2, "entries" );
+
+		LUA->PushNumber( static_cast<double>( stats.watches ) );
+		LUA->SetField( -2, "watches" );
+
+		LUA->PushBool( stats.notifications );
+		LUA->SetField( -2, "notifications" );
+
+		LUA->SetField( -2, "metadata" );
+	}
+
+	{
+		const LookupFilter::Statistics stats = filesystem.GetSharedCache( ).GetLookupFilter( ).GetStatistics( );
+
+		LUA->CreateTable( );
+
+		LUA->PushNumber( static_cast<double>( stats.rejected ) );
+		LUA->SetField( -2, "rejected" );
+
+		LUA->PushNumber( static_cast<double>( stats.passed ) );
+		LUA->SetField( -2, "passed" );
+
+		LUA->PushNumber( static_cast<double>( stats.filters ) );
+		LUA->SetField( -2, "filters" );
+
+		LUA->PushNumber( static_cast<double>( stats.building ) );
+		LUA->SetField( -2, "building" );
+
+		LUA->PushNumber( static_cast<double>( stats.entries ) );
+		LUA->SetField( -2, "entries" );
+
+		LUA->PushNumber( static_cast<double>( stats.size ) );
+		LUA->SetField( -2, "size" );
+
+		LUA->SetField( -2, "filter" );
+	}
+
+	{
+		const ResolutionIndex::Statistics stats = filesystem.GetSharedCache( ).GetResolutionIndex( ).GetStatistics( );
+
+		LUA->CreateTable( );
+
+		LUA->PushNumber( static_cast<double>( stats.hits ) );
+		LUA->SetField( -2, "hits" );
+
+		LUA->PushNumber( static_cast<double>( stats.misses ) );
+		LUA->SetField( -2, "misses" );
+
+		LUA->PushNumber( static_cast<double>( stats.unsure ) );
+		LUA->SetField( -2, "unsure" );
+
+		LUA->PushNumber( static_cast<double>( stats.indexes ) );
+		LUA->SetField( -2, "indexes" );
+
+		LUA->PushNumber( static_cast<double>( stats.building ) );
+		LUA->SetField( -2, "building" );
+
+		LUA->PushNumber( static_cast<double>( stats.entries ) );
+		LUA->SetField( -2, "entries" );
+
+		LUA->PushNumber( static_cast<double>( stats.watches ) );
+		LUA->SetField( -2, "watches" );
+
+		LUA->SetField( -2, "index" );
+	}
+
+	{
+		const DiskUsageCache::Statistics stats = filesystem.GetSharedCache( ).GetDiskUsageCache( ).GetStatistics( );
+
+		LUA->CreateTable( );
+
+		LUA->PushNumber( static_cast<double>( stats.hits ) );
+		LUA->SetField( -2, "hits" );
+
+		LUA->PushNumber( static_cast<double>( stats.misses ) );
+		LUA->SetField( -2, "misses" );
+
+		LUA->PushNumber( static_cast<double>( stats.invalidations ) );
+		LUA->SetField( -2, "invalidations" );
+
+		LUA->PushNumber( static_cast<double>( stats.entries ) );
+		LUA->SetField( -2, "entries" );
+
+		LUA->SetField( -2, "usage" );
+	}
+
+	{
+		const ChangeJournal::Statistics stats = filesystem.GetChangeJournal( ).GetStatistics( );
+
+		LUA->CreateTable( );
+
+		LUA->PushNumber( static_cast<double>( stats.sequence ) );
+		LUA->SetField( -2, "sequence" );
+
+		LUA->PushNumber( static_cast<double>( stats.oldest ) );
+		LUA->SetField( -2, "oldest" );
+
+		LUA->PushNumber( static_cast<double>( stats.entries ) );
+		LUA->SetField( -2, "entries" );
+
+		LUA->PushNumber( static_cast<double>( stats.capacity ) );
+		LUA->SetField( -2, "capacity" );
+
+		LUA->PushBool( stats.persisted );
+		LUA->SetField( -2, "persisted" );
+
+		LUA->SetField( -2, "journal" );
+	}
+
+	{
+		const DirectoryIndex::Statistics stats = filesystem.GetDirectoryIndex( ).GetStatistics( );
+
+		LUA->CreateTable( );
+
+		LUA->PushNumber( static_cast<double>( stats.hits ) );
+		LUA->SetField( -2, "hits" );
+
+		LUA->PushNumber( static_cast<double>( stats.misses ) );
+		LUA->SetField( -2, "misses" );
+
+		LUA->PushNumber( static_cast<double>( stats.directories ) );
+		LUA->SetField( -2, "directories" );
+
+		LUA->PushNumber( static_cast<double>( stats.entries ) );
+		LUA->SetField( -2, "entries" );
+
+		LUA->PushNumber( static_cast<double>( stats.stale ) );
+		LUA->SetField( -2, "stale" );
+
+		LUA->PushBool( stats.answering );
+		LUA->SetField( -2, "answering" );
+
+		LUA->PushBool( stats.validating );
+		LUA->SetField( -2, "validating" );
+
+		LUA->SetField( -2, "saved_index" );
+	}
+
+	{
+		const PathInternCache::Statistics stats = filesystem.GetSharedCache( ).GetPathInternCache( ).GetStatistics( );
+
+		LUA->CreateTable( );
+
+		LUA->PushNumber( static_cast<double>( stats.hits ) );
+		LUA->SetField( -2, "hits" );
+
+		LUA->PushNumber( static_cast<double>( stats.misses ) );
+		LUA->SetField( -2, "misses" );
+
+		LUA->PushNumber( static_cast<double>( stats.evictions ) );
+		LUA->SetField( -2, "evictions" );
+
+		LUA->PushNumber( static_cast<double>( stats.flushes ) );
+		LUA->SetField( -2, "flushes" );
+
+		LUA->PushNumber( static_cast<double>( stats.entries ) );
+		LUA->SetField( -2, "entries" );
+
+		LUA->PushNumber( static_cast<double>( stats.capacity ) );
+		LUA->SetField( -2, "capacity" );
+
+		LUA->SetField( -2, "paths" );
+	}
+
+	return 1;
+}
+
 void Initialize( GarrysMod::Lua::ILuaBase *LUA )
 {
 
@@ -259,6 +1590,21 @@ void Initialize( GarrysMod::Lua::ILuaBase *LUA )
 	if( !filesystem.Initialize( fsystem ) )
 		LUA->ThrowError( "unable to initialize filesystem wrapper" );
 
+	Scheduler::Create( LUA );
+	ChangeWatcher::Create( LUA );
+
+	LUA->GetField( GarrysMod::Lua::INDEX_GLOBAL, "hook" );
+	if( LUA->IsType( -1, GarrysMod::Lua::Type::Table ) )
+	{
+		LUA->GetField( -1, "Add" );
+		LUA->PushString( "Think" );
+		LUA->PushString( scheduler_hook );
+		LUA->PushCFunction( Tick );
+		LUA->Call( 3, 0 );
+	}
+
+	LUA->Pop( 1 );
+
 	LUA->CreateTable( );
 
 	LUA->PushString( "filesystem 1.4.3" );
@@ -271,6 +1617,18 @@ void Initialize( GarrysMod::Lua::ILuaBase *LUA )
 	LUA->PushCFunction( Open );
 	LUA->SetField( -2, "Open" );
 
+	LUA->PushCFunction( ReadAsync );
+	LUA->SetField( -2, "ReadAsync" );
+
+	LUA->PushCFunction( Prefetch );
+	LUA->SetField( -2, "Prefetch" );
+
+	LUA->PushCFunction( Preload );
+	LUA->SetField( -2, "Preload" );
+
+	LUA->PushCFunction( Unload );
+	LUA->SetField( -2, "Unload" );
+
 	LUA->PushCFunction( Exists );
 	LUA->SetField( -2, "Exists" );
 
@@ -283,27 +1641,114 @@ void Initialize( GarrysMod::Lua::ILuaBase *LUA )
 	LUA->PushCFunction( GetTime );
 	LUA->SetField( -2, "GetTime" );
 
+	LUA->PushCFunction( Stat );
+	LUA->SetField( -2, "Stat" );
+
+	LUA->PushCFunction( Batch );
+	LUA->SetField( -2, "Batch" );
+
 	LUA->PushCFunction( Rename );
 	LUA->SetField( -2, "Rename" );
 
 	LUA->PushCFunction( Remove );
 	LUA->SetField( -2, "Remove" );
 
+	LUA->PushCFunction( DiskUsage );
+	LUA->SetField( -2, "DiskUsage" );
+
+	LUA->PushCFunction( Copy );
+	LUA->SetField( -2, "Copy" );
+
+	LUA->PushCFunction( CopyTree );
+	LUA->SetField( -2, "CopyTree" );
+
+	LUA->PushCFunction( RemoveTree );
+	LUA->SetField( -2, "RemoveTree" );
+
 	LUA->PushCFunction( MakeDirectory );
 	LUA->SetField( -2, "MakeDirectory" );
 
 	LUA->PushCFunction( Find );
 	LUA->SetField( -2, "Find" );
 
+	LUA->PushCFunction( FindPaged );
+	LUA->SetField( -2, "FindPaged" );
+
+	LUA->PushCFunction( FindDetailed );
+	LUA->SetField( -2, "FindDetailed" );
+
+	LUA->PushCFunction( FindIter );
+	LUA->SetField( -2, "FindIter" );
+
+	LUA->PushCFunction( Query );
+	LUA->SetField( -2, "Query" );
+
+	LUA->PushCFunction( Glob );
+	LUA->SetField( -2, "Glob" );
+
+	LUA->PushCFunction( Walk );
+	LUA->SetField( -2, "Walk" );
+
+	LUA->PushCFunction( Watch );
+	LUA->SetField( -2, "Watch" );
+
+	LUA->PushCFunction( Unwatch );
+	LUA->SetField( -2, "Unwatch" );
+
+	LUA->PushCFunction( PollEvents );
+	LUA->SetField( -2, "PollEvents" );
+
+	LUA->PushCFunction( ChangesSince );
+	LUA->SetField( -2, "ChangesSince" );
+
+	LUA->PushCFunction( GetChangeSequence );
+	LUA->SetField( -2, "GetChangeSequence" );
+
+	LUA->PushCFunction( SetJournalFile );
+	LUA->SetField( -2, "SetJournalFile" );
+
+	LUA->PushCFunction( EnableDirectoryIndex );
+	LUA->SetField( -2, "EnableDirectoryIndex" );
+
 	LUA->PushCFunction( GetSearchPaths );
 	LUA->SetField( -2, "GetSearchPaths" );
 
+	LUA->PushCFunction( GetSearchPathsGeneration );
+	LUA->SetField( -2, "GetSearchPathsGeneration" );
+
 	LUA->PushCFunction( AddSearchPath );
 	LUA->SetField( -2, "AddSearchPath" );
 
 	LUA->PushCFunction( RemoveSearchPath );
 	LUA->SetField( -2, "RemoveSearchPath" );
 
+	LUA->PushCFunction( SetTickBudget );
+	LUA->SetField( -2, "SetTickBudget" );
+
+	LUA->PushCFunction( GetTickBudget );
+	LUA->SetField( -2, "GetTickBudget" );
+
+	LUA->PushCFunction( SetHandleCacheSize );
+	LUA->SetField( -2, "SetHandleCacheSize" );
+
+	LUA->PushCFunction( GetHandleCacheSize );
+	LUA->SetField( -2, "GetHandleCacheSize" );
+
+	LUA->PushCFunction( SetPathCacheSize );
+	LUA->SetField( -2, "SetPathCacheSize" );
+
+	LUA->PushCFunction( GetPathCacheSize );
+	LUA->SetField( -2, "GetPathCacheSize" );
+
+	LUA->PushCFunction( SetPreloadLimit );
+	LUA->SetField( -2, "SetPreloadLimit" );
+
+	LUA->PushCFunction( GetPreloadLimit );
+	LUA->SetField( -2, "GetPreloadLimit" );
+
+	LUA->PushCFunction( GetStats );
+	LUA->SetField( -2, "GetStats" );
+
 	uint32_t test = 1;
 	LUA->PushBool( *reinterpret_cast<uint8_t *>( &test ) == 1 );
 	LUA->SetField( -2, "IsLittleEndian" );
@@ -322,6 +1767,40 @@ void Initialize( GarrysMod::Lua::ILuaBase *LUA )
 
 void Deinitialize( GarrysMod::Lua::ILuaBase *LUA )
 {
+	LUA->GetField( GarrysMod::Lua::INDEX_GLOBAL, "hook" );
+	if( LUA->IsType( -1, GarrysMod::Lua::Type::Table ) )
+	{
+		LUA->GetField( -1, "Remove" );
+		LUA->PushString( "Think" );
+		LUA->PushString( scheduler_hook );
+		LUA->Call( 2, 0 );
+	}
+
+	LUA->Pop( 1 );
+
+	// callbacks of walks and removals still running are never called now
+	const auto walking = walks.find( LUA );
+	if( walking != walks.end( ) )
+	{
+		for( auto it = walking->second.begin( ); it != walking->second.end( ); ++it )
+			LUA->ReferenceFree( it->callback );
+
+		walks.erase( walking );
+	}
+
+	const auto removing = removals.find( LUA );
+	if( removing != removals.end( ) )
+	{
+		for( auto it = removing->second.begin( ); it != removing->second.end( ); ++it )
+			LUA->ReferenceFree( it->callback );
+
+		removals.erase( removing );
+	}
+
+	ChangeWatcher::Destroy( LUA );
+	Scheduler::Destroy( LUA );
+	filesystem.Deinitialize( );
+
 	LUA->PushNil( );
 	LUA->SetField( GarrysMod::Lua::INDEX_GLOBAL, "filesystem" );
 }
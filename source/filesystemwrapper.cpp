@@ -0,0 +1,1805 @@
+#include "filesystemwrapper.hpp"
+#include "filejournaled.hpp"
+
+#include <filesystem_base.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace filesystem
+{
+
+Wrapper::FindOptions::FindOptions( ) :
+	sort( FindSort::Name ),
+	descending( false ),
+	offset( 0 ),
+	limit( 0 ),
+	metadata( false )
+{ }
+
+Wrapper::QueryOptions::QueryOptions( ) :
+	min_size( 0 ),
+	max_size( std::numeric_limits<uint64_t>::max( ) ),
+	older_than( std::numeric_limits<int64_t>::max( ) ),
+	newer_than( std::numeric_limits<int64_t>::min( ) ),
+	recursive( false ),
+	limit( 0 )
+{ }
+
+static bool NaturalLess( const std::string &a, const std::string &b )
+{
+	size_t i = 0, j = 0;
+	while( i < a.size( ) && j < b.size( ) )
+	{
+		const unsigned char ca = static_cast<unsigned char>( a[i] ), cb = static_cast<unsigned char>( b[j] );
+		if( std::isdigit( ca ) && std::isdigit( cb ) )
+		{
+			size_t si = i, sj = j;
+			while( si < a.size( ) && a[si] == '0' )
+				++si;
+
+			while( sj < b.size( ) && b[sj] == '0' )
+				++sj;
+
+			size_t ei = si, ej = sj;
+			while( ei < a.size( ) && std::isdigit( static_cast<unsigned char>( a[ei] ) ) )
+				++ei;
+
+			while( ej < b.size( ) && std::isdigit( static_cast<unsigned char>( b[ej] ) ) )
+				++ej;
+
+			// without leading zeros, a longer digit run is a bigger number
+			if( ei - si != ej - sj )
+				return ei - si < ej - sj;
+
+			const int result = a.compare( si, ei - si, b, sj, ej - sj );
+			if( result != 0 )
+				return result < 0;
+
+			i = ei;
+			j = ej;
+			continue;
+		}
+
+		const int la = std::tolower( ca ), lb = std::tolower( cb );
+		if( la != lb )
+			return la < lb;
+
+		++i;
+		++j;
+	}
+
+	if( a.size( ) - i != b.size( ) - j )
+		return a.size( ) - i < b.size( ) - j;
+
+	return a < b;
+}
+
+static void SortAndPage(
+	std::vector<FindEntry> &entries,
+	const Wrapper::FindOptions &options
+)
+{
+	switch( options.sort )
+	{
+		case Wrapper::FindSort::Name:
+			std::sort( entries.begin( ), entries.end( ), [] ( const FindEntry &a, const FindEntry &b )
+			{
+				return a.name < b.name;
+			} );
+			break;
+
+		case Wrapper::FindSort::Natural:
+			std::sort( entries.begin( ), entries.end( ), [] ( const FindEntry &a, const FindEntry &b )
+			{
+				return NaturalLess( a.name, b.name );
+			} );
+			break;
+
+		case Wrapper::FindSort::Time:
+			std::sort( entries.begin( ), entries.end( ), [] ( const FindEntry &a, const FindEntry &b )
+			{
+				return a.mtime != b.mtime ? a.mtime < b.mtime : a.name < b.name;
+			} );
+			break;
+
+		case Wrapper::FindSort::Size:
+			std::sort( entries.begin( ), entries.end( ), [] ( const FindEntry &a, const FindEntry &b )
+			{
+				return a.size != b.size ? a.size < b.size : a.name < b.name;
+			} );
+			break;
+	}
+
+	if( options.descending )
+		std::reverse( entries.begin( ), entries.end( ) );
+
+	if( options.offset >= entries.size( ) )
+	{
+		entries.clear( );
+		return;
+	}
+
+	entries.erase( entries.begin( ), entries.begin( ) + static_cast<ptrdiff_t>( options.offset ) );
+	if( options.limit != 0 && entries.size( ) > options.limit )
+		entries.resize( options.limit );
+}
+
+void Wrapper::Deinitialize( )
+{
+	{
+		WriteLock guard( searchpaths_lock );
+		if( references == 0 || --references != 0 )
+		{
+			cache.SetReferences( references );
+			return;
+		}
+
+		cache.SetReferences( 0 );
+	}
+
+	directory_index.Stop( );
+	threadpool.Stop( );
+	cache.Clear( );
+	journal.SetPersistence( std::string( ) );
+}
+
+bool Wrapper::Preload( const StringRef &fpath, const StringRef &pid )
+{
+	ReadLock guard( searchpaths_lock );
+
+	PathIDBuffer pathid;
+	PathBuffer filepath;
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pid, pathid, WhitelistType::Read ) ||
+		!IsPathAllowed( fpath, filepath, pathid.Get( ), WhitelistType::Read, nonascii ) )
+		return false;
+
+	FileHandle_t fh = filesystem->Open( filepath.Get( ), "rb", pathid.Get( ) );
+	if( fh == nullptr )
+		return false;
+
+	std::shared_ptr<std::string> contents = std::make_shared<std::string>( );
+	contents->resize( filesystem->Size( fh ) );
+	const int32_t read = contents->empty( ) ? 0 :
+		filesystem->Read( &( *contents )[0], static_cast<int32_t>( contents->size( ) ), fh );
+	filesystem->Close( fh );
+
+	if( read < 0 || static_cast<size_t>( read ) != contents->size( ) )
+		return false;
+
+	// writes through other path IDs reach the same file, they find it by its full path
+	const PathKey key( filepath.Ref( ), pathid.Ref( ) );
+	return cache.SetContents( key, std::move( contents ), ResolvePath( key.path, key.pathid ) );
+}
+
+bool Wrapper::Unload( const StringRef &fpath, const StringRef &pid )
+{
+	ReadLock guard( searchpaths_lock );
+
+	PathIDBuffer pathid;
+	PathBuffer filepath;
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pid, pathid, WhitelistType::Read ) ||
+		!IsPathAllowed( fpath, filepath, pathid.Get( ), WhitelistType::Read, nonascii ) )
+		return false;
+
+	return cache.RemoveContents( PathKey( filepath.Ref( ), pathid.Ref( ) ) );
+}
+
+bool Wrapper::IsPathAllowed(
+	const StringRef &input,
+	PathBuffer &filepath,
+	const char *pathid,
+	WhitelistType whitelist_type,
+	bool &nonascii,
+	bool find
+) const
+{
+	// relative paths validate faster than the cache's lock and lookup, only absolute ones walk the
+	// search paths to be made relative and are worth remembering
+	if( !V_IsAbsolutePath( input.c_str( ) ) )
+		return FixupFilePath( input, filepath, pathid ) &&
+			VerifyFilePath( filepath.Get( ), filepath.GetLength( ), find, nonascii ) &&
+			VerifyExtension( filepath.Get( ), whitelist_type );
+
+	// absolute paths are normalized against the search paths, changes to them flush the cache
+	ObserveSearchPaths( );
+
+	PathInternCache &interned = cache.GetPathInternCache( );
+	const uint32_t access = static_cast<uint32_t>( whitelist_type ) | ( find ? 0x100 : 0 );
+	bool allowed = false;
+	if( interned.Get( input, pathid, access, allowed, nonascii, filepath.GetBuffer( ), filepath.GetCapacity( ) ) )
+	{
+		if( allowed )
+			filepath.Update( );
+
+		return allowed;
+	}
+
+	allowed = FixupFilePath( input, filepath, pathid ) &&
+		VerifyFilePath( filepath.Get( ), filepath.GetLength( ), find, nonascii ) &&
+		VerifyExtension( filepath.Get( ), whitelist_type );
+	interned.Set( input, pathid, access, allowed, nonascii, filepath.Get( ) );
+	return allowed;
+}
+
+bool Wrapper::IsPathIDAllowed( std::string &pathid, WhitelistType whitelist_type ) const
+{
+	PathIDBuffer buffer;
+	if( !IsPathIDAllowed( pathid, buffer, whitelist_type ) )
+		return false;
+
+	if( !buffer.Equals( pathid ) )
+		pathid.assign( buffer.Get( ), buffer.GetLength( ) );
+
+	return true;
+}
+
+bool Wrapper::FixupFilePath( std::string &filepath, const std::string &pathid ) const
+{
+	PathBuffer buffer;
+	if( !FixupFilePath( filepath, buffer, pathid.c_str( ) ) )
+		return false;
+
+	if( !buffer.Equals( filepath ) )
+		filepath.assign( buffer.Get( ), buffer.GetLength( ) );
+
+	return true;
+}
+
+bool Wrapper::VerifyFilePath( const std::string &filepath, bool find, bool &nonascii ) const
+{
+	return VerifyFilePath( filepath.c_str( ), filepath.size( ), find, nonascii );
+}
+
+bool Wrapper::VerifyExtension( const std::string &filepath, WhitelistType whitelist_type ) const
+{
+	return VerifyExtension( filepath.c_str( ), whitelist_type );
+}
+
+bool Wrapper::IsPathAllowed(
+	std::string &filepath,
+	std::string &pathid,
+	WhitelistType whitelist_type,
+	bool &nonascii,
+	bool find
+) const
+{
+	PathBuffer buffer;
+	if( !IsPathAllowed( filepath, buffer, pathid.c_str( ), whitelist_type, nonascii, find ) )
+		return false;
+
+	if( !buffer.Equals( filepath ) )
+		filepath.assign( buffer.Get( ), buffer.GetLength( ) );
+
+	return true;
+}
+
+// the lists are short enough that comparing every name beats hashing a temporary string
+bool Wrapper::IsListed( const std::vector<const char *> &list, const char *name )
+{
+	for( auto it = list.begin( ); it != list.end( ); ++it )
+		if( std::strcmp( *it, name ) == 0 )
+			return true;
+
+	return false;
+}
+
+bool Wrapper::StatPacked( const StringRef &filepath, const StringRef &pathid, FileInfo &info ) const
+{
+	info.directory = filesystem->IsDirectory( filepath.c_str( ), pathid.c_str( ) );
+	if( !info.directory && !filesystem->FileExists( filepath.c_str( ), pathid.c_str( ) ) )
+		return false;
+
+	info.size = info.directory ? 0 : filesystem->Size( filepath.c_str( ), pathid.c_str( ) );
+	info.mtime = filesystem->GetPathTime( filepath.c_str( ), pathid.c_str( ) );
+	info.ctime = info.mtime;
+	info.atime = info.mtime;
+	info.btime = 0;
+	info.packed = true;
+	return true;
+}
+
+long Wrapper::GetHandleTime( const StringRef &filepath, const StringRef &pathid, bool nonascii ) const
+{
+	// change notifications keep the metadata cache current, so reopening a file it holds costs no calls
+	// into the engine, only lookups it can't answer do
+	bool exists = false;
+	FileInfo info;
+	if( GetMetadata( filepath, pathid, nonascii, exists, info ) )
+		return exists ? static_cast<long>( info.mtime ) : 0;
+
+	return filesystem->GetFileTime( filepath.c_str( ), pathid.c_str( ) );
+}
+
+bool Wrapper::MayExist( const StringRef &path, const StringRef &pathid ) const
+{
+	ObserveSearchPaths( );
+
+	LookupFilter &filter = cache.GetLookupFilter( );
+
+	LookupFilter::SearchPaths loose;
+	switch( filter.Check( pathid, path, loose ) )
+	{
+		case LookupFilter::Unknown:
+		{
+			const std::string id = pathid.ToString( );
+			filter.Start( id, GetLooseSearchPaths( id ) );
+			return true;
+		}
+
+		case LookupFilter::Present:
+			return true;
+
+		case LookupFilter::Absent:
+			break;
+	}
+
+	// loose search paths can gain files without going through us (downloads, the engine's file library)
+	char fullpath[max_tempbuffer_len] = { 0 };
+	for( auto it = loose->begin( ); it != loose->end( ); ++it )
+	{
+		V_ComposeFileName( it->c_str( ), path.c_str( ), fullpath, sizeof( fullpath ) );
+		if( PathExists( fullpath ) )
+			return true;
+	}
+
+	return false;
+}
+
+std::vector<std::string> Wrapper::GetLooseSearchPaths( const std::string &pathid ) const
+{
+	std::vector<std::string> loose;
+
+	// pack files don't change under us, only directories do
+	const std::vector<std::string> searchpaths = ListSearchPaths( pathid );
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+		if( IsDirectoryPath( *it ) )
+			loose.push_back( *it );
+
+	return loose;
+}
+
+MetadataCache::Dependencies Wrapper::GetWatchDirectories( const std::string &path, const std::string &pathid ) const
+{
+	MetadataCache::Dependencies directories;
+
+	const std::vector<std::string> searchpaths = GetLooseSearchPaths( pathid );
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+	{
+		// the nearest existing ancestor is notified when anything below it appears, and every
+		// directory above it up to the search path when the next one down is renamed or removed,
+		// a watch doesn't hear about directories higher up moving it elsewhere
+		std::string directory = *it + path, child;
+		bool found = false;
+		for(
+			size_t pos = directory.find_last_of( "/\\" );
+			pos != directory.npos && pos >= it->size( );
+			pos = directory.find_last_of( "/\\" )
+		)
+		{
+			const std::string name = directory.substr( pos + 1 );
+			directory.resize( pos );
+			if( found || IsDirectoryPath( directory ) )
+			{
+				directories.push_back( MetadataCache::Dependency{ directory, found ? name : std::string( ) } );
+				found = true;
+			}
+
+			child = name;
+		}
+
+		directories.push_back( MetadataCache::Dependency{ *it, found ? child : std::string( ) } );
+	}
+
+	return directories;
+}
+
+bool Wrapper::GetMetadata(
+	const StringRef &path,
+	const StringRef &pathid,
+	bool nonascii,
+	bool &exists,
+	FileInfo &info
+) const
+{
+	MetadataCache &metadata = cache.GetMetadataCache( );
+	const bool cacheable = metadata.Available( );
+	const PathKey key( path, pathid );
+	if( cacheable )
+	{
+		ObserveSearchPaths( );
+		if( metadata.Get( key, exists, info ) )
+			return true;
+	}
+
+	// not cached, everything from here on builds its own strings
+	const std::string filepath = path.ToString( ), id = pathid.ToString( );
+
+	// the saved listing can only be trusted until it's validated
+	if( LookupDirectoryIndex( filepath, id, exists, info ) )
+		return true;
+
+	if( !cacheable )
+		return false;
+
+	// watched before resolving, so changes made while resolving are reported and drop the entry
+	MetadataCache::Dependencies directories = GetWatchDirectories( filepath, id );
+	const bool watched = metadata.Watch( directories );
+
+	exists = ResolveInfo( path, pathid, nonascii, info );
+
+	// a directory's own times change with its contents, it can only be watched once it's found so
+	// it's resolved again after that
+	if( watched && exists && info.directory && !info.packed )
+	{
+		const MetadataCache::Dependencies self( 1, MetadataCache::Dependency{ *info.searchpath + filepath, std::string( ) } );
+		if( metadata.Watch( self ) )
+		{
+			exists = ResolveInfo( path, pathid, nonascii, info );
+			if( exists && info.directory && !info.packed && *info.searchpath + filepath == self[0].directory )
+				directories.push_back( self[0] );
+			else
+				return true;
+		}
+		else
+		{
+			return true;
+		}
+	}
+
+	if( watched )
+		metadata.Set( key.ToString( ), exists, info, directories );
+
+	return true;
+}
+
+static const size_t min_parallel_lookups = 64;
+// lookups claimed at once, small enough that whoever runs keeps the others from idling
+static const size_t lookup_grain = 16;
+
+void Wrapper::Batch( std::vector<BatchItem> &items ) const
+{
+	struct Lookup
+	{
+		std::string path;
+		std::string pathid;
+		bool nonascii;
+		bool resolved;
+		bool exists;
+		FileInfo info;
+		// loose search paths that win over every pack for this path ID
+		const std::vector<std::string> *loose;
+	};
+
+	std::vector<Lookup> lookups;
+	std::vector<size_t> indices( items.size( ) );
+	std::unordered_map<std::string, size_t> keys;
+	std::unordered_map<std::string, std::vector<std::string>> prefixes;
+
+	ReadLock guard( searchpaths_lock );
+
+	ObserveSearchPaths( );
+
+	MetadataCache &metadata = cache.GetMetadataCache( );
+	const bool cacheable = metadata.Available( );
+
+	std::string key;
+	for( size_t k = 0; k < items.size( ); ++k )
+	{
+		Lookup lookup;
+		lookup.path = items[k].path;
+		lookup.pathid = items[k].pathid;
+		lookup.nonascii = false;
+		lookup.resolved = true;
+		lookup.exists = false;
+		lookup.loose = nullptr;
+
+		const bool allowed = IsPathIDAllowed( lookup.pathid, WhitelistType::Read ) &&
+			IsPathAllowed( lookup.path, lookup.pathid, WhitelistType::Read, lookup.nonascii );
+		if( allowed )
+		{
+			// exists, size and time of the same file share one lookup, keyed once normalized
+			// so spellings like a//b and a/b share it too
+			key = SharedCache::MakeKey( lookup.path, lookup.pathid );
+			const auto found = keys.find( key );
+			if( found != keys.end( ) )
+			{
+				indices[k] = found->second;
+				continue;
+			}
+
+			keys.emplace( key, lookups.size( ) );
+		}
+
+		indices[k] = lookups.size( );
+
+		if( allowed &&
+			MayExist( lookup.path, lookup.pathid ) &&
+			( !cacheable || !metadata.Get( PathKey( lookup.path, lookup.pathid ), lookup.exists, lookup.info ) ) )
+		{
+			lookup.resolved = false;
+
+			auto prefix = prefixes.find( lookup.pathid );
+			if( prefix == prefixes.end( ) )
+				prefix = prefixes.emplace( lookup.pathid, GetLeadingSearchPaths( lookup.pathid ) ).first;
+
+			lookup.loose = &prefix->second;
+		}
+
+		lookups.push_back( std::move( lookup ) );
+	}
+
+	std::vector<Lookup *> pending;
+	for( auto it = lookups.begin( ); it != lookups.end( ); ++it )
+		if( !it->resolved && !it->loose->empty( ) )
+			pending.push_back( &*it );
+
+	// plain stats of search path + path, no engine calls, so they're safe on the workers
+	auto resolve = []( Lookup &lookup )
+	{
+		for( auto it = lookup.loose->begin( ); it != lookup.loose->end( ); ++it )
+			if( StatPath( *it + lookup.path, lookup.info ) )
+			{
+				lookup.info.packed = false;
+				lookup.info.searchpath = std::make_shared<const std::string>( *it );
+				lookup.exists = lookup.resolved = true;
+				return;
+			}
+	};
+
+	const size_t threads = threadpool.GetThreadCount( );
+	if( pending.size( ) < min_parallel_lookups || threads < 2 )
+	{
+		for( auto it = pending.begin( ); it != pending.end( ); ++it )
+			resolve( **it );
+	}
+	else
+	{
+		// lookups are claimed a few at a time from a shared counter, by this thread too: helpers
+		// stuck behind a long scan in the pool's queue just find nothing left when they start
+		struct Shared
+		{
+			std::atomic<size_t> next;
+			std::mutex mutex;
+			std::condition_variable condition;
+			size_t done;
+		};
+
+		const std::shared_ptr<Shared> shared = std::make_shared<Shared>( );
+		shared->next = 0;
+		shared->done = 0;
+
+		Lookup *const *claimable = pending.data( );
+		const size_t count = pending.size( );
+		// late helpers never dereference these, every index was claimed before this returns
+		auto work = [shared, claimable, count, resolve]( )
+		{
+			for( ; ; )
+			{
+				const size_t start = shared->next.fetch_add( lookup_grain );
+				if( start >= count )
+					return;
+
+				const size_t end = std::min( start + lookup_grain, count );
+				for( size_t k = start; k < end; ++k )
+					resolve( *claimable[k] );
+
+				std::lock_guard<std::mutex> lock( shared->mutex );
+				shared->done += end - start;
+				if( shared->done == count )
+					shared->condition.notify_all( );
+			}
+		};
+
+		for( size_t k = 1; k < threads; ++k )
+			if( !threadpool.Post( work ) )
+				break;
+
+		work( );
+
+		std::unique_lock<std::mutex> lock( shared->mutex );
+		shared->condition.wait( lock, [&shared, count] { return shared->done == count; } );
+	}
+
+	// packed files, or loose files behind a pack, go through the usual path on this thread
+	for( auto it = lookups.begin( ); it != lookups.end( ); ++it )
+		if( !it->resolved && !GetMetadata( it->path, it->pathid, it->nonascii, it->exists, it->info ) )
+			it->exists = ResolveInfo( it->path, it->pathid, it->nonascii, it->info );
+
+	for( size_t k = 0; k < items.size( ); ++k )
+	{
+		const Lookup &lookup = lookups[indices[k]];
+		items[k].exists = lookup.exists;
+		items[k].info = lookup.info;
+	}
+}
+
+Finder *Wrapper::FindFirst( const std::string &p, const std::string &pid ) const
+{
+	std::string filename = p, pathid = pid;
+
+	ReadLock guard( searchpaths_lock );
+
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
+		!IsPathAllowed( filename, pathid, WhitelistType::Read, nonascii, true ) )
+		return nullptr;
+
+	return OpenFinder( filename, pathid );
+}
+
+bool Wrapper::Find(
+	const std::string &p,
+	const std::string &pid,
+	const FindOptions &options,
+	FindResults &results
+) const
+{
+	std::string filename = p, pathid = pid;
+
+	results.files.clear( );
+	results.directories.clear( );
+	results.total_files = 0;
+	results.total_directories = 0;
+
+	ReadLock guard( searchpaths_lock );
+
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
+		!IsPathAllowed( filename, pathid, WhitelistType::Read, nonascii, true ) )
+		return false;
+
+	// the saved listing comes with sizes and times already
+	const bool indexed = FindDirectoryIndex( filename, pathid, results );
+	if( !indexed )
+	{
+		std::unique_ptr<Finder> finder( OpenFinder( filename, pathid ) );
+		if( !finder )
+			return false;
+
+		// the engine already skips names repeated across search paths, no need for sets here
+		results.files.reserve( 64 );
+		results.directories.reserve( 16 );
+
+		FindEntry entry;
+		entry.size = 0;
+		entry.mtime = 0;
+		while( finder->Next( entry.name, entry.directory ) )
+			( entry.directory ? results.directories : results.files ).push_back( entry );
+	}
+
+	results.total_files = results.files.size( );
+	results.total_directories = results.directories.size( );
+
+	if( !indexed && ( options.metadata || options.sort == FindSort::Time || options.sort == FindSort::Size ) )
+		FillFindMetadata( filename, pathid, results );
+
+	SortAndPage( results.files, options );
+	SortAndPage( results.directories, options );
+	return true;
+}
+
+static const size_t max_walk_depth = 64;
+
+static std::string GetListingPattern( const std::string &directory )
+{
+	std::string listing = directory;
+	std::replace( listing.begin( ), listing.end( ), '\\', '/' );
+	while( !listing.empty( ) && listing.back( ) == '/' )
+		listing.pop_back( );
+
+	if( !listing.empty( ) )
+		listing += '/';
+
+	listing += '*';
+	return listing;
+}
+
+Walker *Wrapper::Walk( const std::string &r, const std::string &pid, const Walker::Options &options ) const
+{
+	std::string listing = GetListingPattern( r ), pathid = pid;
+
+	ReadLock guard( searchpaths_lock );
+
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
+		!IsPathAllowed( listing, pathid, WhitelistType::Read, nonascii, true ) )
+		return nullptr;
+
+	const std::string root = GetPatternDirectory( listing );
+	std::vector<std::string> roots = GetLooseSearchPaths( pathid );
+	for( auto it = roots.begin( ); it != roots.end( ); ++it )
+		*it += root;
+
+	return new( std::nothrow ) Walker( roots, options );
+}
+
+bool Wrapper::GetWatchTargets(
+	const std::string &p,
+	const std::string &pid,
+	std::vector<std::string> &directories,
+	std::string &name
+) const
+{
+	std::string listing = GetListingPattern( p ), pathid = pid;
+
+	directories.clear( );
+	name.clear( );
+
+	ReadLock guard( searchpaths_lock );
+
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
+		!IsPathAllowed( listing, pathid, WhitelistType::Read, nonascii, true ) )
+		return false;
+
+	std::string root = GetPatternDirectory( listing );
+	const std::vector<std::string> searchpaths = GetLooseSearchPaths( pathid );
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+		if( root.empty( ) || IsDirectoryPath( *it + root ) )
+			directories.push_back( *it + root );
+
+	if( directories.empty( ) && !root.empty( ) )
+	{
+		// not a directory anywhere, watch the parents for the entry instead (it might not exist yet)
+		root.pop_back( );
+		const size_t slash = root.rfind( '/' );
+		name = root.substr( slash == root.npos ? 0 : slash + 1 );
+		root.resize( slash == root.npos ? 0 : slash + 1 );
+
+		for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+			if( root.empty( ) || IsDirectoryPath( *it + root ) )
+				directories.push_back( *it + root );
+	}
+
+	for( auto it = directories.begin( ); it != directories.end( ); ++it )
+		while( !it->empty( ) && ( it->back( ) == '/' || it->back( ) == '\\' ) )
+			it->pop_back( );
+
+	return !directories.empty( );
+}
+
+static bool HasExtension( const std::string &name, const std::vector<std::string> &extensions )
+{
+	if( extensions.empty( ) )
+		return true;
+
+	const size_t dot = name.rfind( '.' );
+	if( dot == name.npos )
+		return false;
+
+	const size_t length = name.size( ) - dot - 1;
+	for( auto it = extensions.begin( ); it != extensions.end( ); ++it )
+	{
+		if( it->size( ) != length )
+			continue;
+
+		size_t k = 0;
+		while( k < length && std::tolower( static_cast<unsigned char>( name[dot + 1 + k] ) ) == ( *it )[k] )
+			++k;
+
+		if( k == length )
+			return true;
+	}
+
+	return false;
+}
+
+static void AddUsage( UsageTotals &usage, const Walker::Entry &entry )
+{
+	if( entry.directory )
+	{
+		++usage.directories;
+	}
+	else
+	{
+		++usage.files;
+		usage.bytes += entry.size;
+		usage.allocated += entry.allocated;
+	}
+}
+
+bool Wrapper::DiskUsage( const std::string &r, const std::string &pid, bool children, DiskUsageReport &report ) const
+{
+	std::string listing = GetListingPattern( r ), pathid = pid;
+
+	report.total = UsageTotals( );
+	report.children.clear( );
+
+	std::vector<std::string> roots;
+	std::string key;
+
+	{
+		ReadLock guard( searchpaths_lock );
+
+		bool nonascii = false;
+		if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
+			!IsPathAllowed( listing, pathid, WhitelistType::Read, nonascii, true ) )
+			return false;
+
+		std::string root = GetPatternDirectory( listing );
+		roots = GetLooseSearchPaths( pathid );
+		for( auto it = roots.begin( ); it != roots.end( ); ++it )
+			*it += root;
+
+		if( !root.empty( ) )
+			root.pop_back( );
+
+		key = SharedCache::MakeKey( root, pathid );
+	}
+
+	DiskUsageCache &usage = cache.GetDiskUsageCache( );
+	if( usage.Get( key, children, report ) )
+		return true;
+
+	const uint64_t generation = usage.GetGeneration( );
+
+	// what's on disk is summed, a path under several search paths counts once per copy, which
+	// also keeps the walker from remembering every path it reported
+	Walker::Options options;
+	options.stat = true;
+	options.unique = false;
+	Walker walker( roots, options );
+	walker.Start( );
+
+	// summed while the workers are still going, the entries themselves are never kept around;
+	// every copy counts towards its first level child, itself included, so the children add up
+	// to the total
+	Walker::Batch batch;
+	bool more = true;
+	while( more )
+	{
+		more = walker.Take( batch, 0, true );
+		for( auto it = batch.begin( ); it != batch.end( ); ++it )
+		{
+			AddUsage( report.total, *it );
+			if( children )
+				AddUsage( report.children[it->path.substr( 0, it->path.find( '/' ) )], *it );
+		}
+	}
+
+	usage.Set( key, roots, children, report, generation );
+	return true;
+}
+
+bool Wrapper::Query(
+	const std::string &r,
+	const std::string &pid,
+	const QueryOptions &options,
+	std::vector<FindEntry> &files
+) const
+{
+	std::string pathid = pid;
+
+	files.clear( );
+
+	std::string listing = GetListingPattern( r );
+
+	ReadLock guard( searchpaths_lock );
+
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
+		!IsPathAllowed( listing, pathid, WhitelistType::Read, nonascii, true ) )
+		return false;
+
+	const std::string root = GetPatternDirectory( listing );
+
+	std::vector<std::pair<std::string, size_t>> pending;
+	pending.emplace_back( std::string( ), 0 );
+
+	FindResults results;
+	std::string name;
+	bool directory = false;
+	while( !pending.empty( ) )
+	{
+		const std::string relative = std::move( pending.back( ).first );
+		const size_t depth = pending.back( ).second;
+		pending.pop_back( );
+
+		const std::string pattern = root + relative + "*";
+		std::unique_ptr<Finder> finder( OpenFinder( pattern, pathid ) );
+		if( !finder )
+			continue;
+
+		// the extension is checked before anything gets stated
+		results.files.clear( );
+		results.directories.clear( );
+		while( finder->Next( name, directory ) )
+		{
+			if( directory )
+			{
+				if( options.recursive && depth + 1 < max_walk_depth )
+					pending.emplace_back( relative + name + '/', depth + 1 );
+			}
+			else if( HasExtension( name, options.extensions ) )
+			{
+				results.files.push_back( FindEntry{ name, false, 0, 0 } );
+			}
+		}
+
+		finder.reset( );
+
+		if( results.files.empty( ) )
+			continue;
+
+		// sizes and times are always returned, one stat per candidate from an open directory
+		FillFindMetadata( pattern, pathid, results );
+
+		for( auto it = results.files.begin( ); it != results.files.end( ); ++it )
+		{
+			if( it->size < options.min_size || it->size > options.max_size ||
+				it->mtime >= options.older_than || it->mtime <= options.newer_than )
+				continue;
+
+			files.push_back( FindEntry{ relative + it->name, false, it->size, it->mtime } );
+			if( options.limit != 0 && files.size( ) >= options.limit )
+				return true;
+		}
+	}
+
+	return true;
+}
+
+bool Wrapper::Copy(
+	const std::string &src,
+	const std::string &dst,
+	const std::string &pid,
+	bool overwrite,
+	uint64_t &bytes
+)
+{
+	std::string source = src, destination = dst, pathid = pid;
+
+	ReadLock guard( searchpaths_lock );
+
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pathid, WhitelistType::Write ) ||
+		!IsPathAllowed( source, pathid, WhitelistType::Write, nonascii ) ||
+		!IsPathAllowed( destination, pathid, WhitelistType::Write, nonascii ) )
+		return false;
+
+	const std::string fullsource = GetPath( source, pathid, WhitelistType::Write ),
+		fulldestination = GetPath( destination, pathid, WhitelistType::Write );
+	if( fullsource.empty( ) || fulldestination.empty( ) )
+		return false;
+
+	// overwriting a file with itself would only lose it, the copier also compares file identities
+	if( SharedCache::IsSameOrBelow( fullsource, fulldestination ) &&
+		SharedCache::IsSameOrBelow( fulldestination, fullsource ) )
+		return false;
+
+	cache.Invalidate( SharedCache::MakeKey( destination, pathid ) );
+	cache.GetMetadataCache( ).InvalidateTree( SharedCache::MakeKey( destination, pathid ) );
+	cache.GetLookupFilter( ).Add( pathid, destination );
+	return Journal(
+		TreeCopier::CopyFileContents( fullsource, fulldestination, overwrite, bytes ),
+		ChangeJournal::Operation::Copy, source, pathid, destination
+	);
+}
+
+TreeCopier *Wrapper::CopyTree(
+	const std::string &src,
+	const std::string &dst,
+	const std::string &pid,
+	bool overwrite
+)
+{
+	std::string source = src, destination = dst, pathid = pid;
+
+	ReadLock guard( searchpaths_lock );
+
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pathid, WhitelistType::Write ) ||
+		!IsPathAllowed( source, pathid, WhitelistType::Write, nonascii ) ||
+		!IsPathAllowed( destination, pathid, WhitelistType::Write, nonascii ) )
+		return nullptr;
+
+	// neither the write path itself nor a destination inside the source
+	if( source.find_first_not_of( "./\\" ) == source.npos ||
+		destination.find_first_not_of( "./\\" ) == destination.npos )
+		return nullptr;
+
+	const std::string fullsource = GetPath( source, pathid, WhitelistType::Write ),
+		fulldestination = GetPath( destination, pathid, WhitelistType::Write );
+	if( fullsource.empty( ) || fulldestination.empty( ) || !IsDirectoryPath( fullsource ) ||
+		SharedCache::IsSameOrBelow( fulldestination, fullsource ) )
+		return nullptr;
+
+	const std::string key = SharedCache::MakeKey( destination, pathid );
+	cache.InvalidateTree( key );
+	cache.GetLookupFilter( ).Add( pathid, destination );
+
+	// the same whitelist single writes go through, checked on the copier's threads
+	TreeCopier *copier = new( std::nothrow ) TreeCopier( fullsource, fulldestination, overwrite, [this]( const std::string &relative )
+	{
+		return VerifyExtension( relative, WhitelistType::Write );
+	} );
+
+	// disk usage of the destination isn't cached while it's being filled
+	if( copier != nullptr )
+		copier->Hold( cache.GetDiskUsageCache( ).BeginChange( fulldestination ) );
+
+	// the copy finishes in the background, consumers have to consider the whole destination changed
+	Journal( copier != nullptr, ChangeJournal::Operation::CopyTree, source, pathid, destination );
+	return copier;
+}
+
+TreeRemover *Wrapper::RemoveTree( const std::string &p, const std::string &pid )
+{
+	std::string path = p, pathid = pid;
+
+	ReadLock guard( searchpaths_lock );
+
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pathid, WhitelistType::Write ) ||
+		!IsPathAllowed( path, pathid, WhitelistType::Write, nonascii ) )
+		return nullptr;
+
+	// never the write path itself
+	if( path.find_first_not_of( "./\\" ) == path.npos )
+		return nullptr;
+
+	const std::string fullpath = GetPath( path, pathid, WhitelistType::Write );
+	if( fullpath.empty( ) )
+		return nullptr;
+
+	cache.InvalidateTree( SharedCache::MakeKey( path, pathid ) );
+
+	// the same whitelist single writes go through, files it refuses are left in place
+	TreeRemover *remover = new( std::nothrow ) TreeRemover( fullpath, [this]( const std::string &relative )
+	{
+		return VerifyExtension( relative, WhitelistType::Write );
+	} );
+
+	// disk usage of the tree isn't cached while it's being emptied, possibly in the background
+	if( remover != nullptr )
+		remover->Hold( cache.GetDiskUsageCache( ).BeginChange( fullpath ) );
+
+	Journal( remover != nullptr, ChangeJournal::Operation::RemoveTree, path, pathid );
+	return remover;
+}
+
+bool Wrapper::Glob(
+	const std::string &pattern,
+	const std::string &pid,
+	bool nocase,
+	size_t limit,
+	std::vector<std::string> &files,
+	std::vector<std::string> &directories
+) const
+{
+	std::string pathid = pid;
+
+	files.clear( );
+	directories.clear( );
+
+	GlobMatcher matcher;
+	if( !matcher.Compile( pattern, nocase ) )
+		return false;
+
+	// validating the listing of the base covers every directory below it
+	const std::string &base = matcher.GetBase( );
+	std::string listing = base + "*";
+
+	ReadLock guard( searchpaths_lock );
+
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
+		!IsPathAllowed( listing, pathid, WhitelistType::Read, nonascii, true ) )
+		return false;
+
+	const std::string root = GetPatternDirectory( listing );
+
+	struct Pending
+	{
+		std::string relative;
+		GlobMatcher::State state;
+		size_t depth;
+	};
+
+	std::vector<Pending> pending;
+	pending.push_back( Pending{ std::string( ), matcher.Start( ), 0 } );
+
+	std::string name;
+	bool directory = false;
+	GlobMatcher::State next;
+	while( !pending.empty( ) )
+	{
+		Pending current = std::move( pending.back( ) );
+		pending.pop_back( );
+
+		std::unique_ptr<Finder> finder( OpenFinder( root + current.relative + "*", pathid ) );
+		if( !finder )
+			continue;
+
+		while( finder->Next( name, directory ) )
+		{
+			const bool matched = matcher.Step( current.state, name, next );
+			const std::string relative = current.relative + name;
+			if( matched )
+			{
+				( directory ? directories : files ).push_back( base + relative );
+				if( limit != 0 && files.size( ) + directories.size( ) >= limit )
+					return true;
+			}
+
+			// nothing below can match when no pattern position can consume another component
+			if( directory && !next.empty( ) && current.depth + 1 < max_walk_depth )
+				pending.push_back( Pending{ relative + '/', std::move( next ), current.depth + 1 } );
+		}
+	}
+
+	return true;
+}
+
+void Wrapper::FillPackedMetadata(
+	const std::string &prefix,
+	const std::string &pathid,
+	const std::vector<FindEntry *> &entries
+) const
+{
+	std::string path;
+	for( auto it = entries.begin( ); it != entries.end( ); ++it )
+	{
+		FindEntry &entry = **it;
+		path = prefix + entry.name;
+		entry.size = entry.directory ? 0 : filesystem->Size( path.c_str( ), pathid.c_str( ) );
+		entry.mtime = filesystem->GetPathTime( path.c_str( ), pathid.c_str( ) );
+	}
+}
+
+std::string Wrapper::GetPatternDirectory( const std::string &pattern )
+{
+	const size_t pos = pattern.find_last_of( "/\\" );
+	return pos != pattern.npos ? pattern.substr( 0, pos + 1 ) : std::string( );
+}
+
+std::vector<FindEntry *> Wrapper::GetFindEntries( FindResults &results )
+{
+	std::vector<FindEntry *> entries;
+	entries.reserve( results.files.size( ) + results.directories.size( ) );
+	for( auto it = results.files.begin( ); it != results.files.end( ); ++it )
+		entries.push_back( &*it );
+
+	for( auto it = results.directories.begin( ); it != results.directories.end( ); ++it )
+		entries.push_back( &*it );
+
+	return entries;
+}
+
+std::vector<std::string> Wrapper::ListSearchPaths( const std::string &pathid ) const
+{
+	std::vector<std::string> searchpaths;
+
+	char paths[max_tempbuffer_len] = { 0 };
+	const int32_t len = filesystem->GetSearchPath_safe( pathid.c_str( ), true, paths ) - 1;
+	if( len <= 0 )
+		return searchpaths;
+
+	char *start = paths, *end = paths + len, *pos = std::find( start, end, ';' );
+	for( ; pos != end; start = ++pos, pos = std::find( start, end, ';' ) )
+		searchpaths.push_back( std::string( start, pos ) );
+
+	if( start != end )
+		searchpaths.push_back( std::string( start, end ) );
+
+	return searchpaths;
+}
+
+std::set<std::string> Wrapper::CollectSearchPaths( const std::string &pathid ) const
+{
+	const std::vector<std::string> searchpaths = ListSearchPaths( pathid );
+	return std::set<std::string>( searchpaths.begin( ), searchpaths.end( ) );
+}
+
+std::string Wrapper::ResolvePath( const StringRef &filepath, const StringRef &pathid ) const
+{
+	ObserveSearchPaths( );
+
+	char fullpath[max_tempbuffer_len] = { 0 };
+
+	ResolutionIndex &index = cache.GetResolutionIndex( );
+	std::vector<std::string> searchpaths;
+	switch( index.Find( pathid, filepath, searchpaths ) )
+	{
+		case ResolutionIndex::Unknown:
+		{
+			const std::string id = pathid.ToString( );
+			BuildIndex( id );
+			searchpaths = GetLooseSearchPaths( id );
+			break;
+		}
+
+		case ResolutionIndex::Missing:
+			return std::string( );
+
+		case ResolutionIndex::Found:
+			for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+			{
+				V_ComposeFileName( it->c_str( ), filepath.c_str( ), fullpath, sizeof( fullpath ) );
+				if( PathExists( fullpath ) )
+				{
+					// an earlier search path has it now
+					if( it + 1 != searchpaths.end( ) )
+						index.Insert( pathid, filepath, *it );
+
+					return fullpath;
+				}
+			}
+
+			// removed before the notification arrived, later search paths might have it
+			index.Changed( fullpath );
+			if( index.Find( pathid, filepath, searchpaths ) != ResolutionIndex::Unsure )
+				return std::string( );
+
+			break;
+
+		case ResolutionIndex::Unsure:
+			break;
+	}
+
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+	{
+		V_ComposeFileName( it->c_str( ), filepath.c_str( ), fullpath, sizeof( fullpath ) );
+		if( PathExists( fullpath ) )
+		{
+			index.Insert( pathid, filepath, *it );
+			return fullpath;
+		}
+	}
+
+	index.Insert( pathid, filepath, std::string( ) );
+	return std::string( );
+}
+
+std::string Wrapper::ResolveLeadingPath( const std::string &filepath, const std::string &pathid ) const
+{
+	ObserveSearchPaths( );
+
+	char fullpath[max_tempbuffer_len] = { 0 };
+	const std::vector<std::string> searchpaths = GetLeadingSearchPaths( pathid );
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+	{
+		V_ComposeFileName( it->c_str( ), filepath.c_str( ), fullpath, sizeof( fullpath ) );
+		if( PathExists( fullpath ) )
+			return fullpath;
+	}
+
+	return std::string( );
+}
+
+std::vector<std::string> Wrapper::GetLeadingSearchPaths( const std::string &pathid ) const
+{
+	// packs mounted before a directory win over it, only the leading directories can be looked at blindly
+	std::vector<std::string> loose;
+	const std::vector<std::string> searchpaths = ListSearchPaths( pathid );
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ) && IsDirectoryPath( *it ); ++it )
+		loose.push_back( *it );
+
+	return loose;
+}
+
+void Wrapper::BuildIndex( const std::string &pathid ) const
+{
+	ResolutionIndex &index = cache.GetResolutionIndex( );
+
+	const std::vector<std::string> searchpaths = GetLooseSearchPaths( pathid );
+	uint64_t generation = 0;
+	if( !index.Start( pathid, searchpaths, generation ) )
+		return;
+
+	threadpool.Post( [&index, pathid, searchpaths, generation]
+	{
+		ResolutionIndex::Entries entries;
+		const bool complete = ScanSearchPaths( index, pathid, generation, searchpaths, 0, entries );
+		index.Merge( pathid, generation, std::move( entries ), complete );
+	} );
+}
+
+void Wrapper::ExtendIndex( const std::string &pathid )
+{
+	ResolutionIndex &index = cache.GetResolutionIndex( );
+
+	const std::vector<std::string> searchpaths = GetLooseSearchPaths( pathid );
+	uint64_t generation = 0;
+	size_t first = 0;
+	if( !index.Update( pathid, searchpaths, generation, first ) )
+		return;
+
+	threadpool.Post( [&index, pathid, searchpaths, first, generation]
+	{
+		ResolutionIndex::Entries entries;
+		const bool complete = ScanSearchPaths( index, pathid, generation, searchpaths, first, entries );
+		index.Merge( pathid, generation, std::move( entries ), complete );
+	} );
+}
+
+static const size_t max_index_entries = 256 * 1024;
+
+bool Wrapper::ScanSearchPaths(
+	ResolutionIndex &index,
+	const std::string &pathid,
+	uint64_t generation,
+	const std::vector<std::string> &searchpaths,
+	size_t first,
+	ResolutionIndex::Entries &entries
+)
+{
+	std::vector<std::string> pending, files, directories;
+	for( size_t k = first; k < searchpaths.size( ); ++k )
+	{
+		const uint32_t id = static_cast<uint32_t>( k );
+		const std::string &searchpath = searchpaths[k];
+
+		pending.push_back( std::string( ) );
+		while( !pending.empty( ) )
+		{
+			// a truncated index is still right about everything it holds, earlier search paths were completed
+			if( entries.size( ) >= max_index_entries )
+				return false;
+
+			const std::string directory = std::move( pending.back( ) );
+			pending.pop_back( );
+
+			// watched first, so whatever changes after the listing is heard about
+			index.Watch( pathid, generation, id, directory );
+
+			files.clear( );
+			directories.clear( );
+			if( !ListDirectory( searchpath + directory, files, directories ) )
+				continue;
+
+			for( auto it = files.begin( ); it != files.end( ); ++it )
+				entries.emplace( ResolutionIndex::Normalize( directory + *it ), id );
+
+			for( auto it = directories.begin( ); it != directories.end( ); ++it )
+			{
+				std::string path = directory + *it;
+				entries.emplace( ResolutionIndex::Normalize( path ), id );
+				path += '/';
+				pending.push_back( std::move( path ) );
+			}
+		}
+	}
+
+	return true;
+}
+
+void Wrapper::UpdateFilters( double seconds )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	ReadLock guard( searchpaths_lock );
+
+	if( filesystem == nullptr )
+		return;
+
+	// picks up engine changes once per tick even when only workers look paths up
+	ObserveSearchPaths( );
+
+	LookupFilter &filter = cache.GetLookupFilter( );
+	const Clock::time_point deadline = Clock::now( ) +
+		std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( seconds ) );
+
+	std::string pathid, directory;
+	std::vector<std::string> files, directories;
+	while( Clock::now( ) < deadline && filter.Next( pathid, directory ) )
+	{
+		files.clear( );
+		directories.clear( );
+
+		const std::string wildcard = directory.empty( ) ? "*" : directory + "/*";
+		FileFindHandle_t handle = FILESYSTEM_INVALID_FIND_HANDLE;
+		const char *name = filesystem->FindFirstEx( wildcard.c_str( ), pathid.c_str( ), &handle );
+		while( name != nullptr )
+		{
+			if( std::strcmp( name, "." ) != 0 && std::strcmp( name, ".." ) != 0 )
+			{
+				if( filesystem->FindIsDirectory( handle ) )
+					directories.push_back( name );
+				else
+					files.push_back( name );
+			}
+
+			name = filesystem->FindNext( handle );
+		}
+
+		filesystem->FindClose( handle );
+		filter.Scanned( pathid, directory, files, directories );
+	}
+}
+
+std::shared_ptr<const Wrapper::SearchPathMap> Wrapper::GetSearchPaths( ) const
+{
+	ReadLock guard( searchpaths_lock );
+
+	ObserveSearchPaths( );
+
+	std::lock_guard<std::mutex> lock( snapshot_mutex );
+	if( snapshot )
+		return snapshot;
+
+	std::shared_ptr<SearchPathMap> searchpaths = std::make_shared<SearchPathMap>( );
+
+	const CUtlLinkedList<CBaseFileSystem::CSearchPath> &m_SearchPaths = filesystem->m_SearchPaths;
+	for( uint16_t k = 0; k < m_SearchPaths.Count( ); ++k )
+	{
+		const CBaseFileSystem::CSearchPath &searchpath = m_SearchPaths[k];
+		const CBaseFileSystem::CPathIDInfo *pathIDInfo = searchpath.m_pPathIDInfo;
+		if( searchpath.m_pDebugPath == nullptr ||
+			pathIDInfo == nullptr ||
+			pathIDInfo->m_pDebugPathID == nullptr )
+			continue;
+
+		std::set<std::string> &paths = ( *searchpaths )[pathIDInfo->m_pDebugPathID];
+		const auto packFile = searchpath.m_pPackFile;
+		const auto packFile2 = searchpath.m_pPackFile2;
+		if( packFile != nullptr )
+			paths.insert( packFile->m_ZipName.Get( ) );
+		else if( packFile2 != nullptr )
+			paths.insert( packFile2->m_pszFullPathName );
+		else
+			paths.insert( searchpath.m_pDebugPath );
+	}
+
+	snapshot = std::move( searchpaths );
+	return snapshot;
+}
+
+uint64_t Wrapper::GetSearchPathsGeneration( ) const
+{
+	ReadLock guard( searchpaths_lock );
+
+	ObserveSearchPaths( );
+
+	return snapshot_generation.load( );
+}
+
+void Wrapper::ObserveSearchPaths( ) const
+{
+	// the engine (and other modules) change search paths without telling us, workers can't look
+	// at its list safely so they only compare the generation the main thread keeps up to date
+	if( std::this_thread::get_id( ) == main_thread )
+		CheckSearchPaths( );
+
+	const uint64_t generation = snapshot_generation.load( );
+	uint64_t observed = observed_generation.load( );
+	if( observed == generation || !observed_generation.compare_exchange_strong( observed, generation ) )
+		return;
+
+	cache.InvalidateSearchPaths( );
+	cache.GetResolutionIndex( ).Clear( );
+}
+
+bool Wrapper::CheckSearchPaths( ) const
+{
+	// every entry is compared, so reorders are caught along with mounts and map changes
+	const CUtlLinkedList<CBaseFileSystem::CSearchPath> &m_SearchPaths = filesystem->m_SearchPaths;
+	const size_t count = m_SearchPaths.Count( );
+	bool changed = count * 4 != snapshot_entries.size( );
+	for( uint16_t k = 0; !changed && k < count; ++k )
+	{
+		const CBaseFileSystem::CSearchPath &searchpath = m_SearchPaths[k];
+		const void **entry = &snapshot_entries[k * 4];
+		changed = entry[0] != searchpath.m_pDebugPath ||
+			entry[1] != searchpath.m_pPathIDInfo ||
+			entry[2] != searchpath.m_pPackFile ||
+			entry[3] != searchpath.m_pPackFile2;
+	}
+
+	if( !changed )
+		return false;
+
+	snapshot_entries.clear( );
+	for( uint16_t k = 0; k < count; ++k )
+	{
+		const CBaseFileSystem::CSearchPath &searchpath = m_SearchPaths[k];
+		snapshot_entries.push_back( searchpath.m_pDebugPath );
+		snapshot_entries.push_back( searchpath.m_pPathIDInfo );
+		snapshot_entries.push_back( searchpath.m_pPackFile );
+		snapshot_entries.push_back( searchpath.m_pPackFile2 );
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( snapshot_mutex );
+		snapshot.reset( );
+	}
+
+	++snapshot_generation;
+	return true;
+}
+
+bool Wrapper::RecordSearchPaths( ) const
+{
+	if( !CheckSearchPaths( ) )
+		return false;
+
+	observed_generation = snapshot_generation.load( );
+	return true;
+}
+
+SharedCache &Wrapper::GetSharedCache( )
+{
+	return cache;
+}
+
+// their loose search paths are what the saved listing holds, the others are mostly below them anyway
+static const char *indexed_pathids[] = { "GAME", "DATA" };
+
+const DirectoryIndex &Wrapper::GetDirectoryIndex( ) const
+{
+	return directory_index;
+}
+
+bool Wrapper::SetDirectoryIndexEnabled( bool enabled )
+{
+	// exclusive so concurrent calls can't start two validations
+	WriteLock guard( searchpaths_lock );
+
+	if( !enabled )
+	{
+		directory_index.Stop( );
+		return true;
+	}
+
+	return references != 0 && StartDirectoryIndex( );
+}
+
+bool Wrapper::StartDirectoryIndex( )
+{
+	const auto data = whitelist_writepaths.find( "data" );
+	if( data == whitelist_writepaths.end( ) )
+		return false;
+
+	const std::string directory = DirectoryIndex::GetCacheDirectory( );
+	if( directory.empty( ) )
+		return false;
+
+	// named after the installation, several servers can share the user's cache
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for( auto it = data->second.begin( ); it != data->second.end( ); ++it )
+	{
+		hash ^= static_cast<unsigned char>( *it );
+		hash *= 0x100000001b3ULL;
+	}
+
+	char name[64] = { 0 };
+	std::snprintf( name, sizeof( name ), "index_%016llx.dat", static_cast<unsigned long long>( hash ) );
+	const std::string fullpath = directory + '/' + name;
+
+	std::vector<std::string> roots;
+	for( size_t k = 0; k < sizeof( indexed_pathids ) / sizeof( *indexed_pathids ); ++k )
+	{
+		const std::vector<std::string> loose = GetLooseSearchPaths( indexed_pathids[k] );
+		roots.insert( roots.end( ), loose.begin( ), loose.end( ) );
+	}
+
+	directory_index.Start( fullpath, roots );
+	return true;
+}
+
+bool Wrapper::LookupDirectoryIndex(
+	const std::string &path,
+	const std::string &pathid,
+	bool &exists,
+	FileInfo &info
+) const
+{
+	if( !directory_index.IsAnswering( ) )
+		return false;
+
+	// packs and search paths that weren't indexed end it, they could win over what comes after them
+	const std::vector<std::string> searchpaths = ListSearchPaths( pathid );
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+	{
+		if( !directory_index.HasDirectory( *it ) )
+			return false;
+
+		DirectoryIndex::Listed entry;
+		switch( directory_index.Find( *it + path, entry ) )
+		{
+			case DirectoryIndex::Unknown:
+				return false;
+
+			case DirectoryIndex::Missing:
+				break;
+
+			case DirectoryIndex::Found:
+				exists = true;
+				info.size = entry.size;
+				info.mtime = entry.mtime;
+				info.ctime = entry.mtime;
+				info.atime = entry.mtime;
+				info.btime = 0;
+				info.directory = entry.directory;
+				info.packed = false;
+				info.searchpath = std::make_shared<const std::string>( *it );
+				return true;
+		}
+	}
+
+	exists = false;
+	return !searchpaths.empty( );
+}
+
+// the engine's find patterns only know about stars and question marks
+static bool MatchesFindPattern( const std::string &pattern, const std::string &name )
+{
+	size_t p = 0, n = 0, star = pattern.npos, mark = 0;
+	while( n < name.size( ) )
+	{
+		if( p < pattern.size( ) && pattern[p] == '*' )
+		{
+			star = p++;
+			mark = n;
+		}
+		else if( p < pattern.size( ) && ( pattern[p] == '?' ||
+			std::tolower( static_cast<unsigned char>( pattern[p] ) ) == std::tolower( static_cast<unsigned char>( name[n] ) ) ) )
+		{
+			++p;
+			++n;
+		}
+		else if( star != pattern.npos )
+		{
+			p = star + 1;
+			n = ++mark;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while( p < pattern.size( ) && pattern[p] == '*' )
+		++p;
+
+	return p == pattern.size( );
+}
+
+bool Wrapper::FindDirectoryIndex( const std::string &pattern, const std::string &pathid, FindResults &results ) const
+{
+	if( !directory_index.IsAnswering( ) )
+		return false;
+
+	const std::vector<std::string> searchpaths = ListSearchPaths( pathid );
+	if( searchpaths.empty( ) )
+		return false;
+
+	const std::string directory = GetPatternDirectory( pattern ), name = pattern.substr( directory.size( ) );
+
+	// names repeated across search paths are only listed once, like the engine does
+	std::vector<FindEntry> files, directories;
+	std::unordered_set<std::string> seen;
+	std::vector<DirectoryIndex::Listed> listing;
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+	{
+		// every search path takes part in a find, packs included
+		if( !directory_index.HasDirectory( *it ) )
+			return false;
+
+		switch( directory_index.List( *it + directory, listing ) )
+		{
+			case DirectoryIndex::Unknown:
+				return false;
+
+			case DirectoryIndex::Missing:
+				break;
+
+			case DirectoryIndex::Found:
+				for( auto entry = listing.begin( ); entry != listing.end( ); ++entry )
+					if( MatchesFindPattern( name, entry->name ) && seen.insert( entry->name ).second )
+						( entry->directory ? directories : files ).push_back(
+							FindEntry{ entry->name, entry->directory, entry->size, entry->mtime }
+						);
+
+				break;
+		}
+	}
+
+	results.files.swap( files );
+	results.directories.swap( directories );
+	return true;
+}
+
+ChangeJournal &Wrapper::GetChangeJournal( )
+{
+	return journal;
+}
+
+bool Wrapper::SetJournalFile( const std::string &p, const std::string &pid )
+{
+	if( p.empty( ) )
+		return journal.SetPersistence( std::string( ) );
+
+	std::string path = p, pathid = pid, fullpath;
+
+	{
+		ReadLock guard( searchpaths_lock );
+
+		bool nonascii = false;
+		if( !IsPathIDAllowed( pathid, WhitelistType::Write ) ||
+			!IsPathAllowed( path, pathid, WhitelistType::Write, nonascii ) )
+			return false;
+
+		fullpath = GetPath( path, pathid, WhitelistType::Write );
+		if( fullpath.empty( ) )
+			return false;
+
+		cache.Invalidate( SharedCache::MakeKey( path, pathid ) );
+	}
+
+	return journal.SetPersistence( fullpath );
+}
+
+bool Wrapper::Journal(
+	bool success,
+	ChangeJournal::Operation operation,
+	const std::string &path,
+	const std::string &pathid,
+	const std::string &target
+)
+{
+	if( !success )
+		return false;
+
+	journal.Record( operation, path, pathid, target );
+
+	if( operation != ChangeJournal::Operation::AddSearchPath &&
+		operation != ChangeJournal::Operation::RemoveSearchPath )
+	{
+		// reads reach the same files through other path IDs, those are dropped by full path
+		const std::string fullpath = GetPath( path, pathid, WhitelistType::Write );
+		directory_index.Invalidate( fullpath );
+		cache.InvalidateContents( fullpath );
+		cache.GetDiskUsageCache( ).InvalidatePath( fullpath );
+		cache.GetResolutionIndex( ).Changed( fullpath );
+		if( !target.empty( ) )
+		{
+			const std::string fulltarget = GetPath( target, pathid, WhitelistType::Write );
+			directory_index.Invalidate( fulltarget );
+			cache.InvalidateContents( fulltarget );
+			cache.GetDiskUsageCache( ).InvalidatePath( fulltarget );
+			cache.GetResolutionIndex( ).Changed( fulltarget );
+		}
+	}
+
+	return true;
+}
+
+file::Base *Wrapper::JournalWrites(
+	file::Base *f,
+	const std::string &path,
+	const std::string &pathid,
+	const std::string &options
+)
+{
+	// opening can create the file, which the index must not miss until the journal hears of it
+	cache.GetResolutionIndex( ).Changed( GetPath( path, pathid, WhitelistType::Write ) );
+
+	// the wrapper is a global and outlives every file handed to Lua
+	file::Base *journaled = new( std::nothrow ) file::Journaled(
+		f,
+		[this, path, pathid]( )
+		{
+			ReadLock guard( searchpaths_lock );
+			Journal( true, ChangeJournal::Operation::Write, path, pathid );
+		},
+		options.find( 'w' ) != options.npos
+	);
+	if( journaled == nullptr )
+		delete f;
+
+	return journaled;
+}
+
+}
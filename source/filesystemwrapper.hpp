@@ -1,58 +1,219 @@
 #pragma once
 
+#include "changejournal.hpp"
+#include "directoryindex.hpp"
+#include "filebase.hpp"
+#include "fileinfo.hpp"
+#include "finder.hpp"
+#include "fixedstring.hpp"
+#include "glob.hpp"
+#include "rwlock.hpp"
+#include "sharedcache.hpp"
+#include "stringref.hpp"
+#include "threadpool.hpp"
+#include "treecopier.hpp"
+#include "treeremover.hpp"
+#include "walker.hpp"
+
 #include <cstdint>
 #include <string>
 #include <utility>
+#include <memory>
+#include <vector>
 #include <set>
 #include <unordered_set>
 #include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <thread>
 
 class CBaseFileSystem;
 
-namespace file
-{
-
-class Base;
-
-}
-
 namespace filesystem
 {
 
 class Wrapper
 {
 public:
+	typedef std::unordered_map<std::string, std::set<std::string>> SearchPathMap;
+
+	enum class FindSort
+	{
+		Name,
+		// case insensitive, digit runs compare by value ("map2" before "map10")
+		Natural,
+		Time,
+		Size
+	};
+
+	struct FindOptions
+	{
+		FindOptions( );
+
+		FindSort sort;
+		bool descending;
+		// paging applies to files and directories separately, a limit of 0 means no limit
+		size_t offset;
+		size_t limit;
+		// fills sizes and times even when not sorting by them
+		bool metadata;
+	};
+
+	struct FindResults
+	{
+		std::vector<FindEntry> files;
+		std::vector<FindEntry> directories;
+		// counts before paging
+		size_t total_files;
+		size_t total_directories;
+	};
+
+	enum class BatchOperation
+	{
+		Exists,
+		IsDirectory,
+		Size,
+		Time
+	};
+
+	struct BatchItem
+	{
+		BatchOperation operation;
+		std::string path;
+		std::string pathid;
+		// filled by Batch, exists is false for disallowed paths
+		bool exists;
+		FileInfo info;
+	};
+
+	struct QueryOptions
+	{
+		QueryOptions( );
+
+		// lowercase and without the dot, empty matches any file
+		std::vector<std::string> extensions;
+		// inclusive size range in bytes
+		uint64_t min_size;
+		uint64_t max_size;
+		// modification time bounds, seconds since the Unix epoch
+		int64_t older_than;
+		int64_t newer_than;
+		bool recursive;
+		// 0 means no limit
+		size_t limit;
+	};
+
 	Wrapper( );
 	~Wrapper( );
 
 	bool Initialize( CBaseFileSystem *fsinterface );
+	void Deinitialize( );
 
+	// the strings of the requests below are only borrowed while they run
 	file::Base *Open(
-		const std::string &filepath,
-		const std::string &options,
-		const std::string &pathid
+		const StringRef &filepath,
+		const StringRef &options,
+		const StringRef &pathid,
+		file::AccessHint hint = file::AccessNormal
 	);
 
-	bool Exists( const std::string &filepath, const std::string &pathid ) const;
-	bool IsDirectory( const std::string &filepath, const std::string &pathid ) const;
+	// reads the whole file into the system cache on a worker thread, only for loose files
+	bool Prefetch( const std::string &filepath, const std::string &pathid );
+
+	// keeps the file contents in memory for every Lua state, read-only opens are served from them
+	bool Preload( const StringRef &filepath, const StringRef &pathid );
+	bool Unload( const StringRef &filepath, const StringRef &pathid );
+
+	bool Exists( const StringRef &filepath, const StringRef &pathid ) const;
+	bool IsDirectory( const StringRef &filepath, const StringRef &pathid ) const;
 
-	uint64_t GetSize( const std::string &filepath, const std::string &pathid ) const;
-	uint64_t GetTime( const std::string &filepath, const std::string &pathid ) const;
+	uint64_t GetSize( const StringRef &filepath, const StringRef &pathid ) const;
+	uint64_t GetTime( const StringRef &filepath, const StringRef &pathid ) const;
+	// validates and resolves once, loose files need a single stat call
+	bool Stat( const StringRef &filepath, const StringRef &pathid, FileInfo &info ) const;
+
+	// validates and resolves every item under one lock, repeated paths are looked up once and
+	// uncached loose lookups are spread over the worker threads
+	void Batch( std::vector<BatchItem> &items ) const;
 
 	bool Rename( const std::string &pathold, const std::string &pathnew, const std::string &pathid );
 	bool Remove( const std::string &path, const std::string &pathid );
 	bool MakeDirectory( const std::string &path, const std::string &pathid );
+	// write path IDs only, both paths go through the write extension whitelist
+	bool Copy( const std::string &source, const std::string &destination, const std::string &pathid, bool overwrite, uint64_t &bytes );
+	// files outside the write extension whitelist are skipped, the caller owns and runs the copier
+	TreeCopier *CopyTree(
+		const std::string &source,
+		const std::string &destination,
+		const std::string &pathid,
+		bool overwrite
+	);
+	// write path IDs only, nullptr when not allowed, the caller owns and runs the remover
+	TreeRemover *RemoveTree( const std::string &path, const std::string &pathid );
 
-	std::pair<std::set<std::string>, std::set<std::string>> Find(
+	// sizes and times are only filled when sorting by them or asked to
+	bool Find(
+		const std::string &path,
+		const std::string &pathid,
+		const FindOptions &options,
+		FindResults &results
+	) const;
+	// streaming Find, nullptr when the path isn't allowed, the caller owns the finder
+	Finder *FindFirst( const std::string &path, const std::string &pathid ) const;
+	// files under root that pass every predicate, names are relative to root
+	bool Query(
+		const std::string &root,
+		const std::string &pathid,
+		const QueryOptions &options,
+		std::vector<FindEntry> &files
+	) const;
+	// parallel walk of root over the loose search paths of pathid, packs aren't included,
+	// nullptr when the path isn't allowed, the caller owns and starts the walker
+	Walker *Walk( const std::string &root, const std::string &pathid, const Walker::Options &options ) const;
+	// totals over the loose search paths of pathid, packs aren't included, children breaks them down
+	// per first level entry (files count as their own child), reports are cached until written to
+	bool DiskUsage( const std::string &path, const std::string &pathid, bool children, DiskUsageReport &report ) const;
+	// loose directories to watch for path, when path isn't a directory its existing parent
+	// directories are returned and name is set to the entry to filter events with
+	bool GetWatchTargets(
 		const std::string &path,
-		const std::string &pathid
+		const std::string &pathid,
+		std::vector<std::string> &directories,
+		std::string &name
+	) const;
+	// walks only the directories the pattern can still match below, limit 0 means no limit
+	bool Glob(
+		const std::string &pattern,
+		const std::string &pathid,
+		bool nocase,
+		size_t limit,
+		std::vector<std::string> &files,
+		std::vector<std::string> &directories
 	) const;
 
-	std::unordered_map<std::string, std::set<std::string>> GetSearchPaths( ) const;
+	// shared snapshot, only rebuilt after the search paths change
+	std::shared_ptr<const SearchPathMap> GetSearchPaths( ) const;
+	// bumped on every search path change we make or notice, callers can keep their copy while it holds
+	uint64_t GetSearchPathsGeneration( ) const;
 	std::set<std::string> GetSearchPaths( const std::string &pathid ) const;
 	bool AddSearchPath( const std::string &path, const std::string &pathid );
 	bool RemoveSearchPath( const std::string &path, const std::string &pathid );
 
+	// scans directories for the lookup filters until the time slice runs out
+	void UpdateFilters( double seconds );
+
+	SharedCache &GetSharedCache( );
+
+	// every mutation made through the wrapper, in order
+	ChangeJournal &GetChangeJournal( );
+	// persists the journal to a file under a write path ID, an empty path stops persisting
+	bool SetJournalFile( const std::string &path, const std::string &pathid );
+
+	// listing saved by the previous run, answers lookups while it's validated after starting
+	const DirectoryIndex &GetDirectoryIndex( ) const;
+	// starts (or stops) indexing the loose search paths of GAME and DATA, off until asked for
+	bool SetDirectoryIndexEnabled( bool enabled );
+
 private:
 	enum class WhitelistType
 	{
@@ -61,6 +222,29 @@ private:
 		SearchPath
 	};
 
+	// longer requests are refused, never cut: full paths are composed in buffers this size and
+	// every whitelisted path ID is far shorter than the limit
+	static const size_t max_tempbuffer_len = 2048;
+	static const size_t max_pathid_len = 64;
+
+	typedef FixedString<max_tempbuffer_len> PathBuffer;
+	typedef FixedString<max_pathid_len> PathIDBuffer;
+
+	// validation reads the caller's strings and writes the lowercased path ID and the normalized
+	// path to stack buffers, it never allocates
+	bool IsPathIDAllowed( const StringRef &input, PathIDBuffer &pathid, WhitelistType whitelist_type ) const;
+	bool FixupFilePath( const StringRef &input, PathBuffer &filepath, const char *pathid ) const;
+	bool VerifyFilePath( const char *filepath, size_t length, bool find, bool &nonascii ) const;
+	bool VerifyExtension( const char *filepath, WhitelistType whitelist_type ) const;
+	bool IsPathAllowed(
+		const StringRef &input,
+		PathBuffer &filepath,
+		const char *pathid,
+		WhitelistType whitelist_type,
+		bool &nonascii,
+		bool find = false
+	) const;
+	// same as above, validating the strings in place
 	bool IsPathIDAllowed( std::string &pathid, WhitelistType whitelist_type ) const;
 	bool FixupFilePath( std::string &filepath, const std::string &pathid ) const;
 	bool VerifyFilePath( const std::string &filepath, bool find, bool &nonascii ) const;
@@ -72,19 +256,126 @@ private:
 		bool &nonascii,
 		bool find = false
 	) const;
+	static bool IsListed( const std::vector<const char *> &list, const char *name );
 	std::string GetPath(
 		const std::string &filepath,
 		const std::string &pathid,
 		WhitelistType whitelist_type
 	) const;
+	// search paths of pathid in lookup order
+	std::vector<std::string> ListSearchPaths( const std::string &pathid ) const;
+	std::set<std::string> CollectSearchPaths( const std::string &pathid ) const;
+	// full path of the loose file or directory that wins the lookup, empty when there's none
+	std::string ResolvePath( const StringRef &filepath, const StringRef &pathid ) const;
+	// same, only looking at the loose search paths mounted before every pack, so the result can't be
+	// shadowed by a packed copy, empty when the engine has to resolve it
+	std::string ResolveLeadingPath( const std::string &filepath, const std::string &pathid ) const;
+	std::vector<std::string> GetLeadingSearchPaths( const std::string &pathid ) const;
+	void BuildIndex( const std::string &pathid ) const;
+	void ExtendIndex( const std::string &pathid );
+	// drops everything that depends on search paths when the generation moved since the last call,
+	// checks the engine's list first when called from the main thread
+	void ObserveSearchPaths( ) const;
+	// main thread only, bumps the generation when the engine's list differs from the last one seen
+	bool CheckSearchPaths( ) const;
+	// same, for changes made through us that already dropped what depends on them
+	bool RecordSearchPaths( ) const;
+	// expects a validated pattern
+	Finder *OpenFinder( const std::string &pattern, const std::string &pathid ) const;
+	// stats entries from the directories they were found in, loose search paths first
+	void FillFindMetadata( const std::string &pattern, const std::string &pathid, FindResults &results ) const;
+	void FillPackedMetadata(
+		const std::string &prefix,
+		const std::string &pathid,
+		const std::vector<FindEntry *> &entries
+	) const;
+	static std::string GetPatternDirectory( const std::string &pattern );
+	static std::vector<FindEntry *> GetFindEntries( FindResults &results );
+	bool StatPacked( const StringRef &filepath, const StringRef &pathid, FileInfo &info ) const;
+	bool ResolveInfo( const StringRef &path, const StringRef &pathid, bool nonascii, FileInfo &info ) const;
+	// modification time cached handles are checked against
+	long GetHandleTime( const StringRef &filepath, const StringRef &pathid, bool nonascii ) const;
+	// false only when the path can't exist, starts building the lookup filter of pathid
+	bool MayExist( const StringRef &path, const StringRef &pathid ) const;
+	std::vector<std::string> GetLooseSearchPaths( const std::string &pathid ) const;
+	// loose directories whose changes can alter what a lookup of path returns
+	MetadataCache::Dependencies GetWatchDirectories( const std::string &path, const std::string &pathid ) const;
+	// returns false when metadata can't be cached nor answered by the saved listing,
+	// exists and info are left untouched then
+	bool GetMetadata(
+		const StringRef &path,
+		const StringRef &pathid,
+		bool nonascii,
+		bool &exists,
+		FileInfo &info
+	) const;
 
-	static const size_t max_tempbuffer_len;
-	static const std::unordered_set<std::string> whitelist_extensions;
-	static const std::unordered_set<std::string> whitelist_pathid[];
+	// maps the saved listing of the indexed path IDs and starts validating it
+	bool StartDirectoryIndex( );
+	// answered from the saved listing while it's being validated, false when it can't tell
+	bool LookupDirectoryIndex( const std::string &path, const std::string &pathid, bool &exists, FileInfo &info ) const;
+	bool FindDirectoryIndex( const std::string &pattern, const std::string &pathid, FindResults &results ) const;
+	// records successful mutations, keeps the saved listing from answering for them
+	// and passes the result through
+	bool Journal(
+		bool success,
+		ChangeJournal::Operation operation,
+		const std::string &path,
+		const std::string &pathid,
+		const std::string &target = std::string( )
+	);
+	// hands back a file opened for writing that journals the path once data reaches it,
+	// or when it's closed if the open itself truncated the file
+	file::Base *JournalWrites(
+		file::Base *f,
+		const std::string &path,
+		const std::string &pathid,
+		const std::string &options
+	);
+
+	static bool IsDirectoryPath( const std::string &fullpath );
+	static bool PathExists( const StringRef &fullpath );
+	static bool StatPath( const std::string &fullpath, FileInfo &info );
+	static bool ListDirectory(
+		const std::string &fullpath,
+		std::vector<std::string> &files,
+		std::vector<std::string> &directories
+	);
+	// indexes searchpaths[first..] recursively, earlier search paths win, false when truncated,
+	// directories are watched through index before they're listed
+	static bool ScanSearchPaths(
+		ResolutionIndex &index,
+		const std::string &pathid,
+		uint64_t generation,
+		const std::vector<std::string> &searchpaths,
+		size_t first,
+		ResolutionIndex::Entries &entries
+	);
+
+	static const std::vector<const char *> whitelist_extensions;
+	static const std::vector<const char *> whitelist_pathid[];
 	static std::unordered_map<std::string, std::string> whitelist_writepaths;
 
 	CBaseFileSystem *filesystem;
 	std::string garrysmod_fullpath;
+	size_t references;
+	mutable ThreadPool threadpool;
+	mutable SharedCache cache;
+	ChangeJournal journal;
+	DirectoryIndex directory_index;
+
+	mutable std::mutex snapshot_mutex;
+	mutable std::shared_ptr<const SearchPathMap> snapshot;
+	mutable std::atomic<uint64_t> snapshot_generation;
+	mutable std::atomic<uint64_t> observed_generation;
+	// the engine changes its list from the main thread only, so only that one reads it and keeps
+	// what every entry pointed to the last time it was checked
+	std::thread::id main_thread;
+	mutable std::vector<const void *> snapshot_entries;
+
+	// every public method holds this for reading while it validates and resolves paths,
+	// search path changes and (re)initialization hold it for writing
+	mutable ReadWriteLock searchpaths_lock;
 };
 
 }
@@ -1,13 +1,34 @@
 #include "filevalve.hpp"
+#include "handlecache.hpp"
 
 #include <filesystem_stdio.h>
 
+#include <utility>
+
 namespace file
 {
 
 Valve::Valve( CBaseFileSystem *fsystem, FileHandle_t handle ) :
 	filesystem( fsystem ),
-	filehandle( handle )
+	filehandle( handle ),
+	handlecache( nullptr ),
+	filetime( 0 )
+{ }
+
+Valve::Valve(
+	CBaseFileSystem *fsystem,
+	FileHandle_t handle,
+	filesystem::HandleCache *cache,
+	std::string key,
+	const std::string &mode,
+	long mtime
+) :
+	filesystem( fsystem ),
+	filehandle( handle ),
+	handlecache( cache ),
+	cachekey( std::move( key ) ),
+	cachemode( mode ),
+	filetime( mtime )
 { }
 
 Valve::~Valve( )
@@ -41,7 +62,9 @@ bool Valve::Close( )
 	if( !Valid( ) )
 		return false;
 
-	filesystem->Close( filehandle );
+	if( handlecache == nullptr || !handlecache->Release( std::move( cachekey ), cachemode, filehandle, filetime ) )
+		filesystem->Close( filehandle );
+
 	filehandle = nullptr;
 	filesystem = nullptr;
 	return true;
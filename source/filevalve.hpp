@@ -2,9 +2,18 @@
 
 #include "filebase.hpp"
 
+#include <string>
+
 typedef void *FileHandle_t;
 class CBaseFileSystem;
 
+namespace filesystem
+{
+
+class HandleCache;
+
+}
+
 namespace file
 {
 	
@@ -12,6 +21,15 @@ class Valve : public Base
 {
 public:
 	Valve( CBaseFileSystem *fsystem, FileHandle_t handle );
+	// read-only handles given a cache are handed back to it when closed, along with the key
+	Valve(
+		CBaseFileSystem *fsystem,
+		FileHandle_t handle,
+		filesystem::HandleCache *cache,
+		std::string key,
+		const std::string &mode,
+		long mtime
+	);
 	~Valve( );
 
 	bool Valid( ) const;
@@ -32,6 +50,10 @@ public:
 private:
 	CBaseFileSystem *filesystem;
 	FileHandle_t filehandle;
+	filesystem::HandleCache *handlecache;
+	std::string cachekey;
+	std::string cachemode;
+	long filetime;
 };
 
 }
@@ -0,0 +1,60 @@
+#include "finder.hpp"
+
+#include <filesystem_base.h>
+
+#include <cstring>
+
+namespace filesystem
+{
+
+EngineFinder::EngineFinder( CBaseFileSystem *fsinterface, const std::string &pattern, const std::string &pathid ) :
+	filesystem( fsinterface ),
+	handle( FILESYSTEM_INVALID_FIND_HANDLE ),
+	current( nullptr )
+{
+	current = filesystem->FindFirstEx( pattern.c_str( ), pathid.c_str( ), &handle );
+	if( current == nullptr )
+		Close( );
+}
+
+EngineFinder::~EngineFinder( )
+{
+	Close( );
+}
+
+bool EngineFinder::Next( std::string &name, bool &directory )
+{
+	while( current != nullptr )
+	{
+		const char *path = current;
+		const bool isdir = filesystem->FindIsDirectory( handle );
+		if( isdir && ( std::strcmp( path, "." ) == 0 || std::strcmp( path, ".." ) == 0 ) )
+		{
+			current = filesystem->FindNext( handle );
+			continue;
+		}
+
+		name = path;
+		directory = isdir;
+
+		current = filesystem->FindNext( handle );
+		if( current == nullptr )
+			Close( );
+
+		return true;
+	}
+
+	return false;
+}
+
+void EngineFinder::Close( )
+{
+	current = nullptr;
+	if( handle != FILESYSTEM_INVALID_FIND_HANDLE )
+	{
+		filesystem->FindClose( handle );
+		handle = FILESYSTEM_INVALID_FIND_HANDLE;
+	}
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+typedef int FileFindHandle_t;
+class CBaseFileSystem;
+
+namespace filesystem
+{
+
+struct FindEntry
+{
+	std::string name;
+	bool directory;
+	uint64_t size;
+	// seconds since the Unix epoch
+	int64_t mtime;
+};
+
+// Streams the matches of a find one entry at a time, without collecting them first.
+class Finder
+{
+public:
+	virtual ~Finder( ) { }
+
+	// returns false once there are no more entries, "." and ".." are never returned
+	virtual bool Next( std::string &name, bool &directory ) = 0;
+};
+
+// Engine find handle, sees inside VPKs, GMAs and what not.
+class EngineFinder : public Finder
+{
+public:
+	EngineFinder( CBaseFileSystem *fsinterface, const std::string &pattern, const std::string &pathid );
+	~EngineFinder( );
+
+	bool Next( std::string &name, bool &directory ) override;
+
+private:
+	EngineFinder( const EngineFinder & ) = delete;
+	EngineFinder &operator=( const EngineFinder & ) = delete;
+
+	void Close( );
+
+	CBaseFileSystem *filesystem;
+	FileFindHandle_t handle;
+	const char *current;
+};
+
+}
@@ -0,0 +1,105 @@
+#include "findhandle.hpp"
+#include "finder.hpp"
+#include "scheduler.hpp"
+
+#include <GarrysMod/Lua/Interface.h>
+#include <lua.hpp>
+
+#include <string>
+
+namespace findhandle
+{
+
+static const char *metaname = "FindHandle";
+static int32_t metatype = GarrysMod::Lua::Type::None;
+
+struct Container
+{
+	filesystem::Finder *finder;
+};
+
+static Container *Get( GarrysMod::Lua::ILuaBase *LUA, int32_t index )
+{
+	if( !LUA->IsType( index, metatype ) )
+		luaL_typerror( LUA->GetState( ), index, metaname );
+
+	return LUA->GetUserType<Container>( index, metatype );
+}
+
+LUA_FUNCTION_STATIC( tostring )
+{
+	lua_pushfstring( LUA->GetState( ), "%s: %p", metaname, Get( LUA, 1 )->finder );
+	return 1;
+}
+
+LUA_FUNCTION_STATIC( Close )
+{
+	Container *container = Get( LUA, 1 );
+	delete container->finder;
+	container->finder = nullptr;
+	return 0;
+}
+
+LUA_FUNCTION_STATIC( Next )
+{
+	filesystem::Scheduler::Timer timer( LUA );
+
+	Container *container = Get( LUA, 1 );
+	if( container->finder == nullptr )
+		return 0;
+
+	std::string name;
+	bool directory = false;
+	if( !container->finder->Next( name, directory ) )
+	{
+		// release the find handle right away instead of waiting for the collector
+		delete container->finder;
+		container->finder = nullptr;
+		return 0;
+	}
+
+	LUA->PushString( name.c_str( ), static_cast<unsigned int>( name.size( ) ) );
+	LUA->PushBool( directory );
+	return 2;
+}
+
+void Create( GarrysMod::Lua::ILuaBase *LUA, filesystem::Finder *finder )
+{
+	LUA->PushCFunction( Next );
+
+	Container *container = LUA->NewUserType<Container>( metatype );
+	container->finder = finder;
+
+	LUA->PushMetaTable( metatype );
+	LUA->SetMetaTable( -2 );
+}
+
+void Initialize( GarrysMod::Lua::ILuaBase *LUA )
+{
+	metatype = LUA->CreateMetaTable( metaname );
+
+	LUA->PushCFunction( tostring );
+	LUA->SetField( -2, "__tostring" );
+
+	LUA->PushCFunction( Close );
+	LUA->SetField( -2, "__gc" );
+
+	LUA->Push( -1 );
+	LUA->SetField( -2, "__index" );
+
+	LUA->PushCFunction( Close );
+	LUA->SetField( -2, "Close" );
+
+	LUA->PushCFunction( Next );
+	LUA->SetField( -2, "Next" );
+
+	LUA->Pop( 1 );
+}
+
+void Deinitialize( GarrysMod::Lua::ILuaBase *LUA )
+{
+	LUA->PushNil( );
+	LUA->SetField( GarrysMod::Lua::INDEX_REGISTRY, metaname );
+}
+
+}
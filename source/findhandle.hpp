@@ -0,0 +1,26 @@
+#pragma once
+
+namespace GarrysMod
+{
+	namespace Lua
+	{
+		class ILuaBase;
+	}
+}
+
+namespace filesystem
+{
+
+class Finder;
+
+}
+
+namespace findhandle
+{
+
+void Initialize( GarrysMod::Lua::ILuaBase *LUA );
+void Deinitialize( GarrysMod::Lua::ILuaBase *LUA );
+// pushes the iterator function and its state for a generic for, takes ownership of finder (may be nullptr)
+void Create( GarrysMod::Lua::ILuaBase *LUA, filesystem::Finder *finder );
+
+}
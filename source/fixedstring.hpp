@@ -0,0 +1,87 @@
+#pragma once
+
+#include "stringref.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace filesystem
+{
+
+// Null terminated string with a fixed capacity, kept on the stack so requests can validate and
+// normalize paths without heap allocated copies. Anything that doesn't fit is refused, never cut.
+template<size_t Capacity>
+class FixedString
+{
+public:
+	FixedString( ) :
+		length( 0 )
+	{
+		buffer[0] = '\0';
+	}
+
+	bool Assign( const char *str, size_t len )
+	{
+		if( len >= Capacity )
+			return false;
+
+		std::memmove( buffer, str, len );
+		buffer[len] = '\0';
+		length = len;
+		return true;
+	}
+
+	bool Assign( const StringRef &str )
+	{
+		return Assign( str.c_str( ), str.size( ) );
+	}
+
+	// after writing to GetBuffer directly
+	void Update( )
+	{
+		length = std::strlen( buffer );
+	}
+
+	char *GetBuffer( )
+	{
+		return buffer;
+	}
+
+	const char *Get( ) const
+	{
+		return buffer;
+	}
+
+	size_t GetLength( ) const
+	{
+		return length;
+	}
+
+	bool IsEmpty( ) const
+	{
+		return length == 0;
+	}
+
+	static size_t GetCapacity( )
+	{
+		return Capacity;
+	}
+
+	bool Equals( const std::string &str ) const
+	{
+		return str.size( ) == length && std::memcmp( str.c_str( ), buffer, length ) == 0;
+	}
+
+	// valid until this is changed or destroyed
+	StringRef Ref( ) const
+	{
+		return StringRef( buffer, length );
+	}
+
+private:
+	char buffer[Capacity];
+	size_t length;
+};
+
+}
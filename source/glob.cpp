@@ -0,0 +1,421 @@
+#include "glob.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace filesystem
+{
+
+static const size_t max_alternatives = 1024;
+
+static char ToLower( char c )
+{
+	return c >= 'A' && c <= 'Z' ? static_cast<char>( c - 'A' + 'a' ) : c;
+}
+
+GlobMatcher::GlobMatcher( ) :
+	nocase( false )
+{ }
+
+bool GlobMatcher::Compile( const std::string &pattern, bool insensitive )
+{
+	alternatives.clear( );
+	base.clear( );
+	nocase = insensitive;
+
+	std::string normalized = pattern;
+	std::replace( normalized.begin( ), normalized.end( ), '\\', '/' );
+	if( normalized.empty( ) || normalized[0] == '/' )
+		return false;
+
+	std::vector<std::string> expanded;
+	if( !Expand( normalized, expanded ) )
+		return false;
+
+	for( auto it = expanded.begin( ); it != expanded.end( ); ++it )
+	{
+		Alternative alternative;
+
+		size_t start = 0;
+		while( start <= it->size( ) )
+		{
+			size_t end = it->find( '/', start );
+			if( end == it->npos )
+				end = it->size( );
+
+			const std::string text = it->substr( start, end - start );
+			start = end + 1;
+			if( text.empty( ) )
+				continue;
+
+			if( text == "." || text == ".." )
+				return false;
+
+			Segment segment;
+			if( !CompileSegment( text, segment ) )
+				return false;
+
+			// consecutive globstars are the same as one
+			if( segment.globstar && !alternative.empty( ) && alternative.back( ).globstar )
+				continue;
+
+			alternative.push_back( std::move( segment ) );
+		}
+
+		if( alternative.empty( ) )
+			return false;
+
+		alternatives.push_back( std::move( alternative ) );
+	}
+
+	// strip the literal directories every alternative starts with, leaving at least one component
+	size_t common = 0;
+	while( true )
+	{
+		const Alternative &first = alternatives.front( );
+		if( common + 1 >= first.size( ) || !first[common].literal )
+			break;
+
+		bool shared = true;
+		for( auto it = alternatives.begin( ) + 1; it != alternatives.end( ) && shared; ++it )
+			shared = common + 1 < it->size( ) && ( *it )[common].literal && ( *it )[common].text == first[common].text;
+
+		if( !shared )
+			break;
+
+		base += first[common].text;
+		base += '/';
+		++common;
+	}
+
+	if( common != 0 )
+		for( auto it = alternatives.begin( ); it != alternatives.end( ); ++it )
+			it->erase( it->begin( ), it->begin( ) + static_cast<ptrdiff_t>( common ) );
+
+	return true;
+}
+
+const std::string &GlobMatcher::GetBase( ) const
+{
+	return base;
+}
+
+GlobMatcher::State GlobMatcher::Start( ) const
+{
+	State state;
+	for( uint32_t k = 0; k < alternatives.size( ); ++k )
+		state.emplace_back( k, 0 );
+
+	return state;
+}
+
+bool GlobMatcher::Step( const State &current, const std::string &name, State &next ) const
+{
+	State state = current;
+	Close( state );
+
+	next.clear( );
+	for( auto it = state.begin( ); it != state.end( ); ++it )
+	{
+		const Alternative &alternative = alternatives[it->first];
+		if( it->second >= alternative.size( ) )
+			continue;
+
+		const Segment &segment = alternative[it->second];
+		if( segment.globstar )
+			next.push_back( *it );
+		else if( MatchSegment( segment, name ) )
+			next.emplace_back( it->first, it->second + 1 );
+	}
+
+	std::sort( next.begin( ), next.end( ) );
+	next.erase( std::unique( next.begin( ), next.end( ) ), next.end( ) );
+
+	State closed = next;
+	Close( closed );
+	const bool matched = IsEnd( closed );
+
+	// a fully matched alternative has nothing left for the entries below, only positions that
+	// can consume another component are worth descending for
+	next.erase( std::remove_if( next.begin( ), next.end( ), [this]( const std::pair<uint32_t, uint32_t> &position )
+	{
+		return position.second >= alternatives[position.first].size( );
+	} ), next.end( ) );
+	return matched;
+}
+
+bool GlobMatcher::Match( const std::string &path ) const
+{
+	State state = Start( ), next;
+	bool matched = false;
+
+	size_t start = 0;
+	while( start < path.size( ) )
+	{
+		size_t end = path.find_first_of( "/\\", start );
+		if( end == path.npos )
+			end = path.size( );
+
+		if( end != start )
+		{
+			matched = Step( state, path.substr( start, end - start ), next );
+			state.swap( next );
+			// only a match when this was the last component
+			if( state.empty( ) )
+				return matched && path.find_first_not_of( "/\\", end ) == path.npos;
+		}
+
+		start = end + 1;
+	}
+
+	return matched;
+}
+
+bool GlobMatcher::Expand( const std::string &pattern, std::vector<std::string> &expanded )
+{
+	// find the first top level brace group, ignoring anything inside character classes
+	size_t open = pattern.npos, close = pattern.npos;
+	std::vector<size_t> commas;
+	size_t depth = 0;
+	bool in_class = false;
+	for( size_t k = 0; k < pattern.size( ) && close == pattern.npos; ++k )
+	{
+		const char c = pattern[k];
+		if( in_class )
+		{
+			if( c == ']' )
+				in_class = false;
+
+			continue;
+		}
+
+		switch( c )
+		{
+			case '[':
+				in_class = true;
+				// a leading ']' or negated ']' is part of the class
+				if( k + 1 < pattern.size( ) && ( pattern[k + 1] == '!' || pattern[k + 1] == '^' ) )
+					++k;
+
+				if( k + 1 < pattern.size( ) && pattern[k + 1] == ']' )
+					++k;
+
+				break;
+
+			case '{':
+				if( depth++ == 0 )
+					open = k;
+
+				break;
+
+			case ',':
+				if( depth == 1 )
+					commas.push_back( k );
+
+				break;
+
+			case '}':
+				if( depth == 0 )
+					return false;
+
+				if( --depth == 0 )
+					close = k;
+
+				break;
+		}
+	}
+
+	if( in_class || depth != 0 )
+		return false;
+
+	if( open == pattern.npos )
+	{
+		if( expanded.size( ) >= max_alternatives )
+			return false;
+
+		expanded.push_back( pattern );
+		return true;
+	}
+
+	const std::string prefix = pattern.substr( 0, open ), suffix = pattern.substr( close + 1 );
+	size_t start = open + 1;
+	commas.push_back( close );
+	for( auto it = commas.begin( ); it != commas.end( ); ++it )
+	{
+		if( !Expand( prefix + pattern.substr( start, *it - start ) + suffix, expanded ) )
+			return false;
+
+		start = *it + 1;
+	}
+
+	return true;
+}
+
+bool GlobMatcher::CompileSegment( const std::string &text, Segment &segment ) const
+{
+	segment.globstar = text == "**";
+	segment.literal = !segment.globstar;
+	segment.text = text;
+	if( nocase )
+		std::transform( segment.text.begin( ), segment.text.end( ), segment.text.begin( ), ToLower );
+
+	if( segment.globstar )
+		return true;
+
+	for( size_t k = 0; k < text.size( ); ++k )
+	{
+		Token token;
+		token.type = Token::Literal;
+		token.literal = nocase ? ToLower( text[k] ) : text[k];
+		token.negate = false;
+
+		switch( text[k] )
+		{
+			case '?':
+				token.type = Token::Any;
+				break;
+
+			case '*':
+				// a lone ** inside a component is just a star
+				if( !segment.tokens.empty( ) && segment.tokens.back( ).type == Token::Star )
+					continue;
+
+				token.type = Token::Star;
+				break;
+
+			case '[':
+			{
+				token.type = Token::Class;
+				size_t pos = k + 1;
+				if( pos < text.size( ) && ( text[pos] == '!' || text[pos] == '^' ) )
+				{
+					token.negate = true;
+					++pos;
+				}
+
+				bool first = true;
+				for( ; pos < text.size( ) && ( first || text[pos] != ']' ); ++pos, first = false )
+				{
+					char low = text[pos], high = low;
+					if( pos + 2 < text.size( ) && text[pos + 1] == '-' && text[pos + 2] != ']' )
+					{
+						high = text[pos + 2];
+						pos += 2;
+					}
+
+					if( nocase )
+					{
+						low = ToLower( low );
+						high = ToLower( high );
+					}
+
+					token.ranges.emplace_back( low, high );
+				}
+
+				if( pos >= text.size( ) )
+					return false;
+
+				k = pos;
+				break;
+			}
+		}
+
+		if( token.type != Token::Literal )
+			segment.literal = false;
+
+		segment.tokens.push_back( std::move( token ) );
+	}
+
+	return true;
+}
+
+bool GlobMatcher::MatchToken( const Token &token, char c ) const
+{
+	if( nocase )
+		c = ToLower( c );
+
+	switch( token.type )
+	{
+		case Token::Literal:
+			return token.literal == c;
+
+		case Token::Any:
+			return true;
+
+		case Token::Class:
+		{
+			bool found = false;
+			for( auto it = token.ranges.begin( ); it != token.ranges.end( ) && !found; ++it )
+				found = c >= it->first && c <= it->second;
+
+			return found != token.negate;
+		}
+
+		case Token::Star:
+			break;
+	}
+
+	return false;
+}
+
+bool GlobMatcher::MatchSegment( const Segment &segment, const std::string &name ) const
+{
+	const std::vector<Token> &tokens = segment.tokens;
+
+	// iterative wildcard matching, backtracks only to the last star
+	size_t p = 0, n = 0, star = tokens.size( ), mark = 0;
+	while( n < name.size( ) )
+	{
+		if( p < tokens.size( ) && tokens[p].type == Token::Star )
+		{
+			star = p++;
+			mark = n;
+		}
+		else if( p < tokens.size( ) && MatchToken( tokens[p], name[n] ) )
+		{
+			++p;
+			++n;
+		}
+		else if( star != tokens.size( ) )
+		{
+			p = star + 1;
+			n = ++mark;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while( p < tokens.size( ) && tokens[p].type == Token::Star )
+		++p;
+
+	return p == tokens.size( );
+}
+
+void GlobMatcher::Close( State &state ) const
+{
+	// a globstar can also match no directories at all
+	for( size_t k = 0; k < state.size( ); ++k )
+	{
+		const Alternative &alternative = alternatives[state[k].first];
+		const uint32_t segment = state[k].second;
+		if( segment < alternative.size( ) && alternative[segment].globstar )
+		{
+			const std::pair<uint32_t, uint32_t> skip( state[k].first, segment + 1 );
+			if( std::find( state.begin( ), state.end( ), skip ) == state.end( ) )
+				state.push_back( skip );
+		}
+	}
+}
+
+bool GlobMatcher::IsEnd( const State &state ) const
+{
+	for( auto it = state.begin( ); it != state.end( ); ++it )
+		if( it->second == alternatives[it->first].size( ) )
+			return true;
+
+	return false;
+}
+
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace filesystem
+{
+
+// Compiled shell style pattern over '/' separated relative paths.
+// Supports *, ?, [abc], [a-z], [!abc], {alt1,alt2} (nestable) and ** for any amount of directories.
+// Matching runs one path component at a time so traversals can prune subtrees that can't match.
+class GlobMatcher
+{
+public:
+	// positions (alternative, segment) the match can still advance from, empty means nothing below
+	// can match
+	typedef std::vector<std::pair<uint32_t, uint32_t>> State;
+
+	GlobMatcher( );
+
+	// false on malformed patterns, "." or ".." components or too many brace alternatives
+	bool Compile( const std::string &pattern, bool nocase );
+
+	// leading components without wildcards common to every alternative, traversals start there
+	const std::string &GetBase( ) const;
+
+	// state for the entries of the base directory
+	State Start( ) const;
+	// advances over one path component, returns true when the component completes a match,
+	// positions that are fully matched or can't consume another component are left out of next
+	bool Step( const State &state, const std::string &name, State &next ) const;
+
+	// whole path match, relative to the base
+	bool Match( const std::string &path ) const;
+
+private:
+	struct Token
+	{
+		enum Type
+		{
+			Literal,
+			Any,
+			Star,
+			Class
+		};
+
+		Type type;
+		char literal;
+		bool negate;
+		std::vector<std::pair<char, char>> ranges;
+	};
+
+	struct Segment
+	{
+		bool globstar;
+		bool literal;
+		std::string text;
+		std::vector<Token> tokens;
+	};
+
+	typedef std::vector<Segment> Alternative;
+
+	static bool Expand( const std::string &pattern, std::vector<std::string> &expanded );
+	bool CompileSegment( const std::string &text, Segment &segment ) const;
+	bool MatchToken( const Token &token, char c ) const;
+	bool MatchSegment( const Segment &segment, const std::string &name ) const;
+	void Close( State &state ) const;
+	bool IsEnd( const State &state ) const;
+
+	std::vector<Alternative> alternatives;
+	std::string base;
+	bool nocase;
+};
+
+}
@@ -0,0 +1,146 @@
+#include "handlecache.hpp"
+
+#include <filesystem_stdio.h>
+
+#include <iterator>
+
+namespace filesystem
+{
+
+HandleCache::HandleCache( ) :
+	filesystem( nullptr ),
+	stats( )
+{
+	stats.capacity = 32;
+}
+
+HandleCache::~HandleCache( )
+{
+	Clear( );
+}
+
+void HandleCache::Initialize( CBaseFileSystem *fsinterface )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	filesystem = fsinterface;
+}
+
+void HandleCache::SetCapacity( size_t capacity )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	stats.capacity = capacity;
+	if( entries.size( ) > capacity )
+		Evict( entries.size( ) - capacity );
+}
+
+size_t HandleCache::GetCapacity( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return stats.capacity;
+}
+
+FileHandle_t HandleCache::Acquire( const PathKey &key, const std::string &mode, long mtime, std::string &owned )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto range = lookup.equal_range( key.hash );
+	auto it = range.first;
+	while( it != range.second && ( it->second->mode != mode || !key.Matches( it->second->key ) ) )
+		++it;
+
+	if( it == range.second )
+	{
+		++stats.misses;
+		return nullptr;
+	}
+
+	const Iterator entry = it->second;
+	FileHandle_t handle = entry->handle;
+	const bool fresh = entry->mtime == mtime;
+	if( fresh )
+		owned = std::move( entry->key );
+
+	lookup.erase( it );
+	entries.erase( entry );
+
+	if( !fresh )
+	{
+		++stats.stale;
+		++stats.misses;
+		filesystem->Close( handle );
+		return nullptr;
+	}
+
+	++stats.hits;
+	filesystem->Seek( handle, 0, FILESYSTEM_SEEK_HEAD );
+	return handle;
+}
+
+bool HandleCache::Release( std::string key, const std::string &mode, FileHandle_t handle, long mtime )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	if( filesystem == nullptr || stats.capacity == 0 || !filesystem->IsOk( handle ) )
+		return false;
+
+	if( entries.size( ) >= stats.capacity )
+		Evict( entries.size( ) - stats.capacity + 1 );
+
+	const uint64_t hash = PathKey::Hash( key );
+	entries.push_front( Entry{ std::move( key ), mode, handle, mtime } );
+	lookup.emplace( hash, entries.begin( ) );
+	return true;
+}
+
+void HandleCache::Invalidate( const std::string &key )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto range = lookup.equal_range( PathKey::Hash( key ) );
+	for( auto it = range.first; it != range.second; )
+		if( it->second->key == key )
+		{
+			filesystem->Close( it->second->handle );
+			entries.erase( it->second );
+			it = lookup.erase( it );
+		}
+		else
+		{
+			++it;
+		}
+}
+
+void HandleCache::Clear( )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	Evict( entries.size( ) );
+}
+
+HandleCache::Statistics HandleCache::GetStatistics( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	Statistics statistics = stats;
+	statistics.cached = entries.size( );
+	return statistics;
+}
+
+void HandleCache::Evict( size_t count )
+{
+	for( ; count != 0 && !entries.empty( ); --count )
+	{
+		const Entry &entry = entries.back( );
+
+		const auto range = lookup.equal_range( PathKey::Hash( entry.key ) );
+		for( auto it = range.first; it != range.second; ++it )
+			if( it->second == std::prev( entries.end( ) ) )
+			{
+				lookup.erase( it );
+				break;
+			}
+
+		filesystem->Close( entry.handle );
+		entries.pop_back( );
+		++stats.evictions;
+	}
+}
+
+}
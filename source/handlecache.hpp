@@ -0,0 +1,76 @@
+#pragma once
+
+#include "pathkey.hpp"
+
+#include <cstdint>
+#include <string>
+#include <list>
+#include <utility>
+#include <unordered_map>
+#include <mutex>
+
+typedef void *FileHandle_t;
+class CBaseFileSystem;
+
+namespace filesystem
+{
+
+// LRU of engine handles for read-only files that were recently closed.
+// Handles are keyed by path ID and normalized path, only reused for the same open mode
+// (text and binary reads differ) and while the file modification time they were opened
+// with still matches.
+class HandleCache
+{
+public:
+	struct Statistics
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t stale;
+		uint64_t evictions;
+		size_t cached;
+		size_t capacity;
+	};
+
+	HandleCache( );
+	~HandleCache( );
+
+	void Initialize( CBaseFileSystem *fsinterface );
+
+	void SetCapacity( size_t capacity );
+	size_t GetCapacity( ) const;
+
+	// returns a cached handle seeked to the start or nullptr, ownership goes to the caller along
+	// with the key string it was cached under, so handing it back doesn't need a new one
+	FileHandle_t Acquire( const PathKey &key, const std::string &mode, long mtime, std::string &owned );
+	// returns false when the handle wasn't cached and must be closed by the caller
+	bool Release( std::string key, const std::string &mode, FileHandle_t handle, long mtime );
+
+	// drops every handle of key, whatever their modes
+	void Invalidate( const std::string &key );
+	void Clear( );
+
+	Statistics GetStatistics( ) const;
+
+private:
+	struct Entry
+	{
+		std::string key;
+		std::string mode;
+		FileHandle_t handle;
+		long mtime;
+	};
+
+	typedef std::list<Entry>::iterator Iterator;
+
+	void Evict( size_t count );
+
+	CBaseFileSystem *filesystem;
+	mutable std::mutex mutex;
+	std::list<Entry> entries;
+	// by PathKey hash
+	std::unordered_multimap<uint64_t, Iterator> lookup;
+	Statistics stats;
+};
+
+}
@@ -0,0 +1,164 @@
+#include "lookupfilter.hpp"
+
+namespace filesystem
+{
+
+LookupFilter::LookupFilter( ) :
+	rejected( 0 ),
+	passed( 0 )
+{ }
+
+LookupFilter::Result LookupFilter::Check( const StringRef &pathid, const StringRef &path, SearchPaths &loose )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = Find( pathid );
+	if( it == filters.end( ) )
+		return Unknown;
+
+	const Filter &filter = it->second;
+	if( !filter.ready || filter.bloom.MayContain( BloomFilter::Hash( path ) ) )
+	{
+		++passed;
+		return Present;
+	}
+
+	++rejected;
+	loose = filter.loose;
+	return Absent;
+}
+
+void LookupFilter::Start( const std::string &pathid, const std::vector<std::string> &loose )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if( filters.find( pathid ) != filters.end( ) )
+		return;
+
+	Filter &filter = filters[pathid];
+	filter.ready = false;
+	filter.loose = std::make_shared<const std::vector<std::string>>( loose );
+	filter.pending.push_back( std::string( ) );
+	filter.entries = 0;
+}
+
+void LookupFilter::Add( const std::string &pathid, const std::string &path )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = filters.find( pathid );
+	if( it == filters.end( ) )
+		return;
+
+	std::string current = path;
+	while( !current.empty( ) )
+	{
+		Insert( it->second, BloomFilter::Hash( current ) );
+
+		const size_t pos = current.find_last_of( "/\\" );
+		current.resize( pos != current.npos ? pos : 0 );
+	}
+}
+
+bool LookupFilter::Next( std::string &pathid, std::string &directory )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	for( auto it = filters.begin( ); it != filters.end( ); ++it )
+	{
+		Filter &filter = it->second;
+		if( filter.pending.empty( ) )
+			continue;
+
+		pathid = it->first;
+		directory = std::move( filter.pending.front( ) );
+		filter.pending.pop_front( );
+		return true;
+	}
+
+	return false;
+}
+
+void LookupFilter::Scanned(
+	const std::string &pathid,
+	const std::string &directory,
+	const std::vector<std::string> &files,
+	const std::vector<std::string> &directories
+)
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = filters.find( pathid );
+	if( it == filters.end( ) || it->second.ready )
+		return;
+
+	Filter &filter = it->second;
+	const std::string prefix = directory.empty( ) ? directory : directory + '/';
+	for( auto file = files.begin( ); file != files.end( ); ++file )
+		Insert( filter, BloomFilter::Hash( prefix + *file ) );
+
+	for( auto dir = directories.begin( ); dir != directories.end( ); ++dir )
+	{
+		std::string path = prefix + *dir;
+		Insert( filter, BloomFilter::Hash( path ) );
+		filter.pending.push_back( std::move( path ) );
+	}
+
+	if( !filter.pending.empty( ) )
+		return;
+
+	// names added after this only degrade the false positive rate
+	filter.bloom.Reset( filter.hashes.size( ) );
+	for( auto hash = filter.hashes.begin( ); hash != filter.hashes.end( ); ++hash )
+		filter.bloom.Add( *hash );
+
+	std::vector<uint64_t>( ).swap( filter.hashes );
+	filter.ready = true;
+}
+
+void LookupFilter::Clear( )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	filters.clear( );
+}
+
+LookupFilter::Statistics LookupFilter::GetStatistics( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	Statistics stats = { };
+	stats.rejected = rejected;
+	stats.passed = passed;
+	stats.filters = filters.size( );
+	for( auto it = filters.begin( ); it != filters.end( ); ++it )
+	{
+		if( !it->second.ready )
+			++stats.building;
+
+		stats.entries += it->second.entries;
+		stats.size += it->second.bloom.GetSize( ) + it->second.hashes.size( ) * sizeof( uint64_t );
+	}
+
+	return stats;
+}
+
+LookupFilter::Filters::iterator LookupFilter::Find( const StringRef &pathid )
+{
+	for( auto it = filters.begin( ); it != filters.end( ); ++it )
+		if( pathid.Equals( it->first ) )
+			return it;
+
+	return filters.end( );
+}
+
+void LookupFilter::Insert( Filter &filter, uint64_t hash )
+{
+	if( filter.ready )
+		filter.bloom.Add( hash );
+	else
+		filter.hashes.push_back( hash );
+
+	++filter.entries;
+}
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "bloomfilter.hpp"
+#include "stringref.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+
+namespace filesystem
+{
+
+// Per path ID filters of every name reachable through its search paths, used to answer most
+// lookup misses without asking the engine. Filters are built lazily, a directory at a time,
+// by whoever drives Next and Scanned (the wrapper does it from the filesystem tick).
+// Names are never removed, a removed file only costs an extra engine lookup.
+class LookupFilter
+{
+public:
+	enum Result
+	{
+		// no filter for this path ID yet, Start should be called
+		Unknown,
+		// still being built, or the name might exist
+		Present,
+		// not present when the filter was built, loose search paths still need checking
+		Absent
+	};
+
+	// shared with the callers of Check, which stat them outside of the lock
+	typedef std::shared_ptr<const std::vector<std::string>> SearchPaths;
+
+	struct Statistics
+	{
+		uint64_t rejected;
+		uint64_t passed;
+		size_t filters;
+		size_t building;
+		size_t entries;
+		size_t size;
+	};
+
+	LookupFilter( );
+
+	Result Check( const StringRef &pathid, const StringRef &path, SearchPaths &loose );
+
+	// loose lists the directory search paths of pathid, they're rechecked on every miss
+	void Start( const std::string &pathid, const std::vector<std::string> &loose );
+
+	// adds the path and all of its parents
+	void Add( const std::string &pathid, const std::string &path );
+
+	// returns the next directory some filter needs scanned, relative to its search paths
+	bool Next( std::string &pathid, std::string &directory );
+	void Scanned(
+		const std::string &pathid,
+		const std::string &directory,
+		const std::vector<std::string> &files,
+		const std::vector<std::string> &directories
+	);
+
+	void Clear( );
+
+	Statistics GetStatistics( ) const;
+
+private:
+	struct Filter
+	{
+		bool ready;
+		SearchPaths loose;
+		std::deque<std::string> pending;
+		// hashes collected while building, the filter can only be sized once they're all known
+		std::vector<uint64_t> hashes;
+		size_t entries;
+		BloomFilter bloom;
+	};
+
+	typedef std::unordered_map<std::string, Filter> Filters;
+
+	// a handful of path IDs, comparing them beats building a key to hash
+	Filters::iterator Find( const StringRef &pathid );
+	static void Insert( Filter &filter, uint64_t hash );
+
+	mutable std::mutex mutex;
+	Filters filters;
+	uint64_t rejected;
+	uint64_t passed;
+};
+
+}
@@ -1,11 +1,13 @@
 #include "filesystem.hpp"
 #include "file.hpp"
+#include "findhandle.hpp"
 
 #include <GarrysMod/Lua/Interface.h>
 
 GMOD_MODULE_OPEN( )
 {
 	file::Initialize( LUA );
+	findhandle::Initialize( LUA );
 	filesystem::Initialize( LUA );
 	return 0;
 }
@@ -13,6 +15,7 @@ GMOD_MODULE_OPEN( )
 GMOD_MODULE_CLOSE( )
 {
 	filesystem::Deinitialize( LUA );
+	findhandle::Deinitialize( LUA );
 	file::Deinitialize( LUA );
 	return 0;
 }
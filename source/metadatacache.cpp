@@ -0,0 +1,251 @@
+#include "metadatacache.hpp"
+
+#include <cctype>
+
+namespace filesystem
+{
+
+const size_t MetadataCache::max_entries = 16384;
+
+MetadataCache::MetadataCache( ) :
+	dependencies( 0 ),
+	stats( )
+{ }
+
+bool MetadataCache::Available( ) const
+{
+	return watcher.Available( );
+}
+
+bool MetadataCache::Get( const PathKey &key, bool &exists, FileInfo &info )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto range = entries.equal_range( key.hash );
+	for( auto it = range.first; it != range.second; ++it )
+		if( key.Matches( it->second.key ) )
+		{
+			++stats.hits;
+			exists = it->second.exists;
+			info = it->second.info;
+			return true;
+		}
+
+	++stats.misses;
+	return false;
+}
+
+bool MetadataCache::Watch( const Dependencies &directories )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if( !directories.empty( ) && !watcher.Available( ) )
+		return false;
+
+	// no eviction order is kept, a full cache just starts over
+	if( entries.size( ) >= max_entries || dependencies >= max_entries * 4 )
+		ClearUnlocked( );
+
+	for( auto it = directories.begin( ); it != directories.end( ); ++it )
+	{
+		if( watches.find( it->directory ) != watches.end( ) )
+			continue;
+
+		const int32_t id = watcher.Add( it->directory );
+		if( id == -1 )
+			return false;
+
+		watches.emplace( it->directory, id );
+	}
+
+	return true;
+}
+
+void MetadataCache::Set(
+	const std::string &key,
+	bool exists,
+	const FileInfo &info,
+	const Dependencies &directories
+)
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	// a watch added only now could have missed changes made while resolving, and a watch that
+	// went away (the cache started over, the directory is gone) won't report them at all
+	std::vector<int32_t> ids;
+	ids.reserve( directories.size( ) );
+	for( auto it = directories.begin( ); it != directories.end( ); ++it )
+	{
+		const auto watch = watches.find( it->directory );
+		if( watch == watches.end( ) )
+			return;
+
+		ids.push_back( watch->second );
+	}
+
+	for( size_t k = 0; k < ids.size( ); ++k )
+		dependents[ids[k]].push_back( Dependent{ key, directories[k].child } );
+
+	dependencies += ids.size( );
+
+	auto it = Find( key );
+	if( it == entries.end( ) )
+		it = entries.emplace( PathKey::Hash( key ), Entry{ key, false, FileInfo( ) } );
+
+	it->second.exists = exists;
+	it->second.info = info;
+}
+
+void MetadataCache::Invalidate( const std::string &key )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	stats.invalidations += Erase( key );
+}
+
+void MetadataCache::InvalidateTree( const std::string &key )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	stats.invalidations += Erase( key );
+
+	for( auto it = entries.begin( ); it != entries.end( ); )
+	{
+		const std::string &name = it->second.key;
+		if( name.size( ) > key.size( ) &&
+			( name[key.size( )] == '/' || name[key.size( )] == '\\' ) &&
+			name.compare( 0, key.size( ), key ) == 0 )
+		{
+			it = entries.erase( it );
+			++stats.invalidations;
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	// parents only see their times change, keys look like "pathid:path"
+	const size_t colon = key.find( ':' );
+	for( size_t pos = key.find_last_of( "/\\" ); pos != key.npos && pos > colon; pos = key.find_last_of( "/\\", pos - 1 ) )
+		stats.invalidations += Erase( key.substr( 0, pos ) );
+}
+
+MetadataCache::Entries::iterator MetadataCache::Find( const std::string &key )
+{
+	const auto range = entries.equal_range( PathKey::Hash( key ) );
+	for( auto it = range.first; it != range.second; ++it )
+		if( it->second.key == key )
+			return it;
+
+	return entries.end( );
+}
+
+size_t MetadataCache::Erase( const std::string &key )
+{
+	const auto it = Find( key );
+	if( it == entries.end( ) )
+		return 0;
+
+	entries.erase( it );
+	return 1;
+}
+
+bool MetadataCache::SameName( const std::string &a, const std::string &b )
+{
+
+#if defined SYSTEM_WINDOWS
+
+	if( a.size( ) != b.size( ) )
+		return false;
+
+	for( size_t k = 0; k < a.size( ); ++k )
+		if( std::tolower( static_cast<unsigned char>( a[k] ) ) != std::tolower( static_cast<unsigned char>( b[k] ) ) )
+			return false;
+
+	return true;
+
+#else
+
+	return a == b;
+
+#endif
+
+}
+
+void MetadataCache::Clear( )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	ClearUnlocked( );
+}
+
+void MetadataCache::Poll( )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	watcher.Poll( [this]( int32_t id, const std::string &name, uint32_t events )
+	{
+		if( ( events & Watcher::Overflow ) != 0 )
+		{
+			stats.invalidations += entries.size( );
+			entries.clear( );
+			return;
+		}
+
+		const auto it = dependents.find( id );
+		if( it == dependents.end( ) )
+			return;
+
+		// the directory itself going away concerns everything, otherwise entries that only depend
+		// on one child of it are kept when something else changed
+		const bool gone = ( events & Watcher::Gone ) != 0;
+		std::vector<Dependent> &list = it->second;
+		size_t kept = 0;
+		for( size_t k = 0; k < list.size( ); ++k )
+			if( gone || name.empty( ) || list[k].child.empty( ) || SameName( list[k].child, name ) )
+				stats.invalidations += Erase( list[k].key );
+			else if( kept++ != k )
+				list[kept - 1] = std::move( list[k] );
+
+		dependencies -= list.size( ) - kept;
+		list.resize( kept );
+
+		if( gone )
+		{
+			dependents.erase( it );
+			for( auto watch = watches.begin( ); watch != watches.end( ); ++watch )
+				if( watch->second == id )
+				{
+					watches.erase( watch );
+					break;
+				}
+		}
+	} );
+}
+
+MetadataCache::Statistics MetadataCache::GetStatistics( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	Statistics statistics = stats;
+	statistics.entries = entries.size( );
+	statistics.watches = watches.size( );
+	statistics.notifications = watcher.Available( );
+	return statistics;
+}
+
+void MetadataCache::ClearUnlocked( )
+{
+	for( auto it = watches.begin( ); it != watches.end( ); ++it )
+		watcher.Remove( it->second );
+
+	// drain the removal notifications so stale ids don't linger
+	watcher.Poll( [] ( int32_t, const std::string &, uint32_t ) { } );
+
+	stats.invalidations += entries.size( );
+	entries.clear( );
+	watches.clear( );
+	dependents.clear( );
+	dependencies = 0;
+}
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "fileinfo.hpp"
+#include "pathkey.hpp"
+#include "watcher.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+namespace filesystem
+{
+
+// Results of metadata lookups (existence, type, size and times) keyed by path ID and normalized path.
+// Entries that depend on loose directories are only kept while those directories are being watched,
+// so without change notifications only lookups fully answered by packed files get cached.
+class MetadataCache
+{
+public:
+	struct Statistics
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t invalidations;
+		size_t entries;
+		size_t watches;
+		bool notifications;
+	};
+
+	// a loose directory whose changes can alter a result; with child set only changes to that entry
+	// of it count (the next directory on the way down to the result), otherwise every change does
+	struct Dependency
+	{
+		std::string directory;
+		std::string child;
+	};
+
+	typedef std::vector<Dependency> Dependencies;
+
+	MetadataCache( );
+
+	// without change notifications every lookup goes straight to the filesystem
+	bool Available( ) const;
+
+	bool Get( const PathKey &key, bool &exists, FileInfo &info );
+	// starts watching directories, call it before resolving what gets cached so changes made
+	// in between are reported, false when they can't be watched
+	bool Watch( const Dependencies &dependencies );
+	// dependencies list every loose directory whose changes can alter the result, the result
+	// isn't cached unless they're all still being watched
+	void Set( const std::string &key, bool exists, const FileInfo &info, const Dependencies &dependencies );
+
+	void Invalidate( const std::string &key );
+	// invalidates the key, everything below it and its parent directories, for changes made through the wrapper
+	void InvalidateTree( const std::string &key );
+	void Clear( );
+
+	// applies pending change notifications, meant to be called once per tick
+	void Poll( );
+
+	Statistics GetStatistics( ) const;
+
+private:
+	struct Entry
+	{
+		std::string key;
+		bool exists;
+		FileInfo info;
+	};
+
+	typedef std::unordered_multimap<uint64_t, Entry> Entries;
+
+	struct Dependent
+	{
+		std::string key;
+		std::string child;
+	};
+
+	Entries::iterator Find( const std::string &key );
+	// returns the number of entries erased, for the statistics
+	size_t Erase( const std::string &key );
+	void ClearUnlocked( );
+	static bool SameName( const std::string &a, const std::string &b );
+
+	static const size_t max_entries;
+
+	mutable std::mutex mutex;
+	Watcher watcher;
+	// by PathKey hash
+	Entries entries;
+	std::unordered_map<std::string, int32_t> watches;
+	std::unordered_map<int32_t, std::vector<Dependent>> dependents;
+	size_t dependencies;
+	Statistics stats;
+};
+
+}
@@ -0,0 +1,172 @@
+#include "pathinterncache.hpp"
+
+#include <cstring>
+#include <iterator>
+
+namespace filesystem
+{
+
+PathInternCache::PathInternCache( ) :
+	stats( )
+{
+	stats.capacity = 4096;
+}
+
+void PathInternCache::SetCapacity( size_t capacity )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	stats.capacity = capacity;
+	if( entries.size( ) > capacity )
+		Evict( entries.size( ) - capacity );
+}
+
+size_t PathInternCache::GetCapacity( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return stats.capacity;
+}
+
+bool PathInternCache::Get(
+	const StringRef &input,
+	const char *pathid,
+	uint32_t access,
+	bool &allowed,
+	bool &nonascii,
+	char *filepath,
+	size_t capacity
+)
+{
+	const uint64_t hash = Hash( input, pathid, access );
+
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = lookup.find( hash );
+	if( it == lookup.end( ) )
+	{
+		++stats.misses;
+		return false;
+	}
+
+	const Entry &entry = *it->second;
+	if( entry.access != access || !input.Equals( entry.input ) || entry.pathid != pathid ||
+		entry.filepath.size( ) >= capacity )
+	{
+		++stats.misses;
+		return false;
+	}
+
+	allowed = entry.allowed;
+	nonascii = entry.nonascii;
+	if( allowed )
+		std::memcpy( filepath, entry.filepath.c_str( ), entry.filepath.size( ) + 1 );
+
+	entries.splice( entries.begin( ), entries, it->second );
+	++stats.hits;
+	return true;
+}
+
+void PathInternCache::Set(
+	const StringRef &input,
+	const char *pathid,
+	uint32_t access,
+	bool allowed,
+	bool nonascii,
+	const char *filepath
+)
+{
+	const uint64_t hash = Hash( input, pathid, access );
+
+	std::lock_guard<std::mutex> lock( mutex );
+	if( stats.capacity == 0 )
+		return;
+
+	// colliding requests take over the slot, the full comparison on lookups tells them apart
+	auto it = lookup.find( hash );
+	if( it == lookup.end( ) )
+	{
+		if( entries.size( ) >= stats.capacity )
+		{
+			// the least recently used entry is reused as is, its strings keep their buffers
+			lookup.erase( entries.back( ).hash );
+			entries.splice( entries.begin( ), entries, std::prev( entries.end( ) ) );
+			++stats.evictions;
+		}
+		else
+		{
+			entries.push_front( Entry( ) );
+		}
+
+		it = lookup.emplace( hash, entries.begin( ) ).first;
+	}
+	else
+	{
+		entries.splice( entries.begin( ), entries, it->second );
+	}
+
+	Entry &entry = *it->second;
+	entry.hash = hash;
+	entry.access = access;
+	entry.input.assign( input.c_str( ), input.size( ) );
+	entry.pathid = pathid;
+	entry.allowed = allowed;
+	entry.nonascii = nonascii;
+	if( allowed )
+		entry.filepath = filepath;
+	else
+		entry.filepath.clear( );
+}
+
+void PathInternCache::Clear( )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	lookup.clear( );
+	entries.clear( );
+	++stats.flushes;
+}
+
+PathInternCache::Statistics PathInternCache::GetStatistics( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	Statistics statistics = stats;
+	statistics.entries = entries.size( );
+	return statistics;
+}
+
+uint64_t PathInternCache::Hash( const StringRef &input, const char *pathid, uint32_t access )
+{
+	// FNV-1a over the access type, the path ID and the path, a zero byte keeps them apart
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for( size_t k = 0; k < sizeof( access ); ++k )
+	{
+		hash ^= ( access >> ( k * 8 ) ) & 0xFF;
+		hash *= 0x100000001b3ULL;
+	}
+
+	for( const char *c = pathid; *c != '\0'; ++c )
+	{
+		hash ^= static_cast<unsigned char>( *c );
+		hash *= 0x100000001b3ULL;
+	}
+
+	hash *= 0x100000001b3ULL;
+
+	for( size_t k = 0; k < input.size( ); ++k )
+	{
+		hash ^= static_cast<unsigned char>( input[k] );
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+void PathInternCache::Evict( size_t count )
+{
+	for( ; count != 0 && !entries.empty( ); --count )
+	{
+		lookup.erase( entries.back( ).hash );
+		entries.pop_back( );
+		++stats.evictions;
+	}
+}
+
+}
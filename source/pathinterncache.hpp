@@ -0,0 +1,83 @@
+#pragma once
+
+#include "stringref.hpp"
+
+#include <cstdint>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+
+namespace filesystem
+{
+
+// LRU of validated requests with absolute paths, mapping the path as the caller gave it, the path ID
+// and the access type to the normalized path and the verdict. Entries are found by a hash of those
+// and compared in full, so lookups don't build strings. Making an absolute path relative walks the
+// search paths of its ID, which is why this is flushed along with everything else that depends on
+// them; relative paths validate faster than a lookup here and never come through.
+class PathInternCache
+{
+public:
+	struct Statistics
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		uint64_t flushes;
+		size_t entries;
+		size_t capacity;
+	};
+
+	PathInternCache( );
+
+	void SetCapacity( size_t capacity );
+	size_t GetCapacity( ) const;
+
+	// true when the request was validated before, the normalized path is only written when allowed
+	bool Get(
+		const StringRef &input,
+		const char *pathid,
+		uint32_t access,
+		bool &allowed,
+		bool &nonascii,
+		char *filepath,
+		size_t capacity
+	);
+	void Set(
+		const StringRef &input,
+		const char *pathid,
+		uint32_t access,
+		bool allowed,
+		bool nonascii,
+		const char *filepath
+	);
+
+	void Clear( );
+
+	Statistics GetStatistics( ) const;
+
+private:
+	struct Entry
+	{
+		uint64_t hash;
+		uint32_t access;
+		std::string input;
+		std::string pathid;
+		bool allowed;
+		bool nonascii;
+		std::string filepath;
+	};
+
+	typedef std::list<Entry>::iterator Iterator;
+
+	static uint64_t Hash( const StringRef &input, const char *pathid, uint32_t access );
+	void Evict( size_t count );
+
+	mutable std::mutex mutex;
+	std::list<Entry> entries;
+	std::unordered_map<uint64_t, Iterator> lookup;
+	Statistics stats;
+};
+
+}
@@ -0,0 +1,51 @@
+#include "pathkey.hpp"
+
+#include <cstring>
+
+namespace filesystem
+{
+
+// FNV-1a, fed one part at a time
+static const uint64_t hash_basis = 0xcbf29ce484222325ULL;
+
+static uint64_t HashBytes( uint64_t hash, const char *data, size_t length )
+{
+	for( size_t k = 0; k < length; ++k )
+	{
+		hash ^= static_cast<unsigned char>( data[k] );
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+PathKey::PathKey( const StringRef &p, const StringRef &pid ) :
+	path( p ),
+	pathid( pid ),
+	hash( HashBytes( HashBytes( HashBytes( hash_basis, pid.c_str( ), pid.size( ) ), ":", 1 ), p.c_str( ), p.size( ) ) )
+{ }
+
+uint64_t PathKey::Hash( const std::string &key )
+{
+	return HashBytes( hash_basis, key.c_str( ), key.size( ) );
+}
+
+bool PathKey::Matches( const std::string &key ) const
+{
+	return key.size( ) == pathid.size( ) + 1 + path.size( ) &&
+		std::memcmp( key.c_str( ), pathid.c_str( ), pathid.size( ) ) == 0 &&
+		key[pathid.size( )] == ':' &&
+		std::memcmp( key.c_str( ) + pathid.size( ) + 1, path.c_str( ), path.size( ) ) == 0;
+}
+
+std::string PathKey::ToString( ) const
+{
+	std::string key;
+	key.reserve( pathid.size( ) + 1 + path.size( ) );
+	key.append( pathid.c_str( ), pathid.size( ) );
+	key += ':';
+	key.append( path.c_str( ), path.size( ) );
+	return key;
+}
+
+}
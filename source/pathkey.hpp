@@ -0,0 +1,29 @@
+#pragma once
+
+#include "stringref.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace filesystem
+{
+
+// Path ID and normalized path of a request, what the per file caches are keyed by. They store the
+// key as "pathid:path" (SharedCache::MakeKey) but find entries by its hash and compare them in full,
+// so looking a request up doesn't build that string.
+struct PathKey
+{
+	PathKey( const StringRef &path, const StringRef &pathid );
+
+	// same as the hash of the parts
+	static uint64_t Hash( const std::string &key );
+
+	bool Matches( const std::string &key ) const;
+	std::string ToString( ) const;
+
+	StringRef path;
+	StringRef pathid;
+	uint64_t hash;
+};
+
+}
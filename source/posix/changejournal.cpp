@@ -0,0 +1,16 @@
+#include "changejournal.hpp"
+
+namespace filesystem
+{
+
+FILE *ChangeJournal::OpenLog( const std::string &fullpath, const char *mode )
+{
+	return fopen( fullpath.c_str( ), mode );
+}
+
+bool ChangeJournal::ReplaceLog( const std::string &source, const std::string &destination )
+{
+	return rename( source.c_str( ), destination.c_str( ) ) == 0;
+}
+
+}
@@ -0,0 +1,49 @@
+#include "directorydescriptor.hpp"
+
+#include <unistd.h>
+#include <fcntl.h>
+
+namespace filesystem
+{
+
+static const int directory_flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+int OpenDirectoryBelow( int fd, const std::string &relative )
+{
+	int current = openat( fd, ".", directory_flags );
+	size_t start = 0;
+	while( current != -1 && start < relative.size( ) )
+	{
+		size_t end = relative.find( '/', start );
+		if( end == relative.npos )
+			end = relative.size( );
+
+		if( end != start )
+		{
+			const std::string component = relative.substr( start, end - start );
+			const int next = openat( current, component.c_str( ), directory_flags );
+			close( current );
+			current = next;
+		}
+
+		start = end + 1;
+	}
+
+	return current;
+}
+
+int OpenParentDirectory( const std::string &fullpath, std::string &name )
+{
+	const size_t slash = fullpath.find_last_of( '/' );
+	if( slash == fullpath.npos )
+	{
+		name = fullpath;
+		return open( ".", directory_flags );
+	}
+
+	name = fullpath.substr( slash + 1 );
+	const std::string parent = slash == 0 ? std::string( "/" ) : fullpath.substr( 0, slash );
+	return open( parent.c_str( ), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+}
+
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+namespace filesystem
+{
+
+// opens the directory relative names below fd one '/' separated component at a time, never
+// following a link on the way, an empty relative opens fd itself again, -1 on failure
+int OpenDirectoryBelow( int fd, const std::string &relative );
+
+// opens the directory holding the last component of fullpath and leaves that component in name
+int OpenParentDirectory( const std::string &fullpath, std::string &name );
+
+}
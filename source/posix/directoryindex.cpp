@@ -0,0 +1,169 @@
+#include "directoryindex.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace filesystem
+{
+
+static bool MakeDirectory( const std::string &fullpath )
+{
+	return mkdir( fullpath.c_str( ), 0700 ) == 0 || errno == EEXIST;
+}
+
+std::string DirectoryIndex::GetCacheDirectory( )
+{
+	const char *home = std::getenv( "HOME" );
+
+#if defined SYSTEM_MACOSX
+
+	if( home == nullptr || home[0] != '/' )
+		return std::string( );
+
+	std::string cache = std::string( home ) + "/Library/Caches";
+
+#else
+
+	std::string cache;
+	const char *xdg = std::getenv( "XDG_CACHE_HOME" );
+	if( xdg != nullptr && xdg[0] == '/' )
+		cache = xdg;
+	else if( home != nullptr && home[0] == '/' )
+		cache = std::string( home ) + "/.cache";
+	else
+		return std::string( );
+
+#endif
+
+	const std::string directory = cache + "/gm_filesystem";
+	if( !MakeDirectory( cache ) || !MakeDirectory( directory ) )
+		return std::string( );
+
+	return directory;
+}
+
+const char *DirectoryIndex::MapFile( const std::string &fullpath, size_t &length, intptr_t & )
+{
+	const int fd = open( fullpath.c_str( ), O_RDONLY | O_CLOEXEC );
+	if( fd == -1 )
+		return nullptr;
+
+	struct stat stats;
+	if( fstat( fd, &stats ) != 0 || stats.st_size <= 0 )
+	{
+		close( fd );
+		return nullptr;
+	}
+
+	// the mapping outlives the descriptor
+	length = static_cast<size_t>( stats.st_size );
+	void *mapped = mmap( nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	return mapped != MAP_FAILED ? static_cast<const char *>( mapped ) : nullptr;
+}
+
+void DirectoryIndex::UnmapFile( const char *mapped, size_t length, intptr_t )
+{
+	munmap( const_cast<char *>( mapped ), length );
+}
+
+bool DirectoryIndex::SaveFile( const std::string &fullpath, const std::string &contents )
+{
+	// written aside and moved over, the old file might still be mapped by another process
+	const std::string temporary = fullpath + ".tmp";
+	FILE *file = fopen( temporary.c_str( ), "wb" );
+	if( file == nullptr )
+		return false;
+
+	const bool written = fwrite( contents.data( ), 1, contents.size( ), file ) == contents.size( );
+	if( fclose( file ) != 0 || !written || rename( temporary.c_str( ), fullpath.c_str( ) ) != 0 )
+	{
+		unlink( temporary.c_str( ) );
+		return false;
+	}
+
+	return true;
+}
+
+bool DirectoryIndex::GetDirectoryTime( const std::string &fullpath, int64_t &mtime )
+{
+	struct stat stats;
+	if( stat( fullpath.c_str( ), &stats ) != 0 || !S_ISDIR( stats.st_mode ) )
+		return false;
+
+	mtime = stats.st_mtime;
+	return true;
+}
+
+bool DirectoryIndex::ListDirectory( const std::string &fullpath, std::vector<Listed> &listing )
+{
+	DIR *directory = opendir( fullpath.c_str( ) );
+	if( directory == nullptr )
+		return false;
+
+	const int fd = dirfd( directory );
+	for( struct dirent *entry = readdir( directory ); entry != nullptr; entry = readdir( directory ) )
+	{
+		const char *name = entry->d_name;
+		if( name[0] == '.' && ( name[1] == '\0' || ( name[1] == '.' && name[2] == '\0' ) ) )
+			continue;
+
+		// links are described by what they point to, like the engine sees them
+		struct stat stats;
+		if( fstatat( fd, name, &stats, AT_SYMLINK_NOFOLLOW ) != 0 )
+			continue;
+
+		const bool link = S_ISLNK( stats.st_mode );
+		if( link && fstatat( fd, name, &stats, 0 ) != 0 )
+			continue;
+
+		const bool isdir = S_ISDIR( stats.st_mode );
+		listing.push_back( Listed{
+			name,
+			isdir,
+			isdir ? 0 : static_cast<uint64_t>( stats.st_size ),
+			stats.st_mtime,
+			link
+		} );
+	}
+
+	closedir( directory );
+	return true;
+}
+
+bool DirectoryIndex::StatListing( const std::string &fullpath, std::vector<Listed> &listing )
+{
+	const int fd = open( fullpath.c_str( ), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+	if( fd == -1 )
+		return false;
+
+	bool described = true;
+	for( auto it = listing.begin( ); it != listing.end( ); ++it )
+	{
+		struct stat stats;
+		described = fstatat( fd, it->name.c_str( ), &stats, AT_SYMLINK_NOFOLLOW ) == 0;
+		if( !described )
+			break;
+
+		it->link = S_ISLNK( stats.st_mode );
+		described = !it->link || fstatat( fd, it->name.c_str( ), &stats, 0 ) == 0;
+		if( !described )
+			break;
+
+		it->directory = S_ISDIR( stats.st_mode );
+		it->size = it->directory ? 0 : static_cast<uint64_t>( stats.st_size );
+		it->mtime = stats.st_mtime;
+	}
+
+	close( fd );
+	return described;
+}
+
+}
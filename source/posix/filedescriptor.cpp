@@ -0,0 +1,282 @@
+#include "filedescriptor.hpp"
+#include "threadpool.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <new>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace file
+{
+
+static int ParseOptions( const std::string &options )
+{
+	const bool update = options.find( '+' ) != options.npos;
+	switch( options.empty( ) ? '\0' : options[0] )
+	{
+		case 'r':
+			return update ? O_RDWR : O_RDONLY;
+
+		case 'w':
+			return ( update ? O_RDWR : O_WRONLY ) | O_CREAT | O_TRUNC;
+
+		case 'a':
+			return ( update ? O_RDWR : O_WRONLY ) | O_CREAT | O_APPEND;
+
+		default:
+			return -1;
+	}
+}
+
+static void Advise( int fd, AccessHint hint )
+{
+
+#if defined SYSTEM_LINUX
+
+	switch( hint )
+	{
+		case AccessSequential:
+			posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+			break;
+
+		case AccessRandom:
+			posix_fadvise( fd, 0, 0, POSIX_FADV_RANDOM );
+			break;
+
+		case AccessNoReuse:
+			posix_fadvise( fd, 0, 0, POSIX_FADV_NOREUSE );
+			break;
+
+		default:
+			break;
+	}
+
+#elif defined SYSTEM_MACOSX
+
+	switch( hint )
+	{
+		case AccessSequential:
+			fcntl( fd, F_RDAHEAD, 1 );
+			break;
+
+		case AccessRandom:
+			fcntl( fd, F_RDAHEAD, 0 );
+			break;
+
+		case AccessNoReuse:
+			fcntl( fd, F_NOCACHE, 1 );
+			break;
+
+		default:
+			break;
+	}
+
+#endif
+
+}
+
+void PrefetchFile( int fd, int64_t offset, int64_t len )
+{
+	if( len < 0 )
+	{
+		struct stat stats;
+		if( fstat( fd, &stats ) != 0 || stats.st_size <= offset )
+			return;
+
+		len = stats.st_size - offset;
+	}
+
+#if defined SYSTEM_LINUX
+
+	readahead( fd, static_cast<off64_t>( offset ), static_cast<size_t>( len ) );
+
+#elif defined SYSTEM_MACOSX
+
+	struct radvisory advisory;
+	advisory.ra_offset = static_cast<off_t>( offset );
+	advisory.ra_count = static_cast<int>( len > 0x7FFFFFFF ? 0x7FFFFFFF : len );
+	fcntl( fd, F_RDADVISE, &advisory );
+
+#endif
+
+}
+
+Descriptor::Descriptor( int fd, filesystem::ThreadPool &pool ) :
+	descriptor( fd ),
+	eof( false ),
+	error( false ),
+	threadpool( pool )
+{ }
+
+Descriptor::~Descriptor( )
+{
+	Close( );
+}
+
+Descriptor *Descriptor::Open(
+	const std::string &path,
+	const std::string &options,
+	AccessHint hint,
+	filesystem::ThreadPool &pool
+)
+{
+	const int flags = ParseOptions( options );
+	if( flags == -1 )
+		return nullptr;
+
+	const int fd = open( path.c_str( ), flags | O_CLOEXEC, 0644 );
+	if( fd == -1 )
+		return nullptr;
+
+	Advise( fd, hint );
+
+	Descriptor *f = new( std::nothrow ) Descriptor( fd, pool );
+	if( f == nullptr )
+		close( fd );
+
+	return f;
+}
+
+bool Descriptor::Valid( ) const
+{
+	return descriptor != -1;
+}
+
+bool Descriptor::Good( ) const
+{
+	if( !Valid( ) )
+		return true;
+
+	return !error;
+}
+
+bool Descriptor::EndOfFile( ) const
+{
+	if( !Valid( ) )
+		return true;
+
+	return eof;
+}
+
+bool Descriptor::Close( )
+{
+	if( !Valid( ) )
+		return false;
+
+	close( descriptor );
+	descriptor = -1;
+	return true;
+}
+
+int64_t Descriptor::Size( ) const
+{
+	if( !Valid( ) )
+		return -1;
+
+	struct stat stats;
+	if( fstat( descriptor, &stats ) != 0 )
+		return -1;
+
+	return stats.st_size;
+}
+
+int64_t Descriptor::Tell( ) const
+{
+	if( !Valid( ) )
+		return -1;
+
+	return lseek( descriptor, 0, SEEK_CUR );
+}
+
+bool Descriptor::Seek( int64_t pos, SeekDirection dir )
+{
+	if( !Valid( ) )
+		return false;
+
+	static const int whence[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+	if( lseek( descriptor, static_cast<off_t>( pos ), whence[dir] ) == -1 )
+		return false;
+
+	eof = false;
+	return true;
+}
+
+bool Descriptor::Flush( )
+{
+	return Valid( );
+}
+
+size_t Descriptor::Read( void *buffer, size_t len )
+{
+	if( !Valid( ) )
+		return 0;
+
+	size_t total = 0;
+	while( total < len )
+	{
+		const ssize_t done = read( descriptor, static_cast<char *>( buffer ) + total, len - total );
+		if( done == -1 && errno == EINTR )
+			continue;
+
+		if( done <= 0 )
+		{
+			eof = done == 0;
+			error = done == -1;
+			break;
+		}
+
+		total += static_cast<size_t>( done );
+	}
+
+	return total;
+}
+
+size_t Descriptor::Write( const void *buffer, size_t len )
+{
+	if( !Valid( ) )
+		return 0;
+
+	size_t total = 0;
+	while( total < len )
+	{
+		const ssize_t done = write( descriptor, static_cast<const char *>( buffer ) + total, len - total );
+		if( done == -1 && errno == EINTR )
+			continue;
+
+		if( done <= 0 )
+		{
+			error = true;
+			break;
+		}
+
+		total += static_cast<size_t>( done );
+	}
+
+	return total;
+}
+
+bool Descriptor::Prefetch( int64_t offset, int64_t len )
+{
+	if( !Valid( ) || offset < 0 )
+		return false;
+
+	// the handle might be closed before the worker gets to it
+	const int fd = fcntl( descriptor, F_DUPFD_CLOEXEC, 0 );
+	if( fd == -1 )
+		return false;
+
+	const bool posted = threadpool.Post( [fd, offset, len]
+	{
+		PrefetchFile( fd, offset, len );
+		close( fd );
+	} );
+	if( !posted )
+		close( fd );
+
+	return posted;
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "filebase.hpp"
+
+#include <string>
+
+namespace filesystem
+{
+
+class ThreadPool;
+
+}
+
+namespace file
+{
+
+// Loose file opened directly with open(2), used when the caller gives access hints
+// that need to be applied to the descriptor doing the reads.
+class Descriptor : public Base
+{
+public:
+	Descriptor( int fd, filesystem::ThreadPool &pool );
+	~Descriptor( );
+
+	static Descriptor *Open(
+		const std::string &path,
+		const std::string &options,
+		AccessHint hint,
+		filesystem::ThreadPool &pool
+	);
+
+	bool Valid( ) const;
+	bool Good( ) const;
+	bool EndOfFile( ) const;
+
+	bool Close( );
+
+	int64_t Size( ) const;
+	int64_t Tell( ) const;
+	bool Seek( int64_t pos, SeekDirection dir );
+
+	bool Flush( );
+
+	size_t Read( void *buffer, size_t len );
+	size_t Write( const void *buffer, size_t len );
+
+	bool Prefetch( int64_t offset, int64_t len );
+
+private:
+	int descriptor;
+	bool eof;
+	bool error;
+	filesystem::ThreadPool &threadpool;
+};
+
+// reads the range into the page cache, blocks so it's meant to be run from a worker thread
+void PrefetchFile( int fd, int64_t offset, int64_t len );
+
+}
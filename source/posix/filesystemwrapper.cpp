@@ -1,5 +1,7 @@
 #include "filesystemwrapper.hpp"
 #include "filevalve.hpp"
+#include "filememory.hpp"
+#include "filedescriptor.hpp"
 
 #include <filesystem_base.h>
 
@@ -8,13 +10,70 @@
 #include <algorithm>
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <dirent.h>
 
 namespace filesystem
 {
 
-const size_t Wrapper::max_tempbuffer_len = 2048;
-const std::unordered_set<std::string> Wrapper::whitelist_extensions = {
+static bool StatFile( const char *fullpath, FileInfo &info )
+{
+
+#if defined SYSTEM_LINUX && defined STATX_BASIC_STATS
+
+	struct statx stats;
+	if( statx(
+		AT_FDCWD,
+		fullpath,
+		AT_STATX_SYNC_AS_STAT,
+		STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_CTIME | STATX_ATIME | STATX_BTIME,
+		&stats
+	) != 0 )
+		return false;
+
+	info.size = stats.stx_size;
+	info.mtime = stats.stx_mtime.tv_sec;
+	info.ctime = stats.stx_ctime.tv_sec;
+	info.atime = stats.stx_atime.tv_sec;
+	info.btime = ( stats.stx_mask & STATX_BTIME ) != 0 ? stats.stx_btime.tv_sec : 0;
+	info.directory = S_ISDIR( stats.stx_mode );
+
+#else
+
+	struct stat stats;
+	if( stat( fullpath, &stats ) != 0 )
+		return false;
+
+	info.size = static_cast<uint64_t>( stats.st_size );
+	info.mtime = stats.st_mtime;
+	info.ctime = stats.st_ctime;
+	info.atime = stats.st_atime;
+
+#if defined SYSTEM_MACOSX
+
+	info.btime = stats.st_birthtimespec.tv_sec;
+
+#else
+
+	info.btime = 0;
+
+#endif
+
+	info.directory = S_ISDIR( stats.st_mode );
+
+#endif
+
+	if( info.directory )
+		info.size = 0;
+
+	info.packed = false;
+	return true;
+}
+
+const size_t Wrapper::max_tempbuffer_len;
+const size_t Wrapper::max_pathid_len;
+const std::vector<const char *> Wrapper::whitelist_extensions = {
 	// garry's mod
 	"lua", "gma", "cache",
 	// data
@@ -32,7 +91,7 @@ const std::unordered_set<std::string> Wrapper::whitelist_extensions = {
 	// assorted
 	"tmp", "md", "db", "inf"
 };
-const std::unordered_set<std::string> Wrapper::whitelist_pathid[] = {
+const std::vector<const char *> Wrapper::whitelist_pathid[] = {
 	{
 		"data", "download", "lua", "lcl", "lsv", "game", "garrysmod", "gamebin", "mod",
 		"base_path", "executable_path", "default_write_path"
@@ -43,7 +102,10 @@ const std::unordered_set<std::string> Wrapper::whitelist_pathid[] = {
 std::unordered_map<std::string, std::string> Wrapper::whitelist_writepaths;
 
 Wrapper::Wrapper( ) :
-	filesystem( nullptr )
+	filesystem( nullptr ),
+	references( 0 ),
+	snapshot_generation( 0 ),
+	observed_generation( 0 )
 { }
 
 Wrapper::~Wrapper( )
@@ -51,7 +113,10 @@ Wrapper::~Wrapper( )
 
 bool Wrapper::Initialize( CBaseFileSystem *fsinterface )
 {
+	WriteLock guard( searchpaths_lock );
+
 	filesystem = fsinterface;
+	main_thread = std::this_thread::get_id( );
 
 	{
 		char fullpath[max_tempbuffer_len] = { 0 };
@@ -66,10 +131,10 @@ bool Wrapper::Initialize( CBaseFileSystem *fsinterface )
 	if( whitelist_writepaths.empty( ) )
 	{
 		char searchpath[max_tempbuffer_len] = { 0 };
-		const std::unordered_set<std::string> &whitelist = whitelist_pathid[static_cast<size_t>( WhitelistType::Write )];
+		const std::vector<const char *> &whitelist = whitelist_pathid[static_cast<size_t>( WhitelistType::Write )];
 		for( auto it = whitelist.begin( ); it != whitelist.end( ); ++it )
 		{
-			int32_t len = filesystem->GetSearchPath_safe( it->c_str( ), false, searchpath ) - 1;
+			int32_t len = filesystem->GetSearchPath_safe( *it, false, searchpath ) - 1;
 			if( len <= 0 )
 				return false;
 
@@ -77,125 +142,350 @@ bool Wrapper::Initialize( CBaseFileSystem *fsinterface )
 		}
 	}
 
+	cache.GetHandleCache( ).Initialize( filesystem );
+
+	if( references++ == 0 )
+		threadpool.Start( );
+
+	cache.SetReferences( references );
+
 	return true;
 }
 
-file::Base *Wrapper::Open( const std::string &fpath, const std::string &opts, const std::string &pid )
+file::Base *Wrapper::Open(
+	const StringRef &fpath,
+	const StringRef &opts,
+	const StringRef &pid,
+	file::AccessHint hint
+)
 {
-	std::string filepath = fpath, options = opts, pathid = pid;
+	std::string options( opts.c_str( ), opts.size( ) );
+
+	ReadLock guard( searchpaths_lock );
 
 	std::transform( options.begin( ), options.end( ), options.begin( ), tolower );
 	WhitelistType wtype = options.find_first_of( "wa+" ) != options.npos ?
 		WhitelistType::Write : WhitelistType::Read;
 
+	PathIDBuffer pathidbuffer;
+	PathBuffer filepathbuffer;
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, wtype ) ||
-		!FixupFilePath( filepath, pathid ) ||
-		!VerifyFilePath( filepath, false, nonascii ) ||
-		!VerifyExtension( filepath, wtype ) )
+	if( !IsPathIDAllowed( pid, pathidbuffer, wtype ) ||
+		!IsPathAllowed( fpath, filepathbuffer, pathidbuffer.Get( ), wtype, nonascii ) )
 		return nullptr;
 
-	FileHandle_t fh = filesystem->Open( filepath.c_str( ), options.c_str( ), pathid.c_str( ) );
+	const StringRef filepath = filepathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	const PathKey key( filepath, pathid );
+	if( wtype == WhitelistType::Write )
+	{
+		cache.Invalidate( key.ToString( ) );
+		cache.GetLookupFilter( ).Add( pathid.ToString( ), filepath.ToString( ) );
+	}
+	else
+	{
+		std::shared_ptr<const std::string> contents = cache.GetContents( key );
+		if( contents )
+			return new( std::nothrow ) file::Memory( std::move( contents ) );
+	}
+
+	// hints only make sense on our own descriptors, packed files and loose files behind a pack go
+	// through the engine as usual
+	if( hint != file::AccessNormal )
+	{
+		const std::string path = filepath.ToString( ), id = pathid.ToString( );
+		const std::string fullpath = wtype == WhitelistType::Read ?
+			ResolveLeadingPath( path, id ) : GetPath( path, id, wtype );
+		if( !fullpath.empty( ) )
+		{
+			file::Base *f = file::Descriptor::Open( fullpath, options, hint, threadpool );
+			if( f != nullptr )
+			{
+				if( wtype == WhitelistType::Write )
+					return JournalWrites( f, path, id, options );
+
+				return f;
+			}
+		}
+	}
+
+	if( wtype == WhitelistType::Write )
+	{
+		FileHandle_t fh = filesystem->Open( filepath.c_str( ), options.c_str( ), pathid.c_str( ) );
+		if( fh == nullptr )
+			return nullptr;
+
+		file::Base *f = new( std::nothrow ) file::Valve( filesystem, fh );
+		if( f == nullptr )
+		{
+			filesystem->Close( fh );
+			return nullptr;
+		}
+
+		return JournalWrites( f, filepath.ToString( ), pathid.ToString( ), options );
+	}
+
+	HandleCache &handlecache = cache.GetHandleCache( );
+	long mtime = 0;
+	FileHandle_t fh = nullptr;
+	std::string cachekey;
+	if( handlecache.GetCapacity( ) != 0 )
+	{
+		mtime = GetHandleTime( filepath, pathid, nonascii );
+		fh = handlecache.Acquire( key, options, mtime, cachekey );
+	}
+
+	if( fh == nullptr )
+		fh = filesystem->Open( filepath.c_str( ), options.c_str( ), pathid.c_str( ) );
+
 	if( fh == nullptr )
 		return nullptr;
 
-	file::Base *f = new( std::nothrow ) file::Valve( filesystem, fh );
+	// a reused handle brings its key back with it, only new ones need it built
+	if( cachekey.empty( ) )
+		cachekey = key.ToString( );
+
+	file::Base *f = new( std::nothrow ) file::Valve( filesystem, fh, &handlecache, std::move( cachekey ), options, mtime );
 	if( f == nullptr )
 		filesystem->Close( fh );
 
 	return f;
 }
 
-bool Wrapper::Exists( const std::string &p, const std::string &pid ) const
+bool Wrapper::Prefetch( const std::string &fpath, const std::string &pid )
 {
-	std::string path = p, pathid = pid;
+	std::string filepath = fpath, pathid = pid;
+
+	ReadLock guard( searchpaths_lock );
 
 	bool nonascii = false;
 	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
-		!IsPathAllowed( path, pathid, WhitelistType::Read, nonascii ) )
+		!IsPathAllowed( filepath, pathid, WhitelistType::Read, nonascii ) )
+		return false;
+
+	// whatever the engine reads from a pack can't be prefetched from here
+	const std::string fullpath = ResolveLeadingPath( filepath, pathid );
+	if( fullpath.empty( ) )
+		return false;
+
+	return threadpool.Post( [fullpath]
+	{
+		const int fd = open( fullpath.c_str( ), O_RDONLY | O_CLOEXEC );
+		if( fd == -1 )
+			return;
+
+		file::PrefetchFile( fd, 0, -1 );
+		close( fd );
+	} );
+}
+
+bool Wrapper::Exists( const StringRef &p, const StringRef &pid ) const
+{
+	ReadLock guard( searchpaths_lock );
+
+	PathIDBuffer pathidbuffer;
+	PathBuffer pathbuffer;
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pid, pathidbuffer, WhitelistType::Read ) ||
+		!IsPathAllowed( p, pathbuffer, pathidbuffer.Get( ), WhitelistType::Read, nonascii ) )
+		return false;
+
+	// validated paths usually come out as they went in, those are used without copying them
+	const StringRef path = pathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	if( !MayExist( path, pathid ) )
 		return false;
 
+	bool exists = false;
+	FileInfo info;
+	if( GetMetadata( path, pathid, nonascii, exists, info ) )
+		return exists;
+
 	return filesystem->FileExists( path.c_str( ), pathid.c_str( ) );
 }
 
-bool Wrapper::IsDirectory( const std::string &p, const std::string &pid ) const
+bool Wrapper::IsDirectory( const StringRef &p, const StringRef &pid ) const
 {
-	std::string path = p, pathid = pid;
+	ReadLock guard( searchpaths_lock );
 
+	PathIDBuffer pathidbuffer;
+	PathBuffer pathbuffer;
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
-		!IsPathAllowed( path, pathid, WhitelistType::Read, nonascii ) )
+	if( !IsPathIDAllowed( pid, pathidbuffer, WhitelistType::Read ) ||
+		!IsPathAllowed( p, pathbuffer, pathidbuffer.Get( ), WhitelistType::Read, nonascii ) )
+		return false;
+
+	const StringRef path = pathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	if( !MayExist( path, pathid ) )
 		return false;
 
+	bool exists = false;
+	FileInfo info;
+	if( GetMetadata( path, pathid, nonascii, exists, info ) )
+		return exists && info.directory;
+
 	return filesystem->IsDirectory( path.c_str( ), pathid.c_str( ) );
 }
 
-uint64_t Wrapper::GetSize( const std::string &fpath, const std::string &pid ) const
+uint64_t Wrapper::GetSize( const StringRef &fpath, const StringRef &pid ) const
 {
-	std::string filepath = fpath, pathid = pid;
+	ReadLock guard( searchpaths_lock );
 
+	PathIDBuffer pathidbuffer;
+	PathBuffer filepathbuffer;
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
-		!IsPathAllowed( filepath, pathid, WhitelistType::Read, nonascii ) )
+	if( !IsPathIDAllowed( pid, pathidbuffer, WhitelistType::Read ) ||
+		!IsPathAllowed( fpath, filepathbuffer, pathidbuffer.Get( ), WhitelistType::Read, nonascii ) )
 		return 0;
 
+	const StringRef filepath = filepathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	bool exists = false;
+	FileInfo info;
+	if( GetMetadata( filepath, pathid, nonascii, exists, info ) )
+		return exists ? info.size : 0;
+
 	return filesystem->Size( filepath.c_str( ), pathid.c_str( ) );
 }
 
-uint64_t Wrapper::GetTime( const std::string &p, const std::string &pid ) const
+uint64_t Wrapper::GetTime( const StringRef &p, const StringRef &pid ) const
 {
-	std::string path = p, pathid = pid;
+	ReadLock guard( searchpaths_lock );
 
+	PathIDBuffer pathidbuffer;
+	PathBuffer pathbuffer;
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
-		!IsPathAllowed( path, pathid, WhitelistType::Read, nonascii ) )
+	if( !IsPathIDAllowed( pid, pathidbuffer, WhitelistType::Read ) ||
+		!IsPathAllowed( p, pathbuffer, pathidbuffer.Get( ), WhitelistType::Read, nonascii ) )
 		return false;
 
+	const StringRef path = pathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	bool exists = false;
+	FileInfo info;
+	if( GetMetadata( path, pathid, nonascii, exists, info ) )
+		return exists ? static_cast<uint64_t>( info.mtime ) : 0;
+
 	return filesystem->GetPathTime( path.c_str( ), pathid.c_str( ) );
 }
 
+bool Wrapper::Stat( const StringRef &p, const StringRef &pid, FileInfo &info ) const
+{
+	ReadLock guard( searchpaths_lock );
+
+	PathIDBuffer pathidbuffer;
+	PathBuffer pathbuffer;
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pid, pathidbuffer, WhitelistType::Read ) ||
+		!IsPathAllowed( p, pathbuffer, pathidbuffer.Get( ), WhitelistType::Read, nonascii ) )
+		return false;
+
+	const StringRef path = pathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	bool exists = false;
+	if( GetMetadata( path, pathid, nonascii, exists, info ) )
+		return exists;
+
+	return ResolveInfo( path, pathid, nonascii, info );
+}
+
+bool Wrapper::ResolveInfo( const StringRef &path, const StringRef &pathid, bool nonascii, FileInfo &info ) const
+{
+	char fullpath[max_tempbuffer_len] = { 0 };
+	PathTypeQuery_t pathtype = PATH_IS_NORMAL;
+	const char *resolved = filesystem->RelativePathToFullPath(
+		path.c_str( ),
+		pathid.c_str( ),
+		fullpath,
+		sizeof( fullpath ),
+		FILTER_NONE,
+		&pathtype
+	);
+
+	info.searchpath.reset( );
+	if( resolved != nullptr )
+	{
+		const size_t len = std::strlen( fullpath );
+		if( len >= path.size( ) && std::strcmp( fullpath + len - path.size( ), path.c_str( ) ) == 0 )
+			info.searchpath = std::make_shared<const std::string>( fullpath, len - path.size( ) );
+		else
+			info.searchpath = std::make_shared<const std::string>( fullpath );
+
+		if( ( pathtype & ( PATH_IS_PACKFILE | PATH_IS_MAPPACKFILE ) ) == 0 && StatFile( fullpath, info ) )
+			return true;
+	}
+
+	return StatPacked( path, pathid, info );
+}
+
 bool Wrapper::Rename( const std::string &pold, const std::string &pnew, const std::string &pid )
 {
 	std::string pathold = pold, pathnew = pnew, pathid = pid;
 
+	ReadLock guard( searchpaths_lock );
+
 	bool nonascii = false;
 	if( !IsPathIDAllowed( pathid, WhitelistType::Write ) ||
 		!IsPathAllowed( pathold, pathid, WhitelistType::Write, nonascii ) ||
 		!IsPathAllowed( pathnew, pathid, WhitelistType::Write, nonascii ) )
 		return false;
 
+	const std::string keyold = SharedCache::MakeKey( pathold, pathid ),
+		keynew = SharedCache::MakeKey( pathnew, pathid );
+	cache.Invalidate( keyold );
+	cache.Invalidate( keynew );
+	cache.GetMetadataCache( ).InvalidateTree( keyold );
+	cache.GetMetadataCache( ).InvalidateTree( keynew );
+	cache.GetLookupFilter( ).Add( pathid, pathnew );
+
 	if( filesystem->IsDirectory( pathold.c_str( ), pathid.c_str( ) ) )
 	{
 		char fullpathold[max_tempbuffer_len] = { 0 };
 		filesystem->RelativePathToFullPath_safe( pathold.c_str( ), pathid.c_str( ), fullpathold );
 		char fullpathnew[max_tempbuffer_len] = { 0 };
 		filesystem->RelativePathToFullPath_safe( pathnew.c_str( ), pathid.c_str( ), fullpathnew );
-		return rename( fullpathold, fullpathnew ) == 0;
+		return Journal(
+			rename( fullpathold, fullpathnew ) == 0,
+			ChangeJournal::Operation::Rename, pathold, pathid, pathnew
+		);
 	}
 
-	return filesystem->RenameFile( pathold.c_str( ), pathnew.c_str( ), pathid.c_str( ) );
+	return Journal(
+		filesystem->RenameFile( pathold.c_str( ), pathnew.c_str( ), pathid.c_str( ) ),
+		ChangeJournal::Operation::Rename, pathold, pathid, pathnew
+	);
 }
 
 bool Wrapper::Remove( const std::string &p, const std::string &pid )
 {
 	std::string path = p, pathid = pid;
+
+	ReadLock guard( searchpaths_lock );
 	
 	bool nonascii = false;
 	if( !IsPathIDAllowed( pathid, WhitelistType::Write ) ||
 		!IsPathAllowed( path, pathid, WhitelistType::Write, nonascii ) )
 		return false;
 
+	const std::string key = SharedCache::MakeKey( path, pathid );
+	cache.Invalidate( key );
+	cache.GetMetadataCache( ).InvalidateTree( key );
+
 	if( filesystem->IsDirectory( path.c_str( ), pathid.c_str( ) ) )
 	{
 		char fullpath[max_tempbuffer_len] = { 0 };
 		filesystem->RelativePathToFullPath( path.c_str( ), pathid.c_str( ), fullpath, sizeof( fullpath ) );
-		return rmdir( fullpath ) == 0;
+		return Journal( rmdir( fullpath ) == 0, ChangeJournal::Operation::Remove, path, pathid );
 	}
 
 	if( filesystem->FileExists( path.c_str( ), pathid.c_str( ) ) )
 	{
 		filesystem->RemoveFile( path.c_str( ), pathid.c_str( ) );
-		return !filesystem->FileExists( path.c_str( ), pathid.c_str( ) );
+		return Journal(
+			!filesystem->FileExists( path.c_str( ), pathid.c_str( ) ),
+			ChangeJournal::Operation::Remove, path, pathid
+		);
 	}
 
 	return false;
@@ -205,92 +495,69 @@ bool Wrapper::MakeDirectory( const std::string &p, const std::string &pid )
 {
 	std::string path = p, pathid = pid;
 
+	ReadLock guard( searchpaths_lock );
+
 	bool nonascii = false;
 	if( !IsPathIDAllowed( pathid, WhitelistType::Write ) ||
 		!IsPathAllowed( path, pathid, WhitelistType::Write, nonascii ) )
 		return false;
 
+	cache.InvalidateTree( SharedCache::MakeKey( path, pathid ) );
+	cache.GetLookupFilter( ).Add( pathid, path );
+
 	filesystem->CreateDirHierarchy( path.c_str( ), pathid.c_str( ) );
-	return filesystem->IsDirectory( path.c_str( ), pathid.c_str( ) );
+	return Journal(
+		filesystem->IsDirectory( path.c_str( ), pathid.c_str( ) ),
+		ChangeJournal::Operation::MakeDirectory, path, pathid
+	);
 }
 
-std::pair<std::set<std::string>, std::set<std::string>> Wrapper::Find(
-	const std::string &p,
-	const std::string &pid
-) const
+void Wrapper::FillFindMetadata( const std::string &pattern, const std::string &pathid, FindResults &results ) const
 {
-	std::string filename = p, pathid = pid;
+	const std::string prefix = GetPatternDirectory( pattern );
+	std::vector<FindEntry *> pending = GetFindEntries( results );
 
-	std::set<std::string> files, directories;
+	// one open directory per search path, entries are stated relative to it
+	const std::vector<std::string> searchpaths = GetLooseSearchPaths( pathid );
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ) && !pending.empty( ); ++it )
+	{
+		const std::string directory = *it + prefix;
+		const int fd = open( directory.c_str( ), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+		if( fd == -1 )
+			continue;
 
-	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
-		!IsPathAllowed( filename, pathid, WhitelistType::Read, nonascii, true ) )
-		return std::make_pair( files, directories );
+		auto out = pending.begin( );
+		for( auto entry = pending.begin( ); entry != pending.end( ); ++entry )
+		{
+			FindEntry &current = **entry;
+			struct stat stats;
+			if( fstatat( fd, current.name.c_str( ), &stats, 0 ) != 0 ||
+				S_ISDIR( stats.st_mode ) != current.directory )
+			{
+				*out++ = *entry;
+				continue;
+			}
 
-	FileFindHandle_t handle = FILESYSTEM_INVALID_FIND_HANDLE;
-	const char *path = filesystem->FindFirstEx( filename.c_str( ), pathid.c_str( ), &handle );
-	while( path != nullptr )
-	{
-		if( filesystem->FindIsDirectory( handle ) )
-			directories.insert( path );
-		else
-			files.insert( path );
+			current.size = current.directory ? 0 : static_cast<uint64_t>( stats.st_size );
+			current.mtime = stats.st_mtime;
+		}
 
-		path = filesystem->FindNext( handle );
+		pending.erase( out, pending.end( ) );
+		close( fd );
 	}
 
-	filesystem->FindClose( handle );
-	return std::make_pair( files, directories );
+	FillPackedMetadata( prefix, pathid, pending );
 }
 
-std::unordered_map<std::string, std::set<std::string>> Wrapper::GetSearchPaths( ) const
+Finder *Wrapper::OpenFinder( const std::string &pattern, const std::string &pathid ) const
 {
-	std::unordered_map<std::string, std::set<std::string>> searchpaths;
-
-	const CUtlLinkedList<CBaseFileSystem::CSearchPath> &m_SearchPaths = filesystem->m_SearchPaths;
-	for( uint16_t k = 0; k < m_SearchPaths.Count( ); ++k )
-	{
-		const CBaseFileSystem::CSearchPath &searchpath = m_SearchPaths[k];
-		const CBaseFileSystem::CPathIDInfo *pathIDInfo = searchpath.m_pPathIDInfo;
-		if( searchpath.m_pDebugPath == nullptr ||
-			pathIDInfo == nullptr ||
-			pathIDInfo->m_pDebugPathID == nullptr )
-			continue;
-
-		const auto packFile = searchpath.m_pPackFile;
-		const auto packFile2 = searchpath.m_pPackFile2;
-		if( packFile != nullptr )
-			searchpaths[pathIDInfo->m_pDebugPathID].insert( packFile->m_ZipName.Get( ) );
-		else if( packFile2 != nullptr )
-			searchpaths[pathIDInfo->m_pDebugPathID].insert( packFile2->m_pszFullPathName );
-		else
-			searchpaths[pathIDInfo->m_pDebugPathID].insert( searchpath.m_pDebugPath );
-	}
-
-	return searchpaths;
+	return new( std::nothrow ) EngineFinder( filesystem, pattern, pathid );
 }
 
 std::set<std::string> Wrapper::GetSearchPaths( const std::string &pathid ) const
 {
-	std::set<std::string> searchpaths;
-
-	char paths[max_tempbuffer_len] = { 0 };
-	const int32_t len = filesystem->GetSearchPath_safe( pathid.c_str( ), true, paths ) - 1;
-	if( len <= 0 )
-		return searchpaths;
-
-	char *start = paths, *end = paths + len, *pos = std::find( start, end, ';' );
-	for( ; pos != end; start = ++pos, pos = std::find( start, end, ';' ) )
-	{
-		*pos = '\0';
-		searchpaths.insert( start );
-	}
-
-	if( start != end )
-		searchpaths.insert( start );
-
-	return searchpaths;
+	ReadLock guard( searchpaths_lock );
+	return CollectSearchPaths( pathid );
 }
 
 bool Wrapper::AddSearchPath( const std::string &p, const std::string &pid )
@@ -298,13 +565,24 @@ bool Wrapper::AddSearchPath( const std::string &p, const std::string &pid )
 	std::string directory = p, pathid = pid;
 
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::SearchPath ) ||
-		!FixupFilePath( directory, "DEFAULT_WRITE_PATH" ) ||
-		!VerifyFilePath( directory, false, nonascii ) )
-		return false;
+	{
+		ReadLock guard( searchpaths_lock );
+
+		if( !IsPathIDAllowed( pathid, WhitelistType::SearchPath ) ||
+			!FixupFilePath( directory, "DEFAULT_WRITE_PATH" ) ||
+			!VerifyFilePath( directory, false, nonascii ) )
+			return false;
+	}
 
+	journal.Record( ChangeJournal::Operation::AddSearchPath, directory, pathid );
 	directory.insert( 0, garrysmod_fullpath );
+
+	WriteLock guard( searchpaths_lock );
 	filesystem->AddSearchPath( directory.c_str( ), pathid.c_str( ), PATH_ADD_TO_TAIL );
+	// cached files might not belong to the search path that wins the lookup anymore
+	cache.InvalidateSearchPaths( );
+	ExtendIndex( pathid );
+	RecordSearchPaths( );
 	return true;
 }
 
@@ -313,81 +591,136 @@ bool Wrapper::RemoveSearchPath( const std::string &p, const std::string &pid )
 	std::string directory = p, pathid = pid;
 
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::SearchPath ) ||
-		!FixupFilePath( directory, "DEFAULT_WRITE_PATH" ) ||
-		!VerifyFilePath( directory, false, nonascii ) )
-		return false;
+	{
+		ReadLock guard( searchpaths_lock );
+
+		if( !IsPathIDAllowed( pathid, WhitelistType::SearchPath ) ||
+			!FixupFilePath( directory, "DEFAULT_WRITE_PATH" ) ||
+			!VerifyFilePath( directory, false, nonascii ) )
+			return false;
+	}
 
+	const std::string relative = directory;
 	directory.insert( 0, garrysmod_fullpath );
-	return filesystem->RemoveSearchPath( directory.c_str( ), pathid.c_str( ) );
+
+	WriteLock guard( searchpaths_lock );
+	cache.InvalidateSearchPaths( );
+	const bool removed = filesystem->RemoveSearchPath( directory.c_str( ), pathid.c_str( ) );
+	ExtendIndex( pathid );
+	RecordSearchPaths( );
+	return Journal( removed, ChangeJournal::Operation::RemoveSearchPath, relative, pathid );
 }
 
-bool Wrapper::IsPathIDAllowed( std::string &pathid, WhitelistType whitelist_type ) const
+bool Wrapper::IsPathIDAllowed( const StringRef &input, PathIDBuffer &pathid, WhitelistType whitelist_type ) const
 {
-	if( pathid.empty( ) )
+	// IDs of max_pathid_len characters or more can't be on the whitelist anyway
+	if( input.empty( ) || !pathid.Assign( input ) )
 		return false;
 
-	std::transform( pathid.begin( ), pathid.end( ), pathid.begin( ), tolower );
-	const auto &whitelist = whitelist_pathid[static_cast<size_t>( whitelist_type )];
-	return whitelist.find( pathid ) != whitelist.end( );
+	char *buffer = pathid.GetBuffer( );
+	std::transform( buffer, buffer + pathid.GetLength( ), buffer, tolower );
+	return IsListed( whitelist_pathid[static_cast<size_t>( whitelist_type )], buffer );
 }
 
-bool Wrapper::FixupFilePath( std::string &filepath, const std::string &pathid ) const
+bool Wrapper::FixupFilePath( const StringRef &input, PathBuffer &filepath, const char *pathid ) const
 {
-	if( filepath.empty( ) )
+	if( input.empty( ) )
 		return false;
 
-	if( V_IsAbsolutePath( filepath.c_str( ) ) )
+	if( V_IsAbsolutePath( input.c_str( ) ) )
 	{
-		const std::string tpath = filepath;
-		filepath.resize( max_tempbuffer_len );
-		if( !filesystem->FullPathToRelativePathEx( tpath.c_str( ), pathid.c_str( ), &filepath[0], filepath.size( ) ) )
+		if( !filesystem->FullPathToRelativePathEx( input.c_str( ), pathid, filepath.GetBuffer( ), filepath.GetCapacity( ) ) )
 			return false;
 
-		if( filepath.compare( 0, 3, ".." CORRECT_PATH_SEPARATOR_S ) == 0 )
+		if( std::strncmp( filepath.Get( ), ".." CORRECT_PATH_SEPARATOR_S, 3 ) == 0 )
 			return false;
 	}
-	else if( !V_RemoveDotSlashes( &filepath[0] ) )
+	// relative paths of max_tempbuffer_len characters or more wouldn't fit in their full paths
+	else if( !filepath.Assign( input ) || !V_RemoveDotSlashes( filepath.GetBuffer( ) ) )
 	{
 		return false;
 	}
 
-	filepath.resize( std::strlen( filepath.c_str( ) ) );
+	filepath.Update( );
 	return true;
 }
 
 
-bool Wrapper::VerifyFilePath( const std::string &filepath, bool find, bool &nonascii ) const
+bool Wrapper::VerifyFilePath( const char *filepath, size_t length, bool find, bool &nonascii ) const
 {
 	nonascii = false;
 	return true;
 }
 
-bool Wrapper::VerifyExtension( const std::string &filepath, WhitelistType whitelist_type ) const
+bool Wrapper::VerifyExtension( const char *filepath, WhitelistType whitelist_type ) const
 {
-	const char *extension = V_GetFileExtension( filepath.c_str( ) );
+	const char *extension = V_GetFileExtension( filepath );
 	if( whitelist_type == WhitelistType::Write && extension != nullptr )
 	{
-		std::string ext = extension;
-		std::transform( ext.begin( ), ext.end( ), ext.begin( ), tolower );
-		if( whitelist_extensions.find( extension ) == whitelist_extensions.end( ) )
+		// matched regardless of case like on Windows, the whitelist is lowercase and no entry
+		// is anywhere near as long as the buffer
+		char ext[16] = { 0 };
+		const size_t len = std::strlen( extension );
+		if( len >= sizeof( ext ) )
+			return false;
+
+		std::transform( extension, extension + len, ext, tolower );
+		if( !IsListed( whitelist_extensions, ext ) )
 			return false;
 	}
 
 	return true;
 }
 
-bool Wrapper::IsPathAllowed(
-	std::string &filepath,
-	std::string &pathid,
-	WhitelistType whitelist_type,
-	bool &nonascii,
-	bool find
-) const
+bool Wrapper::IsDirectoryPath( const std::string &fullpath )
+{
+	struct stat stats;
+	return stat( fullpath.c_str( ), &stats ) == 0 && S_ISDIR( stats.st_mode );
+}
+
+bool Wrapper::PathExists( const StringRef &fullpath )
+{
+	struct stat stats;
+	return stat( fullpath.c_str( ), &stats ) == 0;
+}
+
+bool Wrapper::StatPath( const std::string &fullpath, FileInfo &info )
+{
+	return StatFile( fullpath.c_str( ), info );
+}
+
+bool Wrapper::ListDirectory(
+	const std::string &fullpath,
+	std::vector<std::string> &files,
+	std::vector<std::string> &directories
+)
 {
-	return FixupFilePath( filepath, pathid ) &&
-		VerifyFilePath( filepath, find, nonascii ) &&
-		VerifyExtension( filepath, whitelist_type );
+	DIR *dir = opendir( fullpath.c_str( ) );
+	if( dir == nullptr )
+		return false;
+
+	const int fd = dirfd( dir );
+	for( const struct dirent *entry = readdir( dir ); entry != nullptr; entry = readdir( dir ) )
+	{
+		if( std::strcmp( entry->d_name, "." ) == 0 || std::strcmp( entry->d_name, ".." ) == 0 )
+			continue;
+
+		bool directory = entry->d_type == DT_DIR;
+		if( entry->d_type == DT_UNKNOWN )
+		{
+			// symbolic links to directories are listed as files so callers never recurse into loops
+			struct stat stats;
+			directory = fstatat( fd, entry->d_name, &stats, AT_SYMLINK_NOFOLLOW ) == 0 && S_ISDIR( stats.st_mode );
+		}
+
+		if( directory )
+			directories.push_back( entry->d_name );
+		else
+			files.push_back( entry->d_name );
+	}
+
+	closedir( dir );
+	return true;
 }
 
 std::string Wrapper::GetPath(
@@ -396,26 +729,11 @@ std::string Wrapper::GetPath(
 	WhitelistType wtype
 ) const
 {
-	char fullpath[max_tempbuffer_len] = { 0 };
 	if( wtype == WhitelistType::Read )
-	{
-		bool notfound = true;
-		const std::set<std::string> searchpaths = GetSearchPaths( pathid );
-		for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
-		{
-			V_ComposeFileName( it->c_str( ), filepath.c_str( ), fullpath, sizeof( fullpath ) );
-			struct stat stats;
-			if( stat( filepath.c_str( ), &stats ) != -1 )
-			{
-				notfound = false;
-				break;
-			}
-		}
+		return ResolvePath( filepath, pathid );
 
-		if( notfound )
-			return "";
-	}
-	else if( wtype == WhitelistType::Write )
+	char fullpath[max_tempbuffer_len] = { 0 };
+	if( wtype == WhitelistType::Write )
 	{
 		const auto searchpath = whitelist_writepaths.find( pathid );
 		if( searchpath == whitelist_writepaths.end( ) )
@@ -0,0 +1,47 @@
+#include "rwlock.hpp"
+
+namespace filesystem
+{
+
+ReadWriteLock::ReadWriteLock( )
+{
+	pthread_rwlockattr_t attributes;
+	pthread_rwlockattr_init( &attributes );
+
+#if defined SYSTEM_LINUX
+
+	// glibc prefers readers by default, which would let constant lookups starve search path changes
+	pthread_rwlockattr_setkind_np( &attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP );
+
+#endif
+
+	pthread_rwlock_init( &lock, &attributes );
+	pthread_rwlockattr_destroy( &attributes );
+}
+
+ReadWriteLock::~ReadWriteLock( )
+{
+	pthread_rwlock_destroy( &lock );
+}
+
+void ReadWriteLock::LockRead( )
+{
+	pthread_rwlock_rdlock( &lock );
+}
+
+void ReadWriteLock::UnlockRead( )
+{
+	pthread_rwlock_unlock( &lock );
+}
+
+void ReadWriteLock::LockWrite( )
+{
+	pthread_rwlock_wrlock( &lock );
+}
+
+void ReadWriteLock::UnlockWrite( )
+{
+	pthread_rwlock_unlock( &lock );
+}
+
+}
@@ -0,0 +1,340 @@
+#include "treecopier.hpp"
+#include "directorydescriptor.hpp"
+
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined SYSTEM_LINUX
+
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+
+#endif
+
+namespace filesystem
+{
+
+static const size_t copy_buffer_size = 256 * 1024;
+
+#if defined SYSTEM_LINUX && defined SYS_copy_file_range
+
+// returns false only when copy_file_range isn't usable here and nothing was copied yet
+static bool CopyFileRange( int in, int out, uint64_t size, uint64_t &copied, bool &failed )
+{
+	failed = false;
+	while( copied < size )
+	{
+		const long result = syscall( SYS_copy_file_range, in, nullptr, out, nullptr, size - copied, 0u );
+		if( result > 0 )
+		{
+			copied += static_cast<uint64_t>( result );
+			continue;
+		}
+
+		if( result == 0 )
+			return true;
+
+		if( errno == EINTR )
+			continue;
+
+		if( copied == 0 && ( errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP ) )
+			return false;
+
+		failed = true;
+		return true;
+	}
+
+	return true;
+}
+
+#endif
+
+static bool CopyReadWrite( int in, int out, uint64_t &copied )
+{
+	std::vector<char> buffer( copy_buffer_size );
+	while( true )
+	{
+		const ssize_t read = ::read( in, buffer.data( ), buffer.size( ) );
+		if( read == 0 )
+			return true;
+
+		if( read < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+
+			return false;
+		}
+
+		for( ssize_t offset = 0; offset < read; )
+		{
+			const ssize_t written = write( out, buffer.data( ) + offset, static_cast<size_t>( read - offset ) );
+			if( written < 0 )
+			{
+				if( errno == EINTR )
+					continue;
+
+				return false;
+			}
+
+			offset += written;
+		}
+
+		copied += static_cast<uint64_t>( read );
+	}
+}
+
+static std::string MakeTemporaryName( )
+{
+	static std::atomic<uint64_t> counter( 0 );
+	return ".gm_filesystem." + std::to_string( getpid( ) ) + '.' + std::to_string( counter++ ) + ".tmp";
+}
+
+// copies inname below indir to outname below outdir through a temporary file next to the
+// destination, skipped tells links and special files apart from failures
+static bool CopyAt(
+	int indir,
+	const char *inname,
+	int outdir,
+	const char *outname,
+	bool overwrite,
+	uint64_t &bytes,
+	bool &skipped
+)
+{
+	skipped = false;
+
+	// non blocking so a FIFO can't hang the copy, it's skipped right after anyway
+	const int in = openat( indir, inname, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC );
+	if( in == -1 )
+	{
+		skipped = errno == ELOOP;
+		return false;
+	}
+
+	struct stat stats;
+	if( fstat( in, &stats ) != 0 || !S_ISREG( stats.st_mode ) )
+	{
+		skipped = true;
+		close( in );
+		return false;
+	}
+
+	// the rename couldn't lose the file's data anymore, but a file copied over itself is still refused
+	struct stat existing;
+	if( fstatat( outdir, outname, &existing, AT_SYMLINK_NOFOLLOW ) == 0 &&
+		( !overwrite || S_ISDIR( existing.st_mode ) ||
+		( existing.st_dev == stats.st_dev && existing.st_ino == stats.st_ino ) ) )
+	{
+		close( in );
+		return false;
+	}
+
+	const std::string temporary = MakeTemporaryName( );
+	const int out = openat(
+		outdir,
+		temporary.c_str( ),
+		O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+		stats.st_mode & 0777
+	);
+	if( out == -1 )
+	{
+		close( in );
+		return false;
+	}
+
+	uint64_t copied = 0;
+	bool success = false, done = false;
+
+#if defined SYSTEM_LINUX
+
+	const uint64_t size = static_cast<uint64_t>( stats.st_size );
+
+#if defined FICLONE
+
+	// shares the extents on btrfs, XFS and the like, nothing gets copied at all
+	if( ioctl( out, FICLONE, in ) == 0 )
+	{
+		copied = size;
+		success = done = true;
+	}
+
+#endif
+
+#if defined SYS_copy_file_range
+
+	if( !done )
+	{
+		bool failed = false;
+		if( CopyFileRange( in, out, size, copied, failed ) )
+		{
+			// files can grow while being copied, whatever is left goes through the buffer
+			success = !failed && CopyReadWrite( in, out, copied );
+			done = true;
+		}
+	}
+
+#endif
+
+#endif
+
+	if( !done )
+		success = CopyReadWrite( in, out, copied );
+
+	close( in );
+	if( close( out ) != 0 )
+		success = false;
+
+	if( success )
+	{
+		if( overwrite )
+		{
+			success = renameat( outdir, temporary.c_str( ), outdir, outname ) == 0;
+		}
+		else
+		{
+			// a link fails when the destination showed up meanwhile, filesystems without hard
+			// links get the checked rename
+			if( linkat( outdir, temporary.c_str( ), outdir, outname, 0 ) == 0 )
+				success = true;
+			else if( errno == EEXIST || fstatat( outdir, outname, &existing, AT_SYMLINK_NOFOLLOW ) == 0 )
+				success = false;
+			else
+				success = renameat( outdir, temporary.c_str( ), outdir, outname ) == 0;
+		}
+	}
+
+	// gone already when it was renamed
+	unlinkat( outdir, temporary.c_str( ), 0 );
+
+	if( !success )
+		return false;
+
+	bytes += copied;
+	return true;
+}
+
+bool TreeCopier::CopyFileContents(
+	const std::string &source,
+	const std::string &destination,
+	bool overwrite,
+	uint64_t &bytes
+)
+{
+	std::string inname, outname;
+	const int indir = OpenParentDirectory( source, inname );
+	if( indir == -1 )
+		return false;
+
+	const int outdir = OpenParentDirectory( destination, outname );
+	if( outdir == -1 )
+	{
+		close( indir );
+		return false;
+	}
+
+	bool skipped = false;
+	const bool success = CopyAt( indir, inname.c_str( ), outdir, outname.c_str( ), overwrite, bytes, skipped );
+
+	close( indir );
+	close( outdir );
+	return success;
+}
+
+bool TreeCopier::OpenRoots( )
+{
+	if( source_handle == -1 )
+		source_handle = open( source.c_str( ), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC );
+
+	if( source_handle == -1 )
+		return false;
+
+	if( destination_handle == -1 )
+	{
+		std::string name;
+		const int parent = OpenParentDirectory( destination, name );
+		if( parent == -1 )
+			return false;
+
+		if( mkdirat( parent, name.c_str( ), 0755 ) == 0 || errno == EEXIST )
+			destination_handle = openat( parent, name.c_str( ), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC );
+
+		close( parent );
+	}
+
+	return destination_handle != -1;
+}
+
+void TreeCopier::CloseRoots( )
+{
+	if( source_handle != -1 )
+		close( static_cast<int>( source_handle ) );
+
+	if( destination_handle != -1 )
+		close( static_cast<int>( destination_handle ) );
+
+	source_handle = destination_handle = -1;
+}
+
+bool TreeCopier::MakeDirectory( const std::string &relative ) const
+{
+	const size_t slash = relative.rfind( '/' );
+	const int parent = OpenDirectoryBelow(
+		static_cast<int>( destination_handle ),
+		slash == relative.npos ? std::string( ) : relative.substr( 0, slash )
+	);
+	if( parent == -1 )
+		return false;
+
+	const char *name = relative.c_str( ) + ( slash == relative.npos ? 0 : slash + 1 );
+	struct stat stats;
+	const bool made = mkdirat( parent, name, 0755 ) == 0 ||
+		( errno == EEXIST && fstatat( parent, name, &stats, AT_SYMLINK_NOFOLLOW ) == 0 && S_ISDIR( stats.st_mode ) );
+	close( parent );
+	return made;
+}
+
+bool TreeCopier::CopyFiles(
+	const std::string &directory,
+	const std::vector<std::string> &names,
+	uint64_t &files,
+	uint64_t &bytes,
+	uint64_t &skipped
+) const
+{
+	// directories swapped for links since the walk are never followed on either side
+	const int indir = OpenDirectoryBelow( static_cast<int>( source_handle ), directory );
+	if( indir == -1 )
+		return false;
+
+	const int outdir = OpenDirectoryBelow( static_cast<int>( destination_handle ), directory );
+	if( outdir == -1 )
+	{
+		close( indir );
+		return false;
+	}
+
+	bool complete = true;
+	for( auto it = names.begin( ); it != names.end( ); ++it )
+	{
+		bool link = false;
+		if( CopyAt( indir, it->c_str( ), outdir, it->c_str( ), overwrite, bytes, link ) )
+			++files;
+		else if( link )
+			++skipped;
+		else
+			complete = false;
+	}
+
+	close( indir );
+	close( outdir );
+	return complete;
+}
+
+}
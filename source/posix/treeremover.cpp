@@ -0,0 +1,120 @@
+#include "treeremover.hpp"
+#include "directorydescriptor.hpp"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace filesystem
+{
+
+// symbolic links are removed themselves, never what they point to
+static bool UnlinkFiles( int fd, const std::vector<std::string> &names, uint64_t &entries, uint64_t &bytes )
+{
+	bool complete = true;
+	for( auto it = names.begin( ); it != names.end( ); ++it )
+	{
+		struct stat stats;
+		const bool sized = fstatat( fd, it->c_str( ), &stats, AT_SYMLINK_NOFOLLOW ) == 0;
+		if( sized && S_ISDIR( stats.st_mode ) )
+		{
+			complete = false;
+			continue;
+		}
+
+		if( unlinkat( fd, it->c_str( ), 0 ) != 0 )
+		{
+			complete = false;
+			continue;
+		}
+
+		++entries;
+		if( sized && S_ISREG( stats.st_mode ) )
+			bytes += static_cast<uint64_t>( stats.st_size );
+	}
+
+	return complete;
+}
+
+bool TreeRemover::OpenRoot( )
+{
+	if( handle == -1 )
+		handle = open( root.c_str( ), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC );
+
+	return handle != -1;
+}
+
+void TreeRemover::CloseRoot( )
+{
+	if( handle != -1 )
+		close( static_cast<int>( handle ) );
+
+	handle = -1;
+}
+
+bool TreeRemover::RemoveFiles(
+	const std::string &directory,
+	const std::vector<std::string> &names,
+	uint64_t &entries,
+	uint64_t &bytes
+) const
+{
+	// directories swapped for links since the walk are never followed
+	const int fd = OpenDirectoryBelow( static_cast<int>( handle ), directory );
+	if( fd == -1 )
+		return false;
+
+	const bool complete = UnlinkFiles( fd, names, entries, bytes );
+	close( fd );
+	return complete;
+}
+
+bool TreeRemover::RemoveEmptyDirectory( const std::string &relative ) const
+{
+	std::string name;
+	int parent = -1;
+	if( relative.empty( ) )
+	{
+		parent = OpenParentDirectory( root, name );
+
+		// only the directory that was walked, not whatever took its place since
+		struct stat opened, current;
+		if( parent != -1 && ( fstat( static_cast<int>( handle ), &opened ) != 0 ||
+			fstatat( parent, name.c_str( ), &current, AT_SYMLINK_NOFOLLOW ) != 0 ||
+			opened.st_dev != current.st_dev || opened.st_ino != current.st_ino ) )
+		{
+			close( parent );
+			return false;
+		}
+	}
+	else
+	{
+		const size_t slash = relative.rfind( '/' );
+		name = slash == relative.npos ? relative : relative.substr( slash + 1 );
+		parent = OpenDirectoryBelow(
+			static_cast<int>( handle ),
+			slash == relative.npos ? std::string( ) : relative.substr( 0, slash )
+		);
+	}
+
+	if( parent == -1 )
+		return false;
+
+	const bool removed = unlinkat( parent, name.c_str( ), AT_REMOVEDIR ) == 0;
+	close( parent );
+	return removed;
+}
+
+bool TreeRemover::RemoveRootFile( uint64_t &entries, uint64_t &bytes ) const
+{
+	std::string name;
+	const int parent = OpenParentDirectory( root, name );
+	if( parent == -1 )
+		return false;
+
+	const bool complete = UnlinkFiles( parent, std::vector<std::string>( 1, name ), entries, bytes );
+	close( parent );
+	return complete;
+}
+
+}
@@ -0,0 +1,136 @@
+#include "walker.hpp"
+
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#if defined SYSTEM_LINUX
+
+#include <sys/syscall.h>
+
+#endif
+
+namespace filesystem
+{
+
+#if defined SYSTEM_LINUX
+
+// layout the kernel fills on getdents64, glibc doesn't expose it
+struct linux_dirent64
+{
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[1];
+};
+
+static const size_t getdents_buffer_size = 64 * 1024;
+
+#endif
+
+static bool IsDot( const char *name )
+{
+	return name[0] == '.' && ( name[1] == '\0' || ( name[1] == '.' && name[2] == '\0' ) );
+}
+
+static Walker::Listed Describe( int fd, const char *name, unsigned char type, bool stat )
+{
+	Walker::Listed listed = { name, type == DT_DIR, 0, 0 };
+	if( type == DT_UNKNOWN || ( stat && type != DT_DIR ) )
+	{
+		// symbolic links to directories are listed as files so the walk never loops
+		struct stat stats;
+		if( fstatat( fd, name, &stats, AT_SYMLINK_NOFOLLOW ) == 0 )
+		{
+			listed.directory = S_ISDIR( stats.st_mode );
+			if( !listed.directory )
+			{
+				listed.size = static_cast<uint64_t>( stats.st_size );
+				listed.allocated = static_cast<uint64_t>( stats.st_blocks ) * 512;
+			}
+		}
+	}
+
+	return listed;
+}
+
+intptr_t Walker::OpenRoot( const std::string &path )
+{
+	return open( path.c_str( ), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+}
+
+void Walker::CloseRoot( intptr_t handle )
+{
+	close( static_cast<int>( handle ) );
+}
+
+bool Walker::ReadDirectory(
+	const Root &root,
+	const std::string &relative,
+	bool stat,
+	std::vector<char> &buffer,
+	Listing &listing
+)
+{
+	const int rootfd = static_cast<int>( root.handle );
+	const int fd = openat(
+		rootfd,
+		relative.empty( ) ? "." : relative.c_str( ),
+		O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC
+	);
+	if( fd == -1 )
+		return false;
+
+#if defined SYSTEM_LINUX
+
+	// raw getdents64 skips the per entry overhead of readdir, and the buffer is reused per worker
+	buffer.resize( getdents_buffer_size );
+	while( true )
+	{
+		const long read = syscall( SYS_getdents64, fd, buffer.data( ), buffer.size( ) );
+		if( read <= 0 )
+			break;
+
+		for( long offset = 0; offset < read; )
+		{
+			const linux_dirent64 *entry = reinterpret_cast<const linux_dirent64 *>( buffer.data( ) + offset );
+			offset += entry->d_reclen;
+			if( IsDot( entry->d_name ) )
+				continue;
+
+			listing.push_back( Describe( fd, entry->d_name, entry->d_type, stat ) );
+		}
+	}
+
+	close( fd );
+
+#else
+
+	( void )buffer;
+
+	DIR *dir = fdopendir( fd );
+	if( dir == nullptr )
+	{
+		close( fd );
+		return false;
+	}
+
+	for( const struct dirent *entry = readdir( dir ); entry != nullptr; entry = readdir( dir ) )
+	{
+		if( IsDot( entry->d_name ) )
+			continue;
+
+		listing.push_back( Describe( fd, entry->d_name, entry->d_type, stat ) );
+	}
+
+	closedir( dir );
+
+#endif
+
+	return true;
+}
+
+}
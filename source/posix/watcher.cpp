@@ -0,0 +1,130 @@
+#include "watcher.hpp"
+
+#include <cerrno>
+
+#include <unistd.h>
+
+#if defined SYSTEM_LINUX
+
+#include <sys/inotify.h>
+
+#endif
+
+namespace filesystem
+{
+
+#if defined SYSTEM_LINUX
+
+// a link in place of a watched directory is refused instead of watching whatever it points to
+static const uint32_t watch_mask =
+	IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO |
+	IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+Watcher::Watcher( ) :
+	descriptor( inotify_init1( IN_NONBLOCK | IN_CLOEXEC ) )
+{ }
+
+Watcher::~Watcher( )
+{
+	if( descriptor != -1 )
+		close( descriptor );
+}
+
+bool Watcher::Available( ) const
+{
+	return descriptor != -1;
+}
+
+int32_t Watcher::Add( const std::string &directory )
+{
+	if( descriptor == -1 )
+		return -1;
+
+	return inotify_add_watch( descriptor, directory.c_str( ), watch_mask );
+}
+
+void Watcher::Remove( int32_t id )
+{
+	if( descriptor != -1 && id >= 0 )
+		inotify_rm_watch( descriptor, id );
+}
+
+void Watcher::Poll( const Callback &callback )
+{
+	if( descriptor == -1 )
+		return;
+
+	alignas( struct inotify_event ) char buffer[16 * 1024];
+	while( true )
+	{
+		const ssize_t len = read( descriptor, buffer, sizeof( buffer ) );
+		if( len == -1 && errno == EINTR )
+			continue;
+
+		if( len <= 0 )
+			return;
+
+		for( ssize_t offset = 0; offset < len; )
+		{
+			const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>( buffer + offset );
+			offset += sizeof( struct inotify_event ) + event->len;
+
+			uint32_t events = 0;
+			if( ( event->mask & IN_Q_OVERFLOW ) != 0 )
+			{
+				callback( -1, std::string( ), Overflow );
+				continue;
+			}
+
+			if( ( event->mask & IN_CREATE ) != 0 )
+				events |= Created;
+
+			if( ( event->mask & ( IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB ) ) != 0 )
+				events |= Modified;
+
+			if( ( event->mask & IN_DELETE ) != 0 )
+				events |= Removed;
+
+			if( ( event->mask & ( IN_MOVED_FROM | IN_MOVED_TO ) ) != 0 )
+				events |= Renamed;
+
+			if( ( event->mask & ( IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED ) ) != 0 )
+				events |= Gone;
+
+			if( events != 0 && ( event->mask & IN_ISDIR ) != 0 )
+				events |= Directory;
+
+			if( events != 0 )
+				callback( event->wd, event->len != 0 ? std::string( event->name ) : std::string( ), events );
+		}
+	}
+}
+
+#else
+
+Watcher::Watcher( ) :
+	descriptor( -1 )
+{ }
+
+Watcher::~Watcher( )
+{ }
+
+bool Watcher::Available( ) const
+{
+	return false;
+}
+
+int32_t Watcher::Add( const std::string & )
+{
+	return -1;
+}
+
+void Watcher::Remove( int32_t )
+{ }
+
+void Watcher::Poll( const Callback & )
+{ }
+
+#endif
+
+}
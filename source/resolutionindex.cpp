@@ -0,0 +1,455 @@
+#include "resolutionindex.hpp"
+
+#include <algorithm>
+
+namespace filesystem
+{
+
+// directory watches are kernel resources (and a notification buffer each on Windows), shared
+// with the metadata cache, so indexes of big trees are only checked instead
+const size_t ResolutionIndex::max_watches = 512;
+const size_t ResolutionIndex::max_changed = 4096;
+
+ResolutionIndex::ResolutionIndex( ) :
+	generation( 0 ),
+	hits( 0 ),
+	misses( 0 ),
+	unsure( 0 )
+{ }
+
+ResolutionIndex::~ResolutionIndex( )
+{
+	Clear( );
+}
+
+std::string ResolutionIndex::Normalize( const StringRef &path )
+{
+	std::string key = path.ToString( );
+	for( auto it = key.begin( ); it != key.end( ); ++it )
+		if( *it == '\\' )
+			*it = '/';
+		else if( *it >= 'A' && *it <= 'Z' )
+			*it = static_cast<char>( *it - 'A' + 'a' );
+
+	while( !key.empty( ) && key.back( ) == '/' )
+		key.pop_back( );
+
+	return key;
+}
+
+ResolutionIndex::Result ResolutionIndex::Find(
+	const StringRef &pathid,
+	const StringRef &path,
+	std::vector<std::string> &searchpaths
+)
+{
+	const std::string key = Normalize( path );
+
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = FindIndex( pathid );
+	if( it == indexes.end( ) )
+		return Unknown;
+
+	const Index &index = it->second;
+	if( !index.ready || IsChanged( index, key ) )
+	{
+		++unsure;
+		searchpaths = index.searchpaths;
+		return Unsure;
+	}
+
+	const auto entry = index.entries.find( key );
+	if( entry == index.entries.end( ) )
+	{
+		// a truncated or unwatched index can't tell a missing file from one it doesn't know about
+		if( !index.complete || !index.tracked )
+		{
+			++unsure;
+			searchpaths = index.searchpaths;
+			return Unsure;
+		}
+
+		++misses;
+		return Missing;
+	}
+
+	// without notifications a file can have shown up in an earlier search path since
+	++hits;
+	const size_t first = index.tracked ? entry->second : 0;
+	searchpaths.assign( index.searchpaths.begin( ) + first, index.searchpaths.begin( ) + entry->second + 1 );
+	return Found;
+}
+
+bool ResolutionIndex::Start(
+	const std::string &pathid,
+	const std::vector<std::string> &searchpaths,
+	uint64_t &gen
+)
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if( indexes.find( pathid ) != indexes.end( ) )
+		return false;
+
+	Index &index = indexes[pathid];
+	index.ready = false;
+	index.complete = false;
+	index.tracked = watcher.Available( );
+	index.generation = gen = ++generation;
+	index.searchpaths = searchpaths;
+	index.watches = 0;
+	return true;
+}
+
+void ResolutionIndex::Watch(
+	const std::string &pathid,
+	uint64_t gen,
+	uint32_t searchpath,
+	const std::string &directory
+)
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = indexes.find( pathid );
+	if( it == indexes.end( ) || it->second.generation != gen || !it->second.tracked )
+		return;
+
+	Index &index = it->second;
+	if( index.watches >= max_watches )
+	{
+		Untrack( it );
+		return;
+	}
+
+	const int32_t id = watcher.Add( index.searchpaths[searchpath] + directory );
+	if( id < 0 )
+	{
+		Untrack( it );
+		return;
+	}
+
+	locations[id].push_back( Location{ pathid, searchpath, Normalize( directory ) } );
+	++index.watches;
+}
+
+void ResolutionIndex::Merge( const std::string &pathid, uint64_t gen, Entries entries, bool complete )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = indexes.find( pathid );
+	if( it == indexes.end( ) || it->second.generation != gen )
+		return;
+
+	Index &index = it->second;
+	if( index.entries.empty( ) )
+		index.entries.swap( entries );
+	else
+		index.entries.insert( entries.begin( ), entries.end( ) );
+
+	index.ready = true;
+	index.complete = complete;
+}
+
+bool ResolutionIndex::Update(
+	const std::string &pathid,
+	const std::vector<std::string> &searchpaths,
+	uint64_t &gen,
+	size_t &first
+)
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = indexes.find( pathid );
+	if( it == indexes.end( ) )
+		return false;
+
+	// search paths added to the tail can't take over existing entries, anything else needs a rebuild
+	Index &index = it->second;
+	if( !index.ready ||
+		!index.complete ||
+		searchpaths.size( ) < index.searchpaths.size( ) ||
+		!std::equal( index.searchpaths.begin( ), index.searchpaths.end( ), searchpaths.begin( ) ) )
+	{
+		Drop( it );
+		return false;
+	}
+
+	// misses aren't answered until the new search paths are merged
+	first = index.searchpaths.size( );
+	index.complete = false;
+	index.searchpaths = searchpaths;
+	index.generation = gen = ++generation;
+	return true;
+}
+
+void ResolutionIndex::Insert( const StringRef &pathid, const StringRef &path, const std::string &searchpath )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const auto it = FindIndex( pathid );
+	if( it == indexes.end( ) )
+		return;
+
+	Index &index = it->second;
+	const std::string key = Normalize( path );
+	if( searchpath.empty( ) )
+	{
+		index.entries.erase( key );
+		index.changed.erase( key );
+		return;
+	}
+
+	const auto pos = std::find( index.searchpaths.begin( ), index.searchpaths.end( ), searchpath );
+	if( pos != index.searchpaths.end( ) )
+	{
+		index.entries[key] = static_cast<uint32_t>( pos - index.searchpaths.begin( ) );
+		index.changed.erase( key );
+	}
+}
+
+void ResolutionIndex::Changed( const std::string &fullpath )
+{
+	const std::string path = Normalize( fullpath );
+
+	std::lock_guard<std::mutex> lock( mutex );
+
+	// search paths can nest (garrysmod/ and garrysmod/data/), every one holding the path is marked
+	for( auto it = indexes.begin( ); it != indexes.end( ); )
+	{
+		bool keep = true;
+		for( auto searchpath = it->second.searchpaths.begin( ); keep && searchpath != it->second.searchpaths.end( ); ++searchpath )
+		{
+			const std::string root = Normalize( *searchpath );
+			if( path.size( ) > root.size( ) + 1 && path[root.size( )] == '/' && path.compare( 0, root.size( ), root ) == 0 )
+				keep = MarkChanged( it->second, path.substr( root.size( ) + 1 ) );
+		}
+
+		if( keep )
+		{
+			++it;
+			continue;
+		}
+
+		const auto dropped = it++;
+		Drop( dropped );
+	}
+}
+
+void ResolutionIndex::Poll( )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	// indexes are dropped once the notifications are handled, the callback walks their locations
+	bool overflow = false;
+	std::vector<std::string> dropped;
+	std::vector<int32_t> gone;
+	watcher.Poll( [this, &overflow, &dropped, &gone]( int32_t id, const std::string &name, uint32_t events )
+	{
+		if( ( events & Watcher::Overflow ) != 0 )
+		{
+			overflow = true;
+			return;
+		}
+
+		const auto found = locations.find( id );
+		if( found == locations.end( ) )
+			return;
+
+		if( ( events & Watcher::Gone ) != 0 )
+			gone.push_back( id );
+
+		for( auto location = found->second.begin( ); location != found->second.end( ); ++location )
+		{
+			const auto it = indexes.find( location->pathid );
+			if( it == indexes.end( ) )
+				continue;
+
+			Index &index = it->second;
+
+			// the directory itself, a search path going away invalidates everything
+			if( name.empty( ) )
+			{
+				if( ( events & Watcher::Gone ) == 0 )
+					continue;
+
+				if( location->directory.empty( ) || !MarkChanged( index, location->directory ) )
+					dropped.push_back( location->pathid );
+
+				continue;
+			}
+
+			const std::string key = location->directory.empty( ) ?
+				Normalize( name ) : location->directory + '/' + Normalize( name );
+			const auto entry = index.entries.find( key );
+
+			bool keep = true;
+			if( ( events & Watcher::Directory ) != 0 && ( events & ( Watcher::Created | Watcher::Removed | Watcher::Renamed ) ) != 0 )
+			{
+				// nothing below a new directory is watched, or indexed
+				keep = MarkChanged( index, key );
+			}
+			else if( ( events & Watcher::Renamed ) != 0 )
+			{
+				// can't tell the old name from the new one
+				keep = MarkChanged( index, key );
+			}
+			else if( ( events & Watcher::Removed ) != 0 )
+			{
+				// a later search path might still have it
+				if( entry != index.entries.end( ) && entry->second >= location->searchpath )
+					keep = MarkChanged( index, key );
+			}
+			else if( ( events & Watcher::Created ) != 0 )
+			{
+				// a scan in progress might have listed the directory already and merges over this
+				if( !index.ready )
+					keep = MarkChanged( index, key );
+				else if( entry == index.entries.end( ) )
+					index.entries.emplace( key, location->searchpath );
+				else if( entry->second > location->searchpath )
+					entry->second = location->searchpath;
+			}
+
+			if( !keep )
+				dropped.push_back( location->pathid );
+		}
+	} );
+
+	if( overflow )
+	{
+		while( !indexes.empty( ) )
+			Drop( indexes.begin( ) );
+
+		return;
+	}
+
+	for( auto id = gone.begin( ); id != gone.end( ); ++id )
+	{
+		const auto found = locations.find( *id );
+		if( found == locations.end( ) )
+			continue;
+
+		for( auto location = found->second.begin( ); location != found->second.end( ); ++location )
+		{
+			const auto it = indexes.find( location->pathid );
+			if( it != indexes.end( ) && it->second.watches != 0 )
+				--it->second.watches;
+		}
+
+		locations.erase( found );
+	}
+
+	for( auto pathid = dropped.begin( ); pathid != dropped.end( ); ++pathid )
+	{
+		const auto it = indexes.find( *pathid );
+		if( it != indexes.end( ) )
+			Drop( it );
+	}
+}
+
+void ResolutionIndex::Clear( )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	for( auto it = locations.begin( ); it != locations.end( ); ++it )
+		watcher.Remove( it->first );
+
+	// drain the removal notifications so stale ids don't linger
+	watcher.Poll( [] ( int32_t, const std::string &, uint32_t ) { } );
+
+	locations.clear( );
+	indexes.clear( );
+}
+
+ResolutionIndex::Indexes::iterator ResolutionIndex::FindIndex( const StringRef &pathid )
+{
+	for( auto it = indexes.begin( ); it != indexes.end( ); ++it )
+		if( pathid.Equals( it->first ) )
+			return it;
+
+	return indexes.end( );
+}
+
+bool ResolutionIndex::IsChanged( const Index &index, const std::string &key )
+{
+	if( index.changed.empty( ) )
+		return false;
+
+	if( index.changed.find( key ) != index.changed.end( ) )
+		return true;
+
+	for( size_t pos = key.find( '/' ); pos != key.npos; pos = key.find( '/', pos + 1 ) )
+		if( index.changed.find( key.substr( 0, pos ) ) != index.changed.end( ) )
+			return true;
+
+	return false;
+}
+
+bool ResolutionIndex::MarkChanged( Index &index, const std::string &key )
+{
+	index.changed.insert( key );
+	return index.changed.size( ) <= max_changed;
+}
+
+void ResolutionIndex::Untrack( Indexes::iterator it )
+{
+	// answers are checked from now on, the watches would only cost resources
+	it->second.tracked = false;
+	RemoveWatches( it->first );
+	it->second.watches = 0;
+}
+
+void ResolutionIndex::Drop( Indexes::iterator it )
+{
+	RemoveWatches( it->first );
+	indexes.erase( it );
+}
+
+void ResolutionIndex::RemoveWatches( const std::string &pathid )
+{
+	// search paths are shared between path IDs, so are their watches
+	for( auto it = locations.begin( ); it != locations.end( ); )
+	{
+		std::vector<Location> &list = it->second;
+		list.erase(
+			std::remove_if( list.begin( ), list.end( ), [&pathid]( const Location &location )
+			{
+				return location.pathid == pathid;
+			} ),
+			list.end( )
+		);
+
+		if( !list.empty( ) )
+		{
+			++it;
+			continue;
+		}
+
+		watcher.Remove( it->first );
+		it = locations.erase( it );
+	}
+}
+
+ResolutionIndex::Statistics ResolutionIndex::GetStatistics( ) const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	Statistics stats = { };
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.unsure = unsure;
+	stats.indexes = indexes.size( );
+	stats.watches = locations.size( );
+	for( auto it = indexes.begin( ); it != indexes.end( ); ++it )
+	{
+		if( !it->second.ready )
+			++stats.building;
+
+		stats.entries += it->second.entries.size( );
+	}
+
+	return stats;
+}
+
+}
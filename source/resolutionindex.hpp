@@ -0,0 +1,134 @@
+#pragma once
+
+#include "stringref.hpp"
+#include "watcher.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+
+namespace filesystem
+{
+
+// Per path ID map from relative path to the loose search path that wins its lookup.
+// Indexes are built on worker threads from native directory listings, in search path order.
+// Every scanned directory is watched, so a complete index answers misses on its own; changes
+// it hears about mark paths for a slow lookup until one records the result with Insert.
+// Indexes that can't be watched are only hints and have their answers checked.
+class ResolutionIndex
+{
+public:
+	typedef std::unordered_map<std::string, uint32_t> Entries;
+
+	enum Result
+	{
+		// no index for this path ID, Start should be called
+		Unknown,
+		// searchpaths lists where to look in order, ending with the indexed one
+		Found,
+		Missing,
+		// changed since indexed or still being built, searchpaths lists every loose search path
+		Unsure
+	};
+
+	struct Statistics
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t unsure;
+		size_t indexes;
+		size_t building;
+		size_t entries;
+		size_t watches;
+	};
+
+	ResolutionIndex( );
+	~ResolutionIndex( );
+
+	// case and separator insensitive key for a relative path
+	static std::string Normalize( const StringRef &path );
+
+	Result Find( const StringRef &pathid, const StringRef &path, std::vector<std::string> &searchpaths );
+
+	// returns false when pathid is already indexed or being indexed, otherwise the caller builds it
+	bool Start( const std::string &pathid, const std::vector<std::string> &searchpaths, uint64_t &generation );
+	// called by the scan before listing a directory, relative to searchpaths[searchpath]
+	void Watch( const std::string &pathid, uint64_t generation, uint32_t searchpath, const std::string &directory );
+	// entries index the search paths given to Start or Update, existing entries win,
+	// an incomplete index can't be extended later
+	void Merge( const std::string &pathid, uint64_t generation, Entries entries, bool complete );
+
+	// called after the search paths of pathid changed, returns true when only the search paths
+	// from first onwards need to be scanned and merged, otherwise the index is dropped
+	bool Update(
+		const std::string &pathid,
+		const std::vector<std::string> &searchpaths,
+		uint64_t &generation,
+		size_t &first
+	);
+
+	// records a path resolved the slow way, searchpath is empty when none of them had it
+	void Insert( const StringRef &pathid, const StringRef &path, const std::string &searchpath );
+
+	// marks a file or directory changed through the wrapper, before notifications arrive
+	void Changed( const std::string &fullpath );
+
+	// applies pending change notifications, meant to be called once per tick
+	void Poll( );
+
+	void Clear( );
+
+	Statistics GetStatistics( ) const;
+
+private:
+	struct Index
+	{
+		bool ready;
+		bool complete;
+		// every scanned directory is watched
+		bool tracked;
+		uint64_t generation;
+		std::vector<std::string> searchpaths;
+		Entries entries;
+		// normalized paths (and everything below them) that need a slow lookup
+		std::unordered_set<std::string> changed;
+		size_t watches;
+	};
+
+	// a watched directory of an index, directory is normalized and relative to its search path
+	struct Location
+	{
+		std::string pathid;
+		uint32_t searchpath;
+		std::string directory;
+	};
+
+	typedef std::unordered_map<std::string, Index> Indexes;
+
+	// a handful of path IDs, comparing them beats building a key to hash
+	Indexes::iterator FindIndex( const StringRef &pathid );
+
+	static bool IsChanged( const Index &index, const std::string &key );
+	// false once the index has too many changes to keep track of and should be dropped
+	static bool MarkChanged( Index &index, const std::string &key );
+	void Untrack( Indexes::iterator it );
+	void Drop( Indexes::iterator it );
+	void RemoveWatches( const std::string &pathid );
+
+	static const size_t max_watches;
+	static const size_t max_changed;
+
+	mutable std::mutex mutex;
+	Indexes indexes;
+	Watcher watcher;
+	std::unordered_map<int32_t, std::vector<Location>> locations;
+	uint64_t generation;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t unsure;
+};
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#if defined SYSTEM_POSIX
+
+#include <pthread.h>
+
+#endif
+
+namespace filesystem
+{
+
+// Reader-writer lock where readers never wait on each other and waiting writers are
+// preferred over new readers. It is not recursive, never lock it twice on the same thread.
+class ReadWriteLock
+{
+public:
+	ReadWriteLock( );
+	~ReadWriteLock( );
+
+	void LockRead( );
+	void UnlockRead( );
+
+	void LockWrite( );
+	void UnlockWrite( );
+
+private:
+	ReadWriteLock( const ReadWriteLock & ) = delete;
+	ReadWriteLock &operator=( const ReadWriteLock & ) = delete;
+
+#if defined SYSTEM_WINDOWS
+
+	void *lock;
+
+#elif defined SYSTEM_POSIX
+
+	pthread_rwlock_t lock;
+
+#endif
+
+};
+
+class ReadLock
+{
+public:
+	ReadLock( ReadWriteLock &rwlock ) :
+		lock( rwlock )
+	{
+		lock.LockRead( );
+	}
+
+	~ReadLock( )
+	{
+		lock.UnlockRead( );
+	}
+
+private:
+	ReadWriteLock &lock;
+};
+
+class WriteLock
+{
+public:
+	WriteLock( ReadWriteLock &rwlock ) :
+		lock( rwlock )
+	{
+		lock.LockWrite( );
+	}
+
+	~WriteLock( )
+	{
+		lock.UnlockWrite( );
+	}
+
+private:
+	ReadWriteLock &lock;
+};
+
+}
@@ -0,0 +1,139 @@
+#include "scheduler.hpp"
+
+#include <memory>
+
+namespace filesystem
+{
+
+static std::unordered_map<GarrysMod::Lua::ILuaBase *, std::unique_ptr<Scheduler>> schedulers;
+
+Scheduler::Timer::Timer( GarrysMod::Lua::ILuaBase *LUA ) :
+	scheduler( Scheduler::Get( LUA ) ),
+	start( Clock::now( ) ),
+	outermost( scheduler != nullptr && scheduler->depth++ == 0 )
+{ }
+
+Scheduler::Timer::~Timer( )
+{
+	if( scheduler == nullptr )
+		return;
+
+	--scheduler->depth;
+	if( outermost )
+		scheduler->AddTime( Clock::now( ) - start );
+}
+
+Scheduler::Scheduler( ) :
+	budget( std::chrono::milliseconds( 2 ) ),
+	spent( Clock::duration::zero( ) ),
+	stats( ),
+	fresh( 0 ),
+	depth( 0 )
+{ }
+
+Scheduler *Scheduler::Create( GarrysMod::Lua::ILuaBase *LUA )
+{
+	std::unique_ptr<Scheduler> &scheduler = schedulers[LUA];
+	scheduler.reset( new Scheduler );
+	return scheduler.get( );
+}
+
+Scheduler *Scheduler::Get( GarrysMod::Lua::ILuaBase *LUA )
+{
+	const auto it = schedulers.find( LUA );
+	if( it == schedulers.end( ) )
+		return nullptr;
+
+	return it->second.get( );
+}
+
+void Scheduler::Destroy( GarrysMod::Lua::ILuaBase *LUA )
+{
+	schedulers.erase( LUA );
+}
+
+void Scheduler::SetBudget( double seconds )
+{
+	if( seconds < 0.0 )
+		seconds = 0.0;
+
+	budget = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( seconds ) );
+}
+
+double Scheduler::GetBudget( ) const
+{
+	return std::chrono::duration<double>( budget ).count( );
+}
+
+bool Scheduler::HasBudget( ) const
+{
+	return spent < budget;
+}
+
+void Scheduler::Enqueue( const std::string &caller, Task task )
+{
+	std::deque<Queued> &queue = queues[caller];
+	if( queue.empty( ) )
+		rotation.push_back( caller );
+
+	Queued queued = { std::move( task ), stats.ticks };
+	queue.push_back( std::move( queued ) );
+	++stats.pending;
+	++fresh;
+}
+
+void Scheduler::Tick( GarrysMod::Lua::ILuaBase *LUA )
+{
+	// one task per caller on each round, tasks are free to enqueue more work
+	bool progressed = false;
+	while( !rotation.empty( ) && ( !progressed || HasBudget( ) ) )
+	{
+		const std::string caller = std::move( rotation.front( ) );
+		rotation.pop_front( );
+
+		auto it = queues.find( caller );
+		Queued queued = std::move( it->second.front( ) );
+		it->second.pop_front( );
+		if( it->second.empty( ) )
+			queues.erase( it );
+		else
+			rotation.push_back( caller );
+
+		--stats.pending;
+		if( queued.tick == stats.ticks )
+			--fresh;
+
+		// filesystem calls made by the task's Lua callbacks are part of its own time
+		const Clock::time_point start = Clock::now( );
+		++depth;
+		queued.task( LUA );
+		--depth;
+		AddTime( Clock::now( ) - start );
+		++stats.executed;
+		progressed = true;
+	}
+
+	if( !HasBudget( ) )
+		++stats.budget_hits;
+
+	// tasks queued before this tick were already counted when their own tick ended
+	stats.deferred += fresh;
+	fresh = 0;
+	++stats.ticks;
+
+	stats.last_tick_time = std::chrono::duration<double>( spent ).count( );
+	spent = Clock::duration::zero( );
+}
+
+Scheduler::Statistics Scheduler::GetStatistics( ) const
+{
+	return stats;
+}
+
+void Scheduler::AddTime( Clock::duration elapsed )
+{
+	spent += elapsed;
+	stats.total_time += std::chrono::duration<double>( elapsed ).count( );
+}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+
+namespace GarrysMod
+{
+	namespace Lua
+	{
+		class ILuaBase;
+	}
+}
+
+namespace filesystem
+{
+
+// Per Lua state scheduler that accounts the time spent doing filesystem work on each tick.
+// Deferrable work (async reads, prefetches, background scans) is queued per caller and
+// executed in round-robin order on the next ticks while there's budget left, at least one
+// task runs on every tick so work still progresses with no budget at all.
+class Scheduler
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::function<void( GarrysMod::Lua::ILuaBase *LUA )> Task;
+
+	struct Statistics
+	{
+		uint64_t ticks;
+		uint64_t budget_hits;
+		uint64_t deferred;
+		uint64_t executed;
+		uint64_t pending;
+		double last_tick_time;
+		double total_time;
+	};
+
+	// Accounts the lifetime of this object as filesystem work on the current tick. Timers nested in
+	// another one or in a running task don't count, their time is already part of the outer one.
+	class Timer
+	{
+	public:
+		Timer( GarrysMod::Lua::ILuaBase *LUA );
+		~Timer( );
+
+	private:
+		Scheduler *scheduler;
+		Clock::time_point start;
+		bool outermost;
+	};
+
+	Scheduler( );
+
+	static Scheduler *Create( GarrysMod::Lua::ILuaBase *LUA );
+	static Scheduler *Get( GarrysMod::Lua::ILuaBase *LUA );
+	static void Destroy( GarrysMod::Lua::ILuaBase *LUA );
+
+	void SetBudget( double seconds );
+	double GetBudget( ) const;
+	bool HasBudget( ) const;
+
+	void Enqueue( const std::string &caller, Task task );
+	void Tick( GarrysMod::Lua::ILuaBase *LUA );
+
+	Statistics GetStatistics( ) const;
+
+private:
+	struct Queued
+	{
+		Task task;
+		// tick it was queued on, it counts as deferred once if it's still pending when that tick ends
+		uint64_t tick;
+	};
+
+	void AddTime( Clock::duration elapsed );
+
+	Clock::duration budget;
+	Clock::duration spent;
+	Statistics stats;
+	// pending tasks queued on the current tick
+	uint64_t fresh;
+	// timers and tasks currently accounting time, only the outermost one adds it
+	uint32_t depth;
+
+	std::deque<std::string> rotation;
+	std::unordered_map<std::string, std::deque<Queued>> queues;
+};
+
+}
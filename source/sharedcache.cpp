@@ -0,0 +1,247 @@
+#include "sharedcache.hpp"
+
+#include <cctype>
+
+namespace filesystem
+{
+
+SharedCache::SharedCache( ) :
+	contents_size( 0 ),
+	contents_limit( 64 * 1024 * 1024 ),
+	references( 0 )
+{ }
+
+std::string SharedCache::MakeKey( const StringRef &filepath, const StringRef &pathid )
+{
+	return PathKey( filepath, pathid ).ToString( );
+}
+
+HandleCache &SharedCache::GetHandleCache( )
+{
+	return handles;
+}
+
+MetadataCache &SharedCache::GetMetadataCache( )
+{
+	return metadata;
+}
+
+LookupFilter &SharedCache::GetLookupFilter( )
+{
+	return filter;
+}
+
+ResolutionIndex &SharedCache::GetResolutionIndex( )
+{
+	return index;
+}
+
+DiskUsageCache &SharedCache::GetDiskUsageCache( )
+{
+	return usage;
+}
+
+PathInternCache &SharedCache::GetPathInternCache( )
+{
+	return paths;
+}
+
+std::shared_ptr<const std::string> SharedCache::GetContents( const PathKey &key ) const
+{
+	ReadLock guard( lock );
+
+	const auto it = FindContents( key );
+	if( it == contents.end( ) )
+		return std::shared_ptr<const std::string>( );
+
+	return it->second.data;
+}
+
+bool SharedCache::SetContents( const PathKey &key, std::shared_ptr<const std::string> data, const std::string &fullpath )
+{
+	WriteLock guard( lock );
+
+	auto it = FindContents( key );
+	const size_t previous = it != contents.end( ) ? it->second.data->size( ) : 0;
+	if( contents_size - previous + data->size( ) > contents_limit )
+		return false;
+
+	if( it == contents.end( ) )
+		it = contents.emplace( key.hash, Contents{ key.ToString( ), nullptr, std::string( ) } );
+
+	contents_size = contents_size - previous + data->size( );
+	it->second.data = std::move( data );
+	it->second.fullpath = fullpath;
+	return true;
+}
+
+bool SharedCache::RemoveContents( const PathKey &key )
+{
+	WriteLock guard( lock );
+
+	const auto it = FindContents( key );
+	if( it == contents.end( ) )
+		return false;
+
+	EraseContents( it );
+	return true;
+}
+
+void SharedCache::SetContentsLimit( size_t limit )
+{
+	WriteLock guard( lock );
+	contents_limit = limit;
+}
+
+size_t SharedCache::GetContentsLimit( ) const
+{
+	ReadLock guard( lock );
+	return contents_limit;
+}
+
+void SharedCache::Invalidate( const std::string &key )
+{
+	handles.Invalidate( key );
+	metadata.Invalidate( key );
+	usage.Invalidate( key );
+
+	WriteLock guard( lock );
+
+	const auto range = contents.equal_range( PathKey::Hash( key ) );
+	for( auto it = range.first; it != range.second; ++it )
+		if( it->second.key == key )
+		{
+			EraseContents( it );
+			break;
+		}
+}
+
+void SharedCache::InvalidateTree( const std::string &key )
+{
+	handles.Invalidate( key );
+	metadata.InvalidateTree( key );
+	usage.Invalidate( key );
+
+	WriteLock guard( lock );
+
+	for( auto it = contents.begin( ); it != contents.end( ); )
+	{
+		const std::string &name = it->second.key;
+		if( name.compare( 0, key.size( ), key ) == 0 &&
+			( name.size( ) == key.size( ) || name[key.size( )] == '/' || name[key.size( )] == '\\' ) )
+		{
+			const auto erased = it++;
+			EraseContents( erased );
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+bool SharedCache::IsSameOrBelow( const std::string &path, const std::string &root )
+{
+	if( root.empty( ) || path.size( ) < root.size( ) )
+		return false;
+
+	for( size_t k = 0; k < root.size( ); ++k )
+	{
+		char a = path[k], b = root[k];
+
+#if defined SYSTEM_WINDOWS
+
+		a = a == '\\' ? '/' : static_cast<char>( std::tolower( static_cast<unsigned char>( a ) ) );
+		b = b == '\\' ? '/' : static_cast<char>( std::tolower( static_cast<unsigned char>( b ) ) );
+
+#endif
+
+		if( a != b )
+			return false;
+	}
+
+	return path.size( ) == root.size( ) || path[root.size( )] == '/' || path[root.size( )] == '\\';
+}
+
+void SharedCache::InvalidateContents( const std::string &fullpath )
+{
+	WriteLock guard( lock );
+
+	// the same file can be reached through several search paths of different path IDs, the full
+	// path is what they share
+	for( auto it = contents.begin( ); it != contents.end( ); )
+		if( IsSameOrBelow( it->second.fullpath, fullpath ) )
+		{
+			const auto erased = it++;
+			EraseContents( erased );
+		}
+		else
+		{
+			++it;
+		}
+}
+
+void SharedCache::InvalidateSearchPaths( )
+{
+	handles.Clear( );
+	metadata.Clear( );
+	filter.Clear( );
+	usage.Clear( );
+	paths.Clear( );
+
+	WriteLock guard( lock );
+	contents.clear( );
+	contents_size = 0;
+}
+
+void SharedCache::Clear( )
+{
+	InvalidateSearchPaths( );
+	index.Clear( );
+}
+
+void SharedCache::SetReferences( size_t count )
+{
+	WriteLock guard( lock );
+	references = count;
+}
+
+SharedCache::Statistics SharedCache::GetStatistics( ) const
+{
+	ReadLock guard( lock );
+
+	Statistics stats;
+	stats.contents = contents.size( );
+	stats.contents_size = contents_size;
+	stats.contents_limit = contents_limit;
+	stats.references = references;
+	return stats;
+}
+
+SharedCache::ContentsMap::iterator SharedCache::FindContents( const PathKey &key )
+{
+	const auto range = contents.equal_range( key.hash );
+	for( auto it = range.first; it != range.second; ++it )
+		if( key.Matches( it->second.key ) )
+			return it;
+
+	return contents.end( );
+}
+
+SharedCache::ContentsMap::const_iterator SharedCache::FindContents( const PathKey &key ) const
+{
+	const auto range = contents.equal_range( key.hash );
+	for( auto it = range.first; it != range.second; ++it )
+		if( key.Matches( it->second.key ) )
+			return it;
+
+	return contents.end( );
+}
+
+void SharedCache::EraseContents( ContentsMap::iterator it )
+{
+	contents_size -= it->second.data->size( );
+	contents.erase( it );
+}
+
+}
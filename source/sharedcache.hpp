@@ -0,0 +1,97 @@
+#pragma once
+
+#include "diskusagecache.hpp"
+#include "handlecache.hpp"
+#include "lookupfilter.hpp"
+#include "metadatacache.hpp"
+#include "pathkey.hpp"
+#include "pathinterncache.hpp"
+#include "resolutionindex.hpp"
+#include "rwlock.hpp"
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+namespace filesystem
+{
+
+// Caches shared by every Lua state that loaded the module in this process.
+// The owning Wrapper is reference counted by those states and clears this when the last one leaves.
+class SharedCache
+{
+public:
+	struct Statistics
+	{
+		size_t contents;
+		size_t contents_size;
+		size_t contents_limit;
+		size_t references;
+	};
+
+	SharedCache( );
+
+	static std::string MakeKey( const StringRef &filepath, const StringRef &pathid );
+	// compares full paths with either separator, ignoring case on Windows
+	static bool IsSameOrBelow( const std::string &path, const std::string &root );
+
+	HandleCache &GetHandleCache( );
+	MetadataCache &GetMetadataCache( );
+	LookupFilter &GetLookupFilter( );
+	ResolutionIndex &GetResolutionIndex( );
+	DiskUsageCache &GetDiskUsageCache( );
+	PathInternCache &GetPathInternCache( );
+
+	std::shared_ptr<const std::string> GetContents( const PathKey &key ) const;
+	// fullpath is the loose file the contents were read from, empty when they came from a pack
+	bool SetContents( const PathKey &key, std::shared_ptr<const std::string> data, const std::string &fullpath );
+	bool RemoveContents( const PathKey &key );
+
+	void SetContentsLimit( size_t limit );
+	size_t GetContentsLimit( ) const;
+
+	// drops everything known about a single file, used when it's written to through the wrapper
+	void Invalidate( const std::string &key );
+	// same for a directory and everything below it, cached handles already notice removals by their time
+	void InvalidateTree( const std::string &key );
+	// drops contents read from fullpath or below it, whichever path ID they were preloaded through
+	void InvalidateContents( const std::string &fullpath );
+	// drops everything that depends on which search path wins a lookup, except for the resolution index
+	void InvalidateSearchPaths( );
+	void Clear( );
+
+	void SetReferences( size_t count );
+
+	Statistics GetStatistics( ) const;
+
+private:
+	struct Contents
+	{
+		std::string key;
+		std::shared_ptr<const std::string> data;
+		std::string fullpath;
+	};
+
+	// by PathKey hash
+	typedef std::unordered_multimap<uint64_t, Contents> ContentsMap;
+
+	ContentsMap::iterator FindContents( const PathKey &key );
+	ContentsMap::const_iterator FindContents( const PathKey &key ) const;
+	void EraseContents( ContentsMap::iterator it );
+
+	HandleCache handles;
+	MetadataCache metadata;
+	LookupFilter filter;
+	ResolutionIndex index;
+	DiskUsageCache usage;
+	PathInternCache paths;
+
+	mutable ReadWriteLock lock;
+	ContentsMap contents;
+	size_t contents_size;
+	size_t contents_limit;
+	size_t references;
+};
+
+}
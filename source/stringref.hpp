@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace filesystem
+{
+
+// Null terminated string borrowed from the caller (a Lua string, a std::string or a stack buffer),
+// so requests reach validation and the caches without copying their arguments. Named like
+// std::string's members so it can stand in for one, it must not outlive what it points to.
+class StringRef
+{
+public:
+	StringRef( const char *str ) :
+		string( str ),
+		length( std::strlen( str ) )
+	{ }
+
+	StringRef( const char *str, size_t len ) :
+		string( str ),
+		length( len )
+	{ }
+
+	StringRef( const std::string &str ) :
+		string( str.c_str( ) ),
+		length( str.size( ) )
+	{ }
+
+	const char *c_str( ) const
+	{
+		return string;
+	}
+
+	size_t size( ) const
+	{
+		return length;
+	}
+
+	bool empty( ) const
+	{
+		return length == 0;
+	}
+
+	char operator[]( size_t pos ) const
+	{
+		return string[pos];
+	}
+
+	bool Equals( const std::string &str ) const
+	{
+		return str.size( ) == length && std::memcmp( str.c_str( ), string, length ) == 0;
+	}
+
+	// the only way to a std::string, so copies stay visible where they're made
+	std::string ToString( ) const
+	{
+		return std::string( string, length );
+	}
+
+private:
+	const char *string;
+	size_t length;
+};
+
+}
@@ -0,0 +1,94 @@
+#include "threadpool.hpp"
+
+namespace filesystem
+{
+
+ThreadPool::ThreadPool( ) :
+	stopping( false )
+{ }
+
+ThreadPool::~ThreadPool( )
+{
+	Stop( );
+}
+
+bool ThreadPool::Start( size_t count )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	if( !threads.empty( ) )
+		return true;
+
+	if( count == 0 )
+		count = std::thread::hardware_concurrency( );
+
+	if( count == 0 )
+		count = 2;
+
+	stopping = false;
+	threads.reserve( count );
+	for( size_t k = 0; k < count; ++k )
+		threads.emplace_back( &ThreadPool::Work, this );
+
+	return true;
+}
+
+void ThreadPool::Stop( )
+{
+	std::vector<std::thread> workers;
+
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		stopping = true;
+		workers.swap( threads );
+	}
+
+	condition.notify_all( );
+
+	for( auto it = workers.begin( ); it != workers.end( ); ++it )
+		it->join( );
+}
+
+bool ThreadPool::Post( Task task )
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		if( threads.empty( ) )
+			return false;
+
+		tasks.push_back( std::move( task ) );
+	}
+
+	condition.notify_one( );
+	return true;
+}
+
+size_t ThreadPool::GetThreadCount( ) const
+{
+	return threads.size( );
+}
+
+void ThreadPool::Work( )
+{
+	while( true )
+	{
+		Task task;
+
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			condition.wait( lock, [this]
+			{
+				return stopping || !tasks.empty( );
+			} );
+
+			if( tasks.empty( ) )
+				return;
+
+			task = std::move( tasks.front( ) );
+			tasks.pop_front( );
+		}
+
+		task( );
+	}
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace filesystem
+{
+
+// Fixed set of worker threads for background filesystem work (prefetching, scans).
+// Tasks must never touch Lua states, those are only usable from the main thread.
+class ThreadPool
+{
+public:
+	typedef std::function<void( )> Task;
+
+	ThreadPool( );
+	~ThreadPool( );
+
+	// starts as many threads as hardware threads when count is 0
+	bool Start( size_t count = 0 );
+	// waits for every queued task to finish before joining the threads
+	void Stop( );
+
+	bool Post( Task task );
+
+	size_t GetThreadCount( ) const;
+
+private:
+	ThreadPool( const ThreadPool & ) = delete;
+	ThreadPool &operator=( const ThreadPool & ) = delete;
+
+	void Work( );
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<Task> tasks;
+	std::vector<std::thread> threads;
+	bool stopping;
+};
+
+}
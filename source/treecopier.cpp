@@ -0,0 +1,148 @@
+#include "treecopier.hpp"
+#include "walker.hpp"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+namespace filesystem
+{
+
+static const size_t max_copy_depth = 1024;
+
+static std::string TrimSeparators( std::string path )
+{
+	while( path.size( ) > 1 && ( path.back( ) == '/' || path.back( ) == '\\' ) )
+		path.pop_back( );
+
+	return path;
+}
+
+TreeCopier::TreeCopier(
+	const std::string &src,
+	const std::string &dst,
+	bool over,
+	Filter filt,
+	size_t count
+) :
+	source( TrimSeparators( src ) ),
+	destination( TrimSeparators( dst ) ),
+	overwrite( over ),
+	filter( std::move( filt ) ),
+	threads( count ),
+	source_handle( -1 ),
+	destination_handle( -1 )
+{
+	if( threads == 0 )
+		threads = std::thread::hardware_concurrency( );
+
+	if( threads == 0 )
+		threads = 2;
+}
+
+TreeCopier::~TreeCopier( )
+{
+	CloseRoots( );
+}
+
+void TreeCopier::Hold( std::shared_ptr<void> resource )
+{
+	held = std::move( resource );
+}
+
+TreeCopier::Result TreeCopier::Run( )
+{
+	Result copied = { 0, 0, 0, true };
+
+	// a file (or a link) as the source would otherwise leave an empty directory behind
+	if( !OpenRoots( ) )
+	{
+		copied.complete = false;
+		return copied;
+	}
+
+	Walker::Options options;
+	options.threads = threads;
+	options.max_depth = max_copy_depth;
+
+	std::map<std::string, std::vector<std::string>> files;
+	std::vector<std::string> directories;
+
+	{
+		Walker walker( std::vector<std::string>( 1, source ), options );
+		walker.Start( );
+		walker.Wait( );
+
+		Walker::Batch entries;
+		walker.Take( entries );
+		for( auto it = entries.begin( ); it != entries.end( ); ++it )
+		{
+			if( it->directory )
+			{
+				directories.push_back( std::move( it->path ) );
+				continue;
+			}
+
+			if( filter && !filter( it->path ) )
+			{
+				++copied.skipped;
+				continue;
+			}
+
+			const size_t slash = it->path.rfind( '/' );
+			if( slash == it->path.npos )
+				files[std::string( )].push_back( std::move( it->path ) );
+			else
+				files[it->path.substr( 0, slash )].push_back( it->path.substr( slash + 1 ) );
+		}
+	}
+
+	// parents before children
+	std::sort( directories.begin( ), directories.end( ), []( const std::string &a, const std::string &b )
+	{
+		return std::count( a.begin( ), a.end( ), '/' ) < std::count( b.begin( ), b.end( ), '/' );
+	} );
+
+	for( auto it = directories.begin( ); it != directories.end( ); ++it )
+		if( !MakeDirectory( *it ) )
+			copied.complete = false;
+
+	// every directory is copied by a single thread, directories are spread over the threads
+	std::vector<std::pair<const std::string, std::vector<std::string>> *> groups;
+	groups.reserve( files.size( ) );
+	for( auto it = files.begin( ); it != files.end( ); ++it )
+		groups.push_back( &*it );
+
+	std::atomic<size_t> next( 0 );
+	std::mutex mutex;
+	auto work = [&]
+	{
+		uint64_t count = 0, bytes = 0, skipped = 0;
+		bool complete = true;
+		for( size_t k = next++; k < groups.size( ); k = next++ )
+			complete = CopyFiles( groups[k]->first, groups[k]->second, count, bytes, skipped ) && complete;
+
+		std::lock_guard<std::mutex> lock( mutex );
+		copied.files += count;
+		copied.bytes += bytes;
+		copied.skipped += skipped;
+		copied.complete = copied.complete && complete;
+	};
+
+	std::vector<std::thread> pool;
+	const size_t count = std::min( threads, groups.size( ) );
+	for( size_t k = 1; k < count; ++k )
+		pool.emplace_back( work );
+
+	work( );
+	for( auto it = pool.begin( ); it != pool.end( ); ++it )
+		it->join( );
+
+	CloseRoots( );
+	return copied;
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+namespace filesystem
+{
+
+// Copies a directory tree between full paths. The source is listed with a Walker, directories are
+// created parents first and files are copied on parallel threads, kernel side where possible.
+// Validation is up to the caller, the filter decides which relative file paths get copied.
+// Links are skipped, and entries are reached relative to the opened roots where the platform
+// allows it.
+class TreeCopier
+{
+public:
+	struct Result
+	{
+		uint64_t files;
+		uint64_t bytes;
+		// files the filter refused, links and anything else that isn't a regular file
+		uint64_t skipped;
+		// false when something couldn't be copied
+		bool complete;
+	};
+
+	typedef std::function<bool( const std::string &relative )> Filter;
+
+	// hardware threads when 0
+	TreeCopier(
+		const std::string &source,
+		const std::string &destination,
+		bool overwrite,
+		Filter filter,
+		size_t threads = 0
+	);
+	~TreeCopier( );
+
+	// incomplete without copying anything when the source isn't a directory
+	Result Run( );
+
+	// released along with the copier, ties whatever the caller needs to the copy's lifetime
+	void Hold( std::shared_ptr<void> resource );
+
+	// implemented per platform, reflinks or copies inside the kernel when the filesystem allows it,
+	// into a temporary file next to destination that then takes its place, fails when source is a
+	// link, when both are the same file and when destination exists and overwrite isn't set
+	static bool CopyFileContents(
+		const std::string &source,
+		const std::string &destination,
+		bool overwrite,
+		uint64_t &bytes
+	);
+
+private:
+	TreeCopier( const TreeCopier & ) = delete;
+	TreeCopier &operator=( const TreeCopier & ) = delete;
+
+	// implemented per platform, false when the source isn't a directory (links and reparse points
+	// aren't either) or the destination can't be created, paths are relative to the roots and
+	// separated by '/'
+	bool OpenRoots( );
+	void CloseRoots( );
+	// succeeds when the directory already exists
+	bool MakeDirectory( const std::string &relative ) const;
+	// copies names from directory below the source to the same directory below the destination
+	bool CopyFiles(
+		const std::string &directory,
+		const std::vector<std::string> &names,
+		uint64_t &files,
+		uint64_t &bytes,
+		uint64_t &skipped
+	) const;
+
+	std::string source;
+	std::string destination;
+	bool overwrite;
+	Filter filter;
+	size_t threads;
+	// platform specific handles to the opened roots, -1 when they aren't open
+	intptr_t source_handle;
+	intptr_t destination_handle;
+	std::shared_ptr<void> held;
+};
+
+}
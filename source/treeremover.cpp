@@ -0,0 +1,186 @@
+#include "treeremover.hpp"
+#include "walker.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <map>
+#include <set>
+#include <mutex>
+
+namespace filesystem
+{
+
+// deeper than anything the engine would let us create, ends up as an incomplete removal
+static const size_t max_remove_depth = 1024;
+
+TreeRemover::TreeRemover( const std::string &fullpath, Filter filt, size_t count ) :
+	root( fullpath ),
+	filter( std::move( filt ) ),
+	threads( count ),
+	handle( -1 ),
+	finished( false ),
+	result( )
+{
+	while( root.size( ) > 1 && ( root.back( ) == '/' || root.back( ) == '\\' ) )
+		root.pop_back( );
+
+	if( threads == 0 )
+		threads = std::thread::hardware_concurrency( );
+
+	if( threads == 0 )
+		threads = 2;
+}
+
+TreeRemover::~TreeRemover( )
+{
+	if( worker.joinable( ) )
+		worker.join( );
+
+	CloseRoot( );
+}
+
+// marks directory and every directory above it as kept
+static void Keep( std::set<std::string> &kept, std::string directory )
+{
+	kept.insert( std::string( ) );
+	while( !directory.empty( ) && kept.insert( directory ).second )
+	{
+		const size_t slash = directory.rfind( '/' );
+		directory.erase( slash == directory.npos ? 0 : slash );
+	}
+}
+
+TreeRemover::Result TreeRemover::Run( )
+{
+	Result removed = { 0, 0, 0, true };
+
+	if( !OpenRoot( ) )
+	{
+		if( filter && !filter( root.substr( root.find_last_of( "/\\" ) + 1 ) ) )
+			++removed.skipped;
+		else
+			removed.complete = RemoveRootFile( removed.entries, removed.bytes );
+
+		return removed;
+	}
+
+	Walker::Options options;
+	options.threads = threads;
+	options.max_depth = max_remove_depth;
+
+	std::map<std::string, std::vector<std::string>> files;
+	std::vector<std::string> directories;
+	std::set<std::string> kept;
+
+	{
+		Walker walker( std::vector<std::string>( 1, root ), options );
+		walker.Start( );
+		walker.Wait( );
+
+		Walker::Batch entries;
+		walker.Take( entries );
+		for( auto it = entries.begin( ); it != entries.end( ); ++it )
+		{
+			if( it->directory )
+			{
+				directories.push_back( std::move( it->path ) );
+				continue;
+			}
+
+			const size_t slash = it->path.rfind( '/' );
+			std::string directory = slash == it->path.npos ? std::string( ) : it->path.substr( 0, slash );
+			if( filter && !filter( it->path ) )
+			{
+				++removed.skipped;
+				Keep( kept, std::move( directory ) );
+				continue;
+			}
+
+			std::string name = slash == it->path.npos ? std::move( it->path ) : it->path.substr( slash + 1 );
+			files[directory].push_back( std::move( name ) );
+		}
+	}
+
+	// every directory is unlinked by a single thread, directories are spread over the threads
+	std::vector<std::pair<const std::string, std::vector<std::string>> *> groups;
+	groups.reserve( files.size( ) );
+	for( auto it = files.begin( ); it != files.end( ); ++it )
+		groups.push_back( &*it );
+
+	std::atomic<size_t> next( 0 );
+	std::mutex mutex;
+	auto work = [&]
+	{
+		uint64_t entries = 0, bytes = 0;
+		bool complete = true;
+		for( size_t k = next++; k < groups.size( ); k = next++ )
+			complete = RemoveFiles( groups[k]->first, groups[k]->second, entries, bytes ) && complete;
+
+		std::lock_guard<std::mutex> lock( mutex );
+		removed.entries += entries;
+		removed.bytes += bytes;
+		removed.complete = removed.complete && complete;
+	};
+
+	std::vector<std::thread> pool;
+	const size_t count = std::min( threads, groups.size( ) );
+	for( size_t k = 1; k < count; ++k )
+		pool.emplace_back( work );
+
+	work( );
+	for( auto it = pool.begin( ); it != pool.end( ); ++it )
+		it->join( );
+
+	// children before parents
+	std::sort( directories.begin( ), directories.end( ), []( const std::string &a, const std::string &b )
+	{
+		return std::count( a.begin( ), a.end( ), '/' ) > std::count( b.begin( ), b.end( ), '/' );
+	} );
+
+	directories.push_back( std::string( ) );
+	for( auto it = directories.begin( ); it != directories.end( ); ++it )
+	{
+		// still holding skipped files
+		if( kept.find( *it ) != kept.end( ) )
+			continue;
+
+		if( RemoveEmptyDirectory( *it ) )
+			++removed.entries;
+		else
+			removed.complete = false;
+	}
+
+	CloseRoot( );
+	return removed;
+}
+
+void TreeRemover::Start( )
+{
+	if( worker.joinable( ) || finished )
+		return;
+
+	worker = std::thread( [this]
+	{
+		result = Run( );
+		finished = true;
+	} );
+}
+
+void TreeRemover::Hold( std::shared_ptr<void> resource )
+{
+	held = std::move( resource );
+}
+
+bool TreeRemover::Poll( Result &removed )
+{
+	if( !finished )
+		return false;
+
+	if( worker.joinable( ) )
+		worker.join( );
+
+	removed = result;
+	return true;
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+
+namespace filesystem
+{
+
+// Removes a loose file or a whole directory tree. The tree is listed with a Walker, then files
+// are unlinked directory by directory on parallel threads and directories removed deepest first.
+// Validation of the root is up to the caller, the filter decides which relative file paths get
+// removed, entries are removed relative to the opened root where the platform allows it.
+class TreeRemover
+{
+public:
+	struct Result
+	{
+		uint64_t entries;
+		uint64_t bytes;
+		// files the filter refused, they're left in place along with the directories holding them
+		uint64_t skipped;
+		// false when something couldn't be removed
+		bool complete;
+	};
+
+	typedef std::function<bool( const std::string &relative )> Filter;
+
+	// hardware threads when 0
+	TreeRemover( const std::string &fullpath, Filter filter, size_t threads = 0 );
+	~TreeRemover( );
+
+	Result Run( );
+
+	// runs on a thread of its own, Poll returns true and fills result once it finished
+	void Start( );
+	bool Poll( Result &result );
+
+	// released along with the remover, ties whatever the caller needs to the removal's lifetime
+	void Hold( std::shared_ptr<void> resource );
+
+private:
+	TreeRemover( const TreeRemover & ) = delete;
+	TreeRemover &operator=( const TreeRemover & ) = delete;
+
+	// implemented per platform, false when the root isn't a directory (links and reparse points
+	// aren't either), paths are relative to the root and separated by '/'
+	bool OpenRoot( );
+	void CloseRoot( );
+	// names are relative to directory, sizes are counted before unlinking
+	bool RemoveFiles(
+		const std::string &directory,
+		const std::vector<std::string> &names,
+		uint64_t &entries,
+		uint64_t &bytes
+	) const;
+	// an empty relative removes the root itself
+	bool RemoveEmptyDirectory( const std::string &relative ) const;
+	// for roots that aren't directories, removes the root itself
+	bool RemoveRootFile( uint64_t &entries, uint64_t &bytes ) const;
+
+	std::string root;
+	Filter filter;
+	size_t threads;
+	// platform specific handle to the opened root, -1 when it isn't open
+	intptr_t handle;
+	std::thread worker;
+	std::atomic<bool> finished;
+	Result result;
+	std::shared_ptr<void> held;
+};
+
+}
@@ -0,0 +1,269 @@
+#include "walker.hpp"
+
+namespace filesystem
+{
+
+static const size_t flush_threshold = 512;
+
+Walker::Options::Options( ) :
+	threads( 0 ),
+	max_depth( 64 ),
+	limit( 0 ),
+	stat( false ),
+	unique( true )
+{ }
+
+Walker::Walker( const std::vector<std::string> &paths, const Options &opts ) :
+	options( opts ),
+	pending( 0 ),
+	queued( 0 ),
+	running( 0 ),
+	found( 0 ),
+	cancelled( false ),
+	output_offset( 0 ),
+	delivered( 0 )
+{
+	roots.reserve( paths.size( ) );
+	for( auto it = paths.begin( ); it != paths.end( ); ++it )
+	{
+		Root root;
+		root.path = *it;
+		while( root.path.size( ) > 1 && ( root.path.back( ) == '/' || root.path.back( ) == '\\' ) )
+			root.path.pop_back( );
+
+		root.handle = -1;
+		roots.push_back( std::move( root ) );
+	}
+
+	if( options.threads == 0 )
+		options.threads = std::thread::hardware_concurrency( );
+
+	if( options.threads == 0 )
+		options.threads = 2;
+}
+
+Walker::~Walker( )
+{
+	Cancel( );
+
+	for( auto it = roots.begin( ); it != roots.end( ); ++it )
+		if( it->handle != -1 )
+			CloseRoot( it->handle );
+}
+
+void Walker::Start( )
+{
+	if( !threads.empty( ) || !queues.empty( ) )
+		return;
+
+	queues.reserve( options.threads );
+	for( size_t k = 0; k < options.threads; ++k )
+		queues.emplace_back( new Queue );
+
+	for( uint32_t k = 0; k < roots.size( ); ++k )
+	{
+		roots[k].handle = OpenRoot( roots[k].path );
+		if( roots[k].handle != -1 && options.max_depth != 0 )
+			Push( k % options.threads, Job{ k, 0, std::string( ) } );
+	}
+
+	running = options.threads;
+	threads.reserve( options.threads );
+	for( size_t k = 0; k < options.threads; ++k )
+		threads.emplace_back( &Walker::Work, this, k );
+}
+
+void Walker::Cancel( )
+{
+	cancelled = true;
+	Wake( true );
+	Wait( );
+}
+
+void Walker::Wait( )
+{
+	for( auto it = threads.begin( ); it != threads.end( ); ++it )
+		if( it->joinable( ) )
+			it->join( );
+}
+
+bool Walker::Take( Batch &batch, size_t max, bool block )
+{
+	batch.clear( );
+
+	std::unique_lock<std::mutex> lock( output_mutex );
+	if( block )
+		available.wait( lock, [this]( )
+		{
+			return output_offset < output.size( ) || running == 0;
+		} );
+	while( output_offset < output.size( ) && ( max == 0 || batch.size( ) < max ) )
+	{
+		if( options.limit != 0 && delivered >= options.limit )
+		{
+			output_offset = output.size( );
+			break;
+		}
+
+		Entry &entry = output[output_offset++];
+		// the same relative path can exist under several roots
+		if( options.unique && roots.size( ) > 1 && !seen.insert( entry.path ).second )
+			continue;
+
+		batch.push_back( std::move( entry ) );
+		++delivered;
+	}
+
+	if( output_offset == output.size( ) )
+	{
+		output.clear( );
+		output_offset = 0;
+	}
+
+	if( options.limit != 0 && delivered >= options.limit )
+	{
+		cancelled = true;
+		Wake( true );
+		return false;
+	}
+
+	return running != 0 || !output.empty( );
+}
+
+void Walker::Work( size_t index )
+{
+	std::vector<char> buffer;
+	Listing listing;
+	Batch batch;
+	Job job;
+	while( !cancelled )
+	{
+		if( !Pop( index, job ) )
+		{
+			std::unique_lock<std::mutex> lock( idle_mutex );
+			idle.wait( lock, [this]( )
+			{
+				return cancelled || queued != 0 || pending == 0;
+			} );
+
+			if( pending == 0 )
+				break;
+
+			continue;
+		}
+
+		listing.clear( );
+		ReadDirectory( roots[job.root], job.relative, options.stat, buffer, listing );
+		for( auto it = listing.begin( ); it != listing.end( ); ++it )
+		{
+			std::string path = job.relative.empty( ) ? it->name : job.relative + '/' + it->name;
+			if( it->directory && job.depth + 1 < options.max_depth )
+				Push( index, Job{ job.root, job.depth + 1, path } );
+
+			batch.push_back( Entry{ std::move( path ), it->directory, it->size, it->allocated } );
+		}
+
+		if( batch.size( ) >= flush_threshold )
+			Flush( batch );
+
+		// children were queued before this, so reaching 0 means the whole tree was read
+		if( --pending == 0 )
+			Wake( true );
+	}
+
+	Flush( batch );
+
+	{
+		std::lock_guard<std::mutex> lock( output_mutex );
+		--running;
+	}
+
+	available.notify_all( );
+}
+
+void Walker::Push( size_t index, Job job )
+{
+	++pending;
+
+	{
+		Queue &queue = *queues[index];
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		queue.jobs.push_back( std::move( job ) );
+		++queued;
+	}
+
+	Wake( false );
+}
+
+bool Walker::Pop( size_t index, Job &job )
+{
+	{
+		// depth first on our own queue keeps the working set small
+		Queue &queue = *queues[index];
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		if( !queue.jobs.empty( ) )
+		{
+			job = std::move( queue.jobs.back( ) );
+			queue.jobs.pop_back( );
+			--queued;
+			return true;
+		}
+	}
+
+	// steal the oldest (and usually biggest) subtrees from the others
+	for( size_t k = 1; k < queues.size( ); ++k )
+	{
+		Queue &queue = *queues[( index + k ) % queues.size( )];
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		if( !queue.jobs.empty( ) )
+		{
+			job = std::move( queue.jobs.front( ) );
+			queue.jobs.pop_front( );
+			--queued;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Walker::Wake( bool all )
+{
+	// taking the mutex orders this after any worker that checked the state but isn't waiting yet
+	{
+		std::lock_guard<std::mutex> lock( idle_mutex );
+	}
+
+	if( all )
+		idle.notify_all( );
+	else
+		idle.notify_one( );
+}
+
+void Walker::Flush( Batch &batch )
+{
+	if( batch.empty( ) )
+		return;
+
+	const size_t count = batch.size( );
+
+	{
+		std::lock_guard<std::mutex> lock( output_mutex );
+		if( output.empty( ) )
+			output.swap( batch );
+		else
+			output.insert( output.end( ), std::make_move_iterator( batch.begin( ) ), std::make_move_iterator( batch.end( ) ) );
+	}
+
+	available.notify_all( );
+	batch.clear( );
+
+	// duplicates across roots are only dropped when taken, so only walks without them can stop here
+	if( options.limit != 0 && ( found += count ) >= options.limit && ( roots.size( ) == 1 || !options.unique ) )
+	{
+		cancelled = true;
+		Wake( true );
+	}
+}
+
+}
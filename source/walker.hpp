@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace filesystem
+{
+
+// Parallel recursive walk over loose directory trees. Every worker owns a queue of directories,
+// takes work from its back and steals from the front of the others when it runs dry.
+// Entries are collected in batches the owner takes from its own thread.
+class Walker
+{
+public:
+	struct Entry
+	{
+		// relative to the root, separated by '/'
+		std::string path;
+		bool directory;
+		// only filled when stating, 0 for directories
+		uint64_t size;
+		// bytes actually allocated on disk, only filled when stating
+		uint64_t allocated;
+	};
+
+	typedef std::vector<Entry> Batch;
+
+	// one directory entry as the platform lists it
+	struct Listed
+	{
+		std::string name;
+		bool directory;
+		uint64_t size;
+		uint64_t allocated;
+	};
+
+	typedef std::vector<Listed> Listing;
+
+	struct Options
+	{
+		Options( );
+
+		// hardware threads when 0
+		size_t threads;
+		size_t max_depth;
+		// 0 means no limit
+		size_t limit;
+		// fills sizes of files, costs a stat per file where listings don't include them
+		bool stat;
+		// reports a path found under several roots once, which means remembering every path
+		// taken; without it each root's copy is reported
+		bool unique;
+	};
+
+	// roots are walked as one tree, with unique a path found under several of them is reported
+	// once, from whichever root happened to be read first
+	Walker( const std::vector<std::string> &roots, const Options &options );
+	~Walker( );
+
+	void Start( );
+	// stops the workers early, entries found until then can still be taken
+	void Cancel( );
+	// blocks until every directory was read
+	void Wait( );
+
+	// moves up to max entries (0 for all) into batch, returns false once nothing else will come;
+	// with block it waits for entries instead of returning an empty batch while workers still run
+	bool Take( Batch &batch, size_t max = 0, bool block = false );
+
+private:
+	struct Job
+	{
+		uint32_t root;
+		uint32_t depth;
+		std::string relative;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	struct Root
+	{
+		std::string path;
+		// platform specific handle to the opened root, -1 when it couldn't be opened
+		intptr_t handle;
+	};
+
+	Walker( const Walker & ) = delete;
+	Walker &operator=( const Walker & ) = delete;
+
+	void Work( size_t index );
+	void Push( size_t index, Job job );
+	bool Pop( size_t index, Job &job );
+	void Flush( Batch &batch );
+	// wakes idle workers after the state their wait checks changed
+	void Wake( bool all );
+
+	// implemented per platform, buffer is scratch space owned by each worker
+	static intptr_t OpenRoot( const std::string &path );
+	static void CloseRoot( intptr_t handle );
+	static bool ReadDirectory(
+		const Root &root,
+		const std::string &relative,
+		bool stat,
+		std::vector<char> &buffer,
+		Listing &listing
+	);
+
+	std::vector<Root> roots;
+	Options options;
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+	// directories queued or being read, and those only queued
+	std::atomic<size_t> pending;
+	std::atomic<size_t> queued;
+	std::atomic<size_t> running;
+	std::atomic<size_t> found;
+	std::atomic<bool> cancelled;
+	std::mutex idle_mutex;
+	std::condition_variable idle;
+
+	std::mutex output_mutex;
+	// signaled when entries are flushed and when a worker finishes
+	std::condition_variable available;
+	Batch output;
+	size_t output_offset;
+
+	// only touched by the owner thread, only filled with unique and several roots
+	std::unordered_set<std::string> seen;
+	size_t delivered;
+};
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <functional>
+
+namespace filesystem
+{
+
+// Non-blocking directory change notifications (inotify on Linux, ReadDirectoryChangesW on Windows).
+// Watches are not recursive, each directory has to be added on its own.
+class Watcher
+{
+public:
+	enum Events
+	{
+		Created = 1 << 0,
+		Modified = 1 << 1,
+		Removed = 1 << 2,
+		Renamed = 1 << 3,
+		// the watched directory itself is gone, its id is no longer valid
+		Gone = 1 << 4,
+		// events were lost, everything should be considered changed
+		Overflow = 1 << 5,
+		// the entry the event is about is a directory
+		Directory = 1 << 6
+	};
+
+	// id is -1 for Overflow, name is empty when the event is about the directory itself
+	typedef std::function<void( int32_t id, const std::string &name, uint32_t events )> Callback;
+
+	Watcher( );
+	~Watcher( );
+
+	bool Available( ) const;
+
+	// returns the same id when a directory is added twice, -1 on failure
+	int32_t Add( const std::string &directory );
+	void Remove( int32_t id );
+
+	// drains pending events without blocking
+	void Poll( const Callback &callback );
+
+private:
+	Watcher( const Watcher & ) = delete;
+	Watcher &operator=( const Watcher & ) = delete;
+
+#if defined SYSTEM_WINDOWS
+
+	// overlapped directory handles by id
+	void *watches;
+
+#else
+
+	int descriptor;
+
+#endif
+
+};
+
+}
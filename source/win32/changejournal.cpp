@@ -0,0 +1,24 @@
+#include "changejournal.hpp"
+#include "unicode.hpp"
+
+#include <Windows.h>
+
+namespace filesystem
+{
+
+FILE *ChangeJournal::OpenLog( const std::string &fullpath, const char *mode )
+{
+	const std::string options = mode;
+	const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) ),
+		woptions = Unicode::UTF8::ToUTF16( options.begin( ), options.end( ) );
+	return _wfopen( wpath.c_str( ), woptions.c_str( ) );
+}
+
+bool ChangeJournal::ReplaceLog( const std::string &source, const std::string &destination )
+{
+	const std::wstring wsource = Unicode::UTF8::ToUTF16( source.begin( ), source.end( ) ),
+		wdestination = Unicode::UTF8::ToUTF16( destination.begin( ), destination.end( ) );
+	return MoveFileExW( wsource.c_str( ), wdestination.c_str( ), MOVEFILE_REPLACE_EXISTING ) != 0;
+}
+
+}
@@ -0,0 +1,186 @@
+#include "directoryindex.hpp"
+#include "unicode.hpp"
+
+#include <Windows.h>
+
+#include <cstdlib>
+#include <algorithm>
+
+namespace filesystem
+{
+
+static int64_t FileTimeToUnix( const FILETIME &filetime )
+{
+	const uint64_t high = static_cast<uint64_t>( filetime.dwHighDateTime ),
+		low = static_cast<uint64_t>( filetime.dwLowDateTime );
+	const int64_t ticks = static_cast<int64_t>( ( high << 32 ) | low );
+	// FILETIME counts 100 nanosecond intervals since 1601-01-01
+	return ( ticks - 116444736000000000LL ) / 10000000LL;
+}
+
+static std::wstring ToNativePath( const std::string &fullpath )
+{
+	std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+	for( auto it = wpath.begin( ); it != wpath.end( ); ++it )
+		if( *it == L'/' )
+			*it = L'\\';
+
+	return wpath;
+}
+
+std::string DirectoryIndex::GetCacheDirectory( )
+{
+	const wchar_t *local = _wgetenv( L"LOCALAPPDATA" );
+	if( local == nullptr || local[0] == L'\0' )
+		return std::string( );
+
+	const std::wstring wdirectory = std::wstring( local ) + L"\\gm_filesystem";
+	if( !CreateDirectoryW( wdirectory.c_str( ), nullptr ) && GetLastError( ) != ERROR_ALREADY_EXISTS )
+		return std::string( );
+
+	return Unicode::UTF16::ToUTF8( wdirectory.begin( ), wdirectory.end( ) );
+}
+
+const char *DirectoryIndex::MapFile( const std::string &fullpath, size_t &length, intptr_t &mapping )
+{
+	const std::wstring wpath = ToNativePath( fullpath );
+	HANDLE file = CreateFileW(
+		wpath.c_str( ),
+		GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_DELETE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr
+	);
+	if( file == INVALID_HANDLE_VALUE )
+		return nullptr;
+
+	LARGE_INTEGER filesize;
+	if( !GetFileSizeEx( file, &filesize ) || filesize.QuadPart <= 0 ||
+		static_cast<uint64_t>( filesize.QuadPart ) > SIZE_MAX )
+	{
+		CloseHandle( file );
+		return nullptr;
+	}
+
+	// the mapping object keeps the file open on its own
+	HANDLE object = CreateFileMappingW( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	CloseHandle( file );
+	if( object == nullptr )
+		return nullptr;
+
+	const void *view = MapViewOfFile( object, FILE_MAP_READ, 0, 0, 0 );
+	if( view == nullptr )
+	{
+		CloseHandle( object );
+		return nullptr;
+	}
+
+	length = static_cast<size_t>( filesize.QuadPart );
+	mapping = reinterpret_cast<intptr_t>( object );
+	return static_cast<const char *>( view );
+}
+
+void DirectoryIndex::UnmapFile( const char *view, size_t, intptr_t mapping )
+{
+	UnmapViewOfFile( view );
+	CloseHandle( reinterpret_cast<HANDLE>( mapping ) );
+}
+
+bool DirectoryIndex::SaveFile( const std::string &fullpath, const std::string &contents )
+{
+	const std::wstring wpath = ToNativePath( fullpath ), wtemporary = wpath + L".tmp";
+	HANDLE file = CreateFileW(
+		wtemporary.c_str( ),
+		GENERIC_WRITE,
+		0,
+		nullptr,
+		CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr
+	);
+	if( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	bool written = true;
+	for( size_t offset = 0; offset < contents.size( ) && written; )
+	{
+		const DWORD chunk = static_cast<DWORD>( std::min<size_t>( contents.size( ) - offset, 1 << 30 ) );
+		DWORD done = 0;
+		written = WriteFile( file, contents.data( ) + offset, chunk, &done, nullptr ) && done == chunk;
+		offset += done;
+	}
+
+	CloseHandle( file );
+	if( !written || !MoveFileExW( wtemporary.c_str( ), wpath.c_str( ), MOVEFILE_REPLACE_EXISTING ) )
+	{
+		DeleteFileW( wtemporary.c_str( ) );
+		return false;
+	}
+
+	return true;
+}
+
+bool DirectoryIndex::GetDirectoryTime( const std::string &fullpath, int64_t &mtime )
+{
+	const std::wstring wpath = ToNativePath( fullpath );
+	WIN32_FILE_ATTRIBUTE_DATA file_data;
+	if( !GetFileAttributesExW( wpath.c_str( ), GetFileExInfoStandard, &file_data ) ||
+		( file_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) == 0 )
+		return false;
+
+	mtime = FileTimeToUnix( file_data.ftLastWriteTime );
+	return true;
+}
+
+bool DirectoryIndex::ListDirectory( const std::string &fullpath, std::vector<Listed> &listing )
+{
+	const std::wstring wpattern = ToNativePath( fullpath ) + L"\\*";
+
+	WIN32_FIND_DATAW find_data;
+	HANDLE handle = FindFirstFileExW(
+		wpattern.c_str( ),
+		FindExInfoBasic,
+		&find_data,
+		FindExSearchNameMatch,
+		nullptr,
+		FIND_FIRST_EX_LARGE_FETCH
+	);
+	if( handle == INVALID_HANDLE_VALUE )
+		return false;
+
+	do
+	{
+		const std::wstring name = find_data.cFileName;
+		if( name.compare( L"." ) == 0 || name.compare( L".." ) == 0 )
+			continue;
+
+		// junctions and symbolic links report their own times, good enough for what they point to
+		const bool directory = ( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+		listing.push_back( Listed{
+			Unicode::UTF16::ToUTF8( name.begin( ), name.end( ) ),
+			directory,
+			directory ? 0 : ( static_cast<uint64_t>( find_data.nFileSizeHigh ) << 32 ) | find_data.nFileSizeLow,
+			FileTimeToUnix( find_data.ftLastWriteTime ),
+			( find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) != 0
+		} );
+	}
+	while( FindNextFileW( handle, &find_data ) );
+
+	FindClose( handle );
+	return true;
+}
+
+bool DirectoryIndex::StatListing( const std::string &fullpath, std::vector<Listed> &listing )
+{
+	// listing hands out the same details a file at a time would, in a single pass
+	std::vector<Listed> fresh;
+	if( !ListDirectory( fullpath, fresh ) )
+		return false;
+
+	listing.swap( fresh );
+	return true;
+}
+
+}
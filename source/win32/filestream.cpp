@@ -1,10 +1,55 @@
 #include "filestream.hpp"
+#include "threadpool.hpp"
+
+#include <vector>
+#include <algorithm>
+
+#include <Windows.h>
 
 namespace file
 {
 
-Stream::Stream( FILE *handle ) :
-	filehandle( handle )
+void PrefetchFile( const std::wstring &path, int64_t offset, int64_t len )
+{
+	HANDLE handle = CreateFileW(
+		path.c_str( ),
+		GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr
+	);
+	if( handle == INVALID_HANDLE_VALUE )
+		return;
+
+	LARGE_INTEGER position;
+	position.QuadPart = offset;
+	if( SetFilePointerEx( handle, position, nullptr, FILE_BEGIN ) )
+	{
+		// there's no readahead call on Windows, reading through the cache manager is the closest thing
+		std::vector<char> buffer( 256 * 1024 );
+		DWORD read = 0;
+		while( len != 0 )
+		{
+			const DWORD chunk = static_cast<DWORD>(
+				len < 0 ? buffer.size( ) : std::min<int64_t>( len, static_cast<int64_t>( buffer.size( ) ) )
+			);
+			if( !ReadFile( handle, buffer.data( ), chunk, &read, nullptr ) || read == 0 )
+				break;
+
+			if( len > 0 )
+				len -= read;
+		}
+	}
+
+	CloseHandle( handle );
+}
+
+Stream::Stream( FILE *handle, const std::wstring &path, filesystem::ThreadPool *pool ) :
+	filehandle( handle ),
+	filepath( path ),
+	threadpool( pool )
 { }
 
 Stream::~Stream( )
@@ -95,4 +140,16 @@ size_t Stream::Write( const void *buffer, size_t len )
 	return fwrite( buffer, 1, len, filehandle );
 }
 
+bool Stream::Prefetch( int64_t offset, int64_t len )
+{
+	if( !Valid( ) || offset < 0 || filepath.empty( ) || threadpool == nullptr )
+		return false;
+
+	const std::wstring path = filepath;
+	return threadpool->Post( [path, offset, len]
+	{
+		PrefetchFile( path, offset, len );
+	} );
+}
+
 }
@@ -3,6 +3,14 @@
 #include "filebase.hpp"
 
 #include <cstdio>
+#include <string>
+
+namespace filesystem
+{
+
+class ThreadPool;
+
+}
 
 namespace file
 {
@@ -10,7 +18,7 @@ namespace file
 class Stream : public Base
 {
 public:
-	Stream( FILE *handle );
+	Stream( FILE *handle, const std::wstring &path = std::wstring( ), filesystem::ThreadPool *pool = nullptr );
 	~Stream( );
 
 	bool Valid( ) const;
@@ -28,8 +36,15 @@ public:
 	size_t Read( void *buffer, size_t len );
 	size_t Write( const void *buffer, size_t len );
 
+	bool Prefetch( int64_t offset, int64_t len );
+
 private:
 	FILE *filehandle;
+	std::wstring filepath;
+	filesystem::ThreadPool *threadpool;
 };
 
+// reads the range through the system cache, blocks so it's meant to be run from a worker thread
+void PrefetchFile( const std::wstring &path, int64_t offset, int64_t len );
+
 }
@@ -1,5 +1,6 @@
 #include "filesystemwrapper.hpp"
 #include "filevalve.hpp"
+#include "filememory.hpp"
 #include "filestream.hpp"
 #include "unicode.hpp"
 
@@ -18,8 +19,9 @@
 namespace filesystem
 {
 
-const size_t Wrapper::max_tempbuffer_len = 2048;
-const std::unordered_set<std::string> Wrapper::whitelist_extensions = {
+const size_t Wrapper::max_tempbuffer_len;
+const size_t Wrapper::max_pathid_len;
+const std::vector<const char *> Wrapper::whitelist_extensions = {
 	// garry's mod
 	"lua", "gma", "cache",
 	// data
@@ -37,7 +39,7 @@ const std::unordered_set<std::string> Wrapper::whitelist_extensions = {
 	// assorted
 	"tmp", "md", "db", "inf"
 };
-const std::unordered_set<std::string> Wrapper::whitelist_pathid[3] = {
+const std::vector<const char *> Wrapper::whitelist_pathid[3] = {
 	{
 		"data", "download", "lua", "lcl", "lsv", "game", "garrysmod", "gamebin", "mod",
 		"base_path", "executable_path", "default_write_path"
@@ -49,11 +51,38 @@ std::unordered_map<std::string, std::string> Wrapper::whitelist_writepaths;
 
 // BAD WINDOWS, YOU KNOTTY BOY
 static const std::unordered_set<uint32_t> blacklist_characters = { '<', '>', ':', '"', '/', '|', '?' };
-static const std::unordered_set<std::string> blacklist_filenames = {
+static const std::vector<const char *> blacklist_filenames = {
 	"CON", "PRN", "AUX", "NUL", "COM1", "COM2", "COM3", "COM4", "COM5", "COM6", "COM7",
 	"COM8", "COM9", "LPT1", "LPT2", "LPT3", "LPT4", "LPT5", "LPT6", "LPT7", "LPT8", "LPT9"
 };
 
+static int64_t FileTimeToUnix( const FILETIME &filetime )
+{
+	const uint64_t high = static_cast<uint64_t>( filetime.dwHighDateTime ),
+		low = static_cast<uint64_t>( filetime.dwLowDateTime );
+	const int64_t ticks = static_cast<int64_t>( ( high << 32 ) | low );
+	// FILETIME counts 100 nanosecond intervals since 1601-01-01
+	return ( ticks - 116444736000000000LL ) / 10000000LL;
+}
+
+static bool StatFile( const std::string &fullpath, FileInfo &info )
+{
+	const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+	WIN32_FILE_ATTRIBUTE_DATA file_data;
+	if( !GetFileAttributesExW( wpath.c_str( ), GetFileExInfoStandard, &file_data ) )
+		return false;
+
+	info.directory = ( file_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+	info.size = info.directory ? 0 :
+		( static_cast<uint64_t>( file_data.nFileSizeHigh ) << 32 ) | file_data.nFileSizeLow;
+	info.mtime = FileTimeToUnix( file_data.ftLastWriteTime );
+	info.ctime = FileTimeToUnix( file_data.ftCreationTime );
+	info.atime = FileTimeToUnix( file_data.ftLastAccessTime );
+	info.btime = info.ctime;
+	info.packed = false;
+	return true;
+}
+
 inline void ToLower( std::string &source )
 {
 	std::transform( source.begin( ), source.end( ), source.begin( ), [] ( char c )
@@ -62,8 +91,19 @@ inline void ToLower( std::string &source )
 	} );
 }
 
+inline void ToLower( char *source, size_t length )
+{
+	std::transform( source, source + length, source, [] ( char c )
+	{
+		return static_cast<char>( std::tolower( c ) );
+	} );
+}
+
 Wrapper::Wrapper( ) :
-	filesystem( nullptr )
+	filesystem( nullptr ),
+	references( 0 ),
+	snapshot_generation( 0 ),
+	observed_generation( 0 )
 { }
 
 Wrapper::~Wrapper( )
@@ -71,7 +111,10 @@ Wrapper::~Wrapper( )
 
 bool Wrapper::Initialize( CBaseFileSystem *fsinterface )
 {
+	WriteLock guard( searchpaths_lock );
+
 	filesystem = fsinterface;
+	main_thread = std::this_thread::get_id( );
 
 	{
 		char fullpath[max_tempbuffer_len] = { 0 };
@@ -86,10 +129,10 @@ bool Wrapper::Initialize( CBaseFileSystem *fsinterface )
 	if( whitelist_writepaths.empty( ) )
 	{
 		char searchpath[max_tempbuffer_len] = { 0 };
-		const std::unordered_set<std::string> &whitelist = whitelist_pathid[static_cast<size_t>( WhitelistType::Write )];
+		const std::vector<const char *> &whitelist = whitelist_pathid[static_cast<size_t>( WhitelistType::Write )];
 		for( auto it = whitelist.begin( ); it != whitelist.end( ); ++it )
 		{
-			int32_t len = filesystem->GetSearchPath_safe( it->c_str( ), false, searchpath ) - 1;
+			int32_t len = filesystem->GetSearchPath_safe( *it, false, searchpath ) - 1;
 			if( len <= 0 )
 				return false;
 
@@ -97,83 +140,213 @@ bool Wrapper::Initialize( CBaseFileSystem *fsinterface )
 		}
 	}
 
+	cache.GetHandleCache( ).Initialize( filesystem );
+
+	if( references++ == 0 )
+		threadpool.Start( );
+
+	cache.SetReferences( references );
+
 	return true;
 }
 
-file::Base *Wrapper::Open( const std::string &fpath, const std::string &opts, const std::string &pid )
+file::Base *Wrapper::Open(
+	const StringRef &fpath,
+	const StringRef &opts,
+	const StringRef &pid,
+	file::AccessHint hint
+)
 {
-	std::string filepath = fpath, options = opts, pathid = pid;
+	std::string options( opts.c_str( ), opts.size( ) );
+
+	ReadLock guard( searchpaths_lock );
 
 	ToLower( options );
 	WhitelistType wtype = options.find_first_of( "wa+" ) != options.npos ?
 		WhitelistType::Write : WhitelistType::Read;
 
+	PathIDBuffer pathidbuffer;
+	PathBuffer filepathbuffer;
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, wtype ) ||
-		!FixupFilePath( filepath, pathid ) ||
-		!VerifyFilePath( filepath, false, nonascii ) ||
-		!VerifyExtension( filepath, wtype ) )
+	if( !IsPathIDAllowed( pid, pathidbuffer, wtype ) ||
+		!IsPathAllowed( fpath, filepathbuffer, pathidbuffer.Get( ), wtype, nonascii ) )
 		return nullptr;
 
+	const StringRef filepath = filepathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	const PathKey key( filepath, pathid );
+	if( wtype == WhitelistType::Write )
+	{
+		cache.Invalidate( key.ToString( ) );
+		cache.GetLookupFilter( ).Add( pathid.ToString( ), filepath.ToString( ) );
+	}
+	else
+	{
+		std::shared_ptr<const std::string> contents = cache.GetContents( key );
+		if( contents )
+			return new( std::nothrow ) file::Memory( std::move( contents ) );
+	}
+
+	// access hints are only available on our own streams, packed files and loose files behind a pack
+	// go through the engine as usual, except for non-ASCII paths the engine can't open
+	std::string fullpath;
 	if( nonascii )
+		fullpath = GetPath( filepath.ToString( ), pathid.ToString( ), wtype );
+	else if( hint != file::AccessNormal )
+		fullpath = wtype == WhitelistType::Read ?
+			ResolveLeadingPath( filepath.ToString( ), pathid.ToString( ) ) :
+			GetPath( filepath.ToString( ), pathid.ToString( ), wtype );
+
+	if( nonascii || !fullpath.empty( ) )
 	{
-		filepath = GetPath( filepath, pathid, wtype );
-		const std::wstring wfilename = Unicode::UTF8::ToUTF16( filepath.begin( ), filepath.end( ) );
-		const std::wstring woptions = Unicode::UTF8::ToUTF16( options.begin( ), options.end( ) );
+		std::string mode = options;
+		if( hint == file::AccessSequential )
+			mode += 'S';
+		else if( hint == file::AccessRandom )
+			mode += 'R';
+
+		const std::wstring wfilename = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+		const std::wstring woptions = Unicode::UTF8::ToUTF16( mode.begin( ), mode.end( ) );
 		FILE *fh = _wfopen( wfilename.c_str( ), woptions.c_str( ) );
 		if( fh == nullptr )
 			return nullptr;
 
-		file::Base *f = new( std::nothrow ) file::Stream( fh );
+		file::Base *f = new( std::nothrow ) file::Stream( fh, wfilename, &threadpool );
 		if( f == nullptr )
+		{
 			fclose( fh );
+			return nullptr;
+		}
+
+		if( wtype == WhitelistType::Write )
+			return JournalWrites( f, filepath.ToString( ), pathid.ToString( ), options );
 
 		return f;
 	}
 
-	FileHandle_t fh = filesystem->Open( filepath.c_str( ), options.c_str( ), pathid.c_str( ) );
+	if( wtype == WhitelistType::Write )
+	{
+		FileHandle_t fh = filesystem->Open( filepath.c_str( ), options.c_str( ), pathid.c_str( ) );
+		if( fh == nullptr )
+			return nullptr;
+
+		file::Base *f = new( std::nothrow ) file::Valve( filesystem, fh );
+		if( f == nullptr )
+		{
+			filesystem->Close( fh );
+			return nullptr;
+		}
+
+		return JournalWrites( f, filepath.ToString( ), pathid.ToString( ), options );
+	}
+
+	HandleCache &handlecache = cache.GetHandleCache( );
+	long mtime = 0;
+	FileHandle_t fh = nullptr;
+	std::string cachekey;
+	if( handlecache.GetCapacity( ) != 0 )
+	{
+		mtime = GetHandleTime( filepath, pathid, nonascii );
+		fh = handlecache.Acquire( key, options, mtime, cachekey );
+	}
+
+	if( fh == nullptr )
+		fh = filesystem->Open( filepath.c_str( ), options.c_str( ), pathid.c_str( ) );
+
 	if( fh == nullptr )
 		return nullptr;
 
-	file::Base *f = new( std::nothrow ) file::Valve( filesystem, fh );
+	// a reused handle brings its key back with it, only new ones need it built
+	if( cachekey.empty( ) )
+		cachekey = key.ToString( );
+
+	file::Base *f = new( std::nothrow ) file::Valve( filesystem, fh, &handlecache, std::move( cachekey ), options, mtime );
 	if( f == nullptr )
 		filesystem->Close( fh );
 
 	return f;
 }
 
-bool Wrapper::Exists( const std::string &p, const std::string &pid ) const
+bool Wrapper::Prefetch( const std::string &fpath, const std::string &pid )
 {
-	std::string path = p, pathid = pid;
+	std::string filepath = fpath, pathid = pid;
+
+	ReadLock guard( searchpaths_lock );
 
 	bool nonascii = false;
 	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
-		!IsPathAllowed( path, pathid, WhitelistType::Read, nonascii ) )
+		!IsPathAllowed( filepath, pathid, WhitelistType::Read, nonascii ) )
 		return false;
 
+	// whatever the engine reads from a pack can't be prefetched from here
+	const std::string fullpath = ResolveLeadingPath( filepath, pathid );
+	if( fullpath.empty( ) )
+		return false;
+
+	const std::wstring wfullpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+	return threadpool.Post( [wfullpath]
+	{
+		file::PrefetchFile( wfullpath, 0, -1 );
+	} );
+}
+
+bool Wrapper::Exists( const StringRef &p, const StringRef &pid ) const
+{
+	ReadLock guard( searchpaths_lock );
+
+	PathIDBuffer pathidbuffer;
+	PathBuffer pathbuffer;
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pid, pathidbuffer, WhitelistType::Read ) ||
+		!IsPathAllowed( p, pathbuffer, pathidbuffer.Get( ), WhitelistType::Read, nonascii ) )
+		return false;
+
+	// validated paths usually come out as they went in, those are used without copying them
+	const StringRef path = pathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	if( !MayExist( path, pathid ) )
+		return false;
+
+	bool exists = false;
+	FileInfo info;
+	if( GetMetadata( path, pathid, nonascii, exists, info ) )
+		return exists;
+
 	if( nonascii )
 	{
-		path = GetPath( path, pathid, WhitelistType::Read );
-		std::wstring wpath = Unicode::UTF8::ToUTF16( path.begin( ), path.end( ) );
+		const std::string fullpath = GetPath( path.ToString( ), pathid.ToString( ), WhitelistType::Read );
+		std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
 		return GetFileAttributesW( wpath.c_str( ) ) != INVALID_FILE_ATTRIBUTES;
 	}
 
 	return filesystem->FileExists( path.c_str( ), pathid.c_str( ) );
 }
 
-bool Wrapper::IsDirectory( const std::string &p, const std::string &pid ) const
+bool Wrapper::IsDirectory( const StringRef &p, const StringRef &pid ) const
 {
-	std::string path = p, pathid = pid;
+	ReadLock guard( searchpaths_lock );
 
+	PathIDBuffer pathidbuffer;
+	PathBuffer pathbuffer;
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
-		!IsPathAllowed( path, pathid, WhitelistType::Read, nonascii ) )
+	if( !IsPathIDAllowed( pid, pathidbuffer, WhitelistType::Read ) ||
+		!IsPathAllowed( p, pathbuffer, pathidbuffer.Get( ), WhitelistType::Read, nonascii ) )
+		return false;
+
+	const StringRef path = pathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	if( !MayExist( path, pathid ) )
 		return false;
 
+	bool exists = false;
+	FileInfo info;
+	if( GetMetadata( path, pathid, nonascii, exists, info ) )
+		return exists && info.directory;
+
 	if( nonascii )
 	{
-		path = GetPath( path, pathid, WhitelistType::Read );
-		std::wstring wpath = Unicode::UTF8::ToUTF16( path.begin( ), path.end( ) );
+		const std::string fullpath = GetPath( path.ToString( ), pathid.ToString( ), WhitelistType::Read );
+		std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
 		WIN32_FILE_ATTRIBUTE_DATA file_data;
 		if( !GetFileAttributesExW( wpath.c_str( ), GetFileExInfoStandard, &file_data ) )
 			return false;
@@ -184,19 +357,28 @@ bool Wrapper::IsDirectory( const std::string &p, const std::string &pid ) const
 	return filesystem->IsDirectory( path.c_str( ), pathid.c_str( ) );
 }
 
-uint64_t Wrapper::GetSize( const std::string &fpath, const std::string &pid ) const
+uint64_t Wrapper::GetSize( const StringRef &fpath, const StringRef &pid ) const
 {
-	std::string filepath = fpath, pathid = pid;
+	ReadLock guard( searchpaths_lock );
 
+	PathIDBuffer pathidbuffer;
+	PathBuffer filepathbuffer;
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
-		!IsPathAllowed( filepath, pathid, WhitelistType::Read, nonascii ) )
+	if( !IsPathIDAllowed( pid, pathidbuffer, WhitelistType::Read ) ||
+		!IsPathAllowed( fpath, filepathbuffer, pathidbuffer.Get( ), WhitelistType::Read, nonascii ) )
 		return 0;
 
+	const StringRef filepath = filepathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	bool exists = false;
+	FileInfo info;
+	if( GetMetadata( filepath, pathid, nonascii, exists, info ) )
+		return exists ? info.size : 0;
+
 	if( nonascii )
 	{
-		filepath = GetPath( filepath, pathid, WhitelistType::Read );
-		std::wstring wpath = Unicode::UTF8::ToUTF16( filepath.begin( ), filepath.end( ) );
+		const std::string fullpath = GetPath( filepath.ToString( ), pathid.ToString( ), WhitelistType::Read );
+		std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
 		WIN32_FILE_ATTRIBUTE_DATA file_data;
 		if( !GetFileAttributesExW( wpath.c_str( ), GetFileExInfoStandard, &file_data ) )
 			return 0;
@@ -209,19 +391,28 @@ uint64_t Wrapper::GetSize( const std::string &fpath, const std::string &pid ) co
 	return filesystem->Size( filepath.c_str( ), pathid.c_str( ) );
 }
 
-uint64_t Wrapper::GetTime( const std::string &p, const std::string &pid ) const
+uint64_t Wrapper::GetTime( const StringRef &p, const StringRef &pid ) const
 {
-	std::string path = p, pathid = pid;
+	ReadLock guard( searchpaths_lock );
 
+	PathIDBuffer pathidbuffer;
+	PathBuffer pathbuffer;
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
-		!IsPathAllowed( path, pathid, WhitelistType::Read, nonascii ) )
+	if( !IsPathIDAllowed( pid, pathidbuffer, WhitelistType::Read ) ||
+		!IsPathAllowed( p, pathbuffer, pathidbuffer.Get( ), WhitelistType::Read, nonascii ) )
 		return 0;
 
+	const StringRef path = pathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	bool exists = false;
+	FileInfo info;
+	if( GetMetadata( path, pathid, nonascii, exists, info ) )
+		return exists ? static_cast<uint64_t>( info.mtime ) : 0;
+
 	if( nonascii )
 	{
-		path = GetPath( path, pathid, WhitelistType::Read );
-		const std::wstring wpath = Unicode::UTF8::ToUTF16( path.begin( ), path.end( ) );
+		const std::string fullpath = GetPath( path.ToString( ), pathid.ToString( ), WhitelistType::Read );
+		const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
 		WIN32_FILE_ATTRIBUTE_DATA file_data;
 		if( !GetFileAttributesExW( wpath.c_str( ), GetFileExInfoStandard, &file_data ) )
 			return 0;
@@ -234,10 +425,71 @@ uint64_t Wrapper::GetTime( const std::string &p, const std::string &pid ) const
 	return filesystem->GetPathTime( path.c_str( ), pathid.c_str( ) );
 }
 
+bool Wrapper::Stat( const StringRef &p, const StringRef &pid, FileInfo &info ) const
+{
+	ReadLock guard( searchpaths_lock );
+
+	PathIDBuffer pathidbuffer;
+	PathBuffer pathbuffer;
+	bool nonascii = false;
+	if( !IsPathIDAllowed( pid, pathidbuffer, WhitelistType::Read ) ||
+		!IsPathAllowed( p, pathbuffer, pathidbuffer.Get( ), WhitelistType::Read, nonascii ) )
+		return false;
+
+	const StringRef path = pathbuffer.Ref( ), pathid = pathidbuffer.Ref( );
+
+	bool exists = false;
+	if( GetMetadata( path, pathid, nonascii, exists, info ) )
+		return exists;
+
+	return ResolveInfo( path, pathid, nonascii, info );
+}
+
+bool Wrapper::ResolveInfo( const StringRef &path, const StringRef &pathid, bool nonascii, FileInfo &info ) const
+{
+	info.searchpath.reset( );
+	if( nonascii )
+	{
+		const std::string fullpath = GetPath( path.ToString( ), pathid.ToString( ), WhitelistType::Read );
+		if( fullpath.empty( ) || !StatFile( fullpath, info ) )
+			return false;
+
+		info.searchpath = std::make_shared<const std::string>( fullpath, 0, fullpath.size( ) - path.size( ) );
+		return true;
+	}
+
+	char fullpath[max_tempbuffer_len] = { 0 };
+	PathTypeQuery_t pathtype = PATH_IS_NORMAL;
+	const char *resolved = filesystem->RelativePathToFullPath(
+		path.c_str( ),
+		pathid.c_str( ),
+		fullpath,
+		sizeof( fullpath ),
+		FILTER_NONE,
+		&pathtype
+	);
+
+	if( resolved != nullptr )
+	{
+		const size_t len = std::strlen( fullpath );
+		if( len >= path.size( ) && _stricmp( fullpath + len - path.size( ), path.c_str( ) ) == 0 )
+			info.searchpath = std::make_shared<const std::string>( fullpath, len - path.size( ) );
+		else
+			info.searchpath = std::make_shared<const std::string>( fullpath );
+
+		if( ( pathtype & ( PATH_IS_PACKFILE | PATH_IS_MAPPACKFILE ) ) == 0 && StatFile( fullpath, info ) )
+			return true;
+	}
+
+	return StatPacked( path, pathid, info );
+}
+
 bool Wrapper::Rename( const std::string &pold, const std::string &pnew, const std::string &pid )
 {
 	std::string pathold = pold, pathnew = pnew, pathid = pid;
 
+	ReadLock guard( searchpaths_lock );
+
 	bool nonasciio = false, nonasciin = false;
 	if( !IsPathIDAllowed( pathid, WhitelistType::Write ) ||
 		!IsPathAllowed( pathold, pathid, WhitelistType::Write, nonasciio ) ||
@@ -246,52 +498,78 @@ bool Wrapper::Rename( const std::string &pold, const std::string &pnew, const st
 
 	if( nonasciio || nonasciin )
 	{
-		pathold = GetPath( pathold, pathid, WhitelistType::Write );
-		pathnew = GetPath( pathnew, pathid, WhitelistType::Write );
-		const std::wstring wpathold = Unicode::UTF8::ToUTF16( pathold.begin( ), pathold.end( ) );
-		const std::wstring wpathnew = Unicode::UTF8::ToUTF16( pathnew.begin( ), pathnew.end( ) );
-		return MoveFileW( wpathold.c_str( ), wpathnew.c_str( ) ) == 1;
+		const std::string fullpathold = GetPath( pathold, pathid, WhitelistType::Write ),
+			fullpathnew = GetPath( pathnew, pathid, WhitelistType::Write );
+		const std::wstring wpathold = Unicode::UTF8::ToUTF16( fullpathold.begin( ), fullpathold.end( ) );
+		const std::wstring wpathnew = Unicode::UTF8::ToUTF16( fullpathnew.begin( ), fullpathnew.end( ) );
+		return Journal(
+			MoveFileW( wpathold.c_str( ), wpathnew.c_str( ) ) == 1,
+			ChangeJournal::Operation::Rename, pathold, pathid, pathnew
+		);
 	}
 
+	const std::string keyold = SharedCache::MakeKey( pathold, pathid ),
+		keynew = SharedCache::MakeKey( pathnew, pathid );
+	cache.Invalidate( keyold );
+	cache.Invalidate( keynew );
+	cache.GetMetadataCache( ).InvalidateTree( keyold );
+	cache.GetMetadataCache( ).InvalidateTree( keynew );
+	cache.GetLookupFilter( ).Add( pathid, pathnew );
+
 	if( filesystem->IsDirectory( pathold.c_str( ), pathid.c_str( ) ) )
 	{
 		char fullpathold[max_tempbuffer_len] = { 0 };
 		filesystem->RelativePathToFullPath_safe( pathold.c_str( ), pathid.c_str( ), fullpathold );
 		char fullpathnew[max_tempbuffer_len] = { 0 };
 		filesystem->RelativePathToFullPath_safe( pathnew.c_str( ), pathid.c_str( ), fullpathnew );
-		return rename( fullpathold, fullpathnew ) == 0;
+		return Journal(
+			rename( fullpathold, fullpathnew ) == 0,
+			ChangeJournal::Operation::Rename, pathold, pathid, pathnew
+		);
 	}
 
-	return filesystem->RenameFile( pathold.c_str( ), pathnew.c_str( ), pathid.c_str( ) );
+	return Journal(
+		filesystem->RenameFile( pathold.c_str( ), pathnew.c_str( ), pathid.c_str( ) ),
+		ChangeJournal::Operation::Rename, pathold, pathid, pathnew
+	);
 }
 
 bool Wrapper::Remove( const std::string &p, const std::string &pid )
 {
 	std::string path = p, pathid = pid;
 
+	ReadLock guard( searchpaths_lock );
+
 	bool nonascii = false;
 	if( !IsPathIDAllowed( pathid, WhitelistType::Write ) ||
 		!IsPathAllowed( path, pathid, WhitelistType::Write, nonascii ) )
 		return false;
 
+	const std::string key = SharedCache::MakeKey( path, pathid );
+	cache.Invalidate( key );
+	cache.GetMetadataCache( ).InvalidateTree( key );
+
 	if( nonascii )
 	{
-		path = GetPath( path, pathid, WhitelistType::Write );
-		const std::wstring wpath = Unicode::UTF8::ToUTF16( path.begin( ), path.end( ) );
-		return RemoveDirectoryW( wpath.c_str( ) ) == 1;
+		const std::string fullpath = GetPath( path, pathid, WhitelistType::Write );
+		const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+		return Journal( RemoveDirectoryW( wpath.c_str( ) ) == 1, ChangeJournal::Operation::Remove, path, pathid );
 	}
 
 	if( filesystem->IsDirectory( path.c_str( ), pathid.c_str( ) ) )
 	{
 		char fullpath[max_tempbuffer_len] = { 0 };
 		filesystem->RelativePathToFullPath( path.c_str( ), pathid.c_str( ), fullpath, sizeof( fullpath ) );
-		return rmdir( fullpath ) == 0;
+		return Journal( rmdir( fullpath ) == 0, ChangeJournal::Operation::Remove, path, pathid );
 	}
 
 	if( filesystem->FileExists( path.c_str( ), pathid.c_str( ) ) )
 	{
 		filesystem->RemoveFile( path.c_str( ), pathid.c_str( ) );
-		return !filesystem->FileExists( path.c_str( ), pathid.c_str( ) );
+		return Journal(
+			!filesystem->FileExists( path.c_str( ), pathid.c_str( ) ),
+			ChangeJournal::Operation::Remove, path, pathid
+		);
 	}
 
 	return false;
@@ -301,20 +579,31 @@ bool Wrapper::MakeDirectory( const std::string &p, const std::string &pid )
 {
 	std::string path = p, pathid = pid;
 
+	ReadLock guard( searchpaths_lock );
+
 	bool nonascii = false;
 	if( !IsPathIDAllowed( pathid, WhitelistType::Write ) ||
 		!IsPathAllowed( path, pathid, WhitelistType::Write, nonascii ) )
 		return false;
 
+	cache.InvalidateTree( SharedCache::MakeKey( path, pathid ) );
+	cache.GetLookupFilter( ).Add( pathid, path );
+
 	if( nonascii )
 	{
-		path = GetPath( path, pathid, WhitelistType::Write );
-		const std::wstring wpath = Unicode::UTF8::ToUTF16( path.begin( ), path.end( ) );
-		return SHCreateDirectoryExW( nullptr, wpath.c_str( ), nullptr ) == ERROR_SUCCESS;
+		const std::string fullpath = GetPath( path, pathid, WhitelistType::Write );
+		const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+		return Journal(
+			SHCreateDirectoryExW( nullptr, wpath.c_str( ), nullptr ) == ERROR_SUCCESS,
+			ChangeJournal::Operation::MakeDirectory, path, pathid
+		);
 	}
 
 	filesystem->CreateDirHierarchy( path.c_str( ), pathid.c_str( ) );
-	return filesystem->IsDirectory( path.c_str( ), pathid.c_str( ) );
+	return Journal(
+		filesystem->IsDirectory( path.c_str( ), pathid.c_str( ) ),
+		ChangeJournal::Operation::MakeDirectory, path, pathid
+	);
 }
 
 // this function is problematic
@@ -322,138 +611,171 @@ bool Wrapper::MakeDirectory( const std::string &p, const std::string &pid )
 // Win32 API doesn't search inside VPKs and GMAs (obviously)
 // combining them will duplicate results (broken names so not exactly duplicating)
 // besides doing the search twice on each path
-std::pair<std::set<std::string>, std::set<std::string>> Wrapper::Find(
-	const std::string &p,
-	const std::string &pid
-) const
+// The engine can't represent names outside the active code page, those come from a second pass
+// over the loose search paths that only returns what the engine couldn't.
+class UnicodeFinder : public Finder
 {
-	std::string filename = p, pathid = pid;
-
-	std::set<std::string> files, directories;
-
-	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::Read ) ||
-		!IsPathAllowed( filename, pathid, WhitelistType::Read, nonascii, true ) )
-		return std::make_pair( files, directories );
+public:
+	UnicodeFinder(
+		CBaseFileSystem *fsinterface,
+		const std::string &pattern,
+		const std::string &pathid,
+		std::vector<std::string> &&patterns
+	) :
+		engine( fsinterface, pattern, pathid ),
+		engine_done( false ),
+		patterns( std::move( patterns ) ),
+		handle( INVALID_HANDLE_VALUE )
+	{ }
+
+	~UnicodeFinder( )
+	{
+		if( handle != INVALID_HANDLE_VALUE )
+			FindClose( handle );
+	}
 
-	// IFileSystem finding (allows finding inside VPKs, GMAs and what not)
+	bool Next( std::string &name, bool &directory ) override
 	{
-		FileFindHandle_t handle = FILESYSTEM_INVALID_FIND_HANDLE;
-		const char *path = filesystem->FindFirstEx( filename.c_str( ), pathid.c_str( ), &handle );
-		if( handle != FILESYSTEM_INVALID_FIND_HANDLE )
+		if( !engine_done )
 		{
-			while( path != nullptr )
-			{
-				if( filesystem->FindIsDirectory( handle ) )
-				{
-					if( std::strcmp( path, "." ) != 0 && std::strcmp( path, ".." ) != 0 )
-						directories.insert( path );
-				}
-				else
-					files.insert( path );
-
-				path = filesystem->FindNext( handle );
-			}
+			if( engine.Next( name, directory ) )
+				return true;
 
-			filesystem->FindClose( handle );
+			engine_done = true;
 		}
-	}
 
-	// Win32 API finding (allows proper handling of Unicode)
-	{
-		std::set<std::string> searchpaths = GetSearchPaths( pathid );
-		for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
+		WIN32_FIND_DATAW find_data;
+		while( true )
 		{
-			// check if the searchpath is actually a file, we can search inside these
-			const DWORD attrib = GetFileAttributesA( it->c_str( ) );
-			if( attrib != INVALID_FILE_ATTRIBUTES && ( attrib & FILE_ATTRIBUTE_DIRECTORY ) == 0 )
-				continue;
-
-			char fullpath[max_tempbuffer_len] = { 0 };
-			V_ComposeFileName( it->c_str( ), filename.c_str( ), fullpath, sizeof( fullpath ) );
-			const std::wstring wfilename = Unicode::UTF8::ToUTF16( fullpath, fullpath + std::strlen( fullpath ) );
-
-			WIN32_FIND_DATAW find_data;
-			HANDLE handle = FindFirstFileExW(
-				wfilename.c_str( ),
-				FindExInfoStandard,
-				&find_data,
-				FindExSearchNameMatch,
-				nullptr,
-				0
-			);
 			if( handle == INVALID_HANDLE_VALUE )
+			{
+				if( patterns.empty( ) )
+					return false;
+
+				const std::wstring wpattern = Unicode::UTF8::ToUTF16( patterns.back( ).begin( ), patterns.back( ).end( ) );
+				patterns.pop_back( );
+				handle = FindFirstFileExW(
+					wpattern.c_str( ),
+					FindExInfoBasic,
+					&find_data,
+					FindExSearchNameMatch,
+					nullptr,
+					0
+				);
+				if( handle == INVALID_HANDLE_VALUE )
+					continue;
+			}
+			else if( !FindNextFileW( handle, &find_data ) )
+			{
+				FindClose( handle );
+				handle = INVALID_HANDLE_VALUE;
 				continue;
+			}
 
-			do
+			const std::wstring path = find_data.cFileName;
+			const bool ascii = std::all_of( path.begin( ), path.end( ), [] ( wchar_t c )
 			{
-				const std::wstring path = find_data.cFileName;
-				if( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
-				{
-					if( path.compare( L"." ) != 0 && path.compare( L".." ) != 0 )
-						directories.insert( Unicode::UTF16::ToUTF8( path.begin( ), path.end( ) ) );
-				}
-				else
-				{
-					files.insert( Unicode::UTF16::ToUTF8( path.begin( ), path.end( ) ) );
-				}
-			}
-			while( FindNextFileW( handle, &find_data ) );
+				return c < 0x80;
+			} );
+			if( ascii || path.compare( L"." ) == 0 || path.compare( L".." ) == 0 )
+				continue;
 
-			FindClose( handle );
+			name = Unicode::UTF16::ToUTF8( path.begin( ), path.end( ) );
+			directory = ( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+			return true;
 		}
 	}
 
-	return std::make_pair( files, directories );
-}
+private:
+	EngineFinder engine;
+	bool engine_done;
+	std::vector<std::string> patterns;
+	HANDLE handle;
+};
 
-std::unordered_map<std::string, std::set<std::string>> Wrapper::GetSearchPaths( ) const
+void Wrapper::FillFindMetadata( const std::string &pattern, const std::string &pathid, FindResults &results ) const
 {
-	std::unordered_map<std::string, std::set<std::string>> searchpaths;
+	const std::string prefix = GetPatternDirectory( pattern );
+	std::vector<FindEntry *> pending = GetFindEntries( results );
 
-	const CUtlLinkedList<CBaseFileSystem::CSearchPath> &m_SearchPaths = filesystem->m_SearchPaths;
-	for( uint16_t k = 0; k < m_SearchPaths.Count( ); ++k )
+	// a single listing per search path returns every entry's metadata
+	std::unordered_map<std::string, WIN32_FIND_DATAW> listing;
+	const std::vector<std::string> searchpaths = GetLooseSearchPaths( pathid );
+	for( auto it = searchpaths.begin( ); it != searchpaths.end( ) && !pending.empty( ); ++it )
 	{
-		const CBaseFileSystem::CSearchPath &searchpath = m_SearchPaths[k];
-		const CBaseFileSystem::CPathIDInfo *pathIDInfo = searchpath.m_pPathIDInfo;
-		if( searchpath.m_pDebugPath == nullptr ||
-			pathIDInfo == nullptr ||
-			pathIDInfo->m_pDebugPathID == nullptr )
+		char fullpath[max_tempbuffer_len] = { 0 };
+		V_ComposeFileName( it->c_str( ), ( prefix + "*" ).c_str( ), fullpath, sizeof( fullpath ) );
+		const std::wstring wpattern = Unicode::UTF8::ToUTF16( fullpath, fullpath + std::strlen( fullpath ) );
+
+		WIN32_FIND_DATAW find_data;
+		HANDLE handle = FindFirstFileExW(
+			wpattern.c_str( ),
+			FindExInfoBasic,
+			&find_data,
+			FindExSearchNameMatch,
+			nullptr,
+			FIND_FIRST_EX_LARGE_FETCH
+		);
+		if( handle == INVALID_HANDLE_VALUE )
 			continue;
 
-		const auto packFile = searchpath.m_pPackFile;
-		const auto packFile2 = searchpath.m_pPackFile2;
-		if( packFile != nullptr )
-			searchpaths[pathIDInfo->m_pDebugPathID].insert( packFile->m_ZipName.Get( ) );
-		else if( packFile2 != nullptr )
-			searchpaths[pathIDInfo->m_pDebugPathID].insert( packFile2->m_pszFullPathName );
-		else
-			searchpaths[pathIDInfo->m_pDebugPathID].insert( searchpath.m_pDebugPath );
+		listing.clear( );
+		do
+		{
+			const std::wstring name = find_data.cFileName;
+			std::string key = Unicode::UTF16::ToUTF8( name.begin( ), name.end( ) );
+			ToLower( key );
+			listing.emplace( std::move( key ), find_data );
+		}
+		while( FindNextFileW( handle, &find_data ) );
+
+		FindClose( handle );
+
+		auto out = pending.begin( );
+		for( auto entry = pending.begin( ); entry != pending.end( ); ++entry )
+		{
+			FindEntry &current = **entry;
+			std::string key = current.name;
+			ToLower( key );
+
+			const auto found = listing.find( key );
+			if( found == listing.end( ) ||
+				( ( found->second.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 ) != current.directory )
+			{
+				*out++ = *entry;
+				continue;
+			}
+
+			const WIN32_FIND_DATAW &data = found->second;
+			current.size = current.directory ? 0 :
+				( static_cast<uint64_t>( data.nFileSizeHigh ) << 32 ) | data.nFileSizeLow;
+			current.mtime = FileTimeToUnix( data.ftLastWriteTime );
+		}
+
+		pending.erase( out, pending.end( ) );
 	}
 
-	return searchpaths;
+	FillPackedMetadata( prefix, pathid, pending );
 }
 
-std::set<std::string> Wrapper::GetSearchPaths( const std::string &pathid ) const
+Finder *Wrapper::OpenFinder( const std::string &pattern, const std::string &pathid ) const
 {
-	std::set<std::string> searchpaths;
-
-	char paths[max_tempbuffer_len] = { 0 };
-	const int32_t len = filesystem->GetSearchPath_safe( pathid.c_str( ), true, paths ) - 1;
-	if( len <= 0 )
-		return searchpaths;
-
-	char *start = paths, *end = paths + len, *pos = std::find( start, end, ';' );
-	for( ; pos != end; start = ++pos, pos = std::find( start, end, ';' ) )
+	std::vector<std::string> patterns;
+	const std::vector<std::string> searchpaths = GetLooseSearchPaths( pathid );
+	for( auto it = searchpaths.rbegin( ); it != searchpaths.rend( ); ++it )
 	{
-		*pos = '\0';
-		searchpaths.insert( start );
+		char fullpath[max_tempbuffer_len] = { 0 };
+		V_ComposeFileName( it->c_str( ), pattern.c_str( ), fullpath, sizeof( fullpath ) );
+		patterns.push_back( fullpath );
 	}
 
-	if( start != end )
-		searchpaths.insert( start );
+	return new( std::nothrow ) UnicodeFinder( filesystem, pattern, pathid, std::move( patterns ) );
+}
 
-	return searchpaths;
+std::set<std::string> Wrapper::GetSearchPaths( const std::string &pathid ) const
+{
+	ReadLock guard( searchpaths_lock );
+	return CollectSearchPaths( pathid );
 }
 
 bool Wrapper::AddSearchPath( const std::string &p, const std::string &pid )
@@ -461,14 +783,25 @@ bool Wrapper::AddSearchPath( const std::string &p, const std::string &pid )
 	std::string directory = p, pathid = pid;
 
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::SearchPath ) ||
-		!FixupFilePath( directory, "DEFAULT_WRITE_PATH" ) ||
-		!VerifyFilePath( directory, false, nonascii ) ||
-		nonascii )
-		return false;
+	{
+		ReadLock guard( searchpaths_lock );
+
+		if( !IsPathIDAllowed( pathid, WhitelistType::SearchPath ) ||
+			!FixupFilePath( directory, "DEFAULT_WRITE_PATH" ) ||
+			!VerifyFilePath( directory, false, nonascii ) ||
+			nonascii )
+			return false;
+	}
 
+	journal.Record( ChangeJournal::Operation::AddSearchPath, directory, pathid );
 	directory.insert( 0, garrysmod_fullpath );
+
+	WriteLock guard( searchpaths_lock );
 	filesystem->AddSearchPath( directory.c_str( ), pathid.c_str( ), PATH_ADD_TO_TAIL );
+	// cached files might not belong to the search path that wins the lookup anymore
+	cache.InvalidateSearchPaths( );
+	ExtendIndex( pathid );
+	RecordSearchPaths( );
 	return true;
 }
 
@@ -477,56 +810,66 @@ bool Wrapper::RemoveSearchPath( const std::string &p, const std::string &pid )
 	std::string directory = p, pathid = pid;
 
 	bool nonascii = false;
-	if( !IsPathIDAllowed( pathid, WhitelistType::SearchPath ) ||
-		!FixupFilePath( directory, "DEFAULT_WRITE_PATH" ) ||
-		!VerifyFilePath( directory, false, nonascii ) ||
-		nonascii )
-		return false;
+	{
+		ReadLock guard( searchpaths_lock );
 
+		if( !IsPathIDAllowed( pathid, WhitelistType::SearchPath ) ||
+			!FixupFilePath( directory, "DEFAULT_WRITE_PATH" ) ||
+			!VerifyFilePath( directory, false, nonascii ) ||
+			nonascii )
+			return false;
+	}
+
+	const std::string relative = directory;
 	directory.insert( 0, garrysmod_fullpath );
-	return filesystem->RemoveSearchPath( directory.c_str( ), pathid.c_str( ) );
+
+	WriteLock guard( searchpaths_lock );
+	cache.InvalidateSearchPaths( );
+	const bool removed = filesystem->RemoveSearchPath( directory.c_str( ), pathid.c_str( ) );
+	ExtendIndex( pathid );
+	RecordSearchPaths( );
+	return Journal( removed, ChangeJournal::Operation::RemoveSearchPath, relative, pathid );
 }
 
-bool Wrapper::IsPathIDAllowed( std::string &pathid, WhitelistType whitelist_type ) const
+bool Wrapper::IsPathIDAllowed( const StringRef &input, PathIDBuffer &pathid, WhitelistType whitelist_type ) const
 {
-	if( pathid.empty( ) )
+	// IDs of max_pathid_len characters or more can't be on the whitelist anyway
+	if( input.empty( ) || !pathid.Assign( input ) )
 		return false;
 
-	ToLower( pathid );
-	const std::unordered_set<std::string> &whitelist = whitelist_pathid[static_cast<size_t>( whitelist_type )];
-	return whitelist.find( pathid ) != whitelist.end( );
+	ToLower( pathid.GetBuffer( ), pathid.GetLength( ) );
+	return IsListed( whitelist_pathid[static_cast<size_t>( whitelist_type )], pathid.Get( ) );
 }
 
-bool Wrapper::FixupFilePath( std::string &filepath, const std::string &pathid ) const
+bool Wrapper::FixupFilePath( const StringRef &input, PathBuffer &filepath, const char *pathid ) const
 {
-	if( filepath.empty( ) )
+	if( input.empty( ) )
 		return false;
 
-	if( V_IsAbsolutePath( filepath.c_str( ) ) )
+	if( V_IsAbsolutePath( input.c_str( ) ) )
 	{
-		const std::string tpath = filepath;
-		filepath.resize( max_tempbuffer_len );
-		if( !filesystem->FullPathToRelativePathEx( tpath.c_str( ), pathid.c_str( ), &filepath[0], static_cast<int>( filepath.size( ) ) ) )
+		if( !filesystem->FullPathToRelativePathEx( input.c_str( ), pathid, filepath.GetBuffer( ), static_cast<int>( filepath.GetCapacity( ) ) ) )
 			return false;
 
-		if( filepath.compare( 0, 3, ".." CORRECT_PATH_SEPARATOR_S ) == 0 )
+		if( std::strncmp( filepath.Get( ), ".." CORRECT_PATH_SEPARATOR_S, 3 ) == 0 )
 			return false;
 	}
-	else if( !V_RemoveDotSlashes( &filepath[0] ) )
+	// relative paths of max_tempbuffer_len characters or more wouldn't fit in their full paths
+	else if( !filepath.Assign( input ) || !V_RemoveDotSlashes( filepath.GetBuffer( ) ) )
 	{
 		return false;
 	}
 
-	filepath.resize( std::strlen( filepath.c_str( ) ) );
+	filepath.Update( );
 	return true;
 }
 
 
-bool Wrapper::VerifyFilePath( const std::string &filepath, bool find, bool &nonascii ) const
+bool Wrapper::VerifyFilePath( const char *filepath, size_t length, bool find, bool &nonascii ) const
 {
 	nonascii = false;
 
-	auto begin = filepath.begin( ), end = filepath.end( );
+	const char *begin = filepath, *end = filepath + length;
 	uint32_t out = 0;
 	do
 	{
@@ -539,45 +882,100 @@ bool Wrapper::VerifyFilePath( const std::string &filepath, bool find, bool &nona
 	}
 	while( begin != end );
 
-	const char *filename = V_GetFileName( filepath.c_str( ) );
-	std::string filename_extless( filename, 0, 4 );
-	if( filename_extless.size( ) >= 3 )
+	const char *filename = V_GetFileName( filepath );
+	char filename_extless[5] = { 0 };
+	std::strncpy( filename_extless, filename, 4 );
+	const size_t len = std::strlen( filename_extless );
+	if( len >= 3 )
 	{
-		if( filename_extless.size( ) >= 4 && filename_extless[3] == '.' )
-			filename_extless.resize( 3 );
+		if( len >= 4 && filename_extless[3] == '.' )
+			filename_extless[3] = '\0';
 
-		if( blacklist_filenames.find( filename_extless ) != blacklist_filenames.end( ) )
+		if( IsListed( blacklist_filenames, filename_extless ) )
 			return false;
 	}
 
 	return true;
 }
 
-bool Wrapper::VerifyExtension( const std::string &filepath, WhitelistType whitelist_type ) const
+bool Wrapper::VerifyExtension( const char *filepath, WhitelistType whitelist_type ) const
 {
-	const char *extension = V_GetFileExtension( filepath.c_str( ) );
+	const char *extension = V_GetFileExtension( filepath );
 	if( whitelist_type == WhitelistType::Write && extension != nullptr )
 	{
-		std::string ext = extension;
-		ToLower( ext );
-		if( whitelist_extensions.find( ext ) == whitelist_extensions.end( ) )
+		char ext[16] = { 0 };
+		const size_t len = std::strlen( extension );
+		if( len >= sizeof( ext ) )
+			return false;
+
+		std::memcpy( ext, extension, len );
+		ToLower( ext, len );
+		if( !IsListed( whitelist_extensions, ext ) )
 			return false;
 	}
 
 	return true;
 }
 
-bool Wrapper::IsPathAllowed(
-	std::string &filepath,
-	std::string &pathid,
-	WhitelistType whitelist_type,
-	bool &nonascii,
-	bool find
-) const
+bool Wrapper::IsDirectoryPath( const std::string &fullpath )
+{
+	const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+	const DWORD attributes = GetFileAttributesW( wpath.c_str( ) );
+	return attributes != INVALID_FILE_ATTRIBUTES && ( attributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+}
+
+bool Wrapper::PathExists( const StringRef &fullpath )
 {
-	return FixupFilePath( filepath, pathid ) &&
-		VerifyFilePath( filepath, find, nonascii ) &&
-		VerifyExtension( filepath, whitelist_type );
+	const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.c_str( ), fullpath.c_str( ) + fullpath.size( ) );
+	return GetFileAttributesW( wpath.c_str( ) ) != INVALID_FILE_ATTRIBUTES;
+}
+
+bool Wrapper::StatPath( const std::string &fullpath, FileInfo &info )
+{
+	return StatFile( fullpath, info );
+}
+
+bool Wrapper::ListDirectory(
+	const std::string &fullpath,
+	std::vector<std::string> &files,
+	std::vector<std::string> &directories
+)
+{
+	std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+	if( !wpath.empty( ) && wpath.back( ) != L'\\' && wpath.back( ) != L'/' )
+		wpath += L'\\';
+
+	wpath += L'*';
+
+	WIN32_FIND_DATAW find_data;
+	HANDLE handle = FindFirstFileExW(
+		wpath.c_str( ),
+		FindExInfoBasic,
+		&find_data,
+		FindExSearchNameMatch,
+		nullptr,
+		FIND_FIRST_EX_LARGE_FETCH
+	);
+	if( handle == INVALID_HANDLE_VALUE )
+		return false;
+
+	do
+	{
+		const std::wstring name = find_data.cFileName;
+		if( name.compare( L"." ) == 0 || name.compare( L".." ) == 0 )
+			continue;
+
+		// reparse points (junctions, symbolic links) are listed as files so callers never recurse into loops
+		if( ( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 &&
+			( find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) == 0 )
+			directories.push_back( Unicode::UTF16::ToUTF8( name.begin( ), name.end( ) ) );
+		else
+			files.push_back( Unicode::UTF16::ToUTF8( name.begin( ), name.end( ) ) );
+	}
+	while( FindNextFileW( handle, &find_data ) );
+
+	FindClose( handle );
+	return true;
 }
 
 std::string Wrapper::GetPath(
@@ -586,26 +984,11 @@ std::string Wrapper::GetPath(
 	WhitelistType wtype
 ) const
 {
-	char fullpath[max_tempbuffer_len] = { 0 };
 	if( wtype == WhitelistType::Read )
-	{
-		bool notfound = true;
-		const std::set<std::string> searchpaths = GetSearchPaths( pathid );
-		for( auto it = searchpaths.begin( ); it != searchpaths.end( ); ++it )
-		{
-			V_ComposeFileName( it->c_str( ), filepath.c_str( ), fullpath, sizeof( fullpath ) );
-			const std::wstring wfilename = Unicode::UTF8::ToUTF16( fullpath, fullpath + std::strlen( fullpath ) );
-			if( GetFileAttributesW( wfilename.c_str( ) ) != INVALID_FILE_ATTRIBUTES )
-			{
-				notfound = false;
-				break;
-			}
-		}
+		return ResolvePath( filepath, pathid );
 
-		if( notfound )
-			return "";
-	}
-	else if( wtype == WhitelistType::Write )
+	char fullpath[max_tempbuffer_len] = { 0 };
+	if( wtype == WhitelistType::Write )
 	{
 		const auto searchpath = whitelist_writepaths.find( pathid );
 		if( searchpath == whitelist_writepaths.end( ) )
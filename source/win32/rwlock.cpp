@@ -0,0 +1,39 @@
+#include "rwlock.hpp"
+
+#include <Windows.h>
+
+namespace filesystem
+{
+
+static_assert( sizeof( void * ) == sizeof( SRWLOCK ), "SRWLOCK doesn't fit in a pointer" );
+
+ReadWriteLock::ReadWriteLock( ) :
+	lock( nullptr )
+{
+	InitializeSRWLock( reinterpret_cast<PSRWLOCK>( &lock ) );
+}
+
+ReadWriteLock::~ReadWriteLock( )
+{ }
+
+void ReadWriteLock::LockRead( )
+{
+	AcquireSRWLockShared( reinterpret_cast<PSRWLOCK>( &lock ) );
+}
+
+void ReadWriteLock::UnlockRead( )
+{
+	ReleaseSRWLockShared( reinterpret_cast<PSRWLOCK>( &lock ) );
+}
+
+void ReadWriteLock::LockWrite( )
+{
+	AcquireSRWLockExclusive( reinterpret_cast<PSRWLOCK>( &lock ) );
+}
+
+void ReadWriteLock::UnlockWrite( )
+{
+	ReleaseSRWLockExclusive( reinterpret_cast<PSRWLOCK>( &lock ) );
+}
+
+}
@@ -0,0 +1,152 @@
+#include "treecopier.hpp"
+#include "unicode.hpp"
+
+#include <string>
+#include <atomic>
+#include <Windows.h>
+
+namespace filesystem
+{
+
+static bool IsRealDirectory( const std::wstring &wpath )
+{
+	const DWORD attributes = GetFileAttributesW( wpath.c_str( ) );
+	return attributes != INVALID_FILE_ATTRIBUTES &&
+		( attributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 &&
+		( attributes & FILE_ATTRIBUTE_REPARSE_POINT ) == 0;
+}
+
+// volume and file index of wpath itself, never of what a reparse point leads to
+static bool GetFileIdentity( const std::wstring &wpath, BY_HANDLE_FILE_INFORMATION &information )
+{
+	const HANDLE handle = CreateFileW(
+		wpath.c_str( ),
+		FILE_READ_ATTRIBUTES,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT,
+		nullptr
+	);
+	if( handle == INVALID_HANDLE_VALUE )
+		return false;
+
+	const bool found = GetFileInformationByHandle( handle, &information ) != 0;
+	CloseHandle( handle );
+	return found;
+}
+
+// copies through a temporary file next to the destination, skipped tells reparse points and
+// directories apart from failures
+static bool CopyOne( const std::string &source, const std::string &destination, bool overwrite, uint64_t &bytes, bool &skipped )
+{
+	static std::atomic<uint64_t> counter( 0 );
+
+	skipped = false;
+
+	const std::wstring wsource = Unicode::UTF8::ToUTF16( source.begin( ), source.end( ) ),
+		wdestination = Unicode::UTF8::ToUTF16( destination.begin( ), destination.end( ) );
+
+	WIN32_FILE_ATTRIBUTE_DATA file_data;
+	if( !GetFileAttributesExW( wsource.c_str( ), GetFileExInfoStandard, &file_data ) )
+		return false;
+
+	if( ( file_data.dwFileAttributes & ( FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT ) ) != 0 )
+	{
+		skipped = true;
+		return false;
+	}
+
+	// the rename couldn't lose the file's data anymore, but a file copied over itself is still refused
+	BY_HANDLE_FILE_INFORMATION existing, copied;
+	if( GetFileIdentity( wdestination, existing ) &&
+		( !overwrite || ( existing.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 ||
+		( GetFileIdentity( wsource, copied ) &&
+		existing.dwVolumeSerialNumber == copied.dwVolumeSerialNumber &&
+		existing.nFileIndexHigh == copied.nFileIndexHigh &&
+		existing.nFileIndexLow == copied.nFileIndexLow ) ) )
+		return false;
+
+	const size_t separator = wdestination.find_last_of( L"/\\" );
+	const std::wstring wtemporary = ( separator != wdestination.npos ? wdestination.substr( 0, separator + 1 ) : std::wstring( ) ) +
+		L".gm_filesystem." + std::to_wstring( GetCurrentProcessId( ) ) + L'.' + std::to_wstring( counter++ ) + L".tmp";
+
+	// the system copy engine already clones blocks on ReFS and copies with no user mode buffers
+	if( !CopyFileExW( wsource.c_str( ), wtemporary.c_str( ), nullptr, nullptr, nullptr, COPY_FILE_FAIL_IF_EXISTS ) )
+		return false;
+
+	if( !MoveFileExW( wtemporary.c_str( ), wdestination.c_str( ), overwrite ? MOVEFILE_REPLACE_EXISTING : 0 ) )
+	{
+		DeleteFileW( wtemporary.c_str( ) );
+		return false;
+	}
+
+	bytes += ( static_cast<uint64_t>( file_data.nFileSizeHigh ) << 32 ) | file_data.nFileSizeLow;
+	return true;
+}
+
+bool TreeCopier::CopyFileContents(
+	const std::string &source,
+	const std::string &destination,
+	bool overwrite,
+	uint64_t &bytes
+)
+{
+	bool skipped = false;
+	return CopyOne( source, destination, overwrite, bytes, skipped );
+}
+
+bool TreeCopier::OpenRoots( )
+{
+	// nothing to keep open, entries are copied by full path
+	const std::wstring wsource = Unicode::UTF8::ToUTF16( source.begin( ), source.end( ) ),
+		wdestination = Unicode::UTF8::ToUTF16( destination.begin( ), destination.end( ) );
+	if( !IsRealDirectory( wsource ) )
+		return false;
+
+	source_handle = 0;
+	if( !CreateDirectoryW( wdestination.c_str( ), nullptr ) && !IsRealDirectory( wdestination ) )
+		return false;
+
+	destination_handle = 0;
+	return true;
+}
+
+void TreeCopier::CloseRoots( )
+{
+	source_handle = destination_handle = -1;
+}
+
+bool TreeCopier::MakeDirectory( const std::string &relative ) const
+{
+	const std::string fullpath = destination + '/' + relative;
+	const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+	return CreateDirectoryW( wpath.c_str( ), nullptr ) || IsRealDirectory( wpath );
+}
+
+bool TreeCopier::CopyFiles(
+	const std::string &directory,
+	const std::vector<std::string> &names,
+	uint64_t &files,
+	uint64_t &bytes,
+	uint64_t &skipped
+) const
+{
+	const std::string prefix = directory.empty( ) ? std::string( "/" ) : '/' + directory + '/';
+
+	bool complete = true;
+	for( auto it = names.begin( ); it != names.end( ); ++it )
+	{
+		bool link = false;
+		if( CopyOne( source + prefix + *it, destination + prefix + *it, overwrite, bytes, link ) )
+			++files;
+		else if( link )
+			++skipped;
+		else
+			complete = false;
+	}
+
+	return complete;
+}
+
+}
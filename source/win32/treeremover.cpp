@@ -0,0 +1,74 @@
+#include "treeremover.hpp"
+#include "unicode.hpp"
+
+#include <Windows.h>
+
+namespace filesystem
+{
+
+static bool RemoveFile( const std::string &fullpath, uint64_t &entries, uint64_t &bytes )
+{
+	const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+
+	WIN32_FILE_ATTRIBUTE_DATA file_data;
+	const bool sized = GetFileAttributesExW( wpath.c_str( ), GetFileExInfoStandard, &file_data ) != 0;
+
+	// junctions and directory links are removed themselves, never what they point to
+	const BOOL removed = sized && ( file_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 ?
+		RemoveDirectoryW( wpath.c_str( ) ) :
+		DeleteFileW( wpath.c_str( ) );
+	if( !removed )
+		return false;
+
+	++entries;
+	if( sized && ( file_data.dwFileAttributes & ( FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT ) ) == 0 )
+		bytes += ( static_cast<uint64_t>( file_data.nFileSizeHigh ) << 32 ) | file_data.nFileSizeLow;
+
+	return true;
+}
+
+bool TreeRemover::OpenRoot( )
+{
+	// nothing to keep open, entries are removed by full path
+	const std::wstring wpath = Unicode::UTF8::ToUTF16( root.begin( ), root.end( ) );
+	const DWORD attributes = GetFileAttributesW( wpath.c_str( ) );
+	handle = attributes != INVALID_FILE_ATTRIBUTES &&
+		( attributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 &&
+		( attributes & FILE_ATTRIBUTE_REPARSE_POINT ) == 0 ? 0 : -1;
+	return handle != -1;
+}
+
+void TreeRemover::CloseRoot( )
+{
+	handle = -1;
+}
+
+bool TreeRemover::RemoveFiles(
+	const std::string &directory,
+	const std::vector<std::string> &names,
+	uint64_t &entries,
+	uint64_t &bytes
+) const
+{
+	const std::string prefix = directory.empty( ) ? root + '/' : root + '/' + directory + '/';
+
+	bool complete = true;
+	for( auto it = names.begin( ); it != names.end( ); ++it )
+		complete = RemoveFile( prefix + *it, entries, bytes ) && complete;
+
+	return complete;
+}
+
+bool TreeRemover::RemoveEmptyDirectory( const std::string &relative ) const
+{
+	const std::string fullpath = relative.empty( ) ? root : root + '/' + relative;
+	const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+	return RemoveDirectoryW( wpath.c_str( ) ) != 0;
+}
+
+bool TreeRemover::RemoveRootFile( uint64_t &entries, uint64_t &bytes ) const
+{
+	return RemoveFile( root, entries, bytes );
+}
+
+}
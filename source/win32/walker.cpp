@@ -0,0 +1,85 @@
+#include "walker.hpp"
+#include "unicode.hpp"
+
+#include <Windows.h>
+
+namespace filesystem
+{
+
+intptr_t Walker::OpenRoot( const std::string &path )
+{
+	// nothing to keep open, directories are listed by full path
+	const std::wstring wpath = Unicode::UTF8::ToUTF16( path.begin( ), path.end( ) );
+	const DWORD attributes = GetFileAttributesW( wpath.c_str( ) );
+	return attributes != INVALID_FILE_ATTRIBUTES && ( attributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 ? 0 : -1;
+}
+
+void Walker::CloseRoot( intptr_t )
+{ }
+
+bool Walker::ReadDirectory(
+	const Root &root,
+	const std::string &relative,
+	bool stat,
+	std::vector<char> &,
+	Listing &listing
+)
+{
+	std::string path = root.path;
+	if( !relative.empty( ) )
+	{
+		path += '\\';
+		path += relative;
+	}
+
+	std::wstring wpath = Unicode::UTF8::ToUTF16( path.begin( ), path.end( ) );
+	for( auto it = wpath.begin( ); it != wpath.end( ); ++it )
+		if( *it == L'/' )
+			*it = L'\\';
+
+	const std::wstring wdirectory = wpath + L'\\';
+	wpath += L"\\*";
+
+	WIN32_FIND_DATAW find_data;
+	HANDLE handle = FindFirstFileExW(
+		wpath.c_str( ),
+		FindExInfoBasic,
+		&find_data,
+		FindExSearchNameMatch,
+		nullptr,
+		FIND_FIRST_EX_LARGE_FETCH
+	);
+	if( handle == INVALID_HANDLE_VALUE )
+		return false;
+
+	do
+	{
+		const std::wstring name = find_data.cFileName;
+		if( name.compare( L"." ) == 0 || name.compare( L".." ) == 0 )
+			continue;
+
+		// reparse points (junctions, symbolic links) are listed as files so the walk never loops
+		const bool directory = ( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 &&
+			( find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) == 0;
+		// listings carry sizes already, what compression and sparse files actually take costs a call
+		const uint64_t size = directory ? 0 :
+			( static_cast<uint64_t>( find_data.nFileSizeHigh ) << 32 ) | find_data.nFileSizeLow;
+		uint64_t allocated = 0;
+		if( stat && !directory )
+		{
+			const std::wstring wfile = wdirectory + name;
+			DWORD high = 0;
+			const DWORD low = GetCompressedFileSizeW( wfile.c_str( ), &high );
+			if( low != INVALID_FILE_SIZE || GetLastError( ) == NO_ERROR )
+				allocated = ( static_cast<uint64_t>( high ) << 32 ) | low;
+		}
+
+		listing.push_back( Listed{ Unicode::UTF16::ToUTF8( name.begin( ), name.end( ) ), directory, size, allocated } );
+	}
+	while( FindNextFileW( handle, &find_data ) );
+
+	FindClose( handle );
+	return true;
+}
+
+}
@@ -0,0 +1,216 @@
+#include "watcher.hpp"
+#include "unicode.hpp"
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <tuple>
+
+#include <Windows.h>
+
+namespace filesystem
+{
+
+static const DWORD notify_filter =
+	FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES |
+	FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+
+// notification buffers over 64 KiB fail on network shares
+static const size_t notify_buffer_size = 64 * 1024;
+
+struct DirectoryWatch
+{
+	std::string path;
+	HANDLE handle;
+	OVERLAPPED overlapped;
+	std::vector<DWORD> buffer;
+
+	// queues the next read, returns false when the directory can't be watched anymore
+	bool Issue( )
+	{
+		overlapped = OVERLAPPED( );
+		return ReadDirectoryChangesW(
+			handle,
+			buffer.data( ),
+			static_cast<DWORD>( buffer.size( ) * sizeof( DWORD ) ),
+			FALSE,
+			notify_filter,
+			nullptr,
+			&overlapped,
+			nullptr
+		) != 0;
+	}
+
+	~DirectoryWatch( )
+	{
+		// the kernel writes to our buffer until the read is really cancelled
+		DWORD bytes = 0;
+		if( CancelIoEx( handle, &overlapped ) || GetLastError( ) != ERROR_NOT_FOUND )
+			GetOverlappedResult( handle, &overlapped, &bytes, TRUE );
+
+		CloseHandle( handle );
+	}
+};
+
+struct DirectoryWatches
+{
+	int32_t next;
+	std::unordered_map<int32_t, std::unique_ptr<DirectoryWatch>> entries;
+	std::unordered_map<std::string, int32_t> ids;
+};
+
+Watcher::Watcher( ) :
+	watches( new DirectoryWatches( ) )
+{ }
+
+Watcher::~Watcher( )
+{
+	delete static_cast<DirectoryWatches *>( watches );
+}
+
+bool Watcher::Available( ) const
+{
+	return true;
+}
+
+int32_t Watcher::Add( const std::string &directory )
+{
+	DirectoryWatches &state = *static_cast<DirectoryWatches *>( watches );
+	const auto found = state.ids.find( directory );
+	if( found != state.ids.end( ) )
+		return found->second;
+
+	// like IN_DONT_FOLLOW, a junction or link in place of the directory isn't watched
+	const std::wstring wpath = Unicode::UTF8::ToUTF16( directory.begin( ), directory.end( ) );
+	const DWORD attributes = GetFileAttributesW( wpath.c_str( ) );
+	if( attributes == INVALID_FILE_ATTRIBUTES ||
+		( attributes & FILE_ATTRIBUTE_DIRECTORY ) == 0 ||
+		( attributes & FILE_ATTRIBUTE_REPARSE_POINT ) != 0 )
+		return -1;
+
+	HANDLE handle = CreateFileW(
+		wpath.c_str( ),
+		FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_OVERLAPPED,
+		nullptr
+	);
+	if( handle == INVALID_HANDLE_VALUE )
+		return -1;
+
+	std::unique_ptr<DirectoryWatch> watch( new DirectoryWatch );
+	watch->path = directory;
+	watch->handle = handle;
+	watch->buffer.resize( notify_buffer_size / sizeof( DWORD ) );
+	if( !watch->Issue( ) )
+		return -1;
+
+	const int32_t id = state.next++;
+	state.ids[directory] = id;
+	state.entries[id] = std::move( watch );
+	return id;
+}
+
+void Watcher::Remove( int32_t id )
+{
+	DirectoryWatches &state = *static_cast<DirectoryWatches *>( watches );
+	const auto it = state.entries.find( id );
+	if( it == state.entries.end( ) )
+		return;
+
+	state.ids.erase( it->second->path );
+	state.entries.erase( it );
+}
+
+void Watcher::Poll( const Callback &callback )
+{
+	DirectoryWatches &state = *static_cast<DirectoryWatches *>( watches );
+
+	// callbacks are free to add or remove watches, so they only run after the sweep
+	std::vector<std::tuple<int32_t, std::string, uint32_t>> pending;
+	for( auto it = state.entries.begin( ); it != state.entries.end( ); )
+	{
+		DirectoryWatch &watch = *it->second;
+		DWORD bytes = 0;
+		if( !GetOverlappedResult( watch.handle, &watch.overlapped, &bytes, FALSE ) )
+		{
+			if( GetLastError( ) == ERROR_IO_INCOMPLETE )
+			{
+				++it;
+				continue;
+			}
+
+			pending.emplace_back( it->first, std::string( ), Gone );
+			state.ids.erase( watch.path );
+			it = state.entries.erase( it );
+			continue;
+		}
+
+		// a completed read with no data means the buffer overflowed
+		if( bytes == 0 )
+			pending.emplace_back( -1, std::string( ), Overflow );
+
+		const char *data = reinterpret_cast<const char *>( watch.buffer.data( ) );
+		for( DWORD offset = 0; bytes != 0 && offset < bytes; )
+		{
+			const FILE_NOTIFY_INFORMATION *info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>( data + offset );
+			const wchar_t *wname = info->FileName;
+			const std::string name = Unicode::UTF16::ToUTF8( wname, wname + info->FileNameLength / sizeof( wchar_t ) );
+
+			uint32_t events = 0;
+			switch( info->Action )
+			{
+				case FILE_ACTION_ADDED:
+					events = Created;
+					break;
+
+				case FILE_ACTION_REMOVED:
+					events = Removed;
+					break;
+
+				case FILE_ACTION_MODIFIED:
+					events = Modified;
+					break;
+
+				case FILE_ACTION_RENAMED_OLD_NAME:
+				case FILE_ACTION_RENAMED_NEW_NAME:
+					events = Renamed;
+					break;
+			}
+
+			if( ( events & ( Created | Renamed ) ) != 0 )
+			{
+				const std::string fullpath = watch.path + '\\' + name;
+				const std::wstring wpath = Unicode::UTF8::ToUTF16( fullpath.begin( ), fullpath.end( ) );
+				const DWORD attributes = GetFileAttributesW( wpath.c_str( ) );
+				if( attributes != INVALID_FILE_ATTRIBUTES && ( attributes & FILE_ATTRIBUTE_DIRECTORY ) != 0 )
+					events |= Directory;
+			}
+
+			if( events != 0 )
+				pending.emplace_back( it->first, name, events );
+
+			if( info->NextEntryOffset == 0 )
+				break;
+
+			offset += info->NextEntryOffset;
+		}
+
+		if( !watch.Issue( ) )
+		{
+			pending.emplace_back( it->first, std::string( ), Gone );
+			state.ids.erase( watch.path );
+			it = state.entries.erase( it );
+			continue;
+		}
+
+		++it;
+	}
+
+	for( auto it = pending.begin( ); it != pending.end( ); ++it )
+		callback( std::get<0>( *it ), std::get<1>( *it ), std::get<2>( *it ) );
+}
+
+}